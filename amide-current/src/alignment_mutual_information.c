@@ -107,8 +107,8 @@ gdouble calculate_mutual_information(AmitkDataSet * fixed_ds, AmitkDataSet * mov
 	amitk_object_unref(AMITK_OBJECT(fixed_slice[i_view]));
 
       /* compute the fixed slices of data */
-      fixed_slice[i_view] = amitk_data_set_get_slice(fixed_ds, view_start_time, view_duration, -1, pixel_size, 
-						     view_volume);
+      fixed_slice[i_view] = amitk_data_set_get_pyramid_slice(fixed_ds, view_start_time, view_duration, -1, pixel_size, 
+							     view_volume);
     }
 
     /* update the view volume by a transform to take into account the rotations/translations we're doing */
@@ -124,8 +124,8 @@ gdouble calculate_mutual_information(AmitkDataSet * fixed_ds, AmitkDataSet * mov
     amitk_space_set_offset(AMITK_SPACE(view_volume), temp_offset);
 
     /* now calculate the slice from the moving data set, and calculate the corresponding MI */
-    moving_slice = amitk_data_set_get_slice(moving_ds, view_start_time, view_duration, -1, pixel_size, 
-					    view_volume);
+    moving_slice = amitk_data_set_get_pyramid_slice(moving_ds, view_start_time, view_duration, -1, pixel_size, 
+						    view_volume);
 
     /* calculate the mutual information */
     i_voxel = zero_voxel;
@@ -305,6 +305,10 @@ AmitkSpace * alignment_mutual_information(AmitkDataSet * moving_ds,
   step_size = INITIAL_STEP_SIZE;
   fixed_slices_current = FALSE;
 
+  /* we're sampling coarsely, so work from the reduced resolution copies of the data */
+  amitk_data_set_calc_pyramid(fixed_ds, update_func, update_data);
+  amitk_data_set_calc_pyramid(moving_ds, update_func, update_data);
+
   /* set baseline characteristics, including baseline space and initial error */
   best_mi = calculate_mutual_information(fixed_ds, moving_ds, new_space, step_size, &fixed_slices_current, fixed_slice,
 					 view_center, thickness, view_start_time, view_duration);
@@ -193,6 +193,11 @@ int main (int argc, char *argv []) {
   //  textdomain(GETTEXT_PACKAGE);
 
 
+  /* worker threads are used for slice generation and other number crunching */
+#if !GLIB_CHECK_VERSION(2,32,0)
+  if (!g_thread_supported()) g_thread_init(NULL);
+#endif
+
 #if defined (G_PLATFORM_WIN32)
   /* if setlocale is called on win32, we can't seem to reset the locale back to "C"
      to allow correct reading in of text data */
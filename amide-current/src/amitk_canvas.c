@@ -174,7 +174,6 @@ static void canvas_time_changed_cb(AmitkStudy * study, gpointer canvas);
 static void canvas_volume_changed_cb(AmitkVolume * vol, gpointer canvas);
 static void canvas_roi_changed_cb(AmitkRoi * roi, gpointer canvas);
 static void canvas_fiducial_mark_changed_cb(AmitkFiducialMark * fm, gpointer canvas);
-static void canvas_data_set_invalidate_slice_cache(AmitkDataSet * ds, gpointer data);
 static void data_set_changed_cb(AmitkDataSet * ds, gpointer canvas);
 static void data_set_subject_orientation_changed_cb(AmitkDataSet * ds, gpointer canvas);
 static void data_set_thresholding_changed_cb(AmitkDataSet * ds, gpointer data);
@@ -195,7 +194,8 @@ static void canvas_update_arrows(AmitkCanvas * canvas);
 static void canvas_update_line_profile(AmitkCanvas * canvas);
 static void canvas_update_time_on_image(AmitkCanvas * canvas);
 static void canvas_update_subject_orientation(AmitkCanvas * canvas);
-static void canvas_update_pixbuf(AmitkCanvas * canvas);
+static void canvas_render_cancel(AmitkCanvas * canvas);
+static void canvas_update_pixbuf(AmitkCanvas * canvas, const gboolean in_background);
 static void canvas_update_object(AmitkCanvas * canvas, AmitkObject * object);
 static void canvas_update_objects(AmitkCanvas * canvas, gboolean all);
 static void canvas_update_setup(AmitkCanvas * canvas);
@@ -326,8 +326,6 @@ static void canvas_init (AmitkCanvas *canvas)
   canvas->active_object = NULL;
 
   canvas->canvas = NULL;
-  canvas->slice_cache = NULL;
-  canvas->max_slice_cache_size = 15;
   canvas->slices=NULL;
   canvas->image=NULL;
   canvas->pixbuf=NULL;
@@ -345,6 +343,12 @@ static void canvas_init (AmitkCanvas *canvas)
   canvas->next_update = 0;
   canvas->idle_handler_id = 0;
   canvas->next_update_objects = NULL;
+  canvas->render = NULL;
+
+  canvas->prefetch_center = zero_point;
+  canvas->prefetch_start = 0.0;
+  canvas->prefetch_duration = -1.0;
+  canvas->prefetch_gates = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 }
 
@@ -362,6 +366,14 @@ static void canvas_destroy (GtkObject * object) {
     canvas->idle_handler_id = 0;
   }
 
+  canvas_render_cancel(canvas);
+  amitk_data_sets_prefetch_cancel(canvas);
+
+  if (canvas->prefetch_gates != NULL) {
+    g_hash_table_destroy(canvas->prefetch_gates);
+    canvas->prefetch_gates = NULL;
+  }
+
   if (canvas->next_update_objects != NULL) {
     canvas->next_update_objects = amitk_objects_unref(canvas->next_update_objects);
   }
@@ -369,10 +381,6 @@ static void canvas_destroy (GtkObject * object) {
   if (canvas->volume != NULL) 
     canvas->volume = amitk_object_unref(canvas->volume);
 
-  if (canvas->slice_cache != NULL) {
-    canvas->slice_cache = amitk_objects_unref(canvas->slice_cache);
-  }
-
   if (canvas->slices != NULL) {
     canvas->slices = amitk_objects_unref(canvas->slices);
   }
@@ -658,17 +666,6 @@ static void canvas_fiducial_mark_changed_cb(AmitkFiducialMark * fm, gpointer dat
   return;
 }
 
-static void canvas_data_set_invalidate_slice_cache(AmitkDataSet * ds, gpointer data) {
-
-  AmitkCanvas * canvas = data;  
-
-  g_return_if_fail(AMITK_IS_CANVAS(canvas));
-  g_return_if_fail(AMITK_IS_DATA_SET(ds));
-
-  canvas->slice_cache = amitk_data_sets_remove_with_slice_parent(canvas->slice_cache, ds);
-
-}
-
 static void data_set_changed_cb(AmitkDataSet * ds, gpointer data) {
 
   AmitkCanvas * canvas = data;  
@@ -2443,14 +2440,13 @@ static void canvas_scrollbar_adjustment_cb(GtkObject * adjustment, gpointer data
 }
 
 
-static gboolean canvas_recalc_corners(AmitkCanvas * canvas) {
+/* figures out the volume the canvas would show when centered on center */
+static gboolean canvas_calc_display_volume(AmitkCanvas * canvas, AmitkPoint center, 
+					   AmitkVolume * volume) {
 
   GList * volumes;
   gboolean changed;
 
-  /* sanity checks */
-  if (canvas->study == NULL) return FALSE; 
-
   /* what volumes are we looking at - ignore ROI's */
   if (AMITK_STUDY_CANVAS_MAINTAIN_SIZE(canvas->study)) {
     volumes = amitk_object_get_children_of_type(AMITK_OBJECT(canvas->study), 
@@ -2465,15 +2461,23 @@ static gboolean canvas_recalc_corners(AmitkCanvas * canvas) {
 
   changed = amitk_volumes_calc_display_volume(volumes, 
 					      AMITK_SPACE(canvas->volume), 
-					      canvas->center, 
+					      center, 
 					      AMITK_VOLUME_Z_CORNER(canvas->volume),
 					      AMITK_STUDY_FOV(canvas->study),
-					      canvas->volume);
+					      volume);
   amitk_objects_unref(volumes);
 
   return changed;
 }
 
+static gboolean canvas_recalc_corners(AmitkCanvas * canvas) {
+
+  /* sanity checks */
+  if (canvas->study == NULL) return FALSE; 
+
+  return canvas_calc_display_volume(canvas, canvas->center, canvas->volume);
+}
+
 
 /* function to update the adjustment settings for the scrollbar */
 static void canvas_update_scrollbar(AmitkCanvas * canvas, AmitkPoint center, amide_real_t thickness) {
@@ -3223,9 +3227,385 @@ static void canvas_update_subject_orientation(AmitkCanvas * canvas) {
 
 
 
-static void canvas_update_pixbuf(AmitkCanvas * canvas) {
+/* resizes the canvas to fit an image of the given size */
+static void canvas_set_size(AmitkCanvas * canvas, const gint width, const gint height) {
+
+  if ((width == canvas->pixbuf_width) && (height == canvas->pixbuf_height) && 
+      (canvas->image != NULL))
+    return;
+
+  canvas->pixbuf_width = width;
+  canvas->pixbuf_height = height;
+
+  /* reset the min size of the widget and set the scroll region */
+  gtk_widget_set_size_request(canvas->canvas, 
+			      canvas->pixbuf_width + 2 * canvas->border_width, 
+			      canvas->pixbuf_height + 2 * canvas->border_width);
+  gnome_canvas_set_scroll_region(GNOME_CANVAS(canvas->canvas), 0.0, 0.0, 
+				 canvas->pixbuf_width + 2 * canvas->border_width,
+				 canvas->pixbuf_height + 2 * canvas->border_width);
+
+  return;
+}
+
+/* puts up a new image, takes over the reference to the pixbuf */
+static void canvas_set_pixbuf(AmitkCanvas * canvas, GdkPixbuf * pixbuf) {
+
+  if (canvas->pixbuf != NULL) 
+    g_object_unref(canvas->pixbuf);
+  canvas->pixbuf = pixbuf;
+
+  if (canvas->pixbuf == NULL) return;
+
+  /* record the width and height for future use*/
+  canvas_set_size(canvas, gdk_pixbuf_get_width(canvas->pixbuf), 
+		  gdk_pixbuf_get_height(canvas->pixbuf));
+
+  /* put the canvas rgb image on the canvas_image */
+  if (canvas->image == NULL) {/* time to make a new image */
+    canvas->image = gnome_canvas_item_new(gnome_canvas_root(GNOME_CANVAS(canvas->canvas)),
+					  gnome_canvas_pixbuf_get_type(),
+					  "pixbuf", canvas->pixbuf,
+					  "x", (double) canvas->border_width,
+					  "y", (double) canvas->border_width,
+					  NULL);
+    g_signal_connect(G_OBJECT(canvas->image), "event", G_CALLBACK(canvas_event_cb), canvas);
+  } else {
+    gnome_canvas_item_set(canvas->image, "pixbuf", canvas->pixbuf, NULL);
+  }
+
+  return;
+}
+
+/* takes over the reference to slices */
+static void canvas_set_slices(AmitkCanvas * canvas, GList * slices) {
+
+  gboolean had_slices;
+
+  had_slices = (canvas->slices != NULL);
+  amitk_objects_unref(canvas->slices);
+  canvas->slices = slices;
+
+  /* these are hidden when we don't have any slices, and need to be redone from
+     the new slices if we do */
+  if (had_slices != (canvas->slices != NULL))
+    canvas_add_update(canvas, UPDATE_ARROWS | UPDATE_TARGET);
+  if (canvas->slices != NULL)
+    canvas_add_update(canvas, UPDATE_LINE_PROFILE);
+
+  return;
+}
+
+
+/* Large views get sliced and blended on the render thread, so the user
+   interface keeps going while this happens. A newer render cancels any
+   older renders that haven't gotten started yet, and a preview at reduced 
+   resolution gets put up while the full resolution image is being worked on.
+
+   All references to objects are taken and dropped on the main thread, the
+   render thread only ever sees the render's image_fuse_t's.  Note that the data
+   sets' voxels can still get changed out from under the render thread (e.g. 
+   by erasing inside an roi), but the canvas will get an update and the 
+   stale image will get thrown out. */
+#define CANVAS_PREVIEW_REDUCTION 4 /* preview pixels are this many times larger */
+#define CANVAS_PREVIEW_MIN_PIXELS (192*192) /* smaller than this, don't bother with a preview */
+
+struct _AmitkCanvasRender {
+  gint ref_count; /* changed atomically */
+  gint cancelled; /* changed atomically */
+  AmitkCanvas * canvas; /* referenced */
+  gint width;
+  gint height;
+
+  image_fuse_t * preview; /* NULL if we're not doing one */
+  image_fuse_t * full;
+  gboolean preview_ran;
+  gboolean full_ran;
+  GdkPixbuf * preview_pixbuf;
+  GdkPixbuf * pixbuf;
+  gboolean applied; /* only touched from the main thread */
+};
+
+static AmitkCanvasRender * canvas_render_new(AmitkCanvas * canvas, image_fuse_t * full, 
+					     image_fuse_t * preview, 
+					     const gint width, const gint height) {
+
+  AmitkCanvasRender * render;
+
+  render = g_new0(AmitkCanvasRender, 1);
+  render->ref_count = 1;
+  render->canvas = g_object_ref(canvas);
+  render->width = width;
+  render->height = height;
+  render->full = full;
+  render->preview = preview;
+
+  return render;
+}
+
+/* main thread only, as this drops references to objects */
+static void canvas_render_unref(AmitkCanvasRender * render) {
+
+  if (!g_atomic_int_dec_and_test(&(render->ref_count)))
+    return;
+
+  /* finishing off the fuses puts any new slices into the cache, so even 
+     stale renders can save us some work if the user comes back this way */
+  if (render->preview != NULL) {
+    if (render->preview_ran)
+      amitk_objects_unref(image_fuse_finish(render->preview));
+    else
+      image_fuse_free(render->preview);
+  }
+  if (render->full != NULL) {
+    if (render->full_ran)
+      amitk_objects_unref(image_fuse_finish(render->full));
+    else
+      image_fuse_free(render->full);
+  }
+
+  if (render->preview_pixbuf != NULL)
+    g_object_unref(render->preview_pixbuf);
+  if (render->pixbuf != NULL)
+    g_object_unref(render->pixbuf);
+  g_object_unref(render->canvas);
+  g_free(render);
+
+  return;
+}
+
+/* stops the canvas's current render, if any */
+static void canvas_render_cancel(AmitkCanvas * canvas) {
+
+  if (canvas->render == NULL) return;
+
+  g_atomic_int_set(&(canvas->render->cancelled), TRUE);
+  canvas_render_unref(canvas->render);
+  canvas->render = NULL;
+
+  return;
+}
+
+/* puts the results of the render up on the canvas, main thread only */
+static void canvas_render_apply(AmitkCanvasRender * render) {
+
+  AmitkCanvas * canvas = render->canvas;
+  GList * slices;
+
+  if (render->applied) return;
+  render->applied = TRUE;
+
+  if (canvas->render != render) return; /* stale */
+
+  if (render->full_ran) {
+    slices = image_fuse_finish(render->full);
+    render->full = NULL;
+    if (render->pixbuf != NULL) {
+      canvas_set_slices(canvas, slices);
+      canvas_set_pixbuf(canvas, render->pixbuf);
+      render->pixbuf = NULL;
+    } else {
+      g_warning(_("couldn't allocate memory for rgb_data for image"));
+      amitk_objects_unref(slices);
+    }
+  }
+
+  canvas_render_cancel(canvas);
+
+  return;
+}
+
+static gboolean canvas_render_preview_cb(gpointer data) {
+
+  AmitkCanvasRender * render = data;
+
+  if ((!render->applied) && (render->canvas->render == render) && 
+      (render->preview_pixbuf != NULL)) {
+    canvas_set_pixbuf(render->canvas, render->preview_pixbuf);
+    render->preview_pixbuf = NULL;
+  }
+  canvas_render_unref(render);
+
+  return FALSE;
+}
+
+static gboolean canvas_render_done_cb(gpointer data) {
+
+  AmitkCanvasRender * render = data;
+
+  canvas_render_apply(render);
+  canvas_render_unref(render);
+
+  return FALSE;
+}
+
+/* runs on the render thread */
+static void canvas_render_func(gpointer data, gpointer unused) {
+
+  AmitkCanvasRender * render = data;
+  GdkPixbuf * pixbuf;
+
+  if ((render->preview != NULL) && !g_atomic_int_get(&(render->cancelled))) {
+    pixbuf = image_fuse_run(render->preview);
+    render->preview_ran = TRUE;
+    if (pixbuf != NULL) {
+      render->preview_pixbuf = gdk_pixbuf_scale_simple(pixbuf, render->width, render->height,
+						       GDK_INTERP_BILINEAR);
+      g_object_unref(pixbuf);
+      g_atomic_int_inc(&(render->ref_count));
+      g_idle_add(canvas_render_preview_cb, render);
+    }
+  }
+
+  if (!g_atomic_int_get(&(render->cancelled))) {
+    render->pixbuf = image_fuse_run(render->full);
+    render->full_ran = TRUE;
+  }
+
+  /* our reference gets dropped back on the main thread */
+  g_idle_add(canvas_render_done_cb, render);
+
+  return;
+}
+
+/* the render thread, or NULL if we can't have one */
+static GThreadPool * canvas_get_render_pool(void) {
+
+  static GThreadPool * render_pool = NULL;
+  static gboolean initialized = FALSE;
+
+  if (!initialized) {
+    initialized = TRUE;
+#if !GLIB_CHECK_VERSION(2,32,0)
+    if (!g_thread_supported()) return NULL;
+#endif
+    render_pool = g_thread_pool_new(canvas_render_func, NULL, 1, FALSE, NULL);
+  }
+
+  return render_pool;
+}
+
+/* While the user steps through a study (scrolling through slices, going 
+   frame by frame, or cycling through gates), the slices a few more steps
+   along get generated in the background, so that they're already in the 
+   slice cache by the time they're wanted. Guesses left over from the last 
+   update get taken back first. */
+#define CANVAS_PREFETCH_STEPS 3
+
+static void canvas_prefetch(AmitkCanvas * canvas, GList * data_sets, amide_real_t pixel_dim) {
+
+  AmitkPoint z_axis;
+  AmitkPoint shift;
+  amide_real_t z_step;
+  amide_time_t start, duration;
+  amide_time_t time_step;
+  amide_time_t temp_time;
+  gint * gate_steps;
+  gboolean gate_stepping;
+  gint num_data_sets;
+  gint i_ds, i_step;
+  gpointer value;
+  AmitkCanvasPoint pixel_size;
+  AmitkVolume * prefetch_volume;
+  AmitkDataSet * ds;
+  GList * temp_data_sets;
+  GList * ds_list;
+  amide_intpoint_t temp_gate;
+  gboolean room;
+
+  amitk_data_sets_prefetch_cancel(canvas);
+
+  start = AMITK_STUDY_VIEW_START_TIME(canvas->study);
+  duration = AMITK_STUDY_VIEW_DURATION(canvas->study);
+  z_axis = amitk_space_get_axis(AMITK_SPACE(canvas->volume), AMITK_AXIS_Z);
+  num_data_sets = g_list_length(data_sets);
+  gate_steps = g_new0(gint, num_data_sets);
+
+  /* which way are things moving */
+  z_step = 0.0;
+  time_step = 0.0;
+  gate_stepping = FALSE;
+  if (canvas->prefetch_duration >= 0.0) { /* only if there's a last update to go by */
+    shift = point_sub(canvas->center, canvas->prefetch_center);
+    z_step = point_dot_product(shift, z_axis);
+    /* no guessing ahead if we're panning around */
+    if (point_mag(point_sub(shift, point_cmult(z_step, z_axis))) > 
+	AMITK_VOLUME_Z_CORNER(canvas->volume)) 
+      z_step = 0.0;
+
+    if (REAL_EQUAL(duration, canvas->prefetch_duration))
+      time_step = start - canvas->prefetch_start;
+
+    for (temp_data_sets = data_sets, i_ds=0; temp_data_sets != NULL; 
+	 temp_data_sets = temp_data_sets->next, i_ds++) {
+      ds = temp_data_sets->data;
+      if ((AMITK_DATA_SET_NUM_VIEW_GATES(ds) == 1) && (AMITK_DATA_SET_NUM_GATES(ds) > 1) &&
+	  g_hash_table_lookup_extended(canvas->prefetch_gates, ds, NULL, &value)) {
+	gate_steps[i_ds] = AMITK_DATA_SET_VIEW_START_GATE(ds) - GPOINTER_TO_INT(value);
+	if (gate_steps[i_ds] != 0) gate_stepping = TRUE;
+      }
+    }
+  }
+
+  /* remember where we are for next time */
+  canvas->prefetch_center = canvas->center;
+  canvas->prefetch_start = start;
+  canvas->prefetch_duration = duration;
+  g_hash_table_remove_all(canvas->prefetch_gates);
+  for (temp_data_sets = data_sets; temp_data_sets != NULL; temp_data_sets = temp_data_sets->next) 
+    g_hash_table_insert(canvas->prefetch_gates, temp_data_sets->data,
+			GINT_TO_POINTER(AMITK_DATA_SET_VIEW_START_GATE(temp_data_sets->data)));
+
+  if (EQUAL_ZERO(z_step) && EQUAL_ZERO(time_step) && !gate_stepping) {
+    g_free(gate_steps);
+    return;
+  }
+
+  pixel_size.x = pixel_size.y = pixel_dim;
+  prefetch_volume = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(canvas->volume)));
+  room = TRUE;
+
+  for (i_step=1; (i_step <= CANVAS_PREFETCH_STEPS) && room; i_step++) {
+    temp_time = start + i_step*time_step;
+    if (temp_time < 0.0) break;
+
+    canvas_calc_display_volume(canvas, 
+			       point_add(canvas->center, point_cmult(i_step*z_step, z_axis)),
+			       prefetch_volume);
+
+    if (!gate_stepping) {
+      room = amitk_data_sets_prefetch_slices(canvas, data_sets, temp_time, duration, -1,
+					     pixel_size, prefetch_volume);
+    } else { /* each data set goes through its own gates */
+      for (temp_data_sets = data_sets, i_ds=0; (temp_data_sets != NULL) && room; 
+	   temp_data_sets = temp_data_sets->next, i_ds++) {
+	ds = temp_data_sets->data;
+	if (gate_steps[i_ds] == 0) {
+	  temp_gate = -1;
+	} else {
+	  temp_gate = (AMITK_DATA_SET_VIEW_START_GATE(ds) + i_step*gate_steps[i_ds]) %
+	    AMITK_DATA_SET_NUM_GATES(ds);
+	  if (temp_gate < 0) temp_gate += AMITK_DATA_SET_NUM_GATES(ds);
+	}
+	ds_list = g_list_append(NULL, ds);
+	room = amitk_data_sets_prefetch_slices(canvas, ds_list, temp_time, duration, temp_gate,
+					       pixel_size, prefetch_volume);
+	g_list_free(ds_list);
+      }
+    }
+  }
+
+  amitk_object_unref(prefetch_volume);
+  g_free(gate_steps);
+
+  return;
+}
+
+
+/* in_background is FALSE if the image is needed right away (e.g. for
+   exporting the view), in which case it's all done on this thread */
+static void canvas_update_pixbuf(AmitkCanvas * canvas, const gboolean in_background) {
 
-  gint old_width, old_height;
   rgba_t blank_rgba;
   GtkStyle * widget_style;
   amide_real_t pixel_dim;
@@ -3233,23 +3613,28 @@ static void canvas_update_pixbuf(AmitkCanvas * canvas) {
   gint width,height;
   GList * data_sets;
   AmitkDataSet * active_ds;
+  image_fuse_t * full;
+  image_fuse_t * preview;
+  GThreadPool * render_pool;
+  GdkPixbuf * pixbuf;
+  GList * slices;
 
 
   /* sanity checks */
   g_return_if_fail(canvas->study != NULL);
 
-  old_width = canvas->pixbuf_width;
-  old_height = canvas->pixbuf_height;
-
-  /* free the previous pixbuf if possible */
-  if (canvas->pixbuf != NULL) {
-    g_object_unref(canvas->pixbuf);
-    canvas->pixbuf = NULL;
-  }
+  /* anything in the works is now out of date */
+  canvas_render_cancel(canvas);
 
   /* compensate for zoom */
   pixel_dim = (1/AMITK_STUDY_ZOOM(canvas->study))*AMITK_STUDY_VOXEL_DIM(canvas->study); 
 
+  corner = AMITK_VOLUME_CORNER(canvas->volume);
+  width = ceil(corner.x/pixel_dim);
+  if (width < 1) width = 1;
+  height =  ceil(corner.y/pixel_dim);
+  if (height < 1) height = 1;
+
   data_sets = amitk_object_get_selected_children_of_type(AMITK_OBJECT(canvas->study),
   							 AMITK_OBJECT_TYPE_DATA_SET,
   							 canvas->view_mode,
@@ -3270,67 +3655,70 @@ static void canvas_update_pixbuf(AmitkCanvas * canvas) {
     blank_rgba.b = widget_style->bg[GTK_STATE_NORMAL].blue >> 8;
     blank_rgba.a = 0xFF;
 
-    corner = AMITK_VOLUME_CORNER(canvas->volume);
-
-    width = ceil(corner.x/pixel_dim);
-    if (width < 1) width = 1;
-    height =  ceil(corner.y/pixel_dim);
-    if (height < 1) height = 1;
-				 
-    canvas->pixbuf = image_blank(width, height,blank_rgba);
-    amitk_objects_unref(canvas->slices);
-    canvas->slices = NULL;
+    canvas_set_pixbuf(canvas, image_blank(width, height,blank_rgba));
+    canvas_set_slices(canvas, NULL);
+    amitk_data_sets_prefetch_cancel(canvas);
+    return;
+  } 
 
-  } else {
-    if (AMITK_IS_DATA_SET(canvas->active_object))
-      active_ds = AMITK_DATA_SET(canvas->active_object);
-    else
-      active_ds = NULL;
-    canvas->pixbuf = image_from_data_sets(&(canvas->slices),
-					  &(canvas->slice_cache),
-					  canvas->max_slice_cache_size,
-					  data_sets,
-					  active_ds,
-					  AMITK_STUDY_VIEW_START_TIME(canvas->study),
-					  AMITK_STUDY_VIEW_DURATION(canvas->study),
-					  -1,
-					  pixel_dim,
-					  canvas->volume,
-					  AMITK_STUDY_FUSE_TYPE(canvas->study),
-					  AMITK_CANVAS_VIEW_MODE(canvas));
+  if (AMITK_IS_DATA_SET(canvas->active_object))
+    active_ds = AMITK_DATA_SET(canvas->active_object);
+  else
+    active_ds = NULL;
+
+  full = image_fuse_new(data_sets, active_ds,
+			AMITK_STUDY_VIEW_START_TIME(canvas->study),
+			AMITK_STUDY_VIEW_DURATION(canvas->study),
+			-1,
+			pixel_dim,
+			canvas->volume,
+			AMITK_STUDY_FUSE_TYPE(canvas->study),
+			AMITK_CANVAS_VIEW_MODE(canvas));
+  if (full == NULL) {
     amitk_objects_unref(data_sets);
+    return;
   }
 
-  if (canvas->pixbuf != NULL) {
-    /* record the width and height for future use*/
-    canvas->pixbuf_width = gdk_pixbuf_get_width(canvas->pixbuf);
-    canvas->pixbuf_height = gdk_pixbuf_get_height(canvas->pixbuf);
-
-    /* reset the min size of the widget and set the scroll region */
-    if ((old_width != canvas->pixbuf_width) || 
-	(old_height != canvas->pixbuf_height) || (canvas->image == NULL)) {
-      gtk_widget_set_size_request(canvas->canvas, 
-				  canvas->pixbuf_width + 2 * canvas->border_width, 
-				  canvas->pixbuf_height + 2 * canvas->border_width);
-      gnome_canvas_set_scroll_region(GNOME_CANVAS(canvas->canvas), 0.0, 0.0, 
-				     canvas->pixbuf_width + 2 * canvas->border_width,
-				     canvas->pixbuf_height + 2 * canvas->border_width);
-    }
-    /* put the canvas rgb image on the canvas_image */
-    if (canvas->image == NULL) {/* time to make a new image */
-      canvas->image = gnome_canvas_item_new(gnome_canvas_root(GNOME_CANVAS(canvas->canvas)),
-					    gnome_canvas_pixbuf_get_type(),
-					    "pixbuf", canvas->pixbuf,
-					    "x", (double) canvas->border_width,
-					    "y", (double) canvas->border_width,
-					    NULL);
-      g_signal_connect(G_OBJECT(canvas->image), "event", G_CALLBACK(canvas_event_cb), canvas);
+  /* the first image, fly through movies, and slices we already have are
+     done right away */
+  render_pool = canvas_get_render_pool();
+  if ((!in_background) || (render_pool == NULL) || (canvas->image == NULL) ||
+      (canvas->type == AMITK_CANVAS_TYPE_FLY_THROUGH) || image_fuse_cached(full)) {
+    pixbuf = image_fuse_run(full);
+    slices = image_fuse_finish(full);
+    if (pixbuf != NULL) {
+      canvas_set_slices(canvas, slices);
+      canvas_set_pixbuf(canvas, pixbuf);
     } else {
-      gnome_canvas_item_set(canvas->image, "pixbuf", canvas->pixbuf, NULL);
+      g_warning(_("couldn't allocate memory for rgb_data for image"));
+      amitk_objects_unref(slices);
     }
-    
+    canvas_prefetch(canvas, data_sets, pixel_dim);
+    amitk_objects_unref(data_sets);
+    return;
   }
 
+  /* get the objects on the canvas drawn at the right size in the meantime */
+  canvas_set_size(canvas, width, height);
+
+  preview = NULL;
+  if (width*height >= CANVAS_PREVIEW_MIN_PIXELS)
+    preview = image_fuse_new(data_sets, active_ds,
+			     AMITK_STUDY_VIEW_START_TIME(canvas->study),
+			     AMITK_STUDY_VIEW_DURATION(canvas->study),
+			     -1,
+			     CANVAS_PREVIEW_REDUCTION*pixel_dim,
+			     canvas->volume,
+			     AMITK_STUDY_FUSE_TYPE(canvas->study),
+			     AMITK_CANVAS_VIEW_MODE(canvas));
+
+  canvas->render = canvas_render_new(canvas, full, preview, width, height);
+  g_atomic_int_inc(&(canvas->render->ref_count)); /* for the render thread */
+  g_thread_pool_push(render_pool, canvas->render, NULL);
+
+  canvas_prefetch(canvas, data_sets, pixel_dim);
+  amitk_objects_unref(data_sets);
+
   return;
 }
 
@@ -3528,7 +3916,7 @@ static gboolean canvas_update_while_idle(gpointer data) {
     canvas->next_update = canvas->next_update | UPDATE_ALL;
 
   if (canvas->next_update & UPDATE_DATA_SETS) {
-    canvas_update_pixbuf(canvas);
+    canvas_update_pixbuf(canvas, TRUE);
   } 
   
   if (canvas->next_update & UPDATE_ARROWS) {
@@ -3623,7 +4011,6 @@ static void canvas_add_object(AmitkCanvas * canvas, AmitkObject * object) {
   }
   if (AMITK_IS_DATA_SET(object)) {
     g_signal_connect(G_OBJECT(object), "data_set_changed", G_CALLBACK(data_set_changed_cb), canvas);
-    g_signal_connect(G_OBJECT(object), "invalidate_slice_cache", G_CALLBACK(canvas_data_set_invalidate_slice_cache), canvas);
     g_signal_connect(G_OBJECT(object), "interpolation_changed", G_CALLBACK(data_set_changed_cb), canvas);
     g_signal_connect(G_OBJECT(object), "rendering_changed", G_CALLBACK(data_set_changed_cb), canvas);
     g_signal_connect(G_OBJECT(object), "thresholding_changed", G_CALLBACK(data_set_thresholding_changed_cb), canvas);
@@ -3704,11 +4091,9 @@ static void canvas_remove_object(AmitkCanvas * canvas, AmitkObject * object) {
   }
   if (AMITK_IS_DATA_SET(object)) {
     g_signal_handlers_disconnect_by_func(G_OBJECT(object), data_set_changed_cb, canvas);
-    g_signal_handlers_disconnect_by_func(G_OBJECT(object), canvas_data_set_invalidate_slice_cache, canvas);
     g_signal_handlers_disconnect_by_func(G_OBJECT(object), data_set_thresholding_changed_cb, canvas);
     g_signal_handlers_disconnect_by_func(G_OBJECT(object), data_set_color_table_changed_cb, canvas);
     g_signal_handlers_disconnect_by_func(G_OBJECT(object), data_set_subject_orientation_changed_cb, canvas);
-    canvas->slice_cache = amitk_data_sets_remove_with_slice_parent(canvas->slice_cache, AMITK_DATA_SET(object));
   }
   
   /* find corresponding CanvasItem and destroy */
@@ -3849,6 +4234,13 @@ GdkPixbuf * amitk_canvas_get_pixbuf(AmitkCanvas * canvas) {
 
   GdkPixbuf * pixbuf;
 
+  /* make sure we have the full resolution image up.  Rather than blocking
+     on the render thread, the image gets redone on this thread */
+  if (canvas->render != NULL) {
+    canvas_update_pixbuf(canvas, FALSE);
+    gnome_canvas_update_now(GNOME_CANVAS(canvas->canvas));
+  }
+
   pixbuf = amitk_get_pixbuf_from_canvas(GNOME_CANVAS(canvas->canvas), 
 					canvas->border_width,canvas->border_width,
 					canvas->pixbuf_width, canvas->pixbuf_height);
@@ -57,6 +57,7 @@ typedef enum {
 
 typedef struct _AmitkCanvas             AmitkCanvas;
 typedef struct _AmitkCanvasClass        AmitkCanvasClass;
+typedef struct _AmitkCanvasRender       AmitkCanvasRender;
 
 
 struct _AmitkCanvas
@@ -80,8 +81,6 @@ struct _AmitkCanvas
   AmitkObject * active_object;
 
   GList * slices;
-  GList * slice_cache;
-  gint max_slice_cache_size;
   gint pixbuf_width, pixbuf_height;
   gdouble border_width;
   GnomeCanvasItem * image;
@@ -97,6 +96,13 @@ struct _AmitkCanvas
   guint next_update;
   guint idle_handler_id;
   GList * next_update_objects;
+  AmitkCanvasRender * render; /* the image being worked on in the background, or NULL */
+
+  /* where things were at the last update, for guessing what's next */
+  AmitkPoint prefetch_center;
+  amide_time_t prefetch_start;
+  amide_time_t prefetch_duration; /* negative if no update yet */
+  GHashTable * prefetch_gates; /* data set -> view start gate */
 
   /* profile stuff */
   GnomeCanvasItem * line_profile_item;
@@ -60,8 +60,20 @@ gchar * color_table_menu_names[] = {
   N_("inverse NIH")
 };
 
+/* lookup tables for amitk_color_table_lookup_array, built as needed.  As every color
+   table is a function of (datum-min)/(max-min), one table over [0,1] serves for all
+   thresholds.  Entry 0 is for values below min, entries 1 through
+   AMITK_COLOR_TABLE_LUT_SIZE go from min to max, and the last two are for values
+   above max and for NaN's */
+#define LUT_BELOW 0
+#define LUT_ABOVE (AMITK_COLOR_TABLE_LUT_SIZE+1)
+#define LUT_NAN (AMITK_COLOR_TABLE_LUT_SIZE+2)
+static rgba_t * color_table_luts[AMITK_COLOR_TABLE_NUM];
+G_LOCK_DEFINE_STATIC(color_table_luts);
+
 /* internal functions */
 static rgb_t hsv_to_rgb(hsv_t * hsv);
+static const rgba_t * get_lut(AmitkColorTable which);
 
 
 
@@ -381,6 +393,68 @@ rgba_t amitk_color_table_lookup(amide_data_t datum, AmitkColorTable which,
   return rgba;
 }
 
+static const rgba_t * get_lut(AmitkColorTable which) {
+
+  rgba_t * lut;
+  gint k;
+
+  G_LOCK(color_table_luts);
+  lut = color_table_luts[which];
+  if (lut == NULL) {
+    lut = g_new(rgba_t, AMITK_COLOR_TABLE_LUT_SIZE+3);
+    lut[LUT_BELOW] = amitk_color_table_lookup(-1.0, which, 0.0, 1.0);
+    for (k=0; k < AMITK_COLOR_TABLE_LUT_SIZE; k++)
+      lut[k+1] = amitk_color_table_lookup(((amide_data_t) k)/(AMITK_COLOR_TABLE_LUT_SIZE-1), 
+					  which, 0.0, 1.0);
+    lut[LUT_ABOVE] = amitk_color_table_lookup(2.0, which, 0.0, 1.0);
+    lut[LUT_NAN] = amitk_color_table_lookup(NAN, which, 0.0, 1.0);
+    color_table_luts[which] = lut;
+  }
+  G_UNLOCK(color_table_luts);
+
+  return lut;
+}
+
+/* same as calling amitk_color_table_lookup on each of the num values in data, 
+   but much quicker, as the colors come from a lookup table with
+   AMITK_COLOR_TABLE_LUT_SIZE steps between min and max */
+void amitk_color_table_lookup_array(const amide_data_t * data,
+				    const gsize num,
+				    AmitkColorTable which,
+				    amide_data_t min,
+				    amide_data_t max,
+				    rgba_t * rgba) {
+
+  const rgba_t * lut;
+  amide_data_t scale;
+  amide_data_t x;
+  gsize k;
+  gint index;
+
+  g_return_if_fail(which < AMITK_COLOR_TABLE_NUM);
+
+  if (max == min) { /* nothing to scale by */
+    for (k=0; k<num; k++)
+      rgba[k] = amitk_color_table_lookup(data[k], which, min, max);
+    return;
+  }
+
+  lut = get_lut(which);
+  scale = (AMITK_COLOR_TABLE_LUT_SIZE-1)/(max-min);
+
+  /* kept free of function calls and real branches, so that the
+     compiler can vectorize it */
+  for (k=0; k<num; k++) {
+    x = (data[k]-min)*scale;
+    index = (x >= 0.0) ? 
+      ((x <= (AMITK_COLOR_TABLE_LUT_SIZE-1)) ? ((gint) (x+0.5))+1 : LUT_ABOVE) :
+      ((x < 0.0) ? LUT_BELOW : LUT_NAN); /* NaN's fail both comparisons */
+    rgba[k] = lut[index];
+  }
+
+  return;
+}
+
 rgba_t amitk_color_table_uint32_to_rgba(guint32 color_uint32) {
   rgba_t rgba;
 
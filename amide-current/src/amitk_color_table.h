@@ -62,6 +62,9 @@ typedef enum {
 
 #define AMITK_OBJECT_DEFAULT_COLOR 0x808000FF
 
+/* number of steps between min and max used by amitk_color_table_lookup_array */
+#define AMITK_COLOR_TABLE_LUT_SIZE 4096
+
 
 typedef guint8 color_data_t;
 typedef guint16 color_data16_t;
@@ -102,6 +105,9 @@ rgba_t amitk_color_table_uint32_to_rgba(guint32 color_uint32);
 rgba_t amitk_color_table_outline_color(AmitkColorTable which, gboolean highlight);
 rgba_t amitk_color_table_lookup(amide_data_t datum, AmitkColorTable which,
 				amide_data_t min, amide_data_t max);
+void amitk_color_table_lookup_array(const amide_data_t * data, const gsize num, 
+				    AmitkColorTable which, amide_data_t min, amide_data_t max,
+				    rgba_t * rgba);
 const gchar * amitk_color_table_get_name(const AmitkColorTable which);
 /* external variables */
 extern gchar * color_table_menu_names[];
@@ -25,6 +25,9 @@
 
 #include "amide_config.h"
 //#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 //#include <locale.h>
 //#include <signal.h>
 #include <sys/stat.h>
@@ -333,6 +336,185 @@ gboolean amitk_is_xif_flat_file(const gchar * filename, guint64 * plocation_le,
 }
 
 
+/* atomic and locking calls changed names over the glib 2.x series */
+#if GLIB_CHECK_VERSION(2,30,0)
+#define parallel_atomic_add(patomic, val) g_atomic_int_add((patomic), (val))
+#else
+#define parallel_atomic_add(patomic, val) g_atomic_int_exchange_and_add((patomic), (val))
+#endif
+
+typedef struct {
+  AmitkParallelFunc func;
+  gpointer data;
+  gint num_items;
+  gint chunk_size;
+  gint num_chunks;
+  volatile gint next_chunk;
+  volatile gint chunks_done;
+  volatile gint ref_count;
+  GMutex * mutex;
+  GCond * cond;
+} parallel_job_t;
+
+static GThreadPool * parallel_pool = NULL;
+static gint parallel_num_threads = 0;
+
+static parallel_job_t * parallel_job_new(void) {
+  parallel_job_t * job;
+
+  job = g_new0(parallel_job_t, 1);
+  job->ref_count = 1;
+#if GLIB_CHECK_VERSION(2,32,0)
+  job->mutex = g_new(GMutex, 1);
+  g_mutex_init(job->mutex);
+  job->cond = g_new(GCond, 1);
+  g_cond_init(job->cond);
+#else
+  job->mutex = g_mutex_new();
+  job->cond = g_cond_new();
+#endif
+
+  return job;
+}
+
+static void parallel_job_unref(parallel_job_t * job) {
+
+  if (!g_atomic_int_dec_and_test(&(job->ref_count)))
+    return;
+
+#if GLIB_CHECK_VERSION(2,32,0)
+  g_mutex_clear(job->mutex);
+  g_free(job->mutex);
+  g_cond_clear(job->cond);
+  g_free(job->cond);
+#else
+  g_mutex_free(job->mutex);
+  g_cond_free(job->cond);
+#endif
+  g_free(job);
+
+  return;
+}
+
+/* grab chunks off of the job until there are none left */
+static void parallel_job_process(parallel_job_t * job) {
+
+  gint chunk;
+  gint start, end;
+
+  while ((chunk = parallel_atomic_add(&(job->next_chunk), 1)) < job->num_chunks) {
+    start = chunk*job->chunk_size;
+    end = MIN(start+job->chunk_size, job->num_items);
+    (*(job->func))(start, end, job->data);
+
+    if (parallel_atomic_add(&(job->chunks_done), 1)+1 == job->num_chunks) {
+      g_mutex_lock(job->mutex);
+      g_cond_broadcast(job->cond);
+      g_mutex_unlock(job->mutex);
+    }
+  }
+
+  return;
+}
+
+static void parallel_pool_func(gpointer job, gpointer unused) {
+  parallel_job_process(job);
+  parallel_job_unref(job);
+  return;
+}
+
+static gpointer parallel_init(gpointer unused) {
+
+  gint num_threads=1;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+  num_threads = g_get_num_processors();
+#elif defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (num_threads < 1) num_threads = 1;
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+  if (!g_thread_supported()) num_threads = 1;
+#endif
+
+  /* the calling thread also does work, so the pool only needs num_threads-1 workers */
+  if (num_threads > 1) {
+    parallel_pool = g_thread_pool_new(parallel_pool_func, NULL, num_threads-1, FALSE, NULL);
+    if (parallel_pool == NULL) {
+      g_warning(_("Could not start worker threads, running single threaded"));
+      num_threads = 1;
+    }
+  }
+  parallel_num_threads = num_threads;
+
+  return NULL;
+}
+
+/* returns the number of threads that amitk_parallel_for will spread work across */
+gint amitk_get_num_threads(void) {
+  static GOnce parallel_once = G_ONCE_INIT;
+
+  g_once(&parallel_once, parallel_init, NULL);
+  return parallel_num_threads;
+}
+
+/* splits the items 0 through num_items-1 into chunks of chunk_size items, and
+   hands the chunks out to the worker threads.  The calling thread works on chunks
+   as well, and the function returns when all the chunks are done. 
+
+   notes:
+   - func must not call into gtk, and should not touch data shared between chunks
+     without its own locking
+   - amitk_parallel_for can be called from inside func
+*/
+void amitk_parallel_for(const gint num_items, const gint chunk_size, 
+			AmitkParallelFunc func, gpointer data) {
+
+  parallel_job_t * job;
+  gint num_chunks;
+  gint num_helpers;
+  gint i;
+
+  g_return_if_fail(chunk_size > 0);
+  if (num_items <= 0) return;
+
+  num_chunks = (num_items+chunk_size-1)/chunk_size;
+  num_helpers = MIN(num_chunks, amitk_get_num_threads())-1;
+
+  /* not worth the overhead */
+  if (num_helpers <= 0) {
+    (*func)(0, num_items, data);
+    return;
+  }
+
+  job = parallel_job_new();
+  job->func = func;
+  job->data = data;
+  job->num_items = num_items;
+  job->chunk_size = chunk_size;
+  job->num_chunks = num_chunks;
+
+  for (i=0; i<num_helpers; i++) {
+    g_atomic_int_inc(&(job->ref_count));
+    g_thread_pool_push(parallel_pool, job, NULL);
+  }
+
+  parallel_job_process(job);
+
+  /* wait for the chunks the workers are still on */
+  g_mutex_lock(job->mutex);
+  while (g_atomic_int_get(&(job->chunks_done)) < job->num_chunks)
+    g_cond_wait(job->cond, job->mutex);
+  g_mutex_unlock(job->mutex);
+
+  parallel_job_unref(job);
+
+  return;
+}
+
+
+
 
 
 
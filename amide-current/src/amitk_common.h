@@ -154,6 +154,13 @@ GdkPixbuf * amitk_get_pixbuf_from_canvas(GnomeCanvas * canvas, gint xoffset, gin
 gboolean amitk_is_xif_directory(const gchar * filename, gboolean * plegacy, gchar ** pxml_filename);
 gboolean amitk_is_xif_flat_file(const gchar * filename, guint64 * plocation_le, guint64 *psize_le);
 
+/* work function for amitk_parallel_for, handles items start through end-1 */
+typedef void (*AmitkParallelFunc) (const gint start, const gint end, gpointer data);
+
+gint amitk_get_num_threads(void);
+void amitk_parallel_for(const gint num_items, const gint chunk_size, 
+			AmitkParallelFunc func, gpointer data);
+
 
 /* built in type functions */
 const gchar *   amitk_layout_get_name             (const AmitkLayout layout);
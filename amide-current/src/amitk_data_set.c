@@ -29,6 +29,7 @@
 #include "amitk_marshal.h"
 #include "amitk_type_builtins.h"
 #include "amitk_line_profile.h"
+#include "amitk_math_expression.h"
 
 /* variable type function declarations */
 #include "amitk_data_set_UBYTE_0D_SCALING.h"
@@ -225,6 +226,7 @@ enum {
   DATA_SET_CHANGED,
   INVALIDATE_SLICE_CACHE,
   VIEW_GATES_CHANGED,
+  MIN_MAX_CHANGED,
   LAST_SIGNAL
 };
 
@@ -240,7 +242,8 @@ static AmitkObject * data_set_copy                   (const AmitkObject *object)
 static void          data_set_copy_in_place          (AmitkObject * dest_object, const AmitkObject * src_object);
 static void          data_set_write_xml              (const AmitkObject *object, 
 						      xmlNodePtr         nodes, 
-						      FILE              *study_file);
+						      FILE              *study_file,
+						      const gboolean     compress_raw_data);
 static gchar *       data_set_read_xml               (AmitkObject       *object, 
 						      xmlNodePtr         nodes, 
 						      FILE              *study_file,
@@ -255,8 +258,11 @@ static guint         data_set_signals[LAST_SIGNAL];
 
 
 static amide_data_t calculate_scale_factor(AmitkDataSet * ds);
-GList * slice_cache_trim(GList * slice_cache, gint max_size);
-#define MIN_LOCAL_CACHE_SIZE 3
+static void slice_cache_remove_parent(const AmitkDataSet * parent_ds);
+static void data_set_drop_pyramid(AmitkDataSet * ds);
+static void data_set_calc_frame_min_max_if_needed(AmitkDataSet * ds, const guint frame);
+static void data_set_finish_min_max(AmitkDataSet * ds);
+static gboolean data_set_calc_min_max_idle(gpointer data);
 
 GType amitk_data_set_get_type(void) {
 
@@ -435,6 +441,13 @@ static void data_set_class_init (AmitkDataSetClass * class) {
 		  G_STRUCT_OFFSET (AmitkDataSetClass, view_gates_changed),
 		  NULL, NULL,
 		  amitk_marshal_NONE__NONE, G_TYPE_NONE, 0);
+  data_set_signals[MIN_MAX_CHANGED] = 
+    g_signal_new ("min_max_changed",
+		  G_TYPE_FROM_CLASS(class),
+		  G_SIGNAL_RUN_LAST,
+		  G_STRUCT_OFFSET (AmitkDataSetClass, min_max_changed),
+		  NULL, NULL,
+		  amitk_marshal_NONE__NONE, G_TYPE_NONE, 0);
 }
 
 
@@ -453,6 +466,15 @@ static void data_set_init (AmitkDataSet * data_set) {
   data_set->min_max_calculated = FALSE;
   data_set->frame_max = NULL;
   data_set->frame_min = NULL;
+  data_set->frame_min_max_calculated = NULL;
+  data_set->min_max_idle_id = 0;
+  for (i=0; i<AMITK_DATA_SET_PYRAMID_LEVELS; i++)
+    data_set->pyramid[i] = NULL;
+  data_set->pyramid_levels = 0;
+  data_set->pyramid_frame = 0;
+  data_set->pyramid_plane = 0;
+  data_set->pyramid_idle_id = 0;
+  data_set->slice_epoch = 0;
   data_set->global_max = 0.0;
   data_set->global_min = 0.0;
   amitk_data_set_set_thresholding(data_set, AMITK_THRESHOLDING_GLOBAL);
@@ -495,7 +517,6 @@ static void data_set_init (AmitkDataSet * data_set) {
   data_set->rendering = AMITK_RENDERING_MPR;
   data_set->subject_orientation = AMITK_SUBJECT_ORIENTATION_UNKNOWN;
   data_set->subject_sex = AMITK_SUBJECT_SEX_UNKNOWN;
-  data_set->slice_cache = NULL;
   data_set->slice_parent = NULL;
 
   for (i_window=0; i_window < AMITK_WINDOW_NUM; i_window++)
@@ -576,6 +597,18 @@ static void data_set_finalize (GObject *object)
     data_set->frame_min = NULL;
   }
 
+  if (data_set->frame_min_max_calculated != NULL) {
+    g_free(data_set->frame_min_max_calculated);
+    data_set->frame_min_max_calculated = NULL;
+  }
+
+  if (data_set->min_max_idle_id != 0) {
+    g_source_remove(data_set->min_max_idle_id);
+    data_set->min_max_idle_id = 0;
+  }
+
+  data_set_drop_pyramid(data_set);
+
   if (data_set->scan_date != NULL) {
     g_free(data_set->scan_date);
     data_set->scan_date = NULL;
@@ -601,16 +634,12 @@ static void data_set_finalize (GObject *object)
     data_set->dicom_image_type = NULL;
   }
 
-  if (data_set->slice_cache != NULL) {
-    amitk_objects_unref(data_set->slice_cache);
-    data_set->slice_cache = NULL;
-  }
+  /* slices are only cached while their parent is around */
+  if (data_set->slice_parent == NULL)
+    slice_cache_remove_parent(data_set);
 
-  if (data_set->slice_parent != NULL) {
-    g_object_remove_weak_pointer(G_OBJECT(data_set->slice_parent),
-				 (gpointer *) &(data_set->slice_parent));
-    data_set->slice_parent = NULL;
-  }
+  if (data_set->slice_parent != NULL)
+    amitk_data_set_set_slice_parent(data_set, NULL);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -659,9 +688,10 @@ static void data_set_selection_changed(AmitkObject * object) {
   data_set = AMITK_DATA_SET(object);
 
 
+  /* no need to hold onto slices for data sets that aren't being shown */
   if (!amitk_object_get_selected(object, AMITK_SELECTION_ANY)) {
-    data_set->slice_cache = 
-      slice_cache_trim(data_set->slice_cache, MIN_LOCAL_CACHE_SIZE);
+    slice_cache_remove_parent(data_set);
+    data_set_drop_pyramid(data_set);
   }
 
   return;
@@ -690,6 +720,7 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
   AmitkDataSet * src_ds;
   AmitkDataSet * dest_ds;
   AmitkViewMode i_view_mode;
+  gboolean min_max_in_background;
   guint i;
 
   g_return_if_fail(AMITK_IS_DATA_SET(src_object));
@@ -698,6 +729,14 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
   src_ds = AMITK_DATA_SET(src_object);
   dest_ds = AMITK_DATA_SET(dest_object);
 
+  /* the background min/max calculation can't be working on the arrays we're
+     about to replace, it gets restarted below if it's still needed */
+  min_max_in_background = (dest_ds->min_max_idle_id != 0);
+  if (min_max_in_background) {
+    g_source_remove(dest_ds->min_max_idle_id);
+    dest_ds->min_max_idle_id = 0;
+  }
+
 
   /* copy the data elements */
   amitk_data_set_set_scan_date(dest_ds, AMITK_DATA_SET_SCAN_DATE(src_object));
@@ -792,6 +831,10 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
     g_free(dest_ds->frame_min);
     dest_ds->frame_min = NULL;
   }
+  if (dest_ds->frame_min_max_calculated != NULL) {
+    g_free(dest_ds->frame_min_max_calculated);
+    dest_ds->frame_min_max_calculated = NULL;
+  }
 
   if (src_ds->min_max_calculated) {
     dest_ds->global_max = AMITK_DATA_SET(src_object)->global_max;
@@ -806,8 +849,21 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
     g_return_if_fail(dest_ds->frame_min != NULL);
     for (i=0;i<AMITK_DATA_SET_NUM_FRAMES(dest_ds);i++)
       dest_ds->frame_min[i] = src_ds->frame_min[i];
+
+    dest_ds->frame_min_max_calculated = g_try_new(gboolean, AMITK_DATA_SET_NUM_FRAMES(dest_ds));
+    g_return_if_fail(dest_ds->frame_min_max_calculated != NULL);
+    for (i=0;i<AMITK_DATA_SET_NUM_FRAMES(dest_ds);i++)
+      dest_ds->frame_min_max_calculated[i] = TRUE;
   }
 
+  /* anyone waiting on the background calculation still gets "min_max_changed" */
+  if (min_max_in_background)
+    dest_ds->min_max_idle_id = 
+      g_idle_add_full(G_PRIORITY_LOW, data_set_calc_min_max_idle, dest_ds, NULL);
+
+  /* the pyramid gets rebuilt as needed */
+  data_set_drop_pyramid(dest_ds);
+
   AMITK_OBJECT_CLASS (parent_class)->object_copy_in_place (dest_object, src_object);
 }
 
@@ -817,7 +873,8 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
 
 
 
-static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FILE * study_file) {
+static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FILE * study_file,
+			       const gboolean compress_raw_data) {
 
   AmitkDataSet * ds;
   gchar * xml_filename;
@@ -828,7 +885,7 @@ static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FIL
   AmitkLimit i_limit;
   AmitkViewMode i_view_mode;
 
-  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file);
+  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file, compress_raw_data);
 
   ds = AMITK_DATA_SET(object);
 
@@ -842,7 +899,7 @@ static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FIL
   amitk_point_write_xml(nodes,"voxel_size", AMITK_DATA_SET_VOXEL_SIZE(ds));
 
   name = g_strdup_printf("data-set_%s_raw-data",AMITK_OBJECT_NAME(object));
-  amitk_raw_data_write_xml(AMITK_DATA_SET_RAW_DATA(ds), name, study_file, &xml_filename, &location, &size);
+  amitk_raw_data_write_xml(AMITK_DATA_SET_RAW_DATA(ds), name, study_file, compress_raw_data, &xml_filename, &location, &size);
   g_free(name);
   if (study_file == NULL) {
     xml_save_string(nodes, "raw_data_file", xml_filename);
@@ -852,7 +909,7 @@ static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FIL
   }
 
   name = g_strdup_printf("data-set_%s_scaling-factors",AMITK_OBJECT_NAME(ds));
-  amitk_raw_data_write_xml(ds->internal_scaling_factor, name, study_file, &xml_filename, &location, &size);
+  amitk_raw_data_write_xml(ds->internal_scaling_factor, name, study_file, compress_raw_data, &xml_filename, &location, &size);
   g_free(name);
   if (study_file == NULL) {
     xml_save_string(nodes, "internal_scaling_factor_file", xml_filename);
@@ -863,7 +920,7 @@ static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FIL
 
   if (ds->internal_scaling_intercept != NULL) {
     name = g_strdup_printf("data-set_%s_scaling-intercepts",AMITK_OBJECT_NAME(ds));
-    amitk_raw_data_write_xml(ds->internal_scaling_intercept, name, study_file, &xml_filename, &location, &size);
+    amitk_raw_data_write_xml(ds->internal_scaling_intercept, name, study_file, compress_raw_data, &xml_filename, &location, &size);
     g_free(name);
     if (study_file == NULL) {
       xml_save_string(nodes, "internal_scaling_intercepts_file", xml_filename);
@@ -875,7 +932,7 @@ static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FIL
 
   if (ds->distribution != NULL) {
     name = g_strdup_printf("data-set_%s_distribution",AMITK_OBJECT_NAME(ds));
-    amitk_raw_data_write_xml(ds->distribution, name, study_file, &xml_filename, &location, &size);
+    amitk_raw_data_write_xml(ds->distribution, name, study_file, compress_raw_data, &xml_filename, &location, &size);
     g_free(name);
     if (study_file == NULL) {
       xml_save_string(nodes, "distribution_file", xml_filename);
@@ -916,6 +973,7 @@ static void data_set_write_xml(const AmitkObject * object, xmlNodePtr nodes, FIL
 
   xml_save_string(nodes, "interpolation", amitk_interpolation_get_name(AMITK_DATA_SET_INTERPOLATION(ds)));
   xml_save_string(nodes, "rendering", amitk_rendering_get_name(AMITK_DATA_SET_RENDERING(ds)));
+  xml_save_string(nodes, "raw_data_layout", amitk_raw_data_layout_get_name(AMITK_DATA_SET_LAYOUT(ds)));
   xml_save_string(nodes, "subject_orientation", amitk_subject_orientation_get_name(AMITK_DATA_SET_SUBJECT_ORIENTATION(ds)));
   xml_save_string(nodes, "subject_sex", amitk_subject_sex_get_name(AMITK_DATA_SET_SUBJECT_SEX(ds)));
   xml_save_string(nodes, "thresholding", amitk_thresholding_get_name(AMITK_DATA_SET_THRESHOLDING(ds)));
@@ -952,6 +1010,7 @@ static gchar * data_set_read_xml(AmitkObject * object, xmlNodePtr nodes,
   AmitkThresholdStyle i_threshold_style;
   AmitkInterpolation i_interpolation;
   AmitkRendering i_rendering;
+  AmitkRawDataLayout i_layout;
   AmitkSubjectOrientation i_subject_orientation;
   AmitkSubjectSex i_subject_sex;
   AmitkScalingType i_scaling_type;
@@ -1226,6 +1285,14 @@ static gchar * data_set_read_xml(AmitkObject * object, xmlNodePtr nodes,
 	amitk_data_set_set_rendering(ds, i_rendering);
   g_free(temp_string);
 
+  /* raw data is always stored linearly, rearrange it in memory if needed */
+  temp_string = xml_get_string(nodes, "raw_data_layout");
+  if (temp_string != NULL)
+    for (i_layout=0; i_layout < AMITK_RAW_DATA_LAYOUT_NUM; i_layout++) 
+      if (g_ascii_strcasecmp(temp_string, amitk_raw_data_layout_get_name(i_layout)) == 0)
+	amitk_data_set_set_layout(ds, i_layout);
+  g_free(temp_string);
+
   temp_string = xml_get_string(nodes, "subject_orientation");
   if (temp_string != NULL) 
     for (i_subject_orientation=0; i_subject_orientation < AMITK_SUBJECT_ORIENTATION_NUM; i_subject_orientation++) 
@@ -1284,12 +1351,10 @@ static gchar * data_set_read_xml(AmitkObject * object, xmlNodePtr nodes,
 
 static void data_set_invalidate_slice_cache(AmitkDataSet * data_set) {
 
-  /* invalidate cache */
-  if (data_set->slice_cache != NULL) {
-    amitk_objects_unref(data_set->slice_cache);
-    data_set->slice_cache = NULL;
-  }
-
+  /* invalidate cache, and anything still being generated from the old data */
+  data_set->slice_epoch++;
+  slice_cache_remove_parent(data_set);
+  data_set_drop_pyramid(data_set);
 
   return;
 }
@@ -2118,7 +2183,7 @@ gboolean amitk_data_sets_export_to_file(GList * data_sets,
 	/* advance the requested slice volume */
 	amitk_space_set_offset(AMITK_SPACE(volume), amitk_space_s2b(AMITK_SPACE(export_ds), new_offset));
 
-	slices = amitk_data_sets_get_slices(data_sets, NULL, 0,
+	slices = amitk_data_sets_get_slices(data_sets, FALSE,
 					    amitk_data_set_get_start_time(export_ds, i_voxel.t)+EPSILON,
 					    amitk_data_set_get_frame_duration(export_ds, i_voxel.t)-EPSILON,
 					    i_voxel.g,
@@ -2312,24 +2377,41 @@ static void data_set_reduce_scaling_dimension(AmitkDataSet * ds) {
 
 
 
+/* these always return the exact values, if the min/max values are being 
+   calculated in the background, the rest of the frames get done right away */
 amide_data_t amitk_data_set_get_global_max(AmitkDataSet * ds) {
-  amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+  data_set_finish_min_max(ds);
   return ds->global_max;
 }
 
 amide_data_t amitk_data_set_get_global_min(AmitkDataSet * ds) { 
-  amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+  data_set_finish_min_max(ds);
+  return ds->global_min;
+}
+
+/* while the min/max values are being calculated in the background, these
+   return the values over the frames that have been done so far. Only useful
+   for display purposes, e.g. the threshold widget */
+amide_data_t amitk_data_set_get_global_max_provisional(AmitkDataSet * ds) {
+  if (ds->min_max_idle_id == 0)
+    amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+  return ds->global_max;
+}
+
+amide_data_t amitk_data_set_get_global_min_provisional(AmitkDataSet * ds) { 
+  if (ds->min_max_idle_id == 0)
+    amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
   return ds->global_min;
 }
 
 
 amide_data_t amitk_data_set_get_frame_max(AmitkDataSet * ds, const guint frame) {
-  amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+  data_set_calc_frame_min_max_if_needed(ds, frame);
   return ds->frame_max[frame];
 }
 
 amide_data_t amitk_data_set_get_frame_min(AmitkDataSet * ds, const guint frame) {
-  amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+  data_set_calc_frame_min_max_if_needed(ds, frame);
   return ds->frame_min[frame];
 }
 
@@ -2537,6 +2619,28 @@ void amitk_data_set_set_rendering(AmitkDataSet * ds, const AmitkRendering new_re
   return;
 }
 
+/* rearranges the voxels of the data set in memory.  The values don't change, so
+   nothing cached off the data set needs to be thrown out.  The data set gets new
+   raw data, instead of changing the old raw data in place, as others (e.g. copies
+   of the data set) may be holding a reference to it */
+void amitk_data_set_set_layout(AmitkDataSet * ds, const AmitkRawDataLayout new_layout) {
+
+  AmitkRawData * new_raw_data;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(ds->raw_data != NULL);
+
+  if (AMITK_DATA_SET_LAYOUT(ds) == new_layout) return;
+
+  new_raw_data = amitk_raw_data_new_with_layout(ds->raw_data, new_layout);
+  if (new_raw_data == NULL) return;
+
+  g_object_unref(ds->raw_data);
+  ds->raw_data = new_raw_data;
+
+  return;
+}
+
 void amitk_data_set_set_subject_orientation(AmitkDataSet * ds, const AmitkSubjectOrientation subject_orientation) {
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
@@ -3102,33 +3206,222 @@ void amitk_data_set_slice_calc_min_max (AmitkDataSet * ds,
   (*calc_slice_min_max_func[ds->raw_data->format][ds->scaling_type])(ds, frame, gate, z, pmin, pmax);
 }
 
-/* function to calculate the max and min over the data frames */
-void amitk_data_set_calc_min_max(AmitkDataSet * ds,
-				 AmitkUpdateFunc update_func,
-				 gpointer update_data) {
+static void (*get_plane_values_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(const AmitkDataSet *, const amide_intpoint_t, const amide_intpoint_t, const amide_intpoint_t, amide_data_t *) = {
+  {amitk_data_set_UBYTE_0D_SCALING_get_plane_values, amitk_data_set_UBYTE_1D_SCALING_get_plane_values, amitk_data_set_UBYTE_2D_SCALING_get_plane_values, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_SBYTE_0D_SCALING_get_plane_values, amitk_data_set_SBYTE_1D_SCALING_get_plane_values, amitk_data_set_SBYTE_2D_SCALING_get_plane_values, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_USHORT_0D_SCALING_get_plane_values, amitk_data_set_USHORT_1D_SCALING_get_plane_values, amitk_data_set_USHORT_2D_SCALING_get_plane_values, amitk_data_set_USHORT_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_USHORT_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_SSHORT_0D_SCALING_get_plane_values, amitk_data_set_SSHORT_1D_SCALING_get_plane_values, amitk_data_set_SSHORT_2D_SCALING_get_plane_values, amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_UINT_0D_SCALING_get_plane_values, amitk_data_set_UINT_1D_SCALING_get_plane_values, amitk_data_set_UINT_2D_SCALING_get_plane_values, amitk_data_set_UINT_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_UINT_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_UINT_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_SINT_0D_SCALING_get_plane_values, amitk_data_set_SINT_1D_SCALING_get_plane_values, amitk_data_set_SINT_2D_SCALING_get_plane_values, amitk_data_set_SINT_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_SINT_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_SINT_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_FLOAT_0D_SCALING_get_plane_values, amitk_data_set_FLOAT_1D_SCALING_get_plane_values, amitk_data_set_FLOAT_2D_SCALING_get_plane_values, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_get_plane_values},
+  {amitk_data_set_DOUBLE_0D_SCALING_get_plane_values, amitk_data_set_DOUBLE_1D_SCALING_get_plane_values, amitk_data_set_DOUBLE_2D_SCALING_get_plane_values, amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_get_plane_values, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_get_plane_values}
+};
+
+/* fills values (dim.y*dim.x) with the values of the given plane, scaling included */
+void amitk_data_set_get_plane_values(const AmitkDataSet * ds,
+				     const amide_intpoint_t frame,
+				     const amide_intpoint_t gate,
+				     const amide_intpoint_t z,
+				     amide_data_t * values) {
+  (*get_plane_values_func[ds->raw_data->format][ds->scaling_type])(ds, frame, gate, z, values);
+}
+
+static void (*threshold_plane_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(const AmitkDataSet *, const amide_intpoint_t, const amide_intpoint_t, const amide_intpoint_t, const amide_data_t, const amide_data_t, amitk_format_UBYTE_t *, const amitk_format_UBYTE_t) = {
+  {amitk_data_set_UBYTE_0D_SCALING_threshold_plane, amitk_data_set_UBYTE_1D_SCALING_threshold_plane, amitk_data_set_UBYTE_2D_SCALING_threshold_plane, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_SBYTE_0D_SCALING_threshold_plane, amitk_data_set_SBYTE_1D_SCALING_threshold_plane, amitk_data_set_SBYTE_2D_SCALING_threshold_plane, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_USHORT_0D_SCALING_threshold_plane, amitk_data_set_USHORT_1D_SCALING_threshold_plane, amitk_data_set_USHORT_2D_SCALING_threshold_plane, amitk_data_set_USHORT_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_USHORT_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_SSHORT_0D_SCALING_threshold_plane, amitk_data_set_SSHORT_1D_SCALING_threshold_plane, amitk_data_set_SSHORT_2D_SCALING_threshold_plane, amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_UINT_0D_SCALING_threshold_plane, amitk_data_set_UINT_1D_SCALING_threshold_plane, amitk_data_set_UINT_2D_SCALING_threshold_plane, amitk_data_set_UINT_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_UINT_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_UINT_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_SINT_0D_SCALING_threshold_plane, amitk_data_set_SINT_1D_SCALING_threshold_plane, amitk_data_set_SINT_2D_SCALING_threshold_plane, amitk_data_set_SINT_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_SINT_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_SINT_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_FLOAT_0D_SCALING_threshold_plane, amitk_data_set_FLOAT_1D_SCALING_threshold_plane, amitk_data_set_FLOAT_2D_SCALING_threshold_plane, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_threshold_plane},
+  {amitk_data_set_DOUBLE_0D_SCALING_threshold_plane, amitk_data_set_DOUBLE_1D_SCALING_threshold_plane, amitk_data_set_DOUBLE_2D_SCALING_threshold_plane, amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_threshold_plane, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_threshold_plane}
+};
+
+/* ors bit into mask (dim.y*dim.x bytes) for each voxel in the plane with a value in [min_value, max_value] */
+void amitk_data_set_threshold_plane(const AmitkDataSet * ds,
+				    const amide_intpoint_t frame,
+				    const amide_intpoint_t gate,
+				    const amide_intpoint_t z,
+				    const amide_data_t min_value,
+				    const amide_data_t max_value,
+				    amitk_format_UBYTE_t * mask,
+				    const amitk_format_UBYTE_t bit) {
+  (*threshold_plane_func[ds->raw_data->format][ds->scaling_type])(ds, frame, gate, z, min_value, max_value, mask, bit);
+}
+
+/* make sure the per frame max/min arrays are allocated */
+static gboolean data_set_alloc_min_max(AmitkDataSet * ds) {
+
+  if (ds->frame_max == NULL)
+    ds->frame_max = amitk_data_set_get_frame_min_max_mem(ds);
+  if (ds->frame_min == NULL)
+    ds->frame_min = amitk_data_set_get_frame_min_max_mem(ds);
+  if (ds->frame_min_max_calculated == NULL)
+    ds->frame_min_max_calculated = g_try_new0(gboolean, AMITK_DATA_SET_NUM_FRAMES(ds));
+
+  return ((ds->frame_max != NULL) && (ds->frame_min != NULL) && 
+	  (ds->frame_min_max_calculated != NULL));
+}
+
+/* used for spreading the planes of a frame across threads */
+typedef struct {
+  AmitkDataSet * ds;
+  guint frame;
+  gint first_plane;
+  amide_data_t * plane_max;
+  amide_data_t * plane_min;
+} frame_min_max_t;
+
+static void frame_min_max_func(const gint start, const gint end, gpointer data) {
+
+  frame_min_max_t * job = data;
+  gint j, plane;
+
+  for (j=start; j<end; j++) {
+    plane = job->first_plane+j;
+    amitk_data_set_slice_calc_min_max(job->ds, job->frame, 
+				      plane / AMITK_DATA_SET_DIM_Z(job->ds),
+				      plane % AMITK_DATA_SET_DIM_Z(job->ds),
+				      &(job->plane_min[plane]), &(job->plane_max[plane]));
+  }
+
+  return;
+}
+
+/* calculate the max and min over a single frame,
+   pi_plane and total_planes are just used for the progress bar */
+/* notes
+   - the planes get handed out to threads a batch at a time, with the progress 
+     bar updated between batches
+ */
+static void data_set_calc_frame_min_max(AmitkDataSet * ds, 
+					const guint frame,
+					AmitkUpdateFunc update_func,
+					gpointer update_data,
+					gint * pi_plane,
+					const gint total_planes) {
 
   AmitkVoxel i;
   amide_data_t max, min, temp;
-  amide_data_t slice_max, slice_min;
-  div_t x;
   gint divider;
+  gint num_planes, batch_planes;
+  gint plane;
+  frame_min_max_t job;
+
+  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
+  num_planes = AMITK_DATA_SET_DIM_Z(ds)*AMITK_DATA_SET_DIM_G(ds);
+  batch_planes = MAX(divider, 4*amitk_get_num_threads());
+
+  job.ds = ds;
+  job.frame = frame;
+  job.plane_max = g_try_new(amide_data_t, num_planes);
+  job.plane_min = g_try_new(amide_data_t, num_planes);
+  if ((job.plane_max == NULL) || (job.plane_min == NULL)) {
+    g_warning(_("couldn't allocate memory space for the max/min calculation"));
+    g_free(job.plane_max);
+    g_free(job.plane_min);
+    return;
+  }
+
+  for (job.first_plane=0; job.first_plane < num_planes; job.first_plane += batch_planes) {
+    if (update_func != NULL) 
+      (*update_func)(update_data, NULL, ((gdouble) (*pi_plane+job.first_plane))/((gdouble)total_planes));
+    amitk_parallel_for(MIN(batch_planes, num_planes-job.first_plane), 1, frame_min_max_func, &job);
+  }
+  *pi_plane += num_planes;
+
+  i.x = i.y = i.z = i.g = 0;
+  i.t = frame;
+  temp = amitk_data_set_get_value(ds,i);
+  if (finite(temp)) max = min = temp;   
+  else max = min = 0.0; /* just throw in zero */
+
+  for (plane=0; plane < num_planes; plane++) {
+    if (finite(job.plane_min[plane]))
+      if (job.plane_min[plane] < min)
+	min = job.plane_min[plane];
+    if (finite(job.plane_max[plane]))
+      if (job.plane_max[plane] > max)
+	max = job.plane_max[plane];
+  }
+  g_free(job.plane_max);
+  g_free(job.plane_min);
+
+  ds->frame_max[frame] = max;
+  ds->frame_min[frame] = min;
+  ds->frame_min_max_calculated[frame] = TRUE;
+    
+#ifdef AMIDE_DEBUG
+  if (AMITK_DATA_SET_DIM_Z(ds) > 1) /* don't print for slices */
+    g_print("\tframe %d max %5.3g frame min %5.3g\n",frame, ds->frame_max[frame],ds->frame_min[frame]);
+#endif
+
+  return;
+}
+
+/* calc the global max/min over the frames that have been calculated */
+static void data_set_calc_global_min_max(AmitkDataSet * ds) {
+
+  guint i_frame;
+  gboolean found=FALSE;
+  gboolean all_calculated=TRUE;
+
+  for (i_frame=0; i_frame<AMITK_DATA_SET_NUM_FRAMES(ds); i_frame++) {
+    if (!ds->frame_min_max_calculated[i_frame]) {
+      all_calculated = FALSE;
+    } else if (!found) {
+      ds->global_max = ds->frame_max[i_frame];
+      ds->global_min = ds->frame_min[i_frame];
+      found = TRUE;
+    } else {
+      if (ds->global_max < ds->frame_max[i_frame]) 
+	ds->global_max = ds->frame_max[i_frame];
+      if (ds->global_min > ds->frame_min[i_frame])
+	ds->global_min = ds->frame_min[i_frame];
+    }
+  }
+
+  /* note whether we've calculated all the max and mins */
+  ds->min_max_calculated = all_calculated;
+
+#ifdef AMIDE_DEBUG
+  if (all_calculated && (AMITK_DATA_SET_DIM_Z(ds) > 1)) /* don't print for slices */
+    g_print("\tglobal max %5.3g global min %5.3g\n",ds->global_max,ds->global_min);
+#endif
+
+  return;
+}
+
+/* calculate the max and min over the data frames, if all_frames is FALSE,
+   only the frames that haven't been calculated yet are done */
+static void data_set_calc_min_max(AmitkDataSet * ds,
+				  const gboolean all_frames,
+				  AmitkUpdateFunc update_func,
+				  gpointer update_data) {
+
+  guint i_frame;
+  gint num_frames;
   gint total_planes;
   gint i_plane;
   gchar * temp_string;
-  AmitkVoxel dim;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
   g_return_if_fail(ds->raw_data != NULL);
 
-  dim = AMITK_DATA_SET_DIM(ds);
+  /* reallocate the calculated flags, in case the number of frames has changed */
+  if (all_frames && (ds->frame_min_max_calculated != NULL)) {
+    g_free(ds->frame_min_max_calculated);
+    ds->frame_min_max_calculated = NULL;
+  }
 
   /* allocate the arrays if we haven't already */
-  if (ds->frame_max == NULL) {
-    ds->frame_max = amitk_data_set_get_frame_min_max_mem(ds);
-    ds->frame_min = amitk_data_set_get_frame_min_max_mem(ds);
-  }
-  g_return_if_fail(ds->frame_max != NULL);
-  g_return_if_fail(ds->frame_min != NULL);
+  g_return_if_fail(data_set_alloc_min_max(ds));
+
+  num_frames=0;
+  for (i_frame = 0; i_frame < AMITK_DATA_SET_NUM_FRAMES(ds); i_frame++)
+    if (!ds->frame_min_max_calculated[i_frame]) 
+      num_frames++;
+  total_planes = num_frames*AMITK_DATA_SET_DIM_Z(ds)*AMITK_DATA_SET_DIM_G(ds);
 
   /* note, we can't cancel this */
   if (update_func != NULL) {
@@ -3139,70 +3432,119 @@ void amitk_data_set_calc_min_max(AmitkDataSet * ds,
     g_free(temp_string);
   }
 
-  total_planes = AMITK_DATA_SET_TOTAL_PLANES(ds);
-  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
-
   i_plane=0;
-  for (i.t = 0; i.t < dim.t; i.t++) {
-    i.x = i.y = i.z = i.g = 0;
-    temp = amitk_data_set_get_value(ds,i);
-    if (finite(temp)) max = min = temp;   
-    else max = min = 0.0; /* just throw in zero */
-
-    for (i.g = 0; i.g < dim.g; i.g++) {
-      for (i.z = 0; i.z < dim.z; i.z++, i_plane++) {
-	if (update_func != NULL) {
-	  x = div(i_plane, divider);
-	  if (x.rem == 0) 
-	    (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble)total_planes));
-	}
-	amitk_data_set_slice_calc_min_max(ds, i.t, i.g, i.z, &slice_min, &slice_max);
-	if (finite(slice_min))
-	  if (slice_min < min)
-	    min = slice_min;
-	if (finite(slice_max))
-	  if (slice_max > max)
-	    max = slice_max;
-      }
-    }    
-    ds->frame_max[i.t] = max;
-    ds->frame_min[i.t] = min;
-    
-#ifdef AMIDE_DEBUG
-    if (dim.z > 1) /* don't print for slices */
-      g_print("\tframe %d max %5.3g frame min %5.3g\n",i.t, ds->frame_max[i.t],ds->frame_min[i.t]);
-#endif
-  }
+  for (i_frame = 0; i_frame < AMITK_DATA_SET_NUM_FRAMES(ds); i_frame++) 
+    if (!ds->frame_min_max_calculated[i_frame])
+      data_set_calc_frame_min_max(ds, i_frame, update_func, update_data, &i_plane, total_planes);
 
   if (update_func != NULL)
     (*update_func)(update_data, NULL, (gdouble) 2.0); /* remove progress bar */
 
-  /* calc the global max/min */
-  ds->global_max = ds->frame_max[0];
-  ds->global_min = ds->frame_min[0];
-  for (i.t=1; i.t<AMITK_DATA_SET_NUM_FRAMES(ds); i.t++) {
-    if (ds->global_max < ds->frame_max[i.t]) 
-      ds->global_max = ds->frame_max[i.t];
-    if (ds->global_min > ds->frame_min[i.t])
-      ds->global_min = ds->frame_min[i.t];
-  }
-
-  /* note that we've calculated the max and mins */
-  ds->min_max_calculated = TRUE;
-
-#ifdef AMIDE_DEBUG
-  if (AMITK_DATA_SET_DIM_Z(ds) > 1) /* don't print for slices */
-    g_print("\tglobal max %5.3g global min %5.3g\n",ds->global_max,ds->global_min);
-#endif
+  data_set_calc_global_min_max(ds);
    
   return;
 }
 
+/* function to calculate the max and min over the data frames */
+void amitk_data_set_calc_min_max(AmitkDataSet * ds,
+				 AmitkUpdateFunc update_func,
+				 gpointer update_data) {
+  data_set_calc_min_max(ds, TRUE, update_func, update_data);
+  return;
+}
+
 void amitk_data_set_calc_min_max_if_needed(AmitkDataSet * ds,
 					   AmitkUpdateFunc update_func,
 					   gpointer update_data) {
   if (!ds->min_max_calculated)
-    amitk_data_set_calc_min_max(ds, update_func, update_data);
+    data_set_calc_min_max(ds, FALSE, update_func, update_data);
+  return;
+}
+
+/* used by the frame max/min functions, only calculates the needed frame */
+static void data_set_calc_frame_min_max_if_needed(AmitkDataSet * ds, const guint frame) {
+
+  gint i_plane=0;
+
+  if (ds->min_max_calculated) return;
+  g_return_if_fail(ds->raw_data != NULL);
+  g_return_if_fail(data_set_alloc_min_max(ds));
+  g_return_if_fail(frame < AMITK_DATA_SET_NUM_FRAMES(ds));
+
+  if (!ds->frame_min_max_calculated[frame]) {
+    data_set_calc_frame_min_max(ds, frame, NULL, NULL, &i_plane, 
+				AMITK_DATA_SET_DIM_Z(ds)*AMITK_DATA_SET_DIM_G(ds));
+    data_set_calc_global_min_max(ds);
+  }
+
+  return;
+}
+
+/* does one frame per call, the last call (which may come after someone
+   else has finished the calculation) lets everyone know we're done */
+static gboolean data_set_calc_min_max_idle(gpointer data) {
+
+  AmitkDataSet * ds = data;
+  guint i_frame;
+  gint i_plane=0;
+
+  if (!ds->min_max_calculated) {
+    if (!data_set_alloc_min_max(ds)) {
+      ds->min_max_idle_id = 0;
+      return FALSE;
+    }
+    for (i_frame=0; (i_frame < AMITK_DATA_SET_NUM_FRAMES(ds)) && 
+	   ds->frame_min_max_calculated[i_frame]; i_frame++);
+    if (i_frame < AMITK_DATA_SET_NUM_FRAMES(ds)) {
+      data_set_calc_frame_min_max(ds, i_frame, NULL, NULL, &i_plane,
+				  AMITK_DATA_SET_DIM_Z(ds)*AMITK_DATA_SET_DIM_G(ds));
+      data_set_calc_global_min_max(ds);
+      return TRUE;
+    }
+    data_set_calc_global_min_max(ds);
+  }
+
+  ds->min_max_idle_id = 0;
+  g_signal_emit(G_OBJECT (ds), data_set_signals[MIN_MAX_CHANGED], 0);
+
+  return FALSE;
+}
+
+/* if the min/max values are being calculated in the background, stop that
+   and do the rest of the frames now */
+static void data_set_finish_min_max(AmitkDataSet * ds) {
+
+  if (ds->min_max_idle_id != 0) {
+    g_source_remove(ds->min_max_idle_id);
+    ds->min_max_idle_id = 0;
+    amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+    g_signal_emit(G_OBJECT (ds), data_set_signals[MIN_MAX_CHANGED], 0);
+  } else {
+    amitk_data_set_calc_min_max_if_needed(ds, NULL, NULL);
+  }
+
+  return;
+}
+
+/* calculate the first reference frame right away, and the rest of the frames
+   from the main loop */
+void amitk_data_set_calc_min_max_in_background(AmitkDataSet * ds) {
+
+  guint frame;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(ds->raw_data != NULL);
+
+  if (ds->min_max_calculated) return;
+  if (ds->min_max_idle_id != 0) return; /* already going */
+
+  frame = ds->threshold_ref_frame[0];
+  if (frame >= AMITK_DATA_SET_NUM_FRAMES(ds)) frame = 0;
+  data_set_calc_frame_min_max_if_needed(ds, frame);
+
+  if (!ds->min_max_calculated)
+    ds->min_max_idle_id = g_idle_add_full(G_PRIORITY_LOW, data_set_calc_min_max_idle, ds, NULL);
+
   return;
 }
 
@@ -3420,6 +3762,10 @@ void amitk_data_set_calc_distribution(AmitkDataSet * ds,
       ds->distribution = NULL;
     }
 
+  /* the distribution needs the real global max/min, not a provisional one */
+  if (ds->distribution == NULL)
+    amitk_data_set_calc_min_max_if_needed(ds, update_func, update_data);
+
   (*calc_distribution_func[ds->raw_data->format][ds->scaling_type])(ds, update_func, update_data);
   return;
 }
@@ -4139,6 +4485,49 @@ static AmitkDataSet * (*get_slice_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM]
   {amitk_data_set_DOUBLE_0D_SCALING_get_slice,amitk_data_set_DOUBLE_1D_SCALING_get_slice, amitk_data_set_DOUBLE_2D_SCALING_get_slice,amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_get_slice,amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_get_slice, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_get_slice }
 };
 
+/* generates the slice from source, which is either the data set itself or
+   one of its pyramid levels.  Slices from a pyramid level still get the data 
+   set as their slice parent */
+static AmitkDataSet * data_set_get_slice_from(AmitkDataSet * source,
+					      AmitkDataSet * ds,
+					      const amide_time_t start,
+					      const amide_time_t duration,
+					      const amide_intpoint_t gate,
+					      const AmitkCanvasPoint pixel_size,
+					      const AmitkVolume * slice_volume) {
+
+  AmitkDataSet * slice;
+
+  /* hand everything off to the data type specific function */
+  slice = (*get_slice_func[source->raw_data->format][source->scaling_type])(source, start, duration, gate, pixel_size, slice_volume);
+
+  if ((slice != NULL) && (source != ds))
+    amitk_data_set_set_slice_parent(slice, ds);
+
+  return slice;
+}
+
+/* slices can be generated from several threads at once, and older versions of glib
+   don't lock an object's weak pointer list, so changes to slice_parent go through here */
+G_LOCK_DEFINE_STATIC(slice_parent);
+
+void amitk_data_set_set_slice_parent(AmitkDataSet * slice, AmitkDataSet * slice_parent) {
+
+  G_LOCK(slice_parent);
+
+  if (slice->slice_parent != NULL)
+    g_object_remove_weak_pointer(G_OBJECT(slice->slice_parent), 
+				 (gpointer *) &(slice->slice_parent));
+  slice->slice_parent = slice_parent;
+  if (slice_parent != NULL)
+    g_object_add_weak_pointer(G_OBJECT(slice_parent), 
+			      (gpointer *) &(slice->slice_parent));
+
+  G_UNLOCK(slice_parent);
+
+  return;
+}
+
 /* returns a "2D" slice from a data set */
 AmitkDataSet *amitk_data_set_get_slice(AmitkDataSet * ds,
 				       const amide_time_t start,
@@ -4147,75 +4536,422 @@ AmitkDataSet *amitk_data_set_get_slice(AmitkDataSet * ds,
 				       const AmitkCanvasPoint pixel_size,
 				       const AmitkVolume * slice_volume) {
 
-  AmitkDataSet * slice;
-
   g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
   g_return_val_if_fail(ds->raw_data != NULL, NULL);
 
-  /* hand everything off to the data type specific function */
-  slice = (*get_slice_func[ds->raw_data->format][ds->scaling_type])(ds, start, duration, gate, pixel_size, slice_volume);
-  return slice;
+  return data_set_get_slice_from(ds, ds, start, duration, gate, pixel_size, slice_volume);
 }
 
-/* start_point and end_point should be in the base coordinate frame */
-void  amitk_data_set_get_line_profile(AmitkDataSet * ds,
-				      const amide_time_t start,
-				      const amide_time_t duration,
-				      const AmitkPoint base_start_point,
-				      const AmitkPoint base_end_point,
-				      GPtrArray ** preturn_data) {
 
-  AmitkPoint start_point, end_point;
-  AmitkPoint candidate_point, current_point;
-  AmitkPoint step;
-  AmitkPoint direction;
-  AmitkVoxel current_voxel, last_voxel, candidate_voxel;
-  amide_real_t min_size;
-  amide_real_t length;
-  amide_intpoint_t i_gate;
-  gint start_frame, end_frame;
-  amide_time_t used_start, used_end, used_duration;
-  amide_time_t ds_start, ds_end;
-  amide_data_t value, gate_value, time_weight;
-  AmitkLineProfileDataElement * element;
-  AmitkPoint voxel_point;
-  gdouble m;
 
-  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+/* The pyramid holds reduced resolution copies of the data set, each level
+   being the previous one box averaged down by 2 in x, y, and z.  The levels are
+   stored as FLOAT with the data set's scaling already applied, and have the same
+   extent, frames, and gates as the data set.
+
+   Levels are only used for MPR slices where the requested pixel size is at least
+   as big as the level's voxels (so the level's voxels average over at most the 
+   slice's pixel footprint), and are thrown out whenever the slice cache is
+   invalidated.  Data sets smaller than PYRAMID_MIN_VOXELS per frame/gate are 
+   cheap enough to slice as is. */
+#define PYRAMID_MIN_VOXELS (64*64*64)
+
+/* roughly how many reduced voxels get computed per call of the background idle
+   function, so that the main loop doesn't stall on big data sets */
+#define PYRAMID_IDLE_VOXELS (256*256*8)
+
+static void (*reduce_frame_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(AmitkDataSet *, const amide_intpoint_t, const gint, const gint, AmitkDataSet *) = {
+  {amitk_data_set_UBYTE_0D_SCALING_reduce_frame, amitk_data_set_UBYTE_1D_SCALING_reduce_frame,  amitk_data_set_UBYTE_2D_SCALING_reduce_frame, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_reduce_frame, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_reduce_frame,  amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_reduce_frame  },
+  {amitk_data_set_SBYTE_0D_SCALING_reduce_frame, amitk_data_set_SBYTE_1D_SCALING_reduce_frame,  amitk_data_set_SBYTE_2D_SCALING_reduce_frame, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_reduce_frame, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_reduce_frame,  amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_reduce_frame  },
+  {amitk_data_set_USHORT_0D_SCALING_reduce_frame,amitk_data_set_USHORT_1D_SCALING_reduce_frame, amitk_data_set_USHORT_2D_SCALING_reduce_frame,amitk_data_set_USHORT_0D_SCALING_INTERCEPT_reduce_frame,amitk_data_set_USHORT_1D_SCALING_INTERCEPT_reduce_frame, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_reduce_frame },
+  {amitk_data_set_SSHORT_0D_SCALING_reduce_frame,amitk_data_set_SSHORT_1D_SCALING_reduce_frame, amitk_data_set_SSHORT_2D_SCALING_reduce_frame,amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_reduce_frame,amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_reduce_frame, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_reduce_frame },
+  {amitk_data_set_UINT_0D_SCALING_reduce_frame,  amitk_data_set_UINT_1D_SCALING_reduce_frame,   amitk_data_set_UINT_2D_SCALING_reduce_frame,  amitk_data_set_UINT_0D_SCALING_INTERCEPT_reduce_frame,  amitk_data_set_UINT_1D_SCALING_INTERCEPT_reduce_frame,   amitk_data_set_UINT_2D_SCALING_INTERCEPT_reduce_frame   },
+  {amitk_data_set_SINT_0D_SCALING_reduce_frame,  amitk_data_set_SINT_1D_SCALING_reduce_frame,   amitk_data_set_SINT_2D_SCALING_reduce_frame,  amitk_data_set_SINT_0D_SCALING_INTERCEPT_reduce_frame,  amitk_data_set_SINT_1D_SCALING_INTERCEPT_reduce_frame,   amitk_data_set_SINT_2D_SCALING_INTERCEPT_reduce_frame   },
+  {amitk_data_set_FLOAT_0D_SCALING_reduce_frame, amitk_data_set_FLOAT_1D_SCALING_reduce_frame,  amitk_data_set_FLOAT_2D_SCALING_reduce_frame, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_reduce_frame, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_reduce_frame,  amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_reduce_frame  },
+  {amitk_data_set_DOUBLE_0D_SCALING_reduce_frame,amitk_data_set_DOUBLE_1D_SCALING_reduce_frame, amitk_data_set_DOUBLE_2D_SCALING_reduce_frame,amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_reduce_frame,amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_reduce_frame, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_reduce_frame }
+};
 
-  *preturn_data = g_ptr_array_new();
-  g_return_if_fail(*preturn_data != NULL);
+static void data_set_drop_pyramid(AmitkDataSet * ds) {
 
-  /* figure out what frames of this data set to use */
-  used_start = start;
-  start_frame = amitk_data_set_get_frame(ds, used_start);
-  ds_start = amitk_data_set_get_start_time(ds, start_frame);
+  gint i;
 
-  used_end = start+duration;
-  end_frame = amitk_data_set_get_frame(ds, used_end);
-  ds_end = amitk_data_set_get_end_time(ds, end_frame);
+  if (ds->pyramid_idle_id != 0) {
+    g_source_remove(ds->pyramid_idle_id);
+    ds->pyramid_idle_id = 0;
+  }
 
-  if (ds_end < used_end) used_end = ds_end;
-  if (ds_start > used_start) used_start = ds_start;
-  used_duration = used_end-used_start;
+  for (i=0; i < AMITK_DATA_SET_PYRAMID_LEVELS; i++)
+    if (ds->pyramid[i] != NULL) {
+      amitk_object_unref(ds->pyramid[i]);
+      ds->pyramid[i] = NULL;
+    }
+  ds->pyramid_levels = 0;
+  ds->pyramid_frame = 0;
+  ds->pyramid_plane = 0;
 
-  /* translate the start and end into the data set's coordinate frame */
-  start_point = amitk_space_b2s(AMITK_SPACE(ds), base_start_point);
-  end_point = amitk_space_b2s(AMITK_SPACE(ds), base_end_point);
+  return;
+}
 
-  /* figure out the direction we want to go */
-  direction = point_sub(end_point, start_point);
-  length = point_mag(direction);
+/* the dimensions of the given pyramid level */
+static AmitkVoxel data_set_pyramid_dim(const AmitkDataSet * ds, const gint level) {
 
-  /* figure out what our "step" size will be (1/4 a voxel size) */
-  min_size = point_min_dim(AMITK_DATA_SET_VOXEL_SIZE(ds));
-  step = point_cmult((1.0/4.0)*min_size*(1.0/length), direction);
+  AmitkVoxel dim;
+  gint i;
 
-  /* initialize starting values */
-  current_point = start_point;
-  POINT_TO_VOXEL(current_point, AMITK_DATA_SET_VOXEL_SIZE(ds), start_frame, AMITK_DATA_SET_VIEW_START_GATE(ds), current_voxel);
+  dim = AMITK_DATA_SET_DIM(ds);
+  for (i=0; i <= level; i++) {
+    dim.x = (dim.x+1)/2;
+    dim.y = (dim.y+1)/2;
+    dim.z = (dim.z+1)/2;
+  }
 
-  while (point_mag(point_sub(current_point, start_point)) < length) {
+  return dim;
+}
+
+static gboolean data_set_pyramid_worthwhile(const AmitkDataSet * ds) {
+  return (((gsize) AMITK_DATA_SET_DIM_X(ds))*AMITK_DATA_SET_DIM_Y(ds)*AMITK_DATA_SET_DIM_Z(ds) >= PYRAMID_MIN_VOXELS);
+}
+
+/* start off an empty pyramid level */
+static AmitkDataSet * data_set_new_pyramid_level(AmitkDataSet * ds, const gint level) {
+
+  AmitkDataSet * reduced;
+  AmitkVoxel dim;
+  AmitkPoint voxel_size;
+  guint i;
+
+  dim = data_set_pyramid_dim(ds, level);
+  reduced = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(ds), 
+					 AMITK_FORMAT_FLOAT, dim, AMITK_SCALING_TYPE_0D);
+  if (reduced == NULL) return NULL;
+
+  /* the voxels are stretched slightly where the dimensions were odd, so that
+     the level covers the same volume as the data set */
+  voxel_size = AMITK_VOLUME_CORNER(ds);
+  voxel_size.x /= dim.x;
+  voxel_size.y /= dim.y;
+  voxel_size.z /= dim.z;
+  reduced->voxel_size = voxel_size;
+  amitk_space_copy_in_place(AMITK_SPACE(reduced), AMITK_SPACE(ds));
+  amitk_data_set_calc_far_corner(reduced);
+
+  reduced->scan_start = AMITK_DATA_SET_SCAN_START(ds);
+  for (i=0; i < AMITK_DATA_SET_NUM_FRAMES(ds); i++)
+    reduced->frame_duration[i] = amitk_data_set_get_frame_duration(ds, i);
+  for (i=0; i < AMITK_DATA_SET_NUM_GATES(ds); i++)
+    reduced->gate_time[i] = amitk_data_set_get_gate_time(ds, i);
+  amitk_data_set_set_scale_factor(reduced, 1.0);
+
+  return reduced;
+}
+
+/* does (up to) the next max_voxels worth of planes of the pyramid, but at least
+   one plane and never past the end of the frame. Returns FALSE once the pyramid
+   is complete */
+static gboolean data_set_calc_pyramid_planes(AmitkDataSet * ds, const gsize max_voxels) {
+
+  AmitkDataSet * source;
+  AmitkVoxel dim;
+  gint level;
+  gint num_planes, end_plane;
+  gsize planes;
+
+  level = ds->pyramid_levels;
+  if (level >= AMITK_DATA_SET_PYRAMID_LEVELS) return FALSE;
+
+  if (ds->pyramid[level] == NULL) {
+    ds->pyramid[level] = data_set_new_pyramid_level(ds, level);
+    if (ds->pyramid[level] == NULL) {
+      g_warning(_("couldn't allocate memory space for the reduced resolution data set"));
+      ds->pyramid_levels = AMITK_DATA_SET_PYRAMID_LEVELS; /* don't bother trying again */
+      return FALSE;
+    }
+    ds->pyramid_frame = 0;
+    ds->pyramid_plane = 0;
+  }
+
+  dim = AMITK_DATA_SET_DIM(ds->pyramid[level]);
+  num_planes = dim.z*dim.g;
+  planes = MAX(1, max_voxels/(((gsize) dim.x)*dim.y));
+  if (planes >= (gsize) (num_planes - ds->pyramid_plane))
+    end_plane = num_planes;
+  else
+    end_plane = ds->pyramid_plane + planes;
+
+  /* each level is built from the one before it */
+  source = (level == 0) ? ds : ds->pyramid[level-1];
+  (*reduce_frame_func[source->raw_data->format][source->scaling_type])(source, ds->pyramid_frame, 
+								      ds->pyramid_plane, end_plane,
+								      ds->pyramid[level]);
+
+  ds->pyramid_plane = end_plane;
+  if (ds->pyramid_plane >= num_planes) {
+    ds->pyramid_plane = 0;
+    ds->pyramid_frame++;
+    if (ds->pyramid_frame >= AMITK_DATA_SET_NUM_FRAMES(ds)) {
+      ds->pyramid_levels++;
+      ds->pyramid_frame = 0;
+    }
+  }
+
+  return (ds->pyramid_levels < AMITK_DATA_SET_PYRAMID_LEVELS);
+}
+
+static gboolean data_set_calc_pyramid_idle(gpointer data) {
+
+  AmitkDataSet * ds = data;
+
+  if (data_set_calc_pyramid_planes(ds, PYRAMID_IDLE_VOXELS)) 
+    return TRUE;
+
+  ds->pyramid_idle_id = 0;
+  return FALSE;
+}
+
+/* builds whatever's left of the pyramid right away */
+void amitk_data_set_calc_pyramid(AmitkDataSet * ds,
+				 AmitkUpdateFunc update_func,
+				 gpointer update_data) {
+
+  gchar * temp_string;
+  gboolean continue_work=TRUE;
+  gint total, done;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(ds->raw_data != NULL);
+
+  if (!data_set_pyramid_worthwhile(ds)) return;
+  if (ds->pyramid_levels >= AMITK_DATA_SET_PYRAMID_LEVELS) return;
+
+  if (ds->pyramid_idle_id != 0) {
+    g_source_remove(ds->pyramid_idle_id);
+    ds->pyramid_idle_id = 0;
+  }
+
+  total = AMITK_DATA_SET_PYRAMID_LEVELS*AMITK_DATA_SET_NUM_FRAMES(ds);
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Reducing resolution of data set: %s"), AMITK_OBJECT_NAME(ds));
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+
+  do {
+    done = ds->pyramid_levels*AMITK_DATA_SET_NUM_FRAMES(ds) + ds->pyramid_frame;
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, ((gdouble) done)/((gdouble) total));
+  } while (continue_work && data_set_calc_pyramid_planes(ds, G_MAXSIZE));
+
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+
+  return;
+}
+
+/* builds the pyramid a few planes at a time from the main loop */
+void amitk_data_set_calc_pyramid_in_background(AmitkDataSet * ds) {
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(ds->raw_data != NULL);
+
+  if (!data_set_pyramid_worthwhile(ds)) return;
+  if (ds->pyramid_levels >= AMITK_DATA_SET_PYRAMID_LEVELS) return;
+  if (ds->pyramid_idle_id != 0) return; /* already going */
+
+  ds->pyramid_idle_id = g_idle_add_full(G_PRIORITY_LOW, data_set_calc_pyramid_idle, ds, NULL);
+
+  return;
+}
+
+/* figure out what to generate a slice with the given pixel size from, this is 
+   the coarsest complete pyramid level that's no coarser than the pixel size, 
+   or the data set itself.  If a coarser level would do, it gets built in 
+   the background for next time. Should only be called from the main thread. */
+static AmitkDataSet * data_set_get_slice_source(AmitkDataSet * ds, 
+						const AmitkCanvasPoint pixel_size) {
+
+  AmitkDataSet * level;
+  AmitkPoint corner;
+  AmitkVoxel dim;
+  amide_real_t min_pixel;
+  gint wanted, i;
+
+  if (AMITK_DATA_SET_RENDERING(ds) != AMITK_RENDERING_MPR) return ds;
+  if (!data_set_pyramid_worthwhile(ds)) return ds;
+
+  corner = AMITK_VOLUME_CORNER(ds);
+  min_pixel = MIN(pixel_size.x, pixel_size.y)*(1.0+EPSILON);
+  wanted = -1;
+  for (i=0; i < AMITK_DATA_SET_PYRAMID_LEVELS; i++) {
+    dim = data_set_pyramid_dim(ds, i);
+    if ((corner.x/dim.x > min_pixel) || (corner.y/dim.y > min_pixel) || (corner.z/dim.z > min_pixel))
+      break;
+    wanted = i;
+  }
+  if (wanted < 0) return ds;
+
+  if (ds->pyramid_levels <= wanted)
+    amitk_data_set_calc_pyramid_in_background(ds);
+  if (ds->pyramid_levels == 0) return ds;
+  level = ds->pyramid[MIN(wanted, ds->pyramid_levels-1)];
+
+  return level;
+}
+
+/* a stand-in for ds for generating slices on another thread, with the voxels
+   of source (ds itself or one of its pyramid levels) and the view settings 
+   (interpolation, rendering, view gates...) of ds.  Changes to ds (e.g.
+   amitk_object_copy_in_place) swap out its voxels and internal scaling rather
+   than changing them, so those are just referenced, but everything that gets
+   reallocated or rewritten in place is copied.  Pyramid levels themselves are
+   never touched once built.  Should only be called from the main thread. */
+static AmitkDataSet * data_set_new_slice_snapshot(AmitkDataSet * source, AmitkDataSet * ds) {
+
+  AmitkDataSet * snapshot;
+  AmitkRawData * scaling;
+  guint i;
+
+  g_return_val_if_fail(source->raw_data != NULL, NULL);
+
+  snapshot = amitk_data_set_new(NULL, AMITK_DATA_SET_MODALITY(ds));
+  amitk_object_set_name(AMITK_OBJECT(snapshot), AMITK_OBJECT_NAME(ds));
+  amitk_data_set_set_slice_parent(snapshot, ds);
+
+  snapshot->raw_data = g_object_ref(source->raw_data);
+  snapshot->scaling_type = source->scaling_type;
+  g_object_unref(snapshot->internal_scaling_factor);
+  snapshot->internal_scaling_factor = g_object_ref(source->internal_scaling_factor);
+  if (source->internal_scaling_intercept != NULL)
+    snapshot->internal_scaling_intercept = g_object_ref(source->internal_scaling_intercept);
+
+  /* the current scaling factor gets rewritten when the scale factor changes */
+  scaling = source->current_scaling_factor;
+  g_object_unref(snapshot->current_scaling_factor);
+  snapshot->current_scaling_factor = amitk_raw_data_new_with_data(scaling->format, scaling->dim);
+  if (snapshot->current_scaling_factor == NULL) {
+    g_warning(_("couldn't allocate memory space for the data set's scaling factors"));
+    amitk_object_unref(snapshot);
+    return NULL;
+  }
+  memcpy(snapshot->current_scaling_factor->data, scaling->data, amitk_raw_data_size_data_mem(scaling));
+  snapshot->scale_factor = AMITK_DATA_SET_SCALE_FACTOR(source);
+
+  snapshot->voxel_size = AMITK_DATA_SET_VOXEL_SIZE(source);
+  amitk_space_copy_in_place(AMITK_SPACE(snapshot), AMITK_SPACE(source));
+  amitk_data_set_calc_far_corner(snapshot);
+
+  snapshot->scan_start = AMITK_DATA_SET_SCAN_START(source);
+  snapshot->frame_duration = amitk_data_set_get_frame_duration_mem(snapshot);
+  snapshot->gate_time = amitk_data_set_get_gate_time_mem(snapshot);
+  if ((snapshot->frame_duration == NULL) || (snapshot->gate_time == NULL)) {
+    g_warning(_("couldn't allocate memory space for the frame duration info"));
+    amitk_object_unref(snapshot);
+    return NULL;
+  }
+  for (i=0; i < AMITK_DATA_SET_NUM_FRAMES(source); i++)
+    snapshot->frame_duration[i] = amitk_data_set_get_frame_duration(source, i);
+  for (i=0; i < AMITK_DATA_SET_NUM_GATES(source); i++)
+    snapshot->gate_time[i] = amitk_data_set_get_gate_time(source, i);
+
+  snapshot->interpolation = AMITK_DATA_SET_INTERPOLATION(ds);
+  snapshot->rendering = AMITK_DATA_SET_RENDERING(ds);
+  snapshot->thresholding = AMITK_DATA_SET_THRESHOLDING(ds);
+  snapshot->view_start_gate = AMITK_DATA_SET_VIEW_START_GATE(ds);
+  snapshot->view_end_gate = AMITK_DATA_SET_VIEW_END_GATE(ds);
+  snapshot->num_view_gates = AMITK_DATA_SET_NUM_VIEW_GATES(ds);
+
+  return snapshot;
+}
+
+/* like amitk_data_set_get_slice, but for views where speed matters more than
+   exactness (zoomed out views, thumbnails, coarse registration). Where the 
+   pixel size is much bigger than the data set's voxels, the slice comes from 
+   the data set's reduced resolution pyramid if it's been built. */
+AmitkDataSet *amitk_data_set_get_pyramid_slice(AmitkDataSet * ds,
+					       const amide_time_t start,
+					       const amide_time_t duration,
+					       const amide_intpoint_t gate,
+					       const AmitkCanvasPoint pixel_size,
+					       const AmitkVolume * slice_volume) {
+
+  AmitkDataSet * source;
+  AmitkDataSet * snapshot;
+  AmitkDataSet * slice;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+  g_return_val_if_fail(ds->raw_data != NULL, NULL);
+
+  source = data_set_get_slice_source(ds, pixel_size);
+  if (source == ds)
+    return data_set_get_slice_from(ds, ds, start, duration, gate, pixel_size, slice_volume);
+
+  /* the pyramid level needs ds's view settings */
+  snapshot = data_set_new_slice_snapshot(source, ds);
+  if (snapshot == NULL) return NULL;
+  slice = data_set_get_slice_from(snapshot, ds, start, duration, gate, pixel_size, slice_volume);
+  amitk_object_unref(snapshot);
+
+  return slice;
+}
+
+/* start_point and end_point should be in the base coordinate frame */
+void  amitk_data_set_get_line_profile(AmitkDataSet * ds,
+				      const amide_time_t start,
+				      const amide_time_t duration,
+				      const AmitkPoint base_start_point,
+				      const AmitkPoint base_end_point,
+				      GPtrArray ** preturn_data) {
+
+  AmitkPoint start_point, end_point;
+  AmitkPoint candidate_point, current_point;
+  AmitkPoint step;
+  AmitkPoint direction;
+  AmitkVoxel current_voxel, last_voxel, candidate_voxel;
+  amide_real_t min_size;
+  amide_real_t length;
+  amide_intpoint_t i_gate;
+  gint start_frame, end_frame;
+  amide_time_t used_start, used_end, used_duration;
+  amide_time_t ds_start, ds_end;
+  amide_data_t value, gate_value, time_weight;
+  AmitkLineProfileDataElement * element;
+  AmitkPoint voxel_point;
+  gdouble m;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+
+  *preturn_data = g_ptr_array_new();
+  g_return_if_fail(*preturn_data != NULL);
+
+  /* figure out what frames of this data set to use */
+  used_start = start;
+  start_frame = amitk_data_set_get_frame(ds, used_start);
+  ds_start = amitk_data_set_get_start_time(ds, start_frame);
+
+  used_end = start+duration;
+  end_frame = amitk_data_set_get_frame(ds, used_end);
+  ds_end = amitk_data_set_get_end_time(ds, end_frame);
+
+  if (ds_end < used_end) used_end = ds_end;
+  if (ds_start > used_start) used_start = ds_start;
+  used_duration = used_end-used_start;
+
+  /* translate the start and end into the data set's coordinate frame */
+  start_point = amitk_space_b2s(AMITK_SPACE(ds), base_start_point);
+  end_point = amitk_space_b2s(AMITK_SPACE(ds), base_end_point);
+
+  /* figure out the direction we want to go */
+  direction = point_sub(end_point, start_point);
+  length = point_mag(direction);
+
+  /* figure out what our "step" size will be (1/4 a voxel size) */
+  min_size = point_min_dim(AMITK_DATA_SET_VOXEL_SIZE(ds));
+  step = point_cmult((1.0/4.0)*min_size*(1.0/length), direction);
+
+  /* initialize starting values */
+  current_point = start_point;
+  POINT_TO_VOXEL(current_point, AMITK_DATA_SET_VOXEL_SIZE(ds), start_frame, AMITK_DATA_SET_VIEW_START_GATE(ds), current_voxel);
+
+  while (point_mag(point_sub(current_point, start_point)) < length) {
 
     /* this next snippet of code advances us along the line so that we're at the point
        on the line closest to the center of the voxel */
@@ -4282,11 +5018,107 @@ void  amitk_data_set_get_line_profile(AmitkDataSet * ds,
 
 
 
-/* return the three planar projections of the data set */
+/* used for computing projections in parallel.  Each chunk of planes
+   works on its own partial transverse projection, as every plane adds to
+   all of it, while each plane has its own row in the coronal and
+   sagittal projections */
+typedef struct {
+  AmitkDataSet * ds;
+  AmitkProjection projection;
+  AmitkVoxel dim;
+  guint frame;
+  guint gate;
+  amide_data_t weight; /* for sums, how much this frame and gate count */
+  amide_intpoint_t first_plane;
+  amide_intpoint_t planes_per_chunk;
+  amide_intpoint_t end_plane;
+  amitk_format_DOUBLE_t ** transverse; /* one partial projection per chunk */
+  amitk_format_DOUBLE_t * coronal;
+  amitk_format_DOUBLE_t * sagittal;
+} projections_t;
+
+static void projections_planes_func(const gint start, const gint end, gpointer data) {
+
+  projections_t * job = data;
+  amide_data_t * values;
+  amide_data_t * row;
+  amitk_format_DOUBLE_t * transverse;
+  amitk_format_DOUBLE_t * transverse_row;
+  amitk_format_DOUBLE_t * coronal_row;
+  amitk_format_DOUBLE_t * sagittal_row;
+  amide_data_t weight = job->weight;
+  amide_data_t total;
+  amide_intpoint_t z, z_end, y, x;
+  gint chunk;
+
+  values = g_new(amide_data_t, ((gsize) job->dim.y)*job->dim.x);
+
+  for (chunk=start; chunk<end; chunk++) {
+    transverse = job->transverse[chunk];
+    z = job->first_plane+chunk*job->planes_per_chunk;
+    z_end = MIN(z+job->planes_per_chunk, job->end_plane);
+
+    for (; z < z_end; z++) {
+      amitk_data_set_get_plane_values(job->ds, job->frame, job->gate, z, values);
+      coronal_row = job->coronal + ((gsize) (job->dim.z-z-1))*job->dim.x;
+      sagittal_row = job->sagittal + ((gsize) (job->dim.z-z-1))*job->dim.y;
+
+      /* a row at a time, so it's still in cache for all three projections */
+      for (y=0; y < job->dim.y; y++) {
+	row = values + ((gsize) y)*job->dim.x;
+	transverse_row = transverse + ((gsize) y)*job->dim.x;
+
+	switch(job->projection) {
+	case AMITK_PROJECTION_MAXIMUM:
+	  total = sagittal_row[y];
+	  for (x=0; x < job->dim.x; x++) {
+	    transverse_row[x] = (row[x] > transverse_row[x]) ? row[x] : transverse_row[x];
+	    coronal_row[x] = (row[x] > coronal_row[x]) ? row[x] : coronal_row[x];
+	    total = (row[x] > total) ? row[x] : total;
+	  }
+	  sagittal_row[y] = total;
+	  break;
+	case AMITK_PROJECTION_MINIMUM:
+	  total = sagittal_row[y];
+	  for (x=0; x < job->dim.x; x++) {
+	    transverse_row[x] = (row[x] < transverse_row[x]) ? row[x] : transverse_row[x];
+	    coronal_row[x] = (row[x] < coronal_row[x]) ? row[x] : coronal_row[x];
+	    total = (row[x] < total) ? row[x] : total;
+	  }
+	  sagittal_row[y] = total;
+	  break;
+	case AMITK_PROJECTION_SUM:
+	default:
+	  total = 0.0;
+	  for (x=0; x < job->dim.x; x++) {
+	    transverse_row[x] += weight*row[x];
+	    coronal_row[x] += weight*row[x];
+	    total += row[x];
+	  }
+	  sagittal_row[y] += weight*total;
+	  break;
+	}
+      }
+    }
+  }
+
+  g_free(values);
+
+  return;
+}
+
+/* return the three planar projections of the data set over the given frames and gates */
 /* projections should be an array of 3 pointers to data sets */
+/* AMITK_PROJECTION_SUM gives the average along each ray, times the voxel
+   size, so that values in units of blah/mm^3 become blah/mm^2.  Frames are
+   weighted by their duration, and gates equally.  AMITK_PROJECTION_MAXIMUM 
+   and AMITK_PROJECTION_MINIMUM give the maximum/minimum intensity projections */
 void amitk_data_set_get_projections(AmitkDataSet * ds,
-				    const guint frame,
-				    const guint gate,
+				    const AmitkProjection projection,
+				    const guint start_frame,
+				    const guint num_frames,
+				    const guint start_gate,
+				    const guint num_gates,
 				    AmitkDataSet ** projections,
 				    AmitkUpdateFunc update_func,
 				    gpointer update_data) {
@@ -4294,28 +5126,55 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
   AmitkVoxel dim, planar_dim, i;
   AmitkPoint voxel_size;
   amide_data_t normalizers[AMITK_VIEW_NUM];
-  div_t x;
-  gint divider;
+  amide_data_t initial_value;
+  amide_time_t total_duration;
   gboolean continue_work=TRUE;
   gchar * temp_string;
   AmitkView i_view;
-  amide_data_t value;
+  projections_t job;
+  gint num_chunks=0, batch, c;
+  guint i_frame, i_gate;
+  gsize k, num_voxels;
+  gint total_planes, image_num;
+  amitk_format_DOUBLE_t * transverse;
+  amitk_format_DOUBLE_t * partial;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
   g_return_if_fail(ds->raw_data != NULL);
   g_return_if_fail(projections != NULL);
+  g_return_if_fail((num_frames > 0) && (start_frame+num_frames <= AMITK_DATA_SET_NUM_FRAMES(ds)));
+  g_return_if_fail((num_gates > 0) && (start_gate+num_gates <= AMITK_DATA_SET_NUM_GATES(ds)));
 
+  for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++)
+    projections[i_view] = NULL;
+  job.transverse = NULL;
 
   dim = AMITK_DATA_SET_DIM(ds);
   voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ds);
 
+  total_duration = 0.0;
+  for (i_frame=start_frame; i_frame < start_frame+num_frames; i_frame++)
+    total_duration += amitk_data_set_get_frame_duration(ds, i_frame);
+
+  switch(projection) {
+  case AMITK_PROJECTION_MAXIMUM:
+    initial_value = -INFINITY;
+    break;
+  case AMITK_PROJECTION_MINIMUM:
+    initial_value = INFINITY;
+    break;
+  case AMITK_PROJECTION_SUM:
+  default:
+    initial_value = 0.0;
+    break;
+  }
+
   /* setup the wait dialog */
   if (update_func != NULL) {
     temp_string = g_strdup_printf(_("Generating projections of:\n   %s"), AMITK_OBJECT_NAME(ds));
     continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
     g_free(temp_string);
   }
-  divider = ((dim.z/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (dim.z/AMITK_UPDATE_DIVIDER);
 
   /* initialize the 3 projections */
   for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) {
@@ -4344,7 +5203,7 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
     if (projections[i_view] == NULL) {
       g_warning(_("couldn't allocate memory space for the projection, wanted %dx%dx%dx%dx%d elements"), 
 		planar_dim.x, planar_dim.y, planar_dim.z, planar_dim.g, planar_dim.t);
-      return;
+      goto error;
     }
 
     switch(i_view) {
@@ -4369,62 +5228,99 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
       break;
     }
 
-    projections[i_view]->slice_parent = ds;
-    g_object_add_weak_pointer(G_OBJECT(ds), 
-			      (gpointer *) &(projections[i_view]->slice_parent));
+    amitk_data_set_set_slice_parent(projections[i_view], ds);
     amitk_space_copy_in_place(AMITK_SPACE(projections[i_view]), AMITK_SPACE(ds));
     amitk_data_set_calc_far_corner(projections[i_view]);
-    projections[i_view]->scan_start = amitk_data_set_get_start_time(ds, frame);
+    projections[i_view]->scan_start = amitk_data_set_get_start_time(ds, start_frame);
     amitk_data_set_set_thresholding(projections[i_view], AMITK_THRESHOLDING_GLOBAL);
     amitk_data_set_set_color_table(projections[i_view], AMITK_VIEW_MODE_SINGLE, AMITK_DATA_SET_COLOR_TABLE(ds, AMITK_VIEW_MODE_SINGLE));
-    amitk_data_set_set_gate_time(projections[i_view], 0, amitk_data_set_get_gate_time(ds, gate));
-    amitk_data_set_set_frame_duration(projections[i_view], 0, amitk_data_set_get_frame_duration(ds, frame));
+    amitk_data_set_set_gate_time(projections[i_view], 0, amitk_data_set_get_gate_time(ds, start_gate));
+    amitk_data_set_set_frame_duration(projections[i_view], 0, total_duration);
 
     /* initialize our projection */
-    amitk_raw_data_DOUBLE_initialize_data(projections[i_view]->raw_data, 0.0);
+    amitk_raw_data_DOUBLE_initialize_data(projections[i_view]->raw_data, initial_value);
   }
 
-
-  /* now iterate through the entire data set, adding up the 3 projections */
-  i.t = frame;
-  i.g = gate;
-  for (i.z = 0; (i.z < dim.z) && continue_work; i.z++) {
-
-    if (update_func != NULL) {
-      x = div(i.z,divider);
-      if (x.rem == 0)
-	continue_work = (*update_func)(update_data, NULL, (gdouble) (i.z)/dim.z);
+  /* split the planes up into chunks, with a partial transverse projection for each */
+  num_chunks = MIN(amitk_get_num_threads(), dim.z);
+  batch = 4*amitk_get_num_threads();
+  num_voxels = ((gsize) dim.y)*dim.x;
+  job.transverse = g_new0(amitk_format_DOUBLE_t *, num_chunks);
+  for (c=0; c < num_chunks; c++) {
+    if ((job.transverse[c] = g_try_new(amitk_format_DOUBLE_t, num_voxels)) == NULL) {
+      g_warning(_("couldn't allocate memory space for the projection, wanted %dx%dx%dx%dx%d elements"), 
+		dim.x, dim.y, 1, 1, 1);
+      goto error;
     }
+    for (k=0; k < num_voxels; k++)
+      job.transverse[c][k] = initial_value;
+  }
+
+  i.t = i.g = i.z = i.y = i.x = 0;
+  job.ds = ds;
+  job.projection = projection;
+  job.dim = dim;
+  job.coronal = AMITK_RAW_DATA_DOUBLE_POINTER(projections[AMITK_VIEW_CORONAL]->raw_data, i);
+  job.sagittal = AMITK_RAW_DATA_DOUBLE_POINTER(projections[AMITK_VIEW_SAGITTAL]->raw_data, i);
+  total_planes = dim.z*num_frames*num_gates;
+
+  /* now iterate through the data set, a batch of planes at a time */
+  for (i_frame=start_frame; (i_frame < start_frame+num_frames) && continue_work; i_frame++) {
+    for (i_gate=start_gate; (i_gate < start_gate+num_gates) && continue_work; i_gate++) {
+      job.frame = i_frame;
+      job.gate = i_gate;
+      if (total_duration > 0.0)
+	job.weight = amitk_data_set_get_frame_duration(ds, i_frame)/(total_duration*num_gates);
+      else
+	job.weight = 1.0/(num_frames*num_gates);
+
+      for (i.z = 0; (i.z < dim.z) && continue_work; i.z += batch) {
+	if (update_func != NULL) {
+	  image_num = i.z+dim.z*((i_frame-start_frame)*num_gates + (i_gate-start_gate));
+	  continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/total_planes);
+	}
+	if (!continue_work) break;
 
-    for (i.y = 0; i.y < dim.y; i.y++) {
-      for (i.x = 0; i.x < dim.x; i.x++) {
-	value = amitk_data_set_get_value(ds, i);
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[AMITK_VIEW_TRANSVERSE]->raw_data,i.y, i.x) += value;
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[AMITK_VIEW_CORONAL]->raw_data,dim.z-i.z-1, i.x) += value;
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[AMITK_VIEW_SAGITTAL]->raw_data,dim.z-i.z-1, i.y) += value;
+	job.first_plane = i.z;
+	job.end_plane = MIN(i.z+batch, dim.z);
+	job.planes_per_chunk = (job.end_plane-job.first_plane+num_chunks-1)/num_chunks;
+	amitk_parallel_for(num_chunks, 1, projections_planes_func, &job);
       }
     }
   }
 
-  if (update_func != NULL) /* remove progress bar */
-    continue_work = (*update_func)(update_data, NULL, (gdouble) 2.0);
+  if (!continue_work) /* we hit cancel */
+    goto error;
 
-  if (!continue_work) {/* we hit cancel */
-    for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++) {
-      amitk_object_unref(projections[i_view]);
-      projections[i_view] = NULL;
+  /* merge the partial transverse projections */
+  transverse = AMITK_RAW_DATA_DOUBLE_POINTER(projections[AMITK_VIEW_TRANSVERSE]->raw_data, i);
+  for (c=0; c < num_chunks; c++) {
+    partial = job.transverse[c];
+    switch(projection) {
+    case AMITK_PROJECTION_MAXIMUM:
+      for (k=0; k < num_voxels; k++)
+	transverse[k] = (partial[k] > transverse[k]) ? partial[k] : transverse[k];
+      break;
+    case AMITK_PROJECTION_MINIMUM:
+      for (k=0; k < num_voxels; k++)
+	transverse[k] = (partial[k] < transverse[k]) ? partial[k] : transverse[k];
+      break;
+    case AMITK_PROJECTION_SUM:
+    default:
+      for (k=0; k < num_voxels; k++)
+	transverse[k] += partial[k];
+      break;
     }
-    return;
   }
-    
 
   /* normalize for the thickness, we're assuming the previous voxels were
      in some units of blah/mm^3 */
   /* this bit should be short, as the 3 are planar... not updating progress bar */
   for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++) {
-    for (i.y = 0; i.y < AMITK_DATA_SET_DIM_Y(projections[i_view]); i.y++)
-      for (i.x = 0; i.x < AMITK_DATA_SET_DIM_X(projections[i_view]); i.x++)
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[i_view]->raw_data,i.y, i.x) *= normalizers[i_view];
+    if (projection == AMITK_PROJECTION_SUM)
+      for (i.y = 0; i.y < AMITK_DATA_SET_DIM_Y(projections[i_view]); i.y++)
+	for (i.x = 0; i.x < AMITK_DATA_SET_DIM_X(projections[i_view]); i.x++)
+	  AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[i_view]->raw_data,i.y, i.x) *= normalizers[i_view];
   
     amitk_data_set_set_threshold_max(projections[i_view], 0,
 				     amitk_data_set_get_global_max(projections[i_view]));
@@ -4432,6 +5328,27 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
 				     amitk_data_set_get_global_min(projections[i_view]));
   }
 
+  goto exit;
+
+ error:
+  for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++) {
+    if (projections[i_view] != NULL) {
+      amitk_object_unref(projections[i_view]);
+      projections[i_view] = NULL;
+    }
+  }
+
+ exit:
+  if (job.transverse != NULL) {
+    for (c=0; c < num_chunks; c++)
+      if (job.transverse[c] != NULL)
+	g_free(job.transverse[c]);
+    g_free(job.transverse);
+  }
+
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0);
+
   return;
 }
 
@@ -4465,6 +5382,7 @@ AmitkDataSet *amitk_data_set_get_cropped(const AmitkDataSet * ds,
   gint scaling_progress;
   gint i_progress;
   gboolean continue_work=TRUE;
+  gpointer cropped_row, ds_row;
 
 
   g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
@@ -4795,9 +5713,11 @@ AmitkDataSet *amitk_data_set_get_cropped(const AmitkDataSet * ds,
 	  if (same_format_and_scaling) {
 	    i.x = 0;
 	    j.x = start.x;
-	    memcpy(amitk_raw_data_get_pointer(cropped->raw_data, i),
-		   amitk_raw_data_get_pointer(ds->raw_data, j),
-		   amitk_format_sizes[format]*dim.x);
+	    /* cropped is linear, so rows from a bricked ds get gathered straight into it */
+	    cropped_row = amitk_raw_data_get_pointer(cropped->raw_data, i);
+	    ds_row = amitk_raw_data_get_row(ds->raw_data, j, dim.x, cropped_row);
+	    if (ds_row != cropped_row)
+	      memcpy(cropped_row, ds_row, amitk_format_sizes[format]*dim.x);
 	  } else {
 	    for (i.x=0, j.x=start.x; j.x <= end.x; i.x++, j.x++) {
 	      value = amitk_data_set_get_internal_value(ds, j);
@@ -4871,201 +5791,536 @@ error:
 }
 
 
-#ifdef AMIDE_LIBGSL_SUPPORT
+/* the gaussian filter is separable, so it's run as three 1D passes (x, y, then z) over
+   the FLOAT data in filtered_ds.  Each pass works on "bundles" of lines: a single row for
+   the x pass, and a whole plane's (or row's) worth of lines for the y and z passes, so
+   the inner loops always walk along contiguous memory.
+
+   Short kernels are convolved directly with the kernel truncated at kernel_size, which
+   gives the same result as convolving with the kernel_size^3 gaussian.  When sigma is large
+   and the kernel reaches past 3 sigma, Deriche's 4th order recursive approximation is used
+   instead, so the cost per voxel doesn't depend on the kernel size.  Voxels outside the
+   data set are taken as zero in both cases. */
+#define GAUSSIAN_RECURSIVE_MIN_SIGMA 3.0 /* in voxels */
+#define GAUSSIAN_RECURSIVE_ORDER 4
+
+typedef struct {
+  amitk_format_FLOAT_t * data; /* the frame/gate being filtered */
+  gsize bundle_offset; /* distance between the starts of consecutive bundles */
+  gsize stride; /* distance between neighboring voxels along a line */
+  gint width; /* number of adjacent lines in a bundle */
+  gint length; /* number of voxels in a line */
+
+  /* direct convolution */
+  amide_data_t * kernel;
+  gint half;
+
+  /* recursive filtering, y[n] = causal[n] + anticausal[n] */
+  gboolean recursive;
+  amide_data_t causal_b[GAUSSIAN_RECURSIVE_ORDER]; /* applied to x[n-k], k=0..3 */
+  amide_data_t anticausal_b[GAUSSIAN_RECURSIVE_ORDER]; /* applied to x[n+k], k=1..4 */
+  amide_data_t a[GAUSSIAN_RECURSIVE_ORDER]; /* feedback, k=1..4 */
+} gaussian_pass_t;
+
+/* coefficients from Deriche, INRIA RR-1893 (1993), as laid out in Getreuer, 
+   "A Survey of Gaussian Convolution Algorithms", IPOL 3 (2013).  The causal impulse
+   response is a sum of 4 complex exponentials, sum_j r_j p_j^n, which gets turned into
+   a 4th order recursive filter. */
+static void gaussian_recursive_coefficients(gaussian_pass_t * pass, const amide_real_t sigma) {
+
+  const amide_data_t alpha[2] = {1.68, -0.6803}; /* cosine weights */
+  const amide_data_t beta[2] = {3.735, -0.2598}; /* sine weights */
+  const amide_data_t omega[2] = {0.6318, 1.997};
+  const amide_data_t lambda[2] = {1.783, 1.723};
+  amide_data_t r_re[4], r_im[4], p_re[4], p_im[4];
+  amide_data_t num_re[5], num_im[5], den_re[5], den_im[5];
+  amide_data_t t_re[5], t_im[5];
+  amide_data_t mag, d_re, d_im, q_re, q_im, total;
+  gint j, i, k;
+
+  for (j=0; j<2; j++) {
+    mag = exp(-lambda[j]/sigma);
+    p_re[2*j] = p_re[2*j+1] = mag*cos(omega[j]/sigma);
+    p_im[2*j] = mag*sin(omega[j]/sigma);
+    p_im[2*j+1] = -p_im[2*j];
+    r_re[2*j] = r_re[2*j+1] = 0.5*alpha[j];
+    r_im[2*j] = -0.5*beta[j];
+    r_im[2*j+1] = 0.5*beta[j];
+  }
+
+  /* normalize so the filter has unit gain, sum_n h[n] = sum_j r_j (1+p_j)/(1-p_j) */
+  total = 0.0;
+  for (j=0; j<4; j++) {
+    d_re = 1.0-p_re[j];
+    d_im = -p_im[j];
+    mag = d_re*d_re+d_im*d_im;
+    q_re = ((1.0+p_re[j])*d_re + p_im[j]*d_im)/mag;
+    q_im = (p_im[j]*d_re - (1.0+p_re[j])*d_im)/mag;
+    total += r_re[j]*q_re - r_im[j]*q_im;
+  }
+  for (j=0; j<4; j++) {
+    r_re[j] /= total;
+    r_im[j] /= total;
+  }
+
+  /* denominator = prod_j (1 - p_j z^-1), numerator = sum_j r_j prod_{i!=j} (1 - p_i z^-1) */
+  for (k=0; k<5; k++)
+    den_re[k] = den_im[k] = num_re[k] = num_im[k] = 0.0;
+  den_re[0] = 1.0;
+  for (j=0; j<4; j++) {
+    for (k=0; k<5; k++) {
+      t_re[k] = den_re[k] - ((k > 0) ? (p_re[j]*den_re[k-1] - p_im[j]*den_im[k-1]) : 0.0);
+      t_im[k] = den_im[k] - ((k > 0) ? (p_re[j]*den_im[k-1] + p_im[j]*den_re[k-1]) : 0.0);
+    }
+    for (k=0; k<5; k++) {
+      den_re[k] = t_re[k];
+      den_im[k] = t_im[k];
+    }
+  }
+  for (j=0; j<4; j++) {
+    for (k=0; k<5; k++) {
+      t_re[k] = t_im[k] = 0.0;
+    }
+    t_re[0] = r_re[j];
+    t_im[0] = r_im[j];
+    for (i=0; i<4; i++) {
+      if (i == j) continue;
+      for (k=4; k>0; k--) {
+	t_re[k] -= p_re[i]*t_re[k-1] - p_im[i]*t_im[k-1];
+	t_im[k] -= p_re[i]*t_im[k-1] + p_im[i]*t_re[k-1];
+      }
+    }
+    for (k=0; k<5; k++) {
+      num_re[k] += t_re[k];
+      num_im[k] += t_im[k];
+    }
+  }
 
+  /* the poles come in conjugate pairs, so the imaginary parts are zero */
+  for (k=0; k<GAUSSIAN_RECURSIVE_ORDER; k++) {
+    pass->causal_b[k] = num_re[k];
+    pass->a[k] = den_re[k+1];
+  }
+  for (k=0; k<GAUSSIAN_RECURSIVE_ORDER-1; k++) 
+    pass->anticausal_b[k] = pass->causal_b[k+1] - pass->a[k]*pass->causal_b[0];
+  pass->anticausal_b[GAUSSIAN_RECURSIVE_ORDER-1] = -pass->a[GAUSSIAN_RECURSIVE_ORDER-1]*pass->causal_b[0];
 
-/* fills the data set "filtered_ds", with the results of the kernel convolved to data_set */
-/* assumptions:
-   1- filtered_ds is of type FLOAT, 0D scaling
-   2- scale of filtered_ds is 1.0
-   3- kernel is of type DOUBLE, is in complex packed format, and has odd dimensions in x,y,z,
-      and dimension 1 in t
+  return;
+}
 
-   notes:
-   1. kernel is modified (FFT'd) 
-   2. don't have a separate function for each data type, as getting the data_set data,
-   is a tiny fraction of the computational time, use amitk_data_set_get_internal_value instead
- */
-static gboolean filter_fir(const AmitkDataSet * data_set,
-			   AmitkDataSet * filtered_ds,
-			   AmitkRawData * kernel,
-			   AmitkVoxel kernel_size,
-			   AmitkUpdateFunc update_func, 
-			   gpointer update_data) {
-  
-  AmitkVoxel subset_size;
-  AmitkVoxel i_outer;
-  AmitkVoxel i_inner;
-  AmitkVoxel j_inner;
-  AmitkVoxel half;
-  AmitkVoxel ds_dim;
-  AmitkRawData * subset=NULL;
-  gsl_fft_complex_wavetable * wavetable=NULL;
-  gsl_fft_complex_workspace * workspace = NULL;
-  gchar * temp_string;
-  gint image_num;
-  gint total_planes;
-  gboolean continue_work=TRUE;
+static void gaussian_pass_func(const gint start, const gint end, gpointer data) {
+
+  gaussian_pass_t * pass = data;
+  amitk_format_FLOAT_t * bundle;
+  amide_data_t * buffer;
+  amide_data_t * line;
+  amide_data_t * causal=NULL;
+  amide_data_t * anticausal=NULL;
+  amide_data_t * sum;
+  amide_data_t * row;
+  amide_data_t * out;
+  amide_data_t kernel_value;
+  gsize padded_size;
+  gint b, i, k, w, k_start, k_end;
+  gint width, order;
+
+  width = pass->width;
+  order = GAUSSIAN_RECURSIVE_ORDER;
+
+  /* the lines (and the recursive filter outputs) get GAUSSIAN_RECURSIVE_ORDER rows of
+     zeros on either side, so the loops don't need boundary checks.  As the data is taken
+     as zero outside the data set, starting both recursions from zero is exact. */
+  padded_size = ((gsize) (pass->length+2*order))*width;
+  buffer = g_new0(amide_data_t, padded_size);
+  line = buffer+order*width;
+  if (pass->recursive) {
+    causal = g_new0(amide_data_t, padded_size);
+    anticausal = g_new0(amide_data_t, padded_size);
+  }
+  sum = g_new(amide_data_t, width);
+
+  for (b=start; b<end; b++) {
+    bundle = pass->data + b*pass->bundle_offset;
+
+    /* pull the bundle out of the data set */
+    for (i=0; i<pass->length; i++)
+      for (w=0; w<width; w++)
+	line[i*width+w] = bundle[i*pass->stride+w];
+
+    if (pass->recursive) {
+      for (i=0; i<pass->length; i++) {
+	row = line+i*width;
+	out = causal+(i+order)*width;
+	for (w=0; w<width; w++) {
+	  out[w] = pass->causal_b[0]*row[w] + pass->causal_b[1]*row[w-width] 
+	    + pass->causal_b[2]*row[w-2*width] + pass->causal_b[3]*row[w-3*width]
+	    - pass->a[0]*out[w-width] - pass->a[1]*out[w-2*width] 
+	    - pass->a[2]*out[w-3*width] - pass->a[3]*out[w-4*width];
+	}
+      }
 
-  g_return_val_if_fail(kernel_size.t == 1, FALSE);
-  g_return_val_if_fail(kernel_size.g == 1, FALSE);
-  g_return_val_if_fail((kernel_size.z & 0x1), FALSE); /* needs to be odd */
-  g_return_val_if_fail((kernel_size.y & 0x1), FALSE); 
-  g_return_val_if_fail((kernel_size.x & 0x1), FALSE); 
-  g_return_val_if_fail(2*kernel_size.z < AMITK_FILTER_FFT_SIZE, FALSE);
-  g_return_val_if_fail(2*kernel_size.y < AMITK_FILTER_FFT_SIZE, FALSE);
-  g_return_val_if_fail(2*kernel_size.x < AMITK_FILTER_FFT_SIZE, FALSE);
+      for (i=pass->length-1; i>=0; i--) {
+	row = line+i*width;
+	out = anticausal+(i+order)*width;
+	for (w=0; w<width; w++) {
+	  out[w] = pass->anticausal_b[0]*row[w+width] + pass->anticausal_b[1]*row[w+2*width] 
+	    + pass->anticausal_b[2]*row[w+3*width] + pass->anticausal_b[3]*row[w+4*width]
+	    - pass->a[0]*out[w+width] - pass->a[1]*out[w+2*width] 
+	    - pass->a[2]*out[w+3*width] - pass->a[3]*out[w+4*width];
+	}
+      }
 
-  ds_dim = AMITK_DATA_SET_DIM(data_set);
+      for (i=0; i<pass->length; i++)
+	for (w=0; w<width; w++)
+	  bundle[i*pass->stride+w] = causal[(i+order)*width+w] + anticausal[(i+order)*width+w];
 
-  /* initialize gsl's FFT stuff */
-  wavetable = gsl_fft_complex_wavetable_alloc(AMITK_FILTER_FFT_SIZE);
-  workspace = gsl_fft_complex_workspace_alloc (AMITK_FILTER_FFT_SIZE);
-  if ((wavetable == NULL) || (workspace == NULL)) {
-    g_warning(_("Filtering: Failed to allocate wavetable and workspace"));
-    continue_work=FALSE;
-    goto exit_strategy;
-  }
+    } else {
+      for (i=0; i<pass->length; i++) {
+	for (w=0; w<width; w++)
+	  sum[w] = 0.0;
+
+	k_start = MAX(0, i-pass->half);
+	k_end = MIN(pass->length-1, i+pass->half);
+	for (k=k_start; k<=k_end; k++) {
+	  kernel_value = pass->kernel[k-i+pass->half];
+	  row = line+k*width;
+	  for (w=0; w<width; w++)
+	    sum[w] += kernel_value*row[w];
+	}
 
-  /* get space for our data subset*/
-  if ((subset = amitk_raw_data_new()) == NULL) {
-    g_warning(_("couldn't allocate memory space for the subset structure"));
-    continue_work=FALSE;
-    goto exit_strategy;
+	for (w=0; w<width; w++)
+	  bundle[i*pass->stride+w] = sum[w];
+      }
+    }
   }
-  subset->format = AMITK_FORMAT_DOUBLE;
-  subset->dim.t = subset->dim.g = 1;
-  subset->dim.z = subset->dim.y = AMITK_FILTER_FFT_SIZE;
-  subset->dim.x = 2*AMITK_FILTER_FFT_SIZE; /* real and complex parts */
 
-  subset_size.t = subset_size.g = 1;
-  subset_size.z = AMITK_FILTER_FFT_SIZE-kernel_size.z+1;
-  subset_size.y = AMITK_FILTER_FFT_SIZE-kernel_size.y+1;
-  subset_size.x = AMITK_FILTER_FFT_SIZE-kernel_size.x+1;
+  g_free(sum);
+  g_free(buffer);
+  if (causal != NULL) g_free(causal);
+  if (anticausal != NULL) g_free(anticausal);
 
-  half.t = half.g = 0;
-  half.z = kernel_size.z>>1;
-  half.y = kernel_size.y>>1;
-  half.x = kernel_size.x>>1;
+  return;
+}
 
-  if ((subset->data = amitk_raw_data_get_data_mem(subset)) == NULL) {
-    g_warning(_("Couldn't allocate memory space for the subset data"));
-    continue_work=FALSE;
-    goto exit_strategy;
-  }
+/* used for copying the internal values of the data set into the filtered data set in parallel */
+typedef struct {
+  const AmitkDataSet * data_set;
+  AmitkDataSet * filtered_ds;
+  amide_intpoint_t frame;
+  amide_intpoint_t gate;
+} gaussian_copy_t;
 
-  /* FFT the kernel */
-  amitk_filter_3D_FFT(kernel, wavetable, workspace);
+static void gaussian_copy_func(const gint start, const gint end, gpointer data) {
 
-  if (update_func != NULL) {
-    temp_string = g_strdup_printf(_("Filtering Data Set:  %s"), AMITK_OBJECT_NAME(data_set));
-    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
-    g_free(temp_string);
-  }
-  total_planes = ds_dim.z*ds_dim.t*ds_dim.g;
+  gaussian_copy_t * copy = data;
+  AmitkVoxel i_voxel;
+
+  i_voxel.t = copy->frame;
+  i_voxel.g = copy->gate;
+  for (i_voxel.z=start; i_voxel.z<end; i_voxel.z++)
+    for (i_voxel.y=0; i_voxel.y<AMITK_DATA_SET_DIM_Y(copy->data_set); i_voxel.y++)
+      for (i_voxel.x=0; i_voxel.x<AMITK_DATA_SET_DIM_X(copy->data_set); i_voxel.x++)
+	AMITK_RAW_DATA_FLOAT_SET_CONTENT(copy->filtered_ds->raw_data, i_voxel) = 
+	  amitk_data_set_get_internal_value(copy->data_set, i_voxel);
+
+  return;
+}
+
+/* assumptions:
+   1- filtered_ds is of type FLOAT, 0D scaling
+   2- scale of filtered_ds is 1.0
+   3- kernel_size is odd
+ */
+static gboolean filter_gaussian(const AmitkDataSet * data_set,
+				AmitkDataSet * filtered_ds,
+				const gint kernel_size,
+				const amide_real_t fwhm,
+				AmitkUpdateFunc update_func, 
+				gpointer update_data) {
+
+  gaussian_pass_t pass[AMITK_AXIS_NUM];
+  gint num_bundles[AMITK_AXIS_NUM];
+  gaussian_copy_t copy;
+  AmitkAxis i_axis;
+  AmitkVoxel ds_dim, i_voxel;
+  amide_real_t sigma, location, total;
+  gint k, step, total_steps;
+  gchar * temp_string;
+  gboolean continue_work=TRUE;
+
+  g_return_val_if_fail((kernel_size & 0x1), FALSE); /* needs to be odd */
+  g_return_val_if_fail(AMITK_RAW_DATA_FORMAT(AMITK_DATA_SET_RAW_DATA(filtered_ds)) == AMITK_FORMAT_FLOAT, FALSE);
+
+  ds_dim = AMITK_DATA_SET_DIM(data_set);
+
+  /* x lines are single rows, y lines are bundled by plane, z lines by row */
+  pass[AMITK_AXIS_X].length = ds_dim.x;
+  pass[AMITK_AXIS_X].stride = 1;
+  pass[AMITK_AXIS_X].width = 1;
+  pass[AMITK_AXIS_X].bundle_offset = ds_dim.x;
+  num_bundles[AMITK_AXIS_X] = ds_dim.z*ds_dim.y;
+
+  pass[AMITK_AXIS_Y].length = ds_dim.y;
+  pass[AMITK_AXIS_Y].stride = ds_dim.x;
+  pass[AMITK_AXIS_Y].width = ds_dim.x;
+  pass[AMITK_AXIS_Y].bundle_offset = ((gsize) ds_dim.y)*ds_dim.x;
+  num_bundles[AMITK_AXIS_Y] = ds_dim.z;
+
+  pass[AMITK_AXIS_Z].length = ds_dim.z;
+  pass[AMITK_AXIS_Z].stride = ((gsize) ds_dim.y)*ds_dim.x;
+  pass[AMITK_AXIS_Z].width = ds_dim.x;
+  pass[AMITK_AXIS_Z].bundle_offset = ds_dim.x;
+  num_bundles[AMITK_AXIS_Z] = ds_dim.y;
+
+  for (i_axis=0; i_axis<AMITK_AXIS_NUM; i_axis++) {
+    sigma = fwhm/(SIGMA_TO_FWHM*point_get_component(AMITK_DATA_SET_VOXEL_SIZE(data_set), i_axis)); /* in voxels */
+
+    pass[i_axis].half = kernel_size >> 1;
+    pass[i_axis].kernel = NULL;
+    pass[i_axis].recursive = ((sigma >= GAUSSIAN_RECURSIVE_MIN_SIGMA) && 
+			      (pass[i_axis].half >= 3.0*sigma));
+
+    if (pass[i_axis].recursive) {
+      gaussian_recursive_coefficients(&(pass[i_axis]), sigma);
+    } else {
+      /* renormalize, as the tails are cut, and we've discretized the gaussian */
+      pass[i_axis].kernel = g_new(amide_data_t, kernel_size);
+      total = 0.0;
+      for (k=0; k<kernel_size; k++) {
+	location = k-pass[i_axis].half;
+	if (sigma > 0.0)
+	  pass[i_axis].kernel[k] = exp(-(location*location)/(2.0*sigma*sigma));
+	else
+	  pass[i_axis].kernel[k] = (k == pass[i_axis].half) ? 1.0 : 0.0;
+	total += pass[i_axis].kernel[k];
+      }
+      for (k=0; k<kernel_size; k++)
+	pass[i_axis].kernel[k] /= total;
+    }
+  }
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Filtering Data Set:  %s"), AMITK_OBJECT_NAME(data_set));
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+  total_steps = ds_dim.t*ds_dim.g*(1+AMITK_AXIS_NUM);
+  step = 0;
+
+  copy.data_set = data_set;
+  copy.filtered_ds = filtered_ds;
 
-  /* start the overlap and add FFT method */
-  i_outer.t = i_inner.t = j_inner.t = 0;
-  i_outer.g = i_inner.g = j_inner.g = 0;
-  for (i_outer.t = 0; (i_outer.t < ds_dim.t) && continue_work; i_outer.t++) {
-    for (i_outer.g = 0; (i_outer.g < ds_dim.g) && continue_work; i_outer.g++) {
+  i_voxel.z = i_voxel.y = i_voxel.x = 0;
+  for (i_voxel.t = 0; (i_voxel.t < ds_dim.t) && continue_work; i_voxel.t++) {
+    for (i_voxel.g = 0; (i_voxel.g < ds_dim.g) && continue_work; i_voxel.g++) {
 #if AMIDE_DEBUG
-      g_print("Filtering Frame %d/Gate %d\n", i_outer.t, i_outer.g);
+      g_print("Filtering Frame %d/Gate %d\n", i_voxel.t, i_voxel.g);
 #endif
-      for (i_outer.z = 0; (i_outer.z < ds_dim.z) && continue_work; i_outer.z+= subset_size.z) {
+      copy.frame = i_voxel.t;
+      copy.gate = i_voxel.g;
+      amitk_parallel_for(ds_dim.z, 1, gaussian_copy_func, &copy);
+      step++;
+
+      for (i_axis=0; (i_axis<AMITK_AXIS_NUM) && continue_work; i_axis++) {
+	if (update_func != NULL)
+	  continue_work = (*update_func)(update_data, NULL, ((gdouble) step)/((gdouble) total_steps));
+	if (!continue_work) break;
+
+	pass[i_axis].data = AMITK_RAW_DATA_FLOAT_POINTER(filtered_ds->raw_data, i_voxel);
+	amitk_parallel_for(num_bundles[i_axis], 1, gaussian_pass_func, &(pass[i_axis]));
+	step++;
+      }
+    }
+  }
 
-	if (update_func != NULL) {
-	  image_num = i_outer.z+i_outer.t*ds_dim.z+i_outer.g*ds_dim.z*ds_dim.t;
-	  continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
-	}
+  for (i_axis=0; i_axis<AMITK_AXIS_NUM; i_axis++)
+    if (pass[i_axis].kernel != NULL)
+      g_free(pass[i_axis].kernel);
 
-	for (i_outer.y = 0; i_outer.y < ds_dim.y; i_outer.y+= subset_size.y) {
-	  for (i_outer.x = 0; i_outer.x < ds_dim.x; i_outer.x+= subset_size.x) {
-  
-	    /* initialize the subset */
-	    for (j_inner.z = 0; j_inner.z < subset->dim.z; j_inner.z++) 
-	      for (j_inner.y = 0; j_inner.y < subset->dim.y; j_inner.y++) 
-		for (j_inner.x = 0; j_inner.x < subset->dim.x; j_inner.x++) 
-		  AMITK_RAW_DATA_DOUBLE_SET_CONTENT(subset, j_inner) = 0.0;
-	  
-	    /* copy data over from the actual data set */
-	    for (i_inner.z = 0, j_inner.z=0; 
-		 ((i_inner.z < subset_size.z) && (i_inner.z+i_outer.z) < ds_dim.z);
-		 i_inner.z++, j_inner.z++) 
-	      for (i_inner.y = 0, j_inner.y=0; 
-		   ((i_inner.y < subset_size.y) && (i_inner.y+i_outer.y) < ds_dim.y);
-		   i_inner.y++, j_inner.y++) 
-		for (i_inner.x = 0, j_inner.x=0; 
-		     ((i_inner.x < subset_size.x) && (i_inner.x+i_outer.x) < ds_dim.x);
-		     i_inner.x++, j_inner.x+=2) 
-		  AMITK_RAW_DATA_DOUBLE_SET_CONTENT(subset, j_inner) = 
-		    amitk_data_set_get_internal_value(data_set, voxel_add(i_outer, i_inner)); /* should be zero for out of range */
-	  
-	  
-	    /* FFT the data */
-	    amitk_filter_3D_FFT(subset, wavetable, workspace);
-	  
-	    /* multiple the data by the filter */
-	    amitk_filter_complex_mult(subset, kernel);
-	  
-	    /* and inverse FFT */
-	    amitk_filter_inverse_3D_FFT(subset, wavetable, workspace);
-	  
-	    /* and add in, at the same time we're shifting the data set over by half the
-	       kernel size */
-	    for (((i_inner.z = (i_outer.z == 0) ? 0 : -half.z),
-		  (j_inner.z = (i_outer.z == 0) ? half.z : 0)); 
-		 ((j_inner.z < AMITK_FILTER_FFT_SIZE) && 
-		  ((i_inner.z+i_outer.z) < AMITK_DATA_SET_DIM_Z(filtered_ds))); 
-		 i_inner.z++, j_inner.z++)
-	      for (((i_inner.y = (i_outer.y == 0) ? 0 : -half.y),
-		    (j_inner.y = (i_outer.y == 0) ? half.y : 0)); 
-		   ((j_inner.y < AMITK_FILTER_FFT_SIZE) && ((i_inner.y+i_outer.y) < AMITK_DATA_SET_DIM_Y(filtered_ds))); 
-		   i_inner.y++, j_inner.y++) 
-		for (((i_inner.x = (i_outer.x == 0) ? 0 : -half.x),
-		      (j_inner.x = (i_outer.x == 0) ? 2*half.x : 0)); 
-		     ((j_inner.x < 2*AMITK_FILTER_FFT_SIZE) && ((i_inner.x+i_outer.x) < AMITK_DATA_SET_DIM_X(filtered_ds))); 
-		     i_inner.x++, j_inner.x+=2) 
-		  AMITK_RAW_DATA_FLOAT_SET_CONTENT(filtered_ds->raw_data, voxel_add(i_outer,i_inner)) +=
-		    AMITK_RAW_DATA_DOUBLE_CONTENT(subset, j_inner);
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+
+  return continue_work;
+}
 
+/* the median filter slides a sorted window along each row.  When the window steps
+   over by one voxel in x, the column of values (over t, g, z, and y) that leaves the
+   window and the column that enters it are merged in and out of the sorted window in a
+   single pass, instead of re-sorting the whole neighborhood for every voxel.  Each
+   column is sorted once per row.  Voxels outside the data set are taken as zero. */
+typedef struct {
+  const AmitkRawData * input; /* internal values, either a single frame/gate, or all of them */
+  AmitkRawData * output;
+  AmitkVoxel ds_dim;
+  AmitkVoxel kernel_dim;
+  AmitkVoxel half;
+  AmitkVoxel input_offset; /* frame/gate of the data set that's at t=0, g=0 in input */
+  amide_intpoint_t frame;
+  amide_intpoint_t gate;
+  amide_intpoint_t first_plane;
+} median_job_t;
+
+/* sort order with NaN's at the end, so they can be merged in and out of the window */
+static gint median_compare(gconstpointer a, gconstpointer b) {
+  amitk_format_FLOAT_t fa = *((const amitk_format_FLOAT_t *) a);
+  amitk_format_FLOAT_t fb = *((const amitk_format_FLOAT_t *) b);
+
+  if (isnan(fa)) return isnan(fb) ? 0 : 1;
+  else if (isnan(fb)) return -1;
+  else if (fa < fb) return -1;
+  else if (fa > fb) return 1;
+  else return 0;
+}
+
+static inline gboolean median_less(const amitk_format_FLOAT_t a, const amitk_format_FLOAT_t b) {
+  return (a < b) || (isnan(b) && !isnan(a));
+}
+
+static inline gboolean median_same(const amitk_format_FLOAT_t a, const amitk_format_FLOAT_t b) {
+  return (a == b) || (isnan(a) && isnan(b));
+}
 
+/* fills in and sorts the column of values at (z,y,x) across the kernel's t, g, z, and y extent */
+static void median_fill_column(const median_job_t * job, const AmitkVoxel center, 
+			       amitk_format_FLOAT_t * column, const gint column_size) {
+
+  AmitkVoxel i, j;
+  gint loc=0;
+
+  if ((center.x < 0) || (center.x >= job->ds_dim.x)) {
+    for (loc=0; loc<column_size; loc++)
+      column[loc] = 0.0;
+    return;
+  }
+
+  j.x = center.x;
+  for (i.t = center.t-job->half.t; i.t <= center.t+job->half.t; i.t++) {
+    for (i.g = center.g-job->half.g; i.g <= center.g+job->half.g; i.g++) {
+      for (i.z = center.z-job->half.z; i.z <= center.z+job->half.z; i.z++) {
+	for (i.y = center.y-job->half.y; i.y <= center.y+job->half.y; i.y++) {
+	  if ((i.t < 0) || (i.t >= job->ds_dim.t) || (i.g < 0) || (i.g >= job->ds_dim.g) ||
+	      (i.z < 0) || (i.z >= job->ds_dim.z) || (i.y < 0) || (i.y >= job->ds_dim.y)) {
+	    column[loc] = 0.0;
+	  } else {
+	    j.t = i.t - job->input_offset.t;
+	    j.g = i.g - job->input_offset.g;
+	    j.z = i.z;
+	    j.y = i.y;
+	    column[loc] = AMITK_RAW_DATA_FLOAT_CONTENT(job->input, j);
 	  }
+	  loc++;
 	}
       }
     }
-  } /* i_outer.t */
-
+  }
 
+  qsort(column, column_size, sizeof(amitk_format_FLOAT_t), median_compare);
 
+  return;
+}
 
+static void median_planes_func(const gint start, const gint end, gpointer data) {
+
+  median_job_t * job = data;
+  amitk_format_FLOAT_t * columns;
+  amitk_format_FLOAT_t * window;
+  amitk_format_FLOAT_t * new_window;
+  amitk_format_FLOAT_t * temp;
+  amitk_format_FLOAT_t * leaving;
+  amitk_format_FLOAT_t * entering;
+  AmitkVoxel i_voxel, center;
+  gint column_size, window_size, median_point, num_columns;
+  gint c, i, j, k, o;
+
+  column_size = job->kernel_dim.t*job->kernel_dim.g*job->kernel_dim.z*job->kernel_dim.y;
+  window_size = column_size*job->kernel_dim.x;
+  median_point = (window_size-1) >> 1;
+  num_columns = job->ds_dim.x+2*job->half.x;
+
+  columns = g_new(amitk_format_FLOAT_t, ((gsize) num_columns)*column_size);
+  window = g_new(amitk_format_FLOAT_t, window_size);
+  new_window = g_new(amitk_format_FLOAT_t, window_size);
+
+  i_voxel.t = center.t = job->frame;
+  i_voxel.g = center.g = job->gate;
+  for (i_voxel.z=job->first_plane+start; i_voxel.z<job->first_plane+end; i_voxel.z++) {
+    center.z = i_voxel.z;
+    for (i_voxel.y=0; i_voxel.y < job->ds_dim.y; i_voxel.y++) {
+      center.y = i_voxel.y;
+
+      /* sorted columns for x = -half.x to dim.x+half.x-1 */
+      for (c=0; c<num_columns; c++) {
+	center.x = c-job->half.x;
+	median_fill_column(job, center, columns+c*column_size, column_size);
+      }
 
+      /* the window for the first voxel in the row */
+      memcpy(window, columns, window_size*sizeof(amitk_format_FLOAT_t));
+      qsort(window, window_size, sizeof(amitk_format_FLOAT_t), median_compare);
+      i_voxel.x = 0;
+      AMITK_RAW_DATA_FLOAT_SET_CONTENT(job->output, i_voxel) = window[median_point];
+
+      /* and slide it along */
+      for (i_voxel.x=1; i_voxel.x < job->ds_dim.x; i_voxel.x++) {
+	leaving = columns + (i_voxel.x-1)*column_size;
+	entering = columns + (i_voxel.x+2*job->half.x)*column_size;
+
+	i = j = k = o = 0;
+	while (o < window_size) {
+	  if ((j < column_size) && (i < window_size) && median_same(window[i], leaving[j])) {
+	    i++; 
+	    j++;
+	  } else if ((i < window_size) && ((k >= column_size) || !median_less(entering[k], window[i]))) {
+	    new_window[o++] = window[i++];
+	  } else {
+	    new_window[o++] = entering[k++];
+	  }
+	}
 
- exit_strategy:
+	temp = window;
+	window = new_window;
+	new_window = temp;
 
-  if (wavetable != NULL) {
-    gsl_fft_complex_wavetable_free(wavetable);
-    wavetable = NULL;
+	AMITK_RAW_DATA_FLOAT_SET_CONTENT(job->output, i_voxel) = window[median_point];
+      }
+    }
   }
 
-  if (workspace != NULL) {
-    gsl_fft_complex_workspace_free(workspace);
-    workspace = NULL;
-  }
-  
-  if (subset != NULL) {
-    g_object_unref(subset);
-    subset = NULL;
-  }
+  g_free(columns);
+  g_free(window);
+  g_free(new_window);
 
-  if (update_func != NULL) /* remove progress bar */
-    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+  return;
+}
 
-  return continue_work;
+/* used for pulling the internal values of the data set into a FLOAT raw data in parallel */
+typedef struct {
+  const AmitkDataSet * data_set;
+  AmitkRawData * input;
+  AmitkVoxel input_offset;
+} median_load_t;
 
-}
+static void median_load_func(const gint start, const gint end, gpointer data) {
 
-#endif
+  median_load_t * load = data;
+  AmitkVoxel i_voxel, j_voxel;
+  gint plane;
+
+  for (plane=start; plane<end; plane++) {
+    i_voxel.z = plane % load->input->dim.z;
+    i_voxel.g = (plane / load->input->dim.z) % load->input->dim.g;
+    i_voxel.t = plane / (load->input->dim.z*load->input->dim.g);
+    j_voxel.t = i_voxel.t + load->input_offset.t;
+    j_voxel.g = i_voxel.g + load->input_offset.g;
+    j_voxel.z = i_voxel.z;
+    for (i_voxel.y=0, j_voxel.y=0; i_voxel.y<load->input->dim.y; i_voxel.y++, j_voxel.y++)
+      for (i_voxel.x=0, j_voxel.x=0; i_voxel.x<load->input->dim.x; i_voxel.x++, j_voxel.x++)
+	AMITK_RAW_DATA_FLOAT_SET_CONTENT(load->input, i_voxel) = 
+	  amitk_data_set_get_internal_value(load->data_set, j_voxel);
+  }
+
+  return;
+}
 
 /* assumptions:
    1- filtered_ds is of type FLOAT, 0D scaling
@@ -5073,23 +6328,22 @@ static gboolean filter_fir(const AmitkDataSet * data_set,
    3- kernel dimensions are odd
 
    notes:
-   1. don't have a separate function for each data type, as getting the data_set data,
-   is a tiny fraction of the computational time, use amitk_data_set_get_internal_value instead
+   1. the data set's internal values are copied into a FLOAT buffer first, one frame/gate
+   at a time, or all of them if the kernel extends over frames or gates
    2. data set can be the same as filtered_ds
  */
-static gboolean filter_median_3D(const AmitkDataSet * data_set, AmitkDataSet * filtered_ds,
-				 AmitkVoxel kernel_dim, AmitkUpdateFunc update_func, gpointer update_data) {
-
-  amide_data_t * partial_sort_data;
-  AmitkVoxel i,j, mid_dim, output_dim;
-  gint loc, median_size;
-  AmitkRawData * output_data;
-  AmitkVoxel ds_dim;
+static gboolean filter_median(const AmitkDataSet * data_set, AmitkDataSet * filtered_ds,
+			      AmitkVoxel kernel_dim, AmitkUpdateFunc update_func, gpointer update_data) {
+
+  median_job_t job;
+  median_load_t load;
+  AmitkRawData * input;
+  AmitkVoxel ds_dim, input_dim;
+  gboolean all_frames;
   gchar * temp_string;
   gint image_num;
   gint total_planes;
-  div_t x;
-  gint divider;
+  gint batch, z;
   gboolean continue_work=TRUE;
 
 
@@ -5100,15 +6354,23 @@ static gboolean filter_median_3D(const AmitkDataSet * data_set, AmitkDataSet * f
   g_return_val_if_fail(AMITK_RAW_DATA_FORMAT(AMITK_DATA_SET_RAW_DATA(filtered_ds)) == AMITK_FORMAT_FLOAT, FALSE);
   g_return_val_if_fail(REAL_EQUAL(AMITK_DATA_SET_SCALE_FACTOR(filtered_ds), 1.0), FALSE);
   g_return_val_if_fail(VOXEL_EQUAL(AMITK_RAW_DATA_DIM(filtered_ds->internal_scaling_factor), one_voxel), FALSE);
-  g_return_val_if_fail(kernel_dim.t == 1, FALSE); /* haven't written support yet */
-  g_return_val_if_fail(kernel_dim.g == 1, FALSE); /* haven't written support yet */
 
   /* check it's odd */
   g_return_val_if_fail(kernel_dim.x & 0x1, FALSE);
   g_return_val_if_fail(kernel_dim.y & 0x1, FALSE);
   g_return_val_if_fail(kernel_dim.z & 0x1, FALSE);
+  g_return_val_if_fail(kernel_dim.g & 0x1, FALSE);
+  g_return_val_if_fail(kernel_dim.t & 0x1, FALSE);
 
   ds_dim = AMITK_DATA_SET_DIM(data_set);
+  if (ds_dim.t < kernel_dim.t) {
+    kernel_dim.t = 1;
+    g_warning(_("data set doesn't have enough frames for kernel, setting kernel dimension to 1"));
+  }
+  if (ds_dim.g < kernel_dim.g) {
+    kernel_dim.g = 1;
+    g_warning(_("data set doesn't have enough gates for kernel, setting kernel dimension to 1"));
+  }
   if (ds_dim.z < kernel_dim.z) {
     kernel_dim.z = 1;
     g_warning(_("data set z dimension to small for kernel, setting kernel dimension to 1"));
@@ -5122,22 +6384,29 @@ static gboolean filter_median_3D(const AmitkDataSet * data_set, AmitkDataSet * f
     g_warning(_("data set x dimension to small for kernel, setting kernel dimension to 1"));
   }
 
-  mid_dim.t = mid_dim.g = 0;
-  mid_dim.z = kernel_dim.z >> 1;
-  mid_dim.y = kernel_dim.y >> 1;
-  mid_dim.x = kernel_dim.x >> 1;
-
-  median_size = kernel_dim.z*kernel_dim.y*kernel_dim.x;
-
-  output_dim = ds_dim;
-  output_dim.t = output_dim.g = 1;
-  if ((output_data = amitk_raw_data_new_with_data(AMITK_FORMAT_FLOAT, output_dim)) == NULL) {
+  job.ds_dim = ds_dim;
+  job.kernel_dim = kernel_dim;
+  job.half.t = kernel_dim.t >> 1;
+  job.half.g = kernel_dim.g >> 1;
+  job.half.z = kernel_dim.z >> 1;
+  job.half.y = kernel_dim.y >> 1;
+  job.half.x = kernel_dim.x >> 1;
+  job.output = filtered_ds->raw_data;
+  job.input_offset = zero_voxel;
+
+  /* the input buffer only needs to hold the frames/gates the kernel covers */
+  all_frames = (kernel_dim.t > 1) || (kernel_dim.g > 1);
+  input_dim = ds_dim;
+  if (!all_frames)
+    input_dim.t = input_dim.g = 1;
+  if ((input = amitk_raw_data_new_with_data(AMITK_FORMAT_FLOAT, input_dim)) == NULL) {
     g_warning(_("couldn't allocate memory space for the internal raw data"));
     return FALSE;
   }
-  amitk_raw_data_FLOAT_initialize_data(output_data, 0.0);
-  partial_sort_data = g_try_new(amide_data_t, median_size);
-  g_return_val_if_fail(partial_sort_data != NULL, FALSE);
+  job.input = input;
+  load.data_set = data_set;
+  load.input = input;
+  load.input_offset = zero_voxel;
 
   if (update_func != NULL) {
     temp_string = g_strdup_printf(_("Filtering Data Set:  %s"), AMITK_OBJECT_NAME(data_set));
@@ -5145,78 +6414,36 @@ static gboolean filter_median_3D(const AmitkDataSet * data_set, AmitkDataSet * f
     g_free(temp_string);
   }
   total_planes = ds_dim.z*ds_dim.t*ds_dim.g;
-  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
+  batch = 4*amitk_get_num_threads();
+
+  if (all_frames)
+    amitk_parallel_for(input_dim.t*input_dim.g*input_dim.z, 1, median_load_func, &load);
 
+  for (job.frame=0; (job.frame < ds_dim.t) && continue_work; job.frame++) {
+    for (job.gate=0; (job.gate < ds_dim.g) && continue_work; job.gate++) {
 
-  /* iterate over all the voxels in the data_set */
-  i.t = i.g = 0;
-  for (j.t=0; (j.t < AMITK_DATA_SET_NUM_FRAMES(data_set)) && continue_work; j.t++) {
-    for (j.g=0; (j.g < AMITK_DATA_SET_NUM_GATES(data_set)) && continue_work; j.g++) {
-      for (i.z=0; (i.z < output_dim.z) && continue_work; i.z++) {
+      if (!all_frames) {
+	load.input_offset.t = job.input_offset.t = job.frame;
+	load.input_offset.g = job.input_offset.g = job.gate;
+	amitk_parallel_for(input_dim.z, 1, median_load_func, &load);
+      }
 
+      /* planes are handed out a batch at a time, so the progress bar keeps moving */
+      for (z=0; (z < ds_dim.z) && continue_work; z += batch) {
 	if (update_func != NULL) {
-	  image_num = i.z+j.t*ds_dim.z+j.g*ds_dim.z*ds_dim.t;
-	  x = div(image_num,divider);
-	  if (x.rem == 0)
-	    continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
+	  image_num = z+job.frame*ds_dim.z+job.gate*ds_dim.z*ds_dim.t;
+	  continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
 	}
+	if (!continue_work) break;
 
-	for (i.y=0; i.y < output_dim.y; i.y++) {
-	  for (i.x=0; i.x < output_dim.x; i.x++) {
-	    
-	    /* initialize the data for the iteration */
-	    loc = 0;
-	    for (j.z = i.z-mid_dim.z; j.z <= i.z+mid_dim.z; j.z++) {
-	      if ((j.z < 0) || (j.z >= ds_dim.z)) {
-		for (j.y=0; j.y < kernel_dim.y; j.y++) {
-		  for (j.x=0; j.x < kernel_dim.x; j.x++) {
-		    partial_sort_data[loc] = 0.0;
-		    loc++;
-		  }
-		}
-	      } else {
-		for (j.y = i.y-mid_dim.y; j.y <= i.y+mid_dim.y; j.y++) {
-		  if ((j.y < 0) || (j.y >= ds_dim.y)) {
-		    for (j.x=0; j.x < kernel_dim.x; j.x++) {
-		      partial_sort_data[loc] = 0.0;
-		      loc++;
-		    }
-		  } else {
-		    for (j.x = i.x-mid_dim.x; j.x <= i.x+mid_dim.x; j.x++) {
-		      if ((j.x < 0) || (j.x >= ds_dim.x)) {
-			partial_sort_data[loc] = 0.0;
-			loc++;
-		      } else {
-			partial_sort_data[loc] = amitk_data_set_get_internal_value(data_set, j);
-			loc++;
-		      }
-		    }
-		  }
-		}
-	      }
-	    } /* end initializing data */
-	    
-	    /* and store median value */
-	    AMITK_RAW_DATA_FLOAT_SET_CONTENT(output_data, i) = 
-	      amitk_filter_find_median_by_partial_sort(partial_sort_data, median_size);
-	    
-	  } /* i.x */
-	} /* i.y */
-      } /* i.z */
-
-
-      /* copy the output_data over into the filtered_ds */
-      for (i.z=0, j.z=0; i.z < output_dim.z; i.z++, j.z++)
-	for (i.y=0, j.y=0; i.y < output_dim.y; i.y++, j.y++)
-	  for (i.x=0, j.x=0; i.x < output_dim.x; i.x++, j.x++)
-	    AMITK_RAW_DATA_FLOAT_SET_CONTENT(filtered_ds->raw_data, j) = 
-	      AMITK_RAW_DATA_FLOAT_CONTENT(output_data, i);
-    } /* j.g */
-  } /* j.t */
+	job.first_plane = z;
+	amitk_parallel_for(MIN(batch, ds_dim.z-z), 1, median_planes_func, &job);
+      }
+    }
+  }
 
   /* garbage collection */
-  g_object_unref(output_data); 
-  g_free(partial_sort_data);
+  g_object_unref(input); 
 
   if (update_func != NULL) /* remove progress bar */
     (*update_func)(update_data, NULL, (gdouble) 2.0); 
@@ -5224,7 +6451,7 @@ static gboolean filter_median_3D(const AmitkDataSet * data_set, AmitkDataSet * f
   return continue_work;
 }
   
-/* see notes for filter_median_3D */
+/* see notes for filter_median */
 static gboolean filter_median_linear(const AmitkDataSet * data_set,
 				     AmitkDataSet * filtered_ds,
 				     const gint kernel_size,
@@ -5238,7 +6465,7 @@ static gboolean filter_median_linear(const AmitkDataSet * data_set,
   kernel_dim.z = 1;
   kernel_dim.g = 1;
   kernel_dim.t = 1;
-  if (!filter_median_3D(data_set, filtered_ds, kernel_dim, update_func, update_data))
+  if (!filter_median(data_set, filtered_ds, kernel_dim, update_func, update_data))
     return FALSE;
   
   kernel_dim.x = 1;
@@ -5246,7 +6473,7 @@ static gboolean filter_median_linear(const AmitkDataSet * data_set,
   kernel_dim.z = 1;
   kernel_dim.g = 1;
   kernel_dim.t = 1;
-  if (!filter_median_3D(filtered_ds,filtered_ds,kernel_dim, update_func, update_data))
+  if (!filter_median(filtered_ds,filtered_ds,kernel_dim, update_func, update_data))
     return FALSE;
   
   kernel_dim.x = 1;
@@ -5254,7 +6481,7 @@ static gboolean filter_median_linear(const AmitkDataSet * data_set,
   kernel_dim.z = kernel_size;
   kernel_dim.g = 1;
   kernel_dim.t = 1;
-  if (!filter_median_3D(filtered_ds,filtered_ds,kernel_dim, update_func, update_data))
+  if (!filter_median(filtered_ds,filtered_ds,kernel_dim, update_func, update_data))
     return FALSE;
 
   return TRUE;
@@ -5341,27 +6568,9 @@ AmitkDataSet *amitk_data_set_get_filtered(const AmitkDataSet * ds,
 
   switch(filter_type) {
 
-#ifdef AMIDE_LIBGSL_SUPPORT
   case AMITK_FILTER_GAUSSIAN:
-    {
-      AmitkRawData * kernel;
-      AmitkVoxel kernel_size_3D;
-
-      kernel_size_3D.t=kernel_size_3D.g=1;
-      kernel_size_3D.z=kernel_size_3D.y=kernel_size_3D.x=kernel_size;
-
-      kernel = amitk_filter_calculate_gaussian_kernel_complex(kernel_size_3D, 
-							      AMITK_DATA_SET_VOXEL_SIZE(ds),
-							      fwhm);
-      if (kernel == NULL) {
-	g_warning(_("failed to calculate 3D gaussian kernel"));
-	goto error;
-      }
-      good = filter_fir(ds, filtered, kernel, kernel_size_3D, update_func, update_data);
-      g_object_unref(kernel);
-    }
+    good = filter_gaussian(ds, filtered, kernel_size, fwhm, update_func, update_data);
     break;
-#endif
 
   case AMITK_FILTER_MEDIAN_LINEAR:
     good = filter_median_linear(ds, filtered, kernel_size, update_func, update_data);
@@ -5371,7 +6580,21 @@ AmitkDataSet *amitk_data_set_get_filtered(const AmitkDataSet * ds,
   case AMITK_FILTER_MEDIAN_3D:
     kernel_dim.t = kernel_dim.g = 1;
     kernel_dim.z = kernel_dim.y = kernel_dim.x = kernel_size;
-    good = filter_median_3D(ds, filtered, kernel_dim, update_func, update_data);
+    good = filter_median(ds, filtered, kernel_dim, update_func, update_data);
+    break;
+
+
+  case AMITK_FILTER_MEDIAN_FRAMES:
+    kernel_dim = one_voxel;
+    kernel_dim.t = kernel_size;
+    good = filter_median(ds, filtered, kernel_dim, update_func, update_data);
+    break;
+
+
+  case AMITK_FILTER_MEDIAN_GATES:
+    kernel_dim = one_voxel;
+    kernel_dim.g = kernel_size;
+    good = filter_median(ds, filtered, kernel_dim, update_func, update_data);
     break;
 
 
@@ -5548,240 +6771,732 @@ GList * amitk_data_sets_remove_with_slice_parent(GList * slices,const AmitkDataS
   return slices;
 }
 
-/* trim cache slice size down to max_size, removes from end */
-GList * slice_cache_trim(GList * slice_cache, gint max_size) {
-
-  GList * last;
-
-  while (g_list_length(slice_cache) > max_size) {
-    last = g_list_last(slice_cache);
-    slice_cache = g_list_remove_link(slice_cache, last);
-    amitk_objects_unref(last);
-  }
-
-  return slice_cache;
-}
+/* The slice cache is shared between all the canvases and series views.  It holds
+   onto slices until SLICE_CACHE_MAX_BYTES worth of them have been generated, and 
+   then throws out the least recently used ones.  Slices are looked up by a hash of 
+   the parameters that went into generating them.
 
-/* several things cause slice caches to get invalidated, so they don't need to be
-   explicitly checked here
+   several things cause a data set's slices to get thrown out of the cache, so they 
+   aren't part of the lookup:
 
    1. Scale factor changes
    2. The parent data set's space changing
    3. The parent data set's voxel size changing
    4. Any change to the raw data
+   5. The parent data set getting unselected or destroyed
 
+   note, data sets can get finalized on any thread (e.g. the temporary data sets
+   in the parallel workers), so the cache is guarded by the slice_cache lock.  
+   Slices are unreferenced outside of the lock, as that can bring us back here.
 */
-static AmitkDataSet * slice_cache_find (GList * slice_cache, AmitkDataSet * parent_ds, 
-					const amide_time_t start, const amide_time_t duration,
-					const amide_intpoint_t gate,
-					const AmitkCanvasPoint pixel_size, const AmitkVolume * view_volume) {
+#define SLICE_CACHE_MAX_BYTES (128*1024*1024)
+
+typedef struct {
+  const AmitkDataSet * parent; /* not referenced, entries go away with the parent */
+  AmitkPoint offset;
+  AmitkAxes axes;
+  amide_time_t start;
+  amide_time_t duration;
+  amide_intpoint_t start_gate;
+  amide_intpoint_t end_gate;
+  amide_real_t thickness;
+  AmitkVoxel dim;
+  AmitkInterpolation interpolation;
+  AmitkRendering rendering;
+} slice_key_t;
 
+typedef struct {
+  slice_key_t key;
   AmitkDataSet * slice;
-  AmitkVoxel dim;
-  amide_intpoint_t start_gate, end_gate;
+  GList * lru_link; /* this entry's link in slice_cache_lru */
+  gsize size;
+} slice_cache_entry_t;
+
+static GHashTable * slice_cache_table = NULL;
+static GQueue * slice_cache_lru = NULL; /* most recently used at the head */
+static gsize slice_cache_size = 0;
+G_LOCK_DEFINE_STATIC(slice_cache);
+
+/* floating point values are compared with a tolerance, so only coarsely rounded
+   versions can go into the hash. Worst case, two equal keys end up with
+   different hashes, and we generate a slice we could have had from the cache */
+#define SLICE_KEY_ROUND(value) ((guint) ((gint64) floor((value)*1000.0)))
+
+static guint slice_key_hash(gconstpointer data) {
+
+  const slice_key_t * key = data;
+  guint hash;
+
+  hash = g_direct_hash(key->parent);
+  hash = hash*31 + key->dim.x;
+  hash = hash*31 + key->dim.y;
+  hash = hash*31 + key->start_gate;
+  hash = hash*31 + key->end_gate;
+  hash = hash*31 + key->interpolation;
+  hash = hash*31 + key->rendering;
+  hash = hash*31 + SLICE_KEY_ROUND(key->start);
+  hash = hash*31 + SLICE_KEY_ROUND(key->offset.x);
+  hash = hash*31 + SLICE_KEY_ROUND(key->offset.y);
+  hash = hash*31 + SLICE_KEY_ROUND(key->offset.z);
+
+  return hash;
+}
 
-  if (slice_cache == NULL) {
-    return NULL;
+static gboolean slice_key_equal(gconstpointer data1, gconstpointer data2) {
+
+  const slice_key_t * key1 = data1;
+  const slice_key_t * key2 = data2;
+  AmitkAxis i_axis;
+
+  if (key1->parent != key2->parent) return FALSE;
+  if (!VOXEL_EQUAL(key1->dim, key2->dim)) return FALSE;
+  if (key1->start_gate != key2->start_gate) return FALSE;
+  if (key1->end_gate != key2->end_gate) return FALSE;
+  if (key1->interpolation != key2->interpolation) return FALSE;
+  if (key1->rendering != key2->rendering) return FALSE;
+  if (!REAL_EQUAL(key1->start, key2->start)) return FALSE;
+  if (!REAL_EQUAL(key1->duration, key2->duration)) return FALSE;
+  if (!REAL_EQUAL(key1->thickness, key2->thickness)) return FALSE;
+  if (!POINT_EQUAL(key1->offset, key2->offset)) return FALSE;
+  for (i_axis=0; i_axis<AMITK_AXIS_NUM; i_axis++)
+    if (!POINT_EQUAL(key1->axes[i_axis], key2->axes[i_axis])) return FALSE;
+
+  return TRUE;
+}
+
+/* fill in the key for the slice that'd be generated with these parameters */
+static void slice_key_init(slice_key_t * key, const AmitkDataSet * parent_ds, 
+			   const amide_time_t start, const amide_time_t duration,
+			   const amide_intpoint_t gate,
+			   const AmitkCanvasPoint pixel_size, const AmitkVolume * view_volume) {
+
+  key->parent = parent_ds;
+  key->offset = AMITK_SPACE_OFFSET(view_volume);
+  amitk_axes_copy_in_place(key->axes, AMITK_SPACE_AXES(view_volume));
+  key->start = start;
+  key->duration = duration;
+  if (gate < 0) {
+    key->start_gate = AMITK_DATA_SET_VIEW_START_GATE(parent_ds);
+    key->end_gate = AMITK_DATA_SET_VIEW_END_GATE(parent_ds);
   } else {
-    slice = slice_cache->data;
-    if (AMITK_DATA_SET_SLICE_PARENT(slice) == parent_ds) 
-      if (amitk_space_equal(AMITK_SPACE(slice), AMITK_SPACE(view_volume))) 
-	if (REAL_EQUAL(slice->scan_start, start)) 
-	  if (REAL_EQUAL(amitk_data_set_get_frame_duration(slice,0), duration)) {
-	    if (gate < 0) {
-	      start_gate = AMITK_DATA_SET_VIEW_START_GATE(AMITK_DATA_SET_SLICE_PARENT(slice));
-	      end_gate = AMITK_DATA_SET_VIEW_END_GATE(AMITK_DATA_SET_SLICE_PARENT(slice));
-	    } else {
-	      start_gate = gate;
-	      end_gate = gate;
-	    }
-	    if (AMITK_DATA_SET_VIEW_START_GATE(slice) == start_gate)
-	      if (AMITK_DATA_SET_VIEW_END_GATE(slice) == end_gate)
-		if (REAL_EQUAL(slice->voxel_size.z,AMITK_VOLUME_Z_CORNER(view_volume))) {
-		  dim.x = ceil(fabs(AMITK_VOLUME_X_CORNER(view_volume))/pixel_size.x);
-		  dim.y = ceil(fabs(AMITK_VOLUME_Y_CORNER(view_volume))/pixel_size.y);
-		  dim.z = dim.t = dim.g = 1;
-		  if (VOXEL_EQUAL(dim, AMITK_DATA_SET_DIM(slice))) 
-		    if (AMITK_DATA_SET_INTERPOLATION(slice) == AMITK_DATA_SET_INTERPOLATION(parent_ds)) 
-		      if (AMITK_DATA_SET_RENDERING(slice) == AMITK_DATA_SET_RENDERING(parent_ds)) 
-			return slice;
-		}
-	  }
+    key->start_gate = gate;
+    key->end_gate = gate;
   }
-  
+  key->thickness = AMITK_VOLUME_Z_CORNER(view_volume);
+  key->dim.x = ceil(fabs(AMITK_VOLUME_X_CORNER(view_volume))/pixel_size.x);
+  key->dim.y = ceil(fabs(AMITK_VOLUME_Y_CORNER(view_volume))/pixel_size.y);
+  key->dim.z = key->dim.t = key->dim.g = 1;
+  key->interpolation = AMITK_DATA_SET_INTERPOLATION(parent_ds);
+  key->rendering = AMITK_DATA_SET_RENDERING(parent_ds);
 
-  /* this one's not it, keep looking */
-  return slice_cache_find(slice_cache->next, parent_ds, start, duration, gate, pixel_size, view_volume);
+  return;
 }
 
+/* frees a list of entries that have been unlinked, call without holding the lock */
+static void slice_cache_entries_free(GList * entries) {
 
+  GList * temp_entries;
+  slice_cache_entry_t * entry;
 
-/* give a list of data_sets, returns a list of slices of equal size and orientation
-   intersecting these data_sets.  The slice_cache is a list of already generated slices,
-   if an appropriate slice is found in there, it'll be used */
-/* notes
-   - in real practice, the parent data set's local cache is rarely used,
-     as most slices, if there in the local cache, will also be in the passed in cache
-   - the "gate" parameter should ordinarily by -1 (ignored).  Only use it to override the
-     the data set's view_start_gate/view_end_gate parameters 
- */
-GList * amitk_data_sets_get_slices(GList * objects,
-				   GList ** pslice_cache,
-				   const gint max_slice_cache_size,
-				   const amide_time_t start,
-				   const amide_time_t duration,
-				   const amide_intpoint_t gate,
-				   const AmitkCanvasPoint pixel_size,
-				   const AmitkVolume * view_volume) {
+  for (temp_entries = entries; temp_entries != NULL; temp_entries = temp_entries->next) {
+    entry = temp_entries->data;
+    amitk_object_unref(entry->slice);
+    g_free(entry);
+  }
+  g_list_free(entries);
 
+  return;
+}
 
-  GList * slices=NULL;
-  AmitkDataSet * local_slice;
-  AmitkDataSet * canvas_slice=NULL;
-  AmitkDataSet * slice;
-  AmitkDataSet * parent_ds;
-  gint num_data_sets=0;
+/* takes the entry out of the hash table and lru list, does not free it.  
+   Call with the lock held */
+static void slice_cache_unlink(slice_cache_entry_t * entry) {
 
-#ifdef SLICE_TIMING
-  struct timeval tv1;
-  struct timeval tv2;
-  gdouble time1;
-  gdouble time2;
+  g_hash_table_remove(slice_cache_table, &(entry->key));
+  g_queue_delete_link(slice_cache_lru, entry->lru_link);
+  entry->lru_link = NULL;
+  slice_cache_size -= entry->size;
 
-  /* let's do some timing */
-  gettimeofday(&tv1, NULL);
-#endif
+  return;
+}
 
-  g_return_val_if_fail(objects != NULL, NULL);
+/* returns a reference to the cached slice, or NULL if it's not in the cache */
+static AmitkDataSet * slice_cache_find(const slice_key_t * key) {
 
-  /* and get the slices */
-  while (objects != NULL) {
-    if (AMITK_IS_DATA_SET(objects->data)) {
-      num_data_sets++;
-      parent_ds = AMITK_DATA_SET(objects->data);
-
-      /* try to find it in the caches first */
-      if (pslice_cache != NULL)
-	canvas_slice = slice_cache_find(*pslice_cache, parent_ds, start, duration, 
-					gate, pixel_size, view_volume);
-
-      local_slice = slice_cache_find(parent_ds->slice_cache, parent_ds, start, duration, 
-				     gate, pixel_size, view_volume);
-
-      if (canvas_slice != NULL) {
-	slice = amitk_object_ref(canvas_slice);
-      } else if (local_slice != NULL) {
-	slice = amitk_object_ref(local_slice);
-      } else {/* generate a new one */
-	slice = amitk_data_set_get_slice(parent_ds, start, duration, gate, pixel_size, view_volume);
-      }
+  slice_cache_entry_t * entry;
+  AmitkDataSet * slice=NULL;
 
-      g_return_val_if_fail(slice != NULL, slices);
+  G_LOCK(slice_cache);
+  if (slice_cache_table != NULL) {
+    entry = g_hash_table_lookup(slice_cache_table, key);
+    if (entry != NULL) {
+      /* move it to the front of the line */
+      g_queue_unlink(slice_cache_lru, entry->lru_link);
+      g_queue_push_head_link(slice_cache_lru, entry->lru_link);
+      slice = amitk_object_ref(entry->slice);
+    }
+  }
+  G_UNLOCK(slice_cache);
+
+  return slice;
+}
 
-      slices = g_list_prepend(slices, slice);
+/* throw out the least recently used slices until we're back under budget */
+static void slice_cache_trim(void) {
 
-      if ((canvas_slice == NULL) && (pslice_cache != NULL))
-	*pslice_cache = g_list_prepend(*pslice_cache, amitk_object_ref(slice)); /* most recently used first */
-      if (local_slice == NULL) {
-	parent_ds->slice_cache = g_list_prepend(parent_ds->slice_cache, amitk_object_ref(slice));
+  slice_cache_entry_t * entry;
+  GList * removed=NULL;
 
-	/* regulate the size of the local per dataset cache */
-	parent_ds->slice_cache = 
-	  slice_cache_trim(parent_ds->slice_cache, 
-			   3 * MAX(AMITK_DATA_SET_NUM_FRAMES(parent_ds), AMITK_DATA_SET_NUM_GATES(parent_ds)));
-      }
-    }
-    objects = objects->next;
+  G_LOCK(slice_cache);
+  while ((slice_cache_size > SLICE_CACHE_MAX_BYTES) &&
+	 (g_queue_get_length(slice_cache_lru) > 0)) {
+    entry = g_queue_peek_tail(slice_cache_lru);
+    slice_cache_unlink(entry);
+    removed = g_list_prepend(removed, entry);
   }
+  G_UNLOCK(slice_cache);
 
-  /* regulate the size of the global cache */
-  if (pslice_cache != NULL) 
-    *pslice_cache = slice_cache_trim(*pslice_cache, max_slice_cache_size);
-
-#ifdef SLICE_TIMING
-  /* and wrapup our timing */
-  gettimeofday(&tv2, NULL);
-  time1 = ((double) tv1.tv_sec) + ((double) tv1.tv_usec)/1000000.0;
-  time2 = ((double) tv2.tv_sec) + ((double) tv2.tv_usec)/1000000.0;
-  g_print("######## Slice Generating Took %5.3f (s) #########\n",time2-time1);
-#endif
+  slice_cache_entries_free(removed);
 
-  return slices;
+  return;
 }
 
-/* function to perform the given operation on a single data set
-   parameter0 and parameter1 are used by some operations, for instance for the
-   threshold operation, values below parameter0 are set to 0, values above
-   parameter1 1, and parameters between are interpolated */
-AmitkDataSet * amitk_data_sets_math_unary(AmitkDataSet * ds1, 
-					  AmitkOperationUnary operation,
-					  amide_data_t parameter0,
-					  amide_data_t parameter1,
-					  AmitkUpdateFunc update_func,
-					  gpointer update_data) {
+/* adds a reference to the slice into the cache */
+static void slice_cache_add(const slice_key_t * key, AmitkDataSet * slice) {
 
-  AmitkVoxel i_dim;
-  AmitkDataSet * output_ds;
-  AmitkVoxel i_voxel;
-  amide_data_t value;
-  gchar * temp_string;
-  AmitkViewMode i_view_mode;
-  div_t x;
-  gint divider, total_planes,image_num;
-  gboolean continue_work=TRUE;
-  AmitkFormat format;
+  slice_cache_entry_t * entry;
 
-  g_return_val_if_fail(AMITK_IS_DATA_SET(ds1), NULL);
-  i_dim = AMITK_DATA_SET_DIM (ds1);
+  G_LOCK(slice_cache);
 
-  switch(operation) {
-  case AMITK_OPERATION_UNARY_RESCALE:
-    if (parameter0 >= parameter1)
-      format = AMITK_FORMAT_UBYTE; /* results will be 0 or 1 */
-    else
-      format = AMITK_FORMAT_FLOAT; /* results will be between 0 and 1 */
-    break;
-  case AMITK_OPERATION_UNARY_REMOVE_NEGATIVES:
-    format = AMITK_FORMAT_FLOAT;
-    break;
-  default:
-    g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
-    goto error;
+  if (slice_cache_table == NULL) {
+    slice_cache_table = g_hash_table_new(slice_key_hash, slice_key_equal);
+    slice_cache_lru = g_queue_new();
   }
 
-  output_ds = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(ds1), 
-					   format, i_dim, AMITK_SCALING_TYPE_0D);
-  if (output_ds == NULL) {
-    g_warning(_("couldn't allocate %d MB for the output_ds data set structure"),
-	      amitk_raw_format_calc_num_bytes(i_dim, format)/(1024*1024));
-    goto error;
+  if (g_hash_table_lookup(slice_cache_table, key) == NULL) { /* don't already have it */
+    entry = g_new(slice_cache_entry_t, 1);
+    entry->key = *key;
+    amitk_axes_copy_in_place(entry->key.axes, key->axes);
+    entry->slice = amitk_object_ref(slice);
+    entry->size = sizeof(AmitkDataSet) + amitk_raw_data_size_data_mem(slice->raw_data);
+
+    g_queue_push_head(slice_cache_lru, entry);
+    entry->lru_link = g_queue_peek_head_link(slice_cache_lru);
+    g_hash_table_insert(slice_cache_table, &(entry->key), entry);
+    slice_cache_size += entry->size;
   }
 
-  /* Start setting up the new dataset */
-  amitk_space_copy_in_place( AMITK_SPACE(output_ds), AMITK_SPACE(ds1));
-  amitk_data_set_set_scale_factor(output_ds, 1.0);
-  amitk_data_set_set_voxel_size(output_ds, AMITK_DATA_SET_VOXEL_SIZE(ds1));
-  amitk_data_set_calc_far_corner(output_ds);
-  amitk_data_set_set_scan_start(output_ds, amitk_data_set_get_start_time(ds1, i_voxel.t));
+  G_UNLOCK(slice_cache);
 
-  for (i_view_mode=0; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++) 
-    amitk_data_set_set_color_table(output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE(ds1, i_view_mode));
-  for (i_view_mode=AMITK_VIEW_MODE_LINKED_2WAY; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++)
-    amitk_data_set_set_color_table_independent(output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE_INDEPENDENT(ds1, i_view_mode));
+  return;
+}
 
-  /* set a new name for this guy */
-  switch(operation) {
-  case AMITK_OPERATION_UNARY_RESCALE:
-    if (parameter0 >= parameter1)
-      temp_string = g_strdup_printf(_("Result: %s rescaled at %3.2g"), 
-				    AMITK_OBJECT_NAME(ds1), parameter0);
-    else
-      temp_string = g_strdup_printf(_("Result: %s rescaled below %3.2g and above %3.2g"), 
-				    AMITK_OBJECT_NAME(ds1), parameter0, parameter1);
-    break;
-  case AMITK_OPERATION_UNARY_REMOVE_NEGATIVES:
-    temp_string = g_strdup_printf(_("Result: %s negative values removed"),
-				  AMITK_OBJECT_NAME(ds1));
+/* throws out all slices generated from the given data set */
+static void slice_cache_remove_parent(const AmitkDataSet * parent_ds) {
+
+  GList * link;
+  GList * next;
+  GList * removed=NULL;
+  slice_cache_entry_t * entry;
+
+  G_LOCK(slice_cache);
+
+  /* unlink first, and then unref, as unref'ing a slice can bring us back here */
+  if (slice_cache_lru != NULL) {
+    for (link = g_queue_peek_head_link(slice_cache_lru); link != NULL; link = next) {
+      next = link->next;
+      entry = link->data;
+      if (entry->key.parent == parent_ds) {
+	slice_cache_unlink(entry);
+	removed = g_list_prepend(removed, entry);
+      }
+    }
+  }
+
+  G_UNLOCK(slice_cache);
+
+  slice_cache_entries_free(removed);
+
+  return;
+}
+
+
+
+/* a request for the slices through several data sets. Requests are put together
+   (_new) and handed back (_finish) on the main thread, but the slices that weren't
+   in the cache can be generated (_run) from any thread */
+struct _AmitkSliceRequest {
+  gboolean use_cache;
+  amide_time_t start;
+  amide_time_t duration;
+  amide_intpoint_t gate;
+  AmitkCanvasPoint pixel_size;
+  AmitkVolume * view_volume; /* our own copy */
+
+  /* one entry for each data set in the list we were given */
+  gint num_data_sets;
+  AmitkDataSet ** data_sets; /* referenced */
+  guint * epochs; /* the data sets' slice_epoch when the request was put together */
+  AmitkDataSet ** cached; /* the slice from the cache, referenced, or NULL */
+
+  /* one entry for each slice that needs to be generated */
+  gint num_jobs;
+  AmitkDataSet ** parents; /* not referenced, they're in data_sets */
+  AmitkDataSet ** sources; /* snapshot of the parent or one of its pyramid levels, 
+			      NULL if the snapshot couldn't be made */
+  AmitkDataSet ** slices;
+  gsize size; /* roughly how much memory the generated slices will take */
+  gboolean ran;
+};
+
+static void slice_request_func(const gint start, const gint end, gpointer data) {
+
+  AmitkSliceRequest * request = data;
+  gint i;
+
+  for (i=start; i<end; i++) {
+    if (request->sources[i] == NULL) continue;
+    request->slices[i] = data_set_get_slice_from(request->sources[i], request->parents[i], 
+						 request->start, request->duration, request->gate,
+						 request->pixel_size, request->view_volume);
+    /* slices are shared once they're handed back, so get this done now */
+    if (request->slices[i] != NULL)
+      amitk_data_set_calc_min_max_if_needed(request->slices[i], NULL, NULL);
+  }
+
+  return;
+}
+
+/* put together a request for the slices through the data sets in objects, see
+   amitk_data_sets_get_slices.  Needs to be called from the main thread. */
+AmitkSliceRequest * amitk_data_sets_slice_request_new(GList * objects,
+						      const gboolean use_cache,
+						      const amide_time_t start,
+						      const amide_time_t duration,
+						      const amide_intpoint_t gate,
+						      const AmitkCanvasPoint pixel_size,
+						      const AmitkVolume * view_volume) {
+
+  AmitkSliceRequest * request;
+  GList * temp_objects;
+  AmitkDataSet * parent_ds;
+  AmitkDataSet * source;
+  slice_key_t key;
+  gsize slice_size;
+  gint num_objects;
+  gint i, j;
+
+  g_return_val_if_fail(objects != NULL, NULL);
+  g_return_val_if_fail(AMITK_IS_VOLUME(view_volume), NULL);
+
+  num_objects = g_list_length(objects);
+
+  request = g_new0(AmitkSliceRequest, 1);
+  request->use_cache = use_cache;
+  request->start = start;
+  request->duration = duration;
+  request->gate = gate;
+  request->pixel_size = pixel_size;
+  request->view_volume = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(view_volume)));
+  request->data_sets = g_new0(AmitkDataSet *, num_objects);
+  request->epochs = g_new0(guint, num_objects);
+  request->cached = g_new0(AmitkDataSet *, num_objects);
+  request->parents = g_new0(AmitkDataSet *, num_objects);
+  request->sources = g_new0(AmitkDataSet *, num_objects);
+  request->slices = g_new0(AmitkDataSet *, num_objects);
+
+  /* all the slices will be this size */
+  slice_size = sizeof(AmitkDataSet) + sizeof(amitk_format_DOUBLE_t)*
+    ceil(fabs(AMITK_VOLUME_X_CORNER(view_volume))/pixel_size.x)*
+    ceil(fabs(AMITK_VOLUME_Y_CORNER(view_volume))/pixel_size.y);
+
+  /* figure out which slices we need to generate */
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    if (AMITK_IS_DATA_SET(temp_objects->data)) {
+      parent_ds = AMITK_DATA_SET(temp_objects->data);
+      i = request->num_data_sets++;
+      request->data_sets[i] = amitk_object_ref(parent_ds);
+      request->epochs[i] = parent_ds->slice_epoch;
+
+      if (use_cache) {
+	slice_key_init(&key, parent_ds, start, duration, gate, pixel_size, view_volume);
+	request->cached[i] = slice_cache_find(&key);
+      }
+
+      if (request->cached[i] == NULL) {
+	for (j=0; (j < request->num_jobs) && (request->parents[j] != parent_ds); j++);
+	if (j == request->num_jobs) { /* only generate once per data set */
+	  request->parents[j] = parent_ds;
+	  /* the parent can get changed while the request runs, so work from a snapshot */
+	  source = use_cache ? data_set_get_slice_source(parent_ds, pixel_size) : parent_ds;
+	  request->sources[j] = data_set_new_slice_snapshot(source, parent_ds);
+	  request->num_jobs++;
+	  request->size += slice_size;
+	}
+      }
+    }
+  }
+
+  return request;
+}
+
+/* TRUE if all the slices came out of the cache, so running the request is trivial */
+gboolean amitk_data_sets_slice_request_cached(const AmitkSliceRequest * request) {
+  g_return_val_if_fail(request != NULL, TRUE);
+  return (request->num_jobs == 0);
+}
+
+/* the slice through the which'th data set of the list the request was made with, or NULL
+   if it couldn't be generated.  Only valid once the request's been run, and not referenced */
+AmitkDataSet * amitk_data_sets_slice_request_get_slice(const AmitkSliceRequest * request,
+						       const gint which) {
+
+  gint j;
+
+  g_return_val_if_fail(request != NULL, NULL);
+  g_return_val_if_fail(request->ran, NULL);
+  g_return_val_if_fail((which >= 0) && (which < request->num_data_sets), NULL);
+
+  if (request->cached[which] != NULL)
+    return request->cached[which];
+
+  for (j=0; (j < request->num_jobs) && (request->parents[j] != request->data_sets[which]); j++);
+  g_return_val_if_fail(j < request->num_jobs, NULL);
+
+  return request->slices[j];
+}
+
+/* generate the slices that weren't in the cache, this can be called from any thread */
+/* notes
+   - the slices are generated in parallel, one data set per thread
+ */
+void amitk_data_sets_slice_request_run(AmitkSliceRequest * request) {
+
+  g_return_if_fail(request != NULL);
+  g_return_if_fail(!request->ran);
+
+  amitk_parallel_for(request->num_jobs, 1, slice_request_func, request);
+  request->ran = TRUE;
+
+  return;
+}
+
+/* returns the list of slices, and frees the request.  The request must have been run.
+   Needs to be called from the main thread. */
+GList * amitk_data_sets_slice_request_finish(AmitkSliceRequest * request) {
+
+  GList * slices=NULL;
+  AmitkDataSet * slice;
+  slice_key_t key;
+  gboolean use_cache;
+  gint i;
+
+  g_return_val_if_fail(request != NULL, NULL);
+  g_return_val_if_fail(request->ran, NULL);
+  use_cache = request->use_cache;
+
+  /* put together the return list */
+  for (i=0; i < request->num_data_sets; i++) {
+    slice = amitk_data_sets_slice_request_get_slice(request, i);
+    if (slice == NULL) continue; /* get_slice will have already complained */
+    /* if the data set changed while the request was running, the new slice
+       is already stale, so don't cache it */
+    if ((request->cached[i] == NULL) && use_cache &&
+	(request->epochs[i] == request->data_sets[i]->slice_epoch)) {
+      slice_key_init(&key, request->data_sets[i], request->start, request->duration, 
+		     request->gate, request->pixel_size, request->view_volume);
+      slice_cache_add(&key, slice);
+    }
+
+    slices = g_list_prepend(slices, amitk_object_ref(slice));
+  }
+
+  amitk_data_sets_slice_request_free(request);
+
+  /* regulate the size of the cache */
+  if (use_cache)
+    slice_cache_trim();
+
+  return slices;
+}
+
+/* throws out the request, needs to be called from the main thread */
+void amitk_data_sets_slice_request_free(AmitkSliceRequest * request) {
+
+  gint i;
+
+  g_return_if_fail(request != NULL);
+
+  for (i=0; i < request->num_data_sets; i++) {
+    if (request->cached[i] != NULL)
+      amitk_object_unref(request->cached[i]);
+    amitk_object_unref(request->data_sets[i]);
+  }
+  for (i=0; i < request->num_jobs; i++) {
+    if (request->slices[i] != NULL)
+      amitk_object_unref(request->slices[i]);
+    if (request->sources[i] != NULL)
+      amitk_object_unref(request->sources[i]);
+  }
+  amitk_object_unref(request->view_volume);
+
+  g_free(request->data_sets);
+  g_free(request->epochs);
+  g_free(request->cached);
+  g_free(request->parents);
+  g_free(request->sources);
+  g_free(request->slices);
+  g_free(request);
+
+  return;
+}
+
+/* give a list of data_sets, returns a list of slices of equal size and orientation
+   intersecting these data_sets.  If use_cache is set, slices will be pulled from
+   and added to the global slice cache, and may be generated from the data sets'
+   reduced resolution pyramids (see amitk_data_set_get_pyramid_slice). */
+/* notes
+   - the "gate" parameter should ordinarily by -1 (ignored).  Only use it to override the
+     the data set's view_start_gate/view_end_gate parameters 
+   - use_cache should be FALSE for one off slices (e.g. when exporting), so that they
+     don't push out the slices being viewed
+   - to generate the slices from another thread, use amitk_data_sets_slice_request_new
+     and friends
+ */
+GList * amitk_data_sets_get_slices(GList * objects,
+				   const gboolean use_cache,
+				   const amide_time_t start,
+				   const amide_time_t duration,
+				   const amide_intpoint_t gate,
+				   const AmitkCanvasPoint pixel_size,
+				   const AmitkVolume * view_volume) {
+
+  AmitkSliceRequest * request;
+  GList * slices;
+
+#ifdef SLICE_TIMING
+  struct timeval tv1;
+  struct timeval tv2;
+  gdouble time1;
+  gdouble time2;
+
+  /* let's do some timing */
+  gettimeofday(&tv1, NULL);
+#endif
+
+  request = amitk_data_sets_slice_request_new(objects, use_cache, start, duration, 
+					      gate, pixel_size, view_volume);
+  g_return_val_if_fail(request != NULL, NULL);
+  amitk_data_sets_slice_request_run(request);
+  slices = amitk_data_sets_slice_request_finish(request);
+
+#ifdef SLICE_TIMING
+  /* and wrapup our timing */
+  gettimeofday(&tv2, NULL);
+  time1 = ((double) tv1.tv_sec) + ((double) tv1.tv_usec)/1000000.0;
+  time2 = ((double) tv2.tv_sec) + ((double) tv2.tv_usec)/1000000.0;
+  g_print("######## Slice Generating Took %5.3f (s) #########\n",time2-time1);
+#endif
+
+  return slices;
+}
+
+/* Prefetching: slices that are guessed to be wanted soon (e.g. the next few
+   slices while the user is scrolling through a study) get generated on a 
+   background thread, and put into the slice cache once they're done. Each
+   guess belongs to an owner (e.g. a canvas), which can take back its guesses 
+   if they turn out to be wrong. Guesses that haven't gotten started yet are 
+   then dropped.  Outstanding guesses are limited to SLICE_PREFETCH_MAX_BYTES,
+   so they can't push out too much of what's being looked at. */
+#define SLICE_PREFETCH_MAX_BYTES (SLICE_CACHE_MAX_BYTES/4)
+
+typedef struct {
+  gconstpointer owner;
+  AmitkSliceRequest * request;
+  gsize size;
+  gint cancelled; /* changed atomically */
+} slice_prefetch_t;
+
+static GList * slice_prefetches = NULL; /* outstanding prefetches, main thread only */
+static gsize slice_prefetch_size = 0;
+
+static gboolean slice_prefetch_done_cb(gpointer data) {
+
+  slice_prefetch_t * prefetch = data;
+
+  slice_prefetches = g_list_remove(slice_prefetches, prefetch);
+  slice_prefetch_size -= prefetch->size;
+
+  if (prefetch->request->ran)
+    amitk_objects_unref(amitk_data_sets_slice_request_finish(prefetch->request));
+  else
+    amitk_data_sets_slice_request_free(prefetch->request);
+  g_free(prefetch);
+
+  return FALSE;
+}
+
+/* runs on the prefetch thread */
+static void slice_prefetch_func(gpointer data, gpointer unused) {
+
+  slice_prefetch_t * prefetch = data;
+
+  if (!g_atomic_int_get(&(prefetch->cancelled)))
+    amitk_data_sets_slice_request_run(prefetch->request);
+
+  g_idle_add_full(G_PRIORITY_LOW, slice_prefetch_done_cb, prefetch, NULL);
+
+  return;
+}
+
+/* the prefetch thread, or NULL if we can't have one */
+static GThreadPool * slice_prefetch_get_pool(void) {
+
+  static GThreadPool * prefetch_pool = NULL;
+  static gboolean initialized = FALSE;
+
+  if (!initialized) {
+    initialized = TRUE;
+#if !GLIB_CHECK_VERSION(2,32,0)
+    if (!g_thread_supported()) return NULL;
+#endif
+    prefetch_pool = g_thread_pool_new(slice_prefetch_func, NULL, 1, FALSE, NULL);
+  }
+
+  return prefetch_pool;
+}
+
+/* starts generating the given slices in the background, to be put into the slice
+   cache.  The parameters are as for amitk_data_sets_get_slices.  Returns FALSE if 
+   we're out of room for prefetching, in which case there's no point in guessing
+   any further ahead.  Main thread only. */
+gboolean amitk_data_sets_prefetch_slices(gconstpointer owner,
+					 GList * objects,
+					 const amide_time_t start,
+					 const amide_time_t duration,
+					 const amide_intpoint_t gate,
+					 const AmitkCanvasPoint pixel_size,
+					 const AmitkVolume * view_volume) {
+
+  GThreadPool * prefetch_pool;
+  slice_prefetch_t * prefetch;
+  AmitkSliceRequest * request;
+
+  if ((prefetch_pool = slice_prefetch_get_pool()) == NULL)
+    return FALSE;
+  if (slice_prefetch_size >= SLICE_PREFETCH_MAX_BYTES) 
+    return FALSE;
+
+  request = amitk_data_sets_slice_request_new(objects, TRUE, start, duration, gate, 
+					      pixel_size, view_volume);
+  if (request == NULL) return FALSE;
+
+  if (amitk_data_sets_slice_request_cached(request)) { /* already have them */
+    amitk_data_sets_slice_request_free(request);
+    return TRUE;
+  }
+
+  prefetch = g_new0(slice_prefetch_t, 1);
+  prefetch->owner = owner;
+  prefetch->request = request;
+  prefetch->size = request->size;
+
+  slice_prefetches = g_list_prepend(slice_prefetches, prefetch);
+  slice_prefetch_size += prefetch->size;
+  g_thread_pool_push(prefetch_pool, prefetch, NULL);
+
+  return TRUE;
+}
+
+/* drops the prefetches from owner that haven't gotten started yet. Main thread only. */
+void amitk_data_sets_prefetch_cancel(gconstpointer owner) {
+
+  GList * temp_prefetches;
+  slice_prefetch_t * prefetch;
+
+  for (temp_prefetches = slice_prefetches; temp_prefetches != NULL; 
+       temp_prefetches = temp_prefetches->next) {
+    prefetch = temp_prefetches->data;
+    if (prefetch->owner == owner)
+      g_atomic_int_set(&(prefetch->cancelled), TRUE);
+  }
+
+  return;
+}
+
+/* function to perform the given operation on a single data set
+   parameter0 and parameter1 are used by some operations, for instance for the
+   threshold operation, values below parameter0 are set to 0, values above
+   parameter1 1, and parameters between are interpolated */
+AmitkDataSet * amitk_data_sets_math_unary(AmitkDataSet * ds1, 
+					  AmitkOperationUnary operation,
+					  amide_data_t parameter0,
+					  amide_data_t parameter1,
+					  AmitkUpdateFunc update_func,
+					  gpointer update_data) {
+
+  AmitkVoxel i_dim;
+  AmitkDataSet * output_ds;
+  AmitkVoxel i_voxel;
+  amide_data_t value;
+  gchar * temp_string;
+  AmitkViewMode i_view_mode;
+  div_t x;
+  gint divider, total_planes,image_num;
+  gboolean continue_work=TRUE;
+  AmitkFormat format;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds1), NULL);
+  i_dim = AMITK_DATA_SET_DIM (ds1);
+
+  switch(operation) {
+  case AMITK_OPERATION_UNARY_RESCALE:
+    if (parameter0 >= parameter1)
+      format = AMITK_FORMAT_UBYTE; /* results will be 0 or 1 */
+    else
+      format = AMITK_FORMAT_FLOAT; /* results will be between 0 and 1 */
+    break;
+  case AMITK_OPERATION_UNARY_REMOVE_NEGATIVES:
+    format = AMITK_FORMAT_FLOAT;
+    break;
+  default:
+    g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
+    goto error;
+  }
+
+  output_ds = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(ds1), 
+					   format, i_dim, AMITK_SCALING_TYPE_0D);
+  if (output_ds == NULL) {
+    g_warning(_("couldn't allocate %d MB for the output_ds data set structure"),
+	      amitk_raw_format_calc_num_bytes(i_dim, format)/(1024*1024));
+    goto error;
+  }
+
+  /* Start setting up the new dataset */
+  amitk_space_copy_in_place( AMITK_SPACE(output_ds), AMITK_SPACE(ds1));
+  amitk_data_set_set_scale_factor(output_ds, 1.0);
+  amitk_data_set_set_voxel_size(output_ds, AMITK_DATA_SET_VOXEL_SIZE(ds1));
+  amitk_data_set_calc_far_corner(output_ds);
+  amitk_data_set_set_scan_start(output_ds, amitk_data_set_get_start_time(ds1, i_voxel.t));
+
+  for (i_view_mode=0; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++) 
+    amitk_data_set_set_color_table(output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE(ds1, i_view_mode));
+  for (i_view_mode=AMITK_VIEW_MODE_LINKED_2WAY; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++)
+    amitk_data_set_set_color_table_independent(output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE_INDEPENDENT(ds1, i_view_mode));
+
+  /* set a new name for this guy */
+  switch(operation) {
+  case AMITK_OPERATION_UNARY_RESCALE:
+    if (parameter0 >= parameter1)
+      temp_string = g_strdup_printf(_("Result: %s rescaled at %3.2g"), 
+				    AMITK_OBJECT_NAME(ds1), parameter0);
+    else
+      temp_string = g_strdup_printf(_("Result: %s rescaled below %3.2g and above %3.2g"), 
+				    AMITK_OBJECT_NAME(ds1), parameter0, parameter1);
+    break;
+  case AMITK_OPERATION_UNARY_REMOVE_NEGATIVES:
+    temp_string = g_strdup_printf(_("Result: %s negative values removed"),
+				  AMITK_OBJECT_NAME(ds1));
     break;
   default:
     g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
@@ -5874,6 +7589,168 @@ AmitkDataSet * amitk_data_sets_math_unary(AmitkDataSet * ds1,
 }
 
 
+/* applies the binary operation voxel by voxel, see amitk_data_sets_math_binary */
+static void math_binary_values(const AmitkOperationBinary operation,
+			       const amide_data_t * values1,
+			       const amide_data_t * values2,
+			       amitk_format_FLOAT_t * output,
+			       const gsize num_voxels,
+			       const amide_data_t parameter0,
+			       const amide_data_t delta_echo) {
+
+  gsize k;
+  amide_data_t value0, value1;
+
+  /* the switch is outside of the loops, so that the loops can be vectorized */
+  switch(operation) {
+  case AMITK_OPERATION_BINARY_ADD:
+    for (k=0; k<num_voxels; k++)
+      output[k] = values1[k] + values2[k];
+    break;
+  case AMITK_OPERATION_BINARY_SUB:
+    for (k=0; k<num_voxels; k++)
+      output[k] = values1[k] - values2[k];
+    break;
+  case AMITK_OPERATION_BINARY_MULTIPLY:
+    for (k=0; k<num_voxels; k++)
+      output[k] = values1[k] * values2[k];
+    break;
+  case AMITK_OPERATION_BINARY_DIVISION:
+    for (k=0; k<num_voxels; k++)
+      output[k] = (values2[k] > parameter0) ? values1[k] / values2[k] : 0.0;
+    break;
+  case AMITK_OPERATION_BINARY_T2STAR:
+    /* we actually compute the relaxation rate, that way we don't run into issues with infinity */
+    for (k=0; k<num_voxels; k++) {
+      value0 = values1[k];
+      value1 = values2[k];
+      if ((value0 <= 0) || (value1 <= 0))
+	value0 = 0; /* don't have signal, can't assess */
+      if (value0 <= value1) /* no decay between two time points */
+	output[k] = 0; /* no relaxation */
+      else /* compute in units of 1/s */
+	output[k] = 1000.0 * (log(value0)-log(value1)) / (delta_echo);
+    }
+    break;
+  default:
+    break;
+  }
+
+  return;
+}
+
+/* returns TRUE if ds2 can be read voxel for voxel on ds1's grid, which is also the
+   grid of the output, so neither data set needs to be resampled */
+static gboolean math_binary_same_grid(AmitkDataSet * ds1,
+				      AmitkDataSet * ds2,
+				      const AmitkVoxel output_dim,
+				      const gboolean by_frames) {
+
+  AmitkVoxel dim1, dim2;
+  guint i_frame;
+
+  dim1 = AMITK_DATA_SET_DIM(ds1);
+  dim2 = AMITK_DATA_SET_DIM(ds2);
+
+  if ((dim1.x != output_dim.x) || (dim1.y != output_dim.y) || (dim1.z != output_dim.z))
+    return FALSE;
+  if ((dim1.x != dim2.x) || (dim1.y != dim2.y) || (dim1.z != dim2.z))
+    return FALSE;
+  if (!POINT_EQUAL(AMITK_DATA_SET_VOXEL_SIZE(ds1), AMITK_DATA_SET_VOXEL_SIZE(ds2)))
+    return FALSE;
+  if (!amitk_space_equal(AMITK_SPACE(ds1), AMITK_SPACE(ds2)))
+    return FALSE;
+
+  /* if not going by frames, ds2 is averaged over the time of each of ds1's frames, 
+     so the frames need to line up */
+  if (!by_frames) {
+    if (dim1.t != dim2.t)
+      return FALSE;
+    for (i_frame=0; i_frame < dim1.t; i_frame++) {
+      if (!REAL_EQUAL(amitk_data_set_get_start_time(ds1, i_frame), 
+		      amitk_data_set_get_start_time(ds2, i_frame)))
+	return FALSE;
+      if (!REAL_EQUAL(amitk_data_set_get_frame_duration(ds1, i_frame), 
+		      amitk_data_set_get_frame_duration(ds2, i_frame)))
+	return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* used for computing the planes of a frame/gate in parallel */
+typedef struct {
+  AmitkDataSet * ds1;
+  AmitkDataSet * ds2;
+  AmitkDataSet * output_ds;
+  AmitkOperationBinary operation;
+  amide_data_t parameter0;
+  amide_data_t delta_echo;
+  AmitkVoxel i_voxel; /* frame and gate of ds1 and the output */
+  AmitkVoxel j_voxel; /* frame and gate of ds2 */
+  amide_intpoint_t first_plane;
+  gboolean same_grid;
+
+  /* only used when resampling */
+  AmitkVolume ** volumes; /* slice volume for each plane in the batch */
+  amide_time_t start1, duration1;
+  amide_time_t start2, duration2;
+  AmitkCanvasPoint pixel_size;
+  gboolean failed;
+} math_binary_t;
+
+static void math_binary_planes_func(const gint start, const gint end, gpointer data) {
+
+  math_binary_t * job = data;
+  AmitkDataSet * slice1;
+  AmitkDataSet * slice2;
+  amide_data_t * values1;
+  amide_data_t * values2;
+  AmitkVoxel i_voxel;
+  gsize plane_size;
+  gint p;
+
+  plane_size = ((gsize) AMITK_DATA_SET_DIM_X(job->output_ds))*AMITK_DATA_SET_DIM_Y(job->output_ds);
+  values1 = g_new(amide_data_t, plane_size);
+  values2 = g_new(amide_data_t, plane_size);
+
+  i_voxel = job->i_voxel;
+  i_voxel.y = i_voxel.x = 0;
+  for (p=start; p<end; p++) {
+    i_voxel.z = job->first_plane+p;
+
+    if (job->same_grid) {
+      amitk_data_set_get_plane_values(job->ds1, job->i_voxel.t, job->i_voxel.g, i_voxel.z, values1);
+      amitk_data_set_get_plane_values(job->ds2, job->j_voxel.t, job->j_voxel.g, i_voxel.z, values2);
+    } else {
+      slice1 = amitk_data_set_get_slice(job->ds1, job->start1, job->duration1,
+					job->i_voxel.g, job->pixel_size, job->volumes[p]);
+      slice2 = amitk_data_set_get_slice(job->ds2, job->start2, job->duration2,
+					job->j_voxel.g, job->pixel_size, job->volumes[p]);
+      if ((slice1 == NULL) || (slice2 == NULL)) {
+	job->failed = TRUE;
+	if (slice1 != NULL) amitk_object_unref(slice1);
+	if (slice2 != NULL) amitk_object_unref(slice2);
+	continue;
+      }
+      amitk_data_set_get_plane_values(slice1, 0, 0, 0, values1);
+      amitk_data_set_get_plane_values(slice2, 0, 0, 0, values2);
+      amitk_object_unref(slice1);
+      amitk_object_unref(slice2);
+    }
+
+    math_binary_values(job->operation, values1, values2,
+		       AMITK_RAW_DATA_FLOAT_POINTER(job->output_ds->raw_data, i_voxel),
+		       plane_size, job->parameter0, job->delta_echo);
+  }
+
+  g_free(values1);
+  g_free(values2);
+
+  return;
+}
+
 /* function to perform the given operation between two data sets 
    DIVISION: parameter0 used a threshold for the divisor, below which output is set zero. 
    T2STAR: parameter0 is the echo time of ds1
@@ -5897,23 +7774,26 @@ AmitkDataSet * amitk_data_sets_math_binary(AmitkDataSet * ds1,
   AmitkVoxel i_dim,j_dim;
   amide_time_t frame_start, frame_duration;
   AmitkDataSet * output_ds=NULL;
-  AmitkVoxel i_voxel, j_voxel, k_voxel;
+  AmitkVoxel i_voxel, j_voxel;
   AmitkPoint new_offset;
-  AmitkDataSet * slice1=NULL;
-  AmitkDataSet * slice2=NULL;
-  amitk_format_FLOAT_t value0;
-  amitk_format_FLOAT_t value1;
+  math_binary_t job;
   gchar * temp_string;
   AmitkViewMode i_view_mode;
-  div_t x;
-  gint divider, total_planes,image_num;
+  gint total_planes,image_num;
+  gint batch, num_planes, z, p;
   gboolean continue_work=TRUE;
   amide_data_t delta_echo=1.0;
 
   g_return_val_if_fail(AMITK_IS_DATA_SET(ds1), NULL);
   g_return_val_if_fail(AMITK_IS_DATA_SET(ds2), NULL);
+  job.volumes = NULL;
+
+  /* more error checking, before anything gets allocated */
+  if ((operation < 0) || (operation >= AMITK_OPERATION_BINARY_NUM)) {
+    g_warning(_("unknown binary operation %d"), operation);
+    goto error;
+  }
 
-  /* more error checking */
   switch(operation) {
   case AMITK_OPERATION_BINARY_T2STAR:
     if ((parameter0 <= 0) || (parameter1 <= 0)) {
@@ -6026,13 +7906,25 @@ AmitkDataSet * amitk_data_sets_math_binary(AmitkDataSet * ds1,
     g_free(temp_string);
   }
   total_planes = i_dim.z*i_dim.t*i_dim.g;
-  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
 
-  /* fill in output_ds by performing the operation on the data sets */
+  /* fill in output_ds by performing the operation on the data sets.  Planes are done
+     in parallel, a batch at a time, and if the data sets share the output's grid the
+     values are read straight out of the data sets rather than through get_slice */
+  job.ds1 = ds1;
+  job.ds2 = ds2;
+  job.output_ds = output_ds;
+  job.operation = operation;
+  job.parameter0 = parameter0;
+  job.delta_echo = delta_echo;
+  job.pixel_size = pixel_size;
+  job.same_grid = maintain_ds1_dim && math_binary_same_grid(ds1, ds2, i_dim, by_frames);
+  job.failed = FALSE;
+  batch = 4*amitk_get_num_threads();
+  job.volumes = g_new0(AmitkVolume *, batch);
+
   corner[0] = AMITK_VOLUME_CORNER(volume);
   corner[0].z = voxel_size.z;
   amitk_volume_set_corner(volume, corner[0]); /* set the z dim of the slices */
-  k_voxel = zero_voxel;
   new_offset = zero_point;
 
   for (i_voxel.t = 0; (i_voxel.t < i_dim.t) && continue_work; i_voxel.t++) {
@@ -6045,89 +7937,53 @@ AmitkDataSet * amitk_data_sets_math_binary(AmitkDataSet * ds1,
       amitk_data_set_set_scan_start(output_ds, frame_start);
     amitk_data_set_set_frame_duration(output_ds, i_voxel.t, frame_duration);
 
+    job.start1 = frame_start;
+    job.duration1 = frame_duration;
+    job.start2 = by_frames ? amitk_data_set_get_start_time(ds2, j_voxel.t) : frame_start;
+    job.duration2 = by_frames ? amitk_data_set_get_frame_duration(ds2, j_voxel.t) : frame_duration;
+
     for (i_voxel.g = 0; (i_voxel.g < i_dim.g) && continue_work; i_voxel.g++) {
       j_voxel.g = (i_voxel.g >= j_dim.g) ? 0 : i_voxel.g;
 
       amitk_data_set_set_gate_time(output_ds, i_voxel.g, 
 				   amitk_data_set_get_gate_time(ds1, i_voxel.g));
 
-      for (i_voxel.z = 0; (i_voxel.z < i_dim.z) && continue_work; i_voxel.z++) {
-	j_voxel.z = i_voxel.z;
-	new_offset.z = i_voxel.z * voxel_size.z;
+      job.i_voxel = i_voxel;
+      job.j_voxel = j_voxel;
+      if (!by_frames) job.j_voxel.t = i_voxel.t;
+
+      for (z = 0; (z < i_dim.z) && continue_work; z += batch) {
+	num_planes = MIN(batch, i_dim.z-z);
 
 	if (update_func != NULL) {
-	  image_num = i_voxel.z+i_voxel.t*i_dim.z+i_voxel.g*i_dim.z*i_dim.t;
-	  x = div(image_num,divider);
-	  if (x.rem == 0)
-	    continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
+	  image_num = z+i_voxel.t*i_dim.z+i_voxel.g*i_dim.z*i_dim.t;
+	  continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
 	}
-
-	/* advance the requested slice volume */
-	amitk_space_set_offset( AMITK_SPACE(volume), amitk_space_s2b(AMITK_SPACE(output_ds), new_offset));
-
-	slice1 = amitk_data_set_get_slice(ds1,
-					  frame_start, frame_duration,
-					  i_voxel.g,
-					  pixel_size,
-					  volume);
-	slice2 = amitk_data_set_get_slice(ds2,
-					  by_frames ? amitk_data_set_get_start_time(ds2, j_voxel.t) : frame_start,
-					  by_frames ? amitk_data_set_get_frame_duration(ds2, j_voxel.t) : frame_duration,
-					  j_voxel.g,
-					  pixel_size,
-					  volume);
-
-	if ((slice1 == NULL) || (slice2 == NULL)) {
-	  g_warning(_("couldn't generate slices from the data set..."));
-	  goto error;
+	if (!continue_work) break;
+
+	/* the requested slice volumes */
+	if (!job.same_grid) {
+	  for (p=0; p < num_planes; p++) {
+	    new_offset.z = (z+p) * voxel_size.z;
+	    job.volumes[p] = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(volume)));
+	    amitk_space_set_offset(AMITK_SPACE(job.volumes[p]), amitk_space_s2b(AMITK_SPACE(output_ds), new_offset));
+	  }
 	}
 
-	for (i_voxel.y = 0, k_voxel.y = 0; i_voxel.y < i_dim.y; i_voxel.y++, k_voxel.y++) {
-	  for (i_voxel.x = 0, k_voxel.x = 0; i_voxel.x < i_dim.x; i_voxel.x++, k_voxel.x++) {
-	    switch(operation) {
-	    case AMITK_OPERATION_BINARY_ADD:
-	      value0 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(AMITK_DATA_SET(slice1), k_voxel ) 
-		+ AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT( AMITK_DATA_SET(slice2), k_voxel);
-	      break;
-	    case AMITK_OPERATION_BINARY_SUB:
-	      value0 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(AMITK_DATA_SET(slice1), k_voxel ) 
-		- AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT( AMITK_DATA_SET(slice2), k_voxel);
-	      break;
-	    case AMITK_OPERATION_BINARY_MULTIPLY:
-	      value0 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(AMITK_DATA_SET(slice1), k_voxel ) 
-		* AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT( AMITK_DATA_SET(slice2), k_voxel);
-	      break;
-	    case AMITK_OPERATION_BINARY_DIVISION:
-	      value0 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT( AMITK_DATA_SET(slice2), k_voxel);
-	      if (value0 > parameter0)
-		value0 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(AMITK_DATA_SET(slice1), k_voxel ) 
-		  / value0;
-	      else
-		value0 = 0.0;
-	      break;
-	    case AMITK_OPERATION_BINARY_T2STAR:
-	      /* we actually compute the relaxation rate, that way we don't run into issues with infinity */
-	      value0 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(AMITK_DATA_SET(slice1), k_voxel);
-	      value1 = AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(AMITK_DATA_SET(slice2), k_voxel);
-	     
-	      if ((value0 <= 0) || (value1 <= 0))
-		value0 = 0; /* don't have signal, can't assess */
-	      if (value0 <= value1) /* no decay between two time points */
-		value0 = 0; /* no relaxation */
-	      else /* compute in units of 1/s */
-		value0 = 1000.0 * (log(value0)-log(value1)) / (delta_echo);
-	      break;
-	    default:
-	      goto error;
-	    }
+	job.first_plane = z;
+	amitk_parallel_for(num_planes, 1, math_binary_planes_func, &job);
 
-	    AMITK_RAW_DATA_FLOAT_SET_CONTENT(output_ds->raw_data, i_voxel) = value0;
+	for (p=0; p < num_planes; p++) {
+	  if (job.volumes[p] != NULL) {
+	    amitk_object_unref(job.volumes[p]);
+	    job.volumes[p] = NULL;
 	  }
 	}
-	amitk_object_unref(slice1);
-	slice1 = NULL;
-	amitk_object_unref(slice2);
-	slice2 = NULL;
+
+	if (job.failed) {
+	  g_warning(_("couldn't generate slices from the data set..."));
+	  goto error;
+	}
       }
     }
   }
@@ -6154,10 +8010,9 @@ AmitkDataSet * amitk_data_sets_math_binary(AmitkDataSet * ds1,
   }
 
  exit:
-  amitk_object_unref(volume);
+  if (volume != NULL) amitk_object_unref(volume);
   g_list_free(data_sets);
-  if (slice1 != NULL) amitk_object_unref(slice1);
-  if (slice2 != NULL) amitk_object_unref(slice2);
+  if (job.volumes != NULL) g_free(job.volumes);
 
   if (update_func != NULL) /* remove progress bar */
     (*update_func)(update_data, NULL, (gdouble) 2.0); 
@@ -6167,6 +8022,324 @@ AmitkDataSet * amitk_data_sets_math_binary(AmitkDataSet * ds1,
 
 
 
+/* used for computing the planes of a frame/gate of an expression in parallel,
+   the arrays are indexed by variable, and are only filled in for the variables
+   the expression uses */
+typedef struct {
+  const AmitkMathExpression * expression;
+  AmitkDataSet * output_ds;
+  AmitkVoxel i_voxel; /* frame and gate of the output */
+  amide_intpoint_t first_plane;
+  AmitkDataSet * ds[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  gboolean same_grid[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  guint frame[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  guint gate[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  amide_time_t start[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  amide_time_t duration[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+
+  /* only used when resampling */
+  AmitkVolume ** volumes; /* slice volume for each plane in the batch */
+  AmitkCanvasPoint pixel_size;
+  gboolean failed;
+} math_expression_t;
+
+static void math_expression_planes_func(const gint start, const gint end, gpointer data) {
+
+  math_expression_t * job = data;
+  AmitkDataSet * slice;
+  amide_data_t * values[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  AmitkVoxel i_voxel;
+  gsize plane_size;
+  gint p, v;
+
+  plane_size = ((gsize) AMITK_DATA_SET_DIM_X(job->output_ds))*AMITK_DATA_SET_DIM_Y(job->output_ds);
+  for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++)
+    values[v] = (job->ds[v] != NULL) ? g_new(amide_data_t, plane_size) : NULL;
+
+  i_voxel = job->i_voxel;
+  i_voxel.y = i_voxel.x = 0;
+  for (p=start; (p<end) && !job->failed; p++) {
+    i_voxel.z = job->first_plane+p;
+
+    for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++) {
+      if (job->ds[v] == NULL) continue;
+
+      if (job->same_grid[v]) {
+	amitk_data_set_get_plane_values(job->ds[v], job->frame[v], job->gate[v], i_voxel.z, values[v]);
+      } else {
+	slice = amitk_data_set_get_slice(job->ds[v], job->start[v], job->duration[v],
+					 job->gate[v], job->pixel_size, job->volumes[p]);
+	if (slice == NULL) {
+	  job->failed = TRUE;
+	  break;
+	}
+	amitk_data_set_get_plane_values(slice, 0, 0, 0, values[v]);
+	amitk_object_unref(slice);
+      }
+    }
+    if (job->failed) break;
+
+    amitk_math_expression_evaluate(job->expression, (const amide_data_t * const *) values,
+				   AMITK_RAW_DATA_FLOAT_POINTER(job->output_ds->raw_data, i_voxel),
+				   plane_size);
+  }
+
+  for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++)
+    if (values[v] != NULL)
+      g_free(values[v]);
+
+  return;
+}
+
+/* evaluates a formula over several data sets, for instance "(a-b)/c * (c > 10)",
+   see amitk_math_expression.c for the syntax.  The variables a, b, c, ... are the
+   data sets in the list, in order.  The whole formula is worked out a plane at a 
+   time, so no intermediate data sets are made.  The first data set used by the 
+   formula is the reference: the output has its frames and gates, and, if 
+   maintain_first_dim is set, its dimensions.  Otherwise the output covers all 
+   the data sets used.  Data sets other than the reference are averaged over the
+   time of each of the reference's frames, or if by_frames is set, matched frame 
+   by frame. */
+AmitkDataSet * amitk_data_sets_math_expression(GList * data_sets,
+					       const gchar * expression_string,
+					       gboolean by_frames,
+					       gboolean maintain_first_dim,
+					       AmitkUpdateFunc update_func,
+					       gpointer update_data) {
+
+  AmitkMathExpression * expression;
+  gchar * error_message=NULL;
+  GList * used_data_sets=NULL;
+  AmitkDataSet * ref_ds=NULL;
+  AmitkDataSet * ds;
+  AmitkCorners corner;
+  AmitkVolume * volume=NULL;
+  AmitkPoint voxel_size;
+  AmitkCanvasPoint pixel_size;
+  AmitkVoxel i_dim;
+  amide_time_t frame_start, frame_duration;
+  AmitkDataSet * output_ds=NULL;
+  AmitkVoxel i_voxel;
+  AmitkPoint new_offset;
+  math_expression_t job;
+  gchar * temp_string;
+  AmitkViewMode i_view_mode;
+  gint total_planes,image_num;
+  gint batch, num_planes, z, p, v;
+  gboolean resample=FALSE;
+  gboolean continue_work=TRUE;
+
+  g_return_val_if_fail(expression_string != NULL, NULL);
+  job.volumes = NULL;
+
+  expression = amitk_math_expression_new(expression_string, &error_message);
+  if (expression == NULL) {
+    g_warning(_("Couldn't parse \"%s\": %s"), expression_string, error_message);
+    g_free(error_message);
+    return NULL;
+  }
+
+  /* figure out which data sets we need */
+  for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++) {
+    job.ds[v] = NULL;
+    if (!amitk_math_expression_uses_variable(expression, v)) continue;
+
+    ds = g_list_nth_data(data_sets, v);
+    if (!AMITK_IS_DATA_SET(ds)) {
+      g_warning(_("No data set given for variable %c"), amitk_math_expression_variable_name(v));
+      goto error;
+    }
+    job.ds[v] = ds;
+    if (ref_ds == NULL) ref_ds = ds;
+    used_data_sets = g_list_append(used_data_sets, ds);
+  }
+  if (ref_ds == NULL) {
+    g_warning(_("The expression needs to use at least one data set"));
+    goto error;
+  }
+
+  /* Set up the voxel dimensions for the output data set */
+  if (maintain_first_dim) {
+    volume = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(ref_ds)));
+    voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ref_ds);
+    pixel_size.x = voxel_size.x;
+    pixel_size.y = voxel_size.y;
+  } else {
+    /* create a volume that's a superset of the volumes of the data sets */
+    volume = amitk_volume_new();
+    amitk_volumes_get_enclosing_corners(used_data_sets, AMITK_SPACE(volume), corner);
+    amitk_space_set_offset(AMITK_SPACE(volume), corner[0]);
+    amitk_volume_set_corner(volume, amitk_space_b2s(AMITK_SPACE(volume), corner[1]));
+
+    voxel_size.x = voxel_size.y = voxel_size.z = amitk_data_sets_get_min_voxel_size(used_data_sets);
+    pixel_size.x = pixel_size.y = voxel_size.x;
+  }
+
+  i_dim.x = ceil(fabs(AMITK_VOLUME_X_CORNER(volume) ) / voxel_size.x );
+  i_dim.y = ceil(fabs(AMITK_VOLUME_Y_CORNER(volume) ) / voxel_size.y );
+  i_dim.z = ceil(fabs(AMITK_VOLUME_Z_CORNER(volume) ) / voxel_size.z );
+  i_dim.t = AMITK_DATA_SET_DIM_T(ref_ds);
+  i_dim.g = AMITK_DATA_SET_DIM_G(ref_ds);
+
+  for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++) {
+    ds = job.ds[v];
+    if ((ds == NULL) || (ds == ref_ds)) continue;
+
+    if (by_frames && (AMITK_DATA_SET_DIM_T(ds) != i_dim.t))
+      g_warning(_("Can't handle 'by frame' operations with data sets with unequal frame numbers, will use all frames of \"%s\" and the first frame of \"%s\"."),
+		AMITK_OBJECT_NAME(ref_ds), AMITK_OBJECT_NAME(ds));
+    if (AMITK_DATA_SET_DIM_G(ds) != i_dim.g)
+      g_warning(_("Can't handle studies with different numbers of gates, will use all gates of \"%s\" and the first gate of \"%s\"."),
+		AMITK_OBJECT_NAME(ref_ds), AMITK_OBJECT_NAME(ds));
+  }
+
+  output_ds = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(ref_ds), 
+					   AMITK_FORMAT_FLOAT, i_dim, AMITK_SCALING_TYPE_0D);
+  if (output_ds == NULL) {
+    g_warning(_("couldn't allocate %d MB for the output_ds data set structure"),
+	      amitk_raw_format_calc_num_bytes(i_dim, AMITK_FORMAT_FLOAT)/(1024*1024));
+    goto error;
+  }
+
+  /* Start setting up the new dataset */
+  amitk_space_copy_in_place( AMITK_SPACE(output_ds), AMITK_SPACE(volume));
+  amitk_data_set_set_scale_factor(output_ds, 1.0);
+  amitk_data_set_set_voxel_size(output_ds, voxel_size);
+  amitk_raw_data_FLOAT_initialize_data(AMITK_DATA_SET_RAW_DATA(output_ds),NAN);
+  for (i_view_mode=0; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++) 
+    amitk_data_set_set_color_table(output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE(ref_ds, i_view_mode));
+  for (i_view_mode=AMITK_VIEW_MODE_LINKED_2WAY; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++)
+    amitk_data_set_set_color_table_independent(output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE_INDEPENDENT(ref_ds, i_view_mode));
+
+  temp_string = g_strdup_printf(_("Result: %s"), amitk_math_expression_get_string(expression));
+  amitk_object_set_name(AMITK_OBJECT(output_ds), temp_string);
+  g_free(temp_string);
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Performing math operation"));
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+  total_planes = i_dim.z*i_dim.t*i_dim.g;
+
+  /* fill in output_ds, a batch of planes at a time, as in amitk_data_sets_math_binary.
+     Each data set that shares the output's grid is read directly */
+  job.expression = expression;
+  job.output_ds = output_ds;
+  job.pixel_size = pixel_size;
+  job.failed = FALSE;
+  for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++) {
+    if (job.ds[v] == NULL) continue;
+    job.same_grid[v] = maintain_first_dim && math_binary_same_grid(ref_ds, job.ds[v], i_dim, by_frames);
+    if (!job.same_grid[v]) resample = TRUE;
+  }
+  batch = 4*amitk_get_num_threads();
+  job.volumes = g_new0(AmitkVolume *, batch);
+
+  corner[0] = AMITK_VOLUME_CORNER(volume);
+  corner[0].z = voxel_size.z;
+  amitk_volume_set_corner(volume, corner[0]); /* set the z dim of the slices */
+  new_offset = zero_point;
+
+  for (i_voxel.t = 0; (i_voxel.t < i_dim.t) && continue_work; i_voxel.t++) {
+    frame_start = amitk_data_set_get_start_time(ref_ds, i_voxel.t);
+    frame_duration = amitk_data_set_get_frame_duration(ref_ds, i_voxel.t);
+
+    if (i_voxel.t == 0)
+      amitk_data_set_set_scan_start(output_ds, frame_start);
+    amitk_data_set_set_frame_duration(output_ds, i_voxel.t, frame_duration);
+
+    for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++) {
+      if (job.ds[v] == NULL) continue;
+      if (by_frames || (job.ds[v] == ref_ds)) {
+	job.frame[v] = (i_voxel.t < AMITK_DATA_SET_DIM_T(job.ds[v])) ? i_voxel.t : 0;
+	job.start[v] = amitk_data_set_get_start_time(job.ds[v], job.frame[v]);
+	job.duration[v] = amitk_data_set_get_frame_duration(job.ds[v], job.frame[v]);
+      } else {
+	job.frame[v] = i_voxel.t; /* only used if the frames line up */
+	job.start[v] = frame_start;
+	job.duration[v] = frame_duration;
+      }
+    }
+
+    for (i_voxel.g = 0; (i_voxel.g < i_dim.g) && continue_work; i_voxel.g++) {
+      amitk_data_set_set_gate_time(output_ds, i_voxel.g, 
+				   amitk_data_set_get_gate_time(ref_ds, i_voxel.g));
+
+      for (v=0; v<AMITK_MATH_EXPRESSION_MAX_VARIABLES; v++)
+	if (job.ds[v] != NULL)
+	  job.gate[v] = (i_voxel.g < AMITK_DATA_SET_DIM_G(job.ds[v])) ? i_voxel.g : 0;
+      job.i_voxel = i_voxel;
+
+      for (z = 0; (z < i_dim.z) && continue_work; z += batch) {
+	num_planes = MIN(batch, i_dim.z-z);
+
+	if (update_func != NULL) {
+	  image_num = z+i_voxel.t*i_dim.z+i_voxel.g*i_dim.z*i_dim.t;
+	  continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
+	}
+	if (!continue_work) break;
+
+	/* the requested slice volumes */
+	if (resample) {
+	  for (p=0; p < num_planes; p++) {
+	    new_offset.z = (z+p) * voxel_size.z;
+	    job.volumes[p] = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(volume)));
+	    amitk_space_set_offset(AMITK_SPACE(job.volumes[p]), amitk_space_s2b(AMITK_SPACE(output_ds), new_offset));
+	  }
+	}
+
+	job.first_plane = z;
+	amitk_parallel_for(num_planes, 1, math_expression_planes_func, &job);
+
+	for (p=0; p < num_planes; p++) {
+	  if (job.volumes[p] != NULL) {
+	    amitk_object_unref(job.volumes[p]);
+	    job.volumes[p] = NULL;
+	  }
+	}
+
+	if (job.failed) {
+	  g_warning(_("couldn't generate slices from the data set..."));
+	  goto error;
+	}
+      }
+    }
+  }
+
+  if (!continue_work)
+    goto error;
+
+  /* recalc the temporary parameters */
+  amitk_data_set_calc_min_max(output_ds, NULL, NULL);
+
+  /* set some sensible thresholds */
+  output_ds->threshold_max[0] = output_ds->threshold_max[1] = 
+    amitk_data_set_get_global_max(output_ds);
+  output_ds->threshold_min[0] = output_ds->threshold_min[1] =
+    amitk_data_set_get_global_min(output_ds);
+  output_ds->threshold_ref_frame[1] = AMITK_DATA_SET_NUM_FRAMES(output_ds)-1;
+
+  goto exit;
+
+ error:
+  if (output_ds != NULL) {
+    amitk_object_unref(output_ds);
+    output_ds = NULL;
+  }
+
+ exit:
+  if (volume != NULL) amitk_object_unref(volume);
+  g_list_free(used_data_sets);
+  if (job.volumes != NULL) g_free(job.volumes);
+  amitk_math_expression_free(expression);
+
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+
+  return output_ds;
+}
+
 const gchar * amitk_scaling_type_get_name(const AmitkScalingType scaling_type) {
 
   GEnumClass * enum_class;
@@ -60,10 +60,12 @@ G_BEGIN_DECLS
 #define AMITK_DATA_SET_NUM_FRAMES(ds)              (AMITK_DATA_SET_DIM_T(ds))
 #define AMITK_DATA_SET_TOTAL_PLANES(ds)            (AMITK_DATA_SET_DIM_Z(ds)*AMITK_DATA_SET_DIM_G(ds)*AMITK_DATA_SET_DIM_T(ds))
 #define AMITK_DATA_SET_DISTRIBUTION(ds)            (AMITK_DATA_SET(ds)->distribution)
+#define AMITK_DATA_SET_MIN_MAX_CALCULATED(ds)      (AMITK_DATA_SET(ds)->min_max_calculated)
 #define AMITK_DATA_SET_COLOR_TABLE(ds, view_mode)  (AMITK_DATA_SET(ds)->color_table[view_mode])
 #define AMITK_DATA_SET_COLOR_TABLE_INDEPENDENT(ds, view_mode) (AMITK_DATA_SET(ds)->color_table_independent[view_mode])
 #define AMITK_DATA_SET_INTERPOLATION(ds)           (AMITK_DATA_SET(ds)->interpolation)
 #define AMITK_DATA_SET_RENDERING(ds)               (AMITK_DATA_SET(ds)->rendering)
+#define AMITK_DATA_SET_LAYOUT(ds)                  (AMITK_RAW_DATA_LAYOUT(AMITK_DATA_SET_RAW_DATA(ds)))
 #define AMITK_DATA_SET_DYNAMIC(ds)                 (AMITK_DATA_SET_NUM_FRAMES(ds) > 1)
 #define AMITK_DATA_SET_GATED(ds)                   (AMITK_DATA_SET_NUM_GATES(ds) > 1)
 #define AMITK_DATA_SET_THRESHOLDING(ds)            (AMITK_DATA_SET(ds)->thresholding)
@@ -102,6 +104,7 @@ G_BEGIN_DECLS
 #define AMITK_DATA_SET_NUM_VIEW_GATES(ds)          (AMITK_DATA_SET(ds)->num_view_gates)
 
 #define AMITK_DATA_SET_DISTRIBUTION_SIZE 256
+#define AMITK_DATA_SET_PYRAMID_LEVELS 3
 
 typedef enum {
   AMITK_OPERATION_UNARY_RESCALE,
@@ -118,6 +121,13 @@ typedef enum {
   AMITK_OPERATION_BINARY_NUM
 } AmitkOperationBinary;
 
+typedef enum {
+  AMITK_PROJECTION_SUM,
+  AMITK_PROJECTION_MAXIMUM,
+  AMITK_PROJECTION_MINIMUM,
+  AMITK_PROJECTION_NUM
+} AmitkProjection;
+
 
 typedef enum {
   AMITK_INTERPOLATION_NEAREST_NEIGHBOR, 
@@ -241,6 +251,7 @@ typedef enum { /*< skip >*/
 
 typedef struct _AmitkDataSetClass AmitkDataSetClass;
 typedef struct _AmitkDataSet AmitkDataSet;
+typedef struct _AmitkSliceRequest AmitkSliceRequest;
 
 
 struct _AmitkDataSet
@@ -305,11 +316,17 @@ struct _AmitkDataSet
   amide_data_t global_min;
   amide_data_t * frame_max; 
   amide_data_t * frame_min;
+  gboolean * frame_min_max_calculated; /* frames are calculated as they're needed */
+  guint min_max_idle_id; /* nonzero while calculating the remaining frames in the background */
+  AmitkDataSet * pyramid[AMITK_DATA_SET_PYRAMID_LEVELS]; /* 2x, 4x, 8x reduced copies for zoomed out views */
+  gint pyramid_levels; /* how many of the pyramid levels are complete */
+  guint pyramid_frame; /* next frame to do in the level being built */
+  gint pyramid_plane; /* next plane to do in that frame, over all the gates */
+  guint pyramid_idle_id; /* nonzero while building the pyramid in the background */
+  guint slice_epoch; /* bumped whenever the slices through this data set go stale */
   AmitkRawData * current_scaling_factor; /* external_scaling * internal_scaling_factor[] */
   amide_intpoint_t num_view_gates;
 
-  GList * slice_cache;
-
   /* only used by derived data sets (slices and projections)  */
   /* this is a weak pointer, it should be NULL'ed automatically by gtk on the parent's destruction */
   AmitkDataSet * slice_parent; 
@@ -344,6 +361,7 @@ struct _AmitkDataSetClass
   void (* data_set_changed)             (AmitkDataSet * ds);
   void (* invalidate_slice_cache)       (AmitkDataSet * ds);
   void (* view_gates_changed)           (AmitkDataSet * ds);
+  void (* min_max_changed)              (AmitkDataSet * ds);
 
 };
 
@@ -396,6 +414,8 @@ gboolean       amitk_data_sets_export_to_file    (GList * data_sets,
 						  gpointer update_data);
 amide_data_t   amitk_data_set_get_global_max     (AmitkDataSet * ds);
 amide_data_t   amitk_data_set_get_global_min     (AmitkDataSet * ds);
+amide_data_t   amitk_data_set_get_global_max_provisional(AmitkDataSet * ds);
+amide_data_t   amitk_data_set_get_global_min_provisional(AmitkDataSet * ds);
 amide_data_t   amitk_data_set_get_frame_max      (AmitkDataSet * ds,
 						  const guint frame);
 amide_data_t   amitk_data_set_get_frame_min      (AmitkDataSet * ds,
@@ -434,6 +454,8 @@ void           amitk_data_set_set_interpolation  (AmitkDataSet * ds,
 						  const AmitkInterpolation new_interpolation);
 void           amitk_data_set_set_rendering      (AmitkDataSet * ds,
 						  const AmitkRendering new_rendering);
+void           amitk_data_set_set_layout         (AmitkDataSet * ds,
+						  const AmitkRawDataLayout new_layout);
 void           amitk_data_set_set_subject_orientation    (AmitkDataSet * ds,
 							  const AmitkSubjectOrientation subject_orientation);
 void           amitk_data_set_set_subject_sex    (AmitkDataSet * ds,
@@ -503,19 +525,37 @@ void           amitk_data_set_calc_far_corner    (AmitkDataSet * ds);
 /* note: calling any of the get_*_max or get_*_min functions will automatically
    call calc_min_max if needed.  The main reason to call this function independently
    is if you know the min/max values will be needed later, and you'd like to put up a 
-   progress dialog. */
+   progress dialog.  The frame max/min functions only calculate the given frame.
+   calc_min_max_in_background calculates the remaining frames from the main loop,
+   and "min_max_changed" is emitted when it finishes. While it's running, 
+   get_global_max/min finish the calculation right away, and 
+   get_global_max/min_provisional return the values over the frames done so far. */
 void           amitk_data_set_calc_min_max       (AmitkDataSet * ds,
 						  AmitkUpdateFunc update_func,
 						  gpointer update_data);
 void           amitk_data_set_calc_min_max_if_needed(AmitkDataSet * ds,
 						     AmitkUpdateFunc update_func,
 						     gpointer update_data);
+void           amitk_data_set_calc_min_max_in_background(AmitkDataSet * ds);
 void           amitk_data_set_slice_calc_min_max (AmitkDataSet * ds,
 						  const amide_intpoint_t frame,
 						  const amide_intpoint_t gate,
 						  const amide_intpoint_t z,
 						  amitk_format_DOUBLE_t * pmin,
 						  amitk_format_DOUBLE_t * pmax);
+void           amitk_data_set_get_plane_values   (const AmitkDataSet * ds,
+						  const amide_intpoint_t frame,
+						  const amide_intpoint_t gate,
+						  const amide_intpoint_t z,
+						  amide_data_t * values);
+void           amitk_data_set_threshold_plane    (const AmitkDataSet * ds,
+						  const amide_intpoint_t frame,
+						  const amide_intpoint_t gate,
+						  const amide_intpoint_t z,
+						  const amide_data_t min_value,
+						  const amide_data_t max_value,
+						  amitk_format_UBYTE_t * mask,
+						  const amitk_format_UBYTE_t bit);
 amide_data_t   amitk_data_set_get_max            (AmitkDataSet * ds, 
 						  const amide_time_t start, 
 						  const amide_time_t duration);
@@ -549,8 +589,11 @@ void           amitk_data_set_set_internal_value  (AmitkDataSet *ds,
 						   const amide_data_t internal_value,
 						   const gboolean signal_change);
 void           amitk_data_set_get_projections     (AmitkDataSet * ds,
-						   const guint frame,
-						   const guint gate,
+						   const AmitkProjection projection,
+						   const guint start_frame,
+						   const guint num_frames,
+						   const guint start_gate,
+						   const guint num_gates,
 						   AmitkDataSet ** projections,
 						   AmitkUpdateFunc update_func,
 						   gpointer update_data);
@@ -567,12 +610,24 @@ AmitkDataSet * amitk_data_set_get_filtered        (const AmitkDataSet * ds,
 						   const amide_real_t fwhm,
 						   AmitkUpdateFunc update_func,
 						   gpointer update_data);
+void           amitk_data_set_set_slice_parent   (AmitkDataSet * slice,
+						  AmitkDataSet * slice_parent);
 AmitkDataSet * amitk_data_set_get_slice           (AmitkDataSet * ds,
 						   const amide_time_t start,
 						   const amide_time_t duration,
 						   const amide_intpoint_t gate,
 						   const AmitkCanvasPoint pixel_size,
 						   const AmitkVolume * slice_volume);
+AmitkDataSet * amitk_data_set_get_pyramid_slice   (AmitkDataSet * ds,
+						   const amide_time_t start,
+						   const amide_time_t duration,
+						   const amide_intpoint_t gate,
+						   const AmitkCanvasPoint pixel_size,
+						   const AmitkVolume * slice_volume);
+void           amitk_data_set_calc_pyramid        (AmitkDataSet * ds,
+						   AmitkUpdateFunc update_func,
+						   gpointer update_data);
+void           amitk_data_set_calc_pyramid_in_background(AmitkDataSet * ds);
 void           amitk_data_set_get_line_profile    (AmitkDataSet * ds,
 						   const amide_time_t start,
 						   const amide_time_t duration,
@@ -588,13 +643,33 @@ amide_time_t   amitk_data_sets_get_min_frame_duration(GList * objects);
 amide_real_t   amitk_data_sets_get_min_voxel_size    (GList * objects);
 amide_real_t   amitk_data_sets_get_max_min_voxel_size(GList * objects);
 GList *        amitk_data_sets_get_slices            (GList * objects,
-						      GList ** pslice_cache,
-						      const gint max_slice_cache_size,
+						      const gboolean use_cache,
+						      const amide_time_t start,
+						      const amide_time_t duration,
+						      const amide_intpoint_t gate,
+						      const AmitkCanvasPoint pixel_size,
+						      const AmitkVolume * view_volume);
+AmitkSliceRequest * amitk_data_sets_slice_request_new(GList * objects,
+						      const gboolean use_cache,
 						      const amide_time_t start,
 						      const amide_time_t duration,
 						      const amide_intpoint_t gate,
 						      const AmitkCanvasPoint pixel_size,
 						      const AmitkVolume * view_volume);
+gboolean       amitk_data_sets_slice_request_cached  (const AmitkSliceRequest * request);
+void           amitk_data_sets_slice_request_run     (AmitkSliceRequest * request);
+AmitkDataSet * amitk_data_sets_slice_request_get_slice(const AmitkSliceRequest * request,
+						       const gint which);
+GList *        amitk_data_sets_slice_request_finish  (AmitkSliceRequest * request);
+void           amitk_data_sets_slice_request_free    (AmitkSliceRequest * request);
+gboolean       amitk_data_sets_prefetch_slices       (gconstpointer owner,
+						      GList * objects,
+						      const amide_time_t start,
+						      const amide_time_t duration,
+						      const amide_intpoint_t gate,
+						      const AmitkCanvasPoint pixel_size,
+						      const AmitkVolume * view_volume);
+void           amitk_data_sets_prefetch_cancel       (gconstpointer owner);
 AmitkDataSet * amitk_data_sets_find_with_slice_parent(GList * slices, 
 						      const AmitkDataSet * slice_parent);
 GList *        amitk_data_sets_remove_with_slice_parent(GList * slices,
@@ -614,6 +689,12 @@ AmitkDataSet * amitk_data_sets_math_binary           (AmitkDataSet * ds1,
 						      gboolean maintain_ds1_dim,
 						      AmitkUpdateFunc update_func,
 						      gpointer update_data);
+AmitkDataSet * amitk_data_sets_math_expression       (GList * data_sets,
+						      const gchar * expression,
+						      gboolean by_frames,
+						      gboolean maintain_first_dim,
+						      AmitkUpdateFunc update_func,
+						      gpointer update_data);
 
 
 
@@ -27,6 +27,7 @@
 #include "amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'.h"
 #include "amitk_data_set_FLOAT_0D_SCALING.h"
 
+#include <string.h>
 #ifdef AMIDE_DEBUG
 #include <stdlib.h>
 #endif
@@ -35,7 +36,20 @@
 #define DATA_TYPE_`'m4_Variable_Type`'
 
 
+/* scales a raw value from the current plane, the scale factor (and intercept)
+   is constant over a plane for all scaling types */
+m4_ifelse(m4_Intercept, `INTERCEPT_', `
+#define PLANE_SCALED_VALUE(raw) (plane_scale*(((amide_data_t) (raw)) + plane_intercept))
+', `
+#define PLANE_SCALED_VALUE(raw) (plane_scale*((amide_data_t) (raw)))
+')
+
 /* function to calculate the max/min values of a slice within a data set */
+/* notes:
+   - the raw values are compared, and only the results are scaled.  As scaling
+     is linear, this gives the same answer as scaling each voxel.
+   - as before, if the first voxel isn't finite, zero is thrown into the range
+ */
 void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_slice_min_max(AmitkDataSet * data_set,
 											     const amide_intpoint_t frame,
 											     const amide_intpoint_t gate,
@@ -45,6 +59,14 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_s
 
   AmitkVoxel i;
   amide_data_t max, min, temp;
+  amide_data_t plane_scale;
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  amide_data_t plane_intercept;
+')m4_dnl
+  amitk_format_`'m4_Variable_Type`'_t * plane_data;
+  amitk_format_`'m4_Variable_Type`'_t raw_max, raw_min, value;
+  gpointer buffer=NULL;
+  gboolean found;
+  gsize k, num_voxels;
   AmitkVoxel dim;
   
   dim = AMITK_DATA_SET_DIM(data_set);
@@ -54,18 +76,63 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_s
   i.z = z;
   i.y = i.x = 0;
 
-  temp = AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set, i);
-  if (finite(temp)) max = min = temp;   
-  else max = min = 0.0; /* just throw in zero */
+  if (AMITK_DATA_SET_LAYOUT(data_set) != AMITK_RAW_DATA_LAYOUT_LINEAR) 
+    if ((buffer = g_try_malloc(amitk_raw_data_size_plane_mem(data_set->raw_data))) == NULL) {
+      g_warning(_("couldn't allocate memory space for the plane buffer"));
+      if (pmin != NULL) *pmin = 0.0;
+      if (pmax != NULL) *pmax = 0.0;
+      return;
+    }
+  plane_data = amitk_raw_data_get_plane(data_set->raw_data, i, buffer);
+  plane_scale = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->current_scaling_factor, i);
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  plane_intercept = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->internal_scaling_intercept, i);
+')m4_dnl
+  num_voxels = ((gsize) dim.x)*dim.y;
+
+#if defined(DATA_TYPE_FLOAT) || defined(DATA_TYPE_DOUBLE)
+  /* need to step around non-finite values */
+  raw_max = raw_min = 0;
+  found = FALSE;
+  for (k = 0; k < num_voxels; k++) {
+    value = plane_data[k];
+    if (finite(value)) {
+      if (!found) {
+	raw_max = raw_min = value;
+	found = TRUE;
+      } else if (value > raw_max) raw_max = value;
+      else if (value < raw_min) raw_min = value;
+    }
+  }
+#else
+  /* written to let the compiler vectorize it */
+  raw_max = raw_min = plane_data[0];
+  for (k = 1; k < num_voxels; k++) {
+    value = plane_data[k];
+    raw_max = (value > raw_max) ? value : raw_max;
+    raw_min = (value < raw_min) ? value : raw_min;
+  }
+  found = TRUE;
+#endif
 
-  for (i.y = 0; i.y < dim.y; i.y++) 
-    for (i.x = 0; i.x < dim.x; i.x++) {
-      temp = AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set, i);
-      if (finite(temp)) {
-	if (temp > max) max = temp;
-	else if (temp < min) min = temp;
-      }
+  max = min = 0.0;
+  if (found) {
+    max = PLANE_SCALED_VALUE(raw_max);
+    min = PLANE_SCALED_VALUE(raw_min);
+    if (min > max) { /* negative scale factor */
+      temp = max;
+      max = min;
+      min = temp;
     }
+  }
+
+  /* the first voxel sets the starting point for the range */
+  temp = PLANE_SCALED_VALUE(plane_data[0]);
+  if (!finite(temp)) {
+    if (max < 0.0) max = 0.0;
+    if (min > 0.0) min = 0.0;
+  }
+
+  g_free(buffer);
 
   if (pmin != NULL)
     *pmin = min;
@@ -76,32 +143,199 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_s
   return;
 }
 
+/* fills values (dim.y*dim.x) with the scaled values of the given plane */
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'get_plane_values(const AmitkDataSet * data_set,
+											   const amide_intpoint_t frame,
+											   const amide_intpoint_t gate,
+											   const amide_intpoint_t z,
+											   amide_data_t * values) {
+
+  AmitkVoxel i;
+  amide_data_t plane_scale;
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  amide_data_t plane_intercept;
+')m4_dnl
+  amitk_format_`'m4_Variable_Type`'_t * plane_data;
+  gsize k, num_voxels;
+
+  i.t = frame;
+  i.g = gate;
+  i.z = z;
+  i.y = i.x = 0;
+
+  plane_scale = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->current_scaling_factor, i);
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  plane_intercept = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->internal_scaling_intercept, i);
+')m4_dnl
+  num_voxels = ((gsize) AMITK_DATA_SET_DIM_X(data_set))*AMITK_DATA_SET_DIM_Y(data_set);
+
+  if (AMITK_DATA_SET_LAYOUT(data_set) == AMITK_RAW_DATA_LAYOUT_LINEAR) {
+    plane_data = AMITK_RAW_DATA_`'m4_Variable_Type`'_POINTER(data_set->raw_data, i);
+    for (k = 0; k < num_voxels; k++)
+      values[k] = PLANE_SCALED_VALUE(plane_data[k]);
+  } else {
+    k = 0;
+    for (i.y = 0; i.y < AMITK_DATA_SET_DIM_Y(data_set); i.y++)
+      for (i.x = 0; i.x < AMITK_DATA_SET_DIM_X(data_set); i.x++, k++)
+	values[k] = PLANE_SCALED_VALUE(AMITK_RAW_DATA_`'m4_Variable_Type`'_CONTENT(data_set->raw_data, i));
+  }
+
+  return;
+}
+
+/* sets bit in mask (a dim.y by dim.x plane) for every voxel of the given plane whose
+   value lies within [min_value, max_value].  The range is moved into raw units once
+   for the plane, so the inner loop is a straight compare on the raw data. */
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'threshold_plane(const AmitkDataSet * data_set,
+											  const amide_intpoint_t frame,
+											  const amide_intpoint_t gate,
+											  const amide_intpoint_t z,
+											  const amide_data_t min_value,
+											  const amide_data_t max_value,
+											  amitk_format_UBYTE_t * mask,
+											  const amitk_format_UBYTE_t bit) {
+
+  AmitkVoxel i;
+  amide_data_t plane_scale;
+  amide_data_t plane_intercept;
+  amide_data_t raw_min, raw_max, value;
+  amitk_format_`'m4_Variable_Type`'_t * plane_data;
+  gpointer buffer=NULL;
+  gsize k, num_voxels;
+
+  i.t = frame;
+  i.g = gate;
+  i.z = z;
+  i.y = i.x = 0;
+
+  plane_scale = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->current_scaling_factor, i);
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  plane_intercept = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->internal_scaling_intercept, i);
+', `  plane_intercept = 0.0;
+')m4_dnl
+  num_voxels = ((gsize) AMITK_DATA_SET_DIM_X(data_set))*AMITK_DATA_SET_DIM_Y(data_set);
+
+  if (plane_scale == 0.0) { /* every voxel in the plane has a value of zero */
+    if ((min_value <= 0.0) && (max_value >= 0.0))
+      for (k = 0; k < num_voxels; k++)
+	mask[k] |= bit;
+    return;
+  } else if (plane_scale > 0.0) {
+    raw_min = min_value/plane_scale - plane_intercept;
+    raw_max = max_value/plane_scale - plane_intercept;
+  } else { /* negative scale factor flips the range */
+    raw_min = max_value/plane_scale - plane_intercept;
+    raw_max = min_value/plane_scale - plane_intercept;
+  }
+
+  if (AMITK_DATA_SET_LAYOUT(data_set) != AMITK_RAW_DATA_LAYOUT_LINEAR) 
+    if ((buffer = g_try_malloc(amitk_raw_data_size_plane_mem(data_set->raw_data))) == NULL) {
+      g_warning(_("couldn't allocate memory space for the plane buffer"));
+      return;
+    }
+  plane_data = amitk_raw_data_get_plane(data_set->raw_data, i, buffer);
+
+  for (k = 0; k < num_voxels; k++) {
+    value = plane_data[k];
+    if ((value >= raw_min) && (value <= raw_max))
+      mask[k] |= bit;
+  }
+
+  g_free(buffer);
+
+  return;
+}
+
+
+/* number of planes to bin at a time between progress updates, the work in
+   each batch gets spread across threads */
+#define DISTRIBUTION_BATCH_PLANES(total_planes) \
+  MAX((total_planes)/AMITK_UPDATE_DIVIDER, 4*amitk_get_num_threads())
+
+/* what the threads need to bin up a batch of planes */
+typedef struct {
+  AmitkDataSet * data_set;
+  gint first_plane;
+  amide_data_t bin_scale;
+  amide_data_t global_min;
+  guint * counts; /* AMITK_DATA_SET_DISTRIBUTION_SIZE counts per plane in the batch */
+} distribution_batch_t;
+
+static void distribution_bin_planes(const gint start, const gint end, gpointer data) {
+
+  distribution_batch_t * batch = data;
+  AmitkDataSet * data_set = batch->data_set;
+  AmitkVoxel dim;
+  AmitkVoxel i;
+  amide_data_t plane_scale;
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  amide_data_t plane_intercept;
+')m4_dnl
+  amitk_format_`'m4_Variable_Type`'_t * plane_data;
+  gpointer buffer=NULL;
+  amide_data_t bin;
+  guint * counts;
+  gsize k, num_voxels;
+  gint plane, j;
+
+  dim = AMITK_DATA_SET_DIM(data_set);
+  num_voxels = ((gsize) dim.x)*dim.y;
+
+  if (AMITK_DATA_SET_LAYOUT(data_set) != AMITK_RAW_DATA_LAYOUT_LINEAR) 
+    if ((buffer = g_try_malloc(amitk_raw_data_size_plane_mem(data_set->raw_data))) == NULL) {
+      g_warning(_("couldn't allocate memory space for the plane buffer"));
+      return;
+    }
+
+  for (j=start; j<end; j++) {
+    plane = batch->first_plane+j;
+    i.x = i.y = 0;
+    i.z = plane % dim.z;
+    i.g = (plane / dim.z) % dim.g;
+    i.t = plane / (dim.z*dim.g);
+
+    plane_data = amitk_raw_data_get_plane(data_set->raw_data, i, buffer);
+    plane_scale = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->current_scaling_factor, i);
+m4_ifelse(m4_Intercept, `INTERCEPT_', `    plane_intercept = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->internal_scaling_intercept, i);
+')m4_dnl
+    counts = batch->counts + j*AMITK_DATA_SET_DISTRIBUTION_SIZE;
+
+    for (k=0; k<num_voxels; k++) {
+      bin = batch->bin_scale*(PLANE_SCALED_VALUE(plane_data[k])-batch->global_min);
+      /* written so that non-finite values fall through */
+      if ((bin >= 0.0) && (bin < AMITK_DATA_SET_DISTRIBUTION_SIZE))
+	counts[(gint) bin]++;
+    }
+  }
+
+  g_free(buffer);
+
+  return;
+}
+
 /* generate the distribution array for a data_set */
 void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_distribution(AmitkDataSet * data_set,
 									    AmitkUpdateFunc update_func,
 									    gpointer update_data) {
 
-  AmitkVoxel i,j;
-  amide_data_t scale, diff;
+  AmitkVoxel j;
+  amide_data_t diff;
   AmitkVoxel distribution_dim;
-  AmitkVoxel data_set_dim;
   gchar * temp_string;
-  div_t x;
-  gint divider;
   gint total_planes;
   gint i_plane;
+  gint batch_planes, num_planes;
+  gint k;
   gboolean continue_work=TRUE;
   AmitkRawData * distribution;
+  distribution_batch_t batch;
 
   if (data_set->distribution != NULL)
     return;
 
-  data_set_dim = AMITK_DATA_SET_DIM(data_set);
   diff = amitk_data_set_get_global_max(data_set) - amitk_data_set_get_global_min(data_set);
   if (diff == 0.0)
-    scale = 0.0;
+    batch.bin_scale = 0.0;
   else
-    scale = (AMITK_DATA_SET_DISTRIBUTION_SIZE-1)/diff;
+    batch.bin_scale = (AMITK_DATA_SET_DISTRIBUTION_SIZE-1)/diff;
+  batch.global_min = amitk_data_set_get_global_min(data_set);
+  batch.data_set = data_set;
   
   distribution_dim.x = AMITK_DATA_SET_DISTRIBUTION_SIZE;
   distribution_dim.y = distribution_dim.z = distribution_dim.g = distribution_dim.t = 1;
@@ -114,34 +348,38 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
   /* initialize the distribution array */
   amitk_raw_data_DOUBLE_initialize_data(distribution, 0.0);
   
+  total_planes = AMITK_DATA_SET_TOTAL_PLANES(data_set);
+  batch_planes = MIN(DISTRIBUTION_BATCH_PLANES(total_planes), total_planes);
+  batch.counts = g_try_new(guint, batch_planes*AMITK_DATA_SET_DISTRIBUTION_SIZE);
+  if (batch.counts == NULL) {
+    g_warning(_("couldn't allocate memory space for the data set structure to hold distribution data"));
+    g_object_unref(distribution);
+    return;
+  }
+
   if (update_func != NULL) {
     temp_string = g_strdup_printf(_("Generating distribution data for:\n   %s"), AMITK_OBJECT_NAME(data_set));
     continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
     g_free(temp_string);
   }
-  total_planes = AMITK_DATA_SET_TOTAL_PLANES(data_set);
-  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
 
-  /* now "bin" the data */
+  /* now "bin" the data, a batch of planes at a time */
   j = zero_voxel;
-  i_plane=0;
-  for (i.t = 0; (i.t < data_set_dim.t) && continue_work; i.t++) {
-    for (i.g = 0; (i.g < data_set_dim.g) && continue_work; i.g++) {
-      for ( i.z = 0; (i.z < data_set_dim.z) && continue_work; i.z++, i_plane++) {
-	if (update_func != NULL) {
-	  x = div(i_plane,divider);
-	  if (x.rem == 0)
-	    continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
-	}
-
-	for (i.y = 0; i.y < data_set_dim.y; i.y++) 
-	  for (i.x = 0; i.x < data_set_dim.x; i.x++) {
-	    j.x = scale*(AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,i)-amitk_data_set_get_global_min(data_set));
-	    AMITK_RAW_DATA_DOUBLE_SET_CONTENT(distribution,j) += 1.0;
-	  }
-      }
-    }
+  for (i_plane=0; (i_plane < total_planes) && continue_work; i_plane += num_planes) {
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
+
+    num_planes = MIN(batch_planes, total_planes-i_plane);
+    batch.first_plane = i_plane;
+    memset(batch.counts, 0, sizeof(guint)*num_planes*AMITK_DATA_SET_DISTRIBUTION_SIZE);
+    amitk_parallel_for(num_planes, 1, distribution_bin_planes, &batch);
+
+    for (k=0; k<num_planes; k++)
+      for (j.x=0; j.x < AMITK_DATA_SET_DISTRIBUTION_SIZE; j.x++)
+	AMITK_RAW_DATA_DOUBLE_SET_CONTENT(distribution,j) += 
+	  batch.counts[k*AMITK_DATA_SET_DISTRIBUTION_SIZE+j.x];
   }
+  g_free(batch.counts);
 
   if (update_func != NULL) /* remove progress bar */
     continue_work = (*update_func)(update_data, NULL, (gdouble) 2.0); 
@@ -163,6 +401,495 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
 }
 
 
+/* what the threads need to build a frame of a reduced resolution data set */
+typedef struct {
+  AmitkDataSet * data_set;
+  AmitkDataSet * reduced;
+  amide_intpoint_t frame;
+  gint start_plane;
+} reduce_frame_t;
+
+/* each reduced voxel is the average of the (up to) 2x2x2 block of data set 
+   voxels it covers, with non-finite voxels left out.  Does reduced planes 
+   start through end-1 past job->start_plane, counting through the planes 
+   of all the gates */
+static void reduce_frame_planes(const gint start, const gint end, gpointer data) {
+
+  reduce_frame_t * job = data;
+  AmitkDataSet * data_set = job->data_set;
+  AmitkVoxel i, j, dim, reduced_dim;
+  amitk_format_FLOAT_t * reduced_data;
+  amitk_format_`'m4_Variable_Type`'_t * block_data[2];
+  gpointer buffers[2] = {NULL, NULL};
+  amide_data_t block_scale[2];
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  amide_data_t block_intercept[2];
+  amide_data_t plane_intercept;
+')m4_dnl
+  amide_data_t plane_scale;
+  amide_data_t sum, value;
+  gint count, num_planes, l;
+  gint plane;
+  gsize offset;
+
+  dim = AMITK_DATA_SET_DIM(data_set);
+  reduced_dim = AMITK_DATA_SET_DIM(job->reduced);
+
+  if (AMITK_DATA_SET_LAYOUT(data_set) != AMITK_RAW_DATA_LAYOUT_LINEAR) 
+    for (l = 0; l < 2; l++)
+      if ((buffers[l] = g_try_malloc(amitk_raw_data_size_plane_mem(data_set->raw_data))) == NULL) {
+	g_warning(_("couldn't allocate memory space for the plane buffer"));
+	g_free(buffers[0]);
+	return;
+      }
+
+  for (plane = job->start_plane+start; plane < job->start_plane+end; plane++) {
+    i.t = job->frame;
+    i.g = plane / reduced_dim.z;
+    i.z = plane % reduced_dim.z;
+    i.y = i.x = 0;
+    reduced_data = AMITK_RAW_DATA_FLOAT_POINTER(job->reduced->raw_data, i);
+
+    /* the data set planes that go into this reduced plane */
+    j = i;
+    num_planes = 0;
+    for (j.z = 2*i.z; (j.z < 2*i.z+2) && (j.z < dim.z); j.z++, num_planes++) {
+      block_data[num_planes] = amitk_raw_data_get_plane(data_set->raw_data, j, buffers[num_planes]);
+      block_scale[num_planes] = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->current_scaling_factor, j);
+m4_ifelse(m4_Intercept, `INTERCEPT_', `      block_intercept[num_planes] = *AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->internal_scaling_intercept, j);
+')m4_dnl
+    }
+
+    for (i.y = 0; i.y < reduced_dim.y; i.y++)
+      for (i.x = 0; i.x < reduced_dim.x; i.x++) {
+	sum = 0.0;
+	count = 0;
+	for (l = 0; l < num_planes; l++) {
+	  plane_scale = block_scale[l];
+m4_ifelse(m4_Intercept, `INTERCEPT_', `	  plane_intercept = block_intercept[l];
+')m4_dnl
+	  for (j.y = 2*i.y; (j.y < 2*i.y+2) && (j.y < dim.y); j.y++)
+	    for (j.x = 2*i.x; (j.x < 2*i.x+2) && (j.x < dim.x); j.x++) {
+	      offset = ((gsize) j.y)*dim.x + j.x;
+	      value = PLANE_SCALED_VALUE(block_data[l][offset]);
+	      if (finite(value)) {
+		sum += value;
+		count++;
+	      }
+	    }
+	}
+	*reduced_data = (count > 0) ? sum/count : NAN;
+	reduced_data++;
+      }
+  }
+
+  g_free(buffers[0]);
+  g_free(buffers[1]);
+
+  return;
+}
+
+/* fills in planes start_plane through end_plane-1 of the given frame of a reduced
+   resolution copy of the data set, with the planes of all the gates counted one 
+   after the other.  The reduced data set should be FLOAT with 0D scaling, and have
+   dimensions of half the data set's (rounded up) in x, y, and z */
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'reduce_frame(AmitkDataSet * data_set,
+										   const amide_intpoint_t frame,
+										   const gint start_plane,
+										   const gint end_plane,
+										   AmitkDataSet * reduced) {
+
+  reduce_frame_t job;
+
+  g_return_if_fail(start_plane >= 0);
+  g_return_if_fail(end_plane <= AMITK_DATA_SET_DIM_Z(reduced)*AMITK_DATA_SET_DIM_G(reduced));
+
+  job.data_set = data_set;
+  job.reduced = reduced;
+  job.frame = frame;
+  job.start_plane = start_plane;
+
+  if (end_plane > start_plane)
+    amitk_parallel_for(end_plane-start_plane, 1, reduce_frame_planes, &job);
+
+  return;
+}
+
+#undef PLANE_SCALED_VALUE
+
+
+
+/* number of slice rows handed out to a worker thread at a time, this is fixed
+   (instead of depending on the number of threads) so that the results don't
+   depend on how many processors we're running on */
+#define SLICE_TILE_ROWS 16
+
+/* whether a point in (non-integer) voxel units lands in the data set, this 
+   is equivalent to casting to amide_intpoint_t and calling amitk_raw_data_includes_voxel, 
+   but doesn't overflow for points far outside of the data set */
+#define VOXEL_POINT_IN_DIM(point, dim) (((point).x > -1.0) && ((point).x < (dim).x) && \
+					((point).y > -1.0) && ((point).y < (dim).y) && \
+					((point).z > -1.0) && ((point).z < (dim).z))
+
+/* get_slice pulls raw values straight out of the current frame/gate.  With 0D and 1D 
+   scaling the scale factor and intercept are constant over a frame/gate, so the raw
+   values are interpolated as is, and the scaling gets applied once per slice voxel 
+   (PIXEL_VALUE).  With 2D scaling they change plane by plane, so they're applied to 
+   each data set voxel we read (VOXEL_VALUE) */
+m4_ifelse(m4_Intercept, `INTERCEPT_', `
+#define SCALED_VALUE(raw, iz) (frame_scale[iz]*(((amide_data_t) (raw)) + frame_intercept[iz]))
+', `
+#define SCALED_VALUE(raw, iz) (frame_scale[iz]*((amide_data_t) (raw)))
+')
+#if defined(DIM_TYPE_2D_SCALING)
+#define VOXEL_VALUE(raw, iz) SCALED_VALUE(raw, iz)
+#define PIXEL_VALUE(value) (value)
+#else
+#define VOXEL_VALUE(raw, iz) ((amide_data_t) (raw))
+#define PIXEL_VALUE(value) SCALED_VALUE(value, 0)
+#endif
+
+/* offset of voxel (x,y,z) from the start of a frame/gate's data, in get_slice_rows */
+#define FRAME_OFFSET(ix,iy,iz) (bricked ? amitk_raw_data_brick_offset(dim, (iz), (iy), (ix)) : \
+				((iz)*((gsize) dim.y) + (iy))*dim.x + (ix))
+
+/* everything a worker thread needs to fill in part of a slice */
+typedef struct {
+  AmitkDataSet * data_set;
+  AmitkDataSet * slice;
+  amide_intpoint_t gate;
+  amide_intpoint_t start_frame;
+  amide_intpoint_t end_frame;
+  amide_data_t * time_weights; /* weight of each frame, start_frame through end_frame */
+  gint num_gates;
+  amide_real_t z_steps;
+  AmitkVoxel start;
+  AmitkVoxel end;
+  AmitkPoint origin; /* center of slice voxel (start.x, start.y, 0), in data set voxel units */
+  AmitkPoint step[AMITK_AXIS_NUM]; /* a one voxel step in the slice, in data set voxel units */
+  amide_data_t * weights;
+  amide_data_t * intermediate_data;
+} slice_tile_t;
+
+
+/* linear interpolation between two neighboring values where either may be empty (NAN).
+   if one's empty, we go with whichever one we're closer to */
+static inline amide_data_t lerp_with_empties(const amide_data_t value0, 
+					     const amide_data_t value1, 
+					     const amide_real_t frac) {
+  if (isnan(value0))
+    return (frac >= 0.5) ? value1 : value0;
+  else if (isnan(value1))
+    return (frac > 0.5) ? NAN : value0;
+  else
+    return value0*(1.0-frac) + value1*frac;
+}
+
+/* fills in rows start_row through end_row-1 (counted from tile->start.y) of the slice. 
+   Each row is only ever touched by one thread, and all the frames, gates, and planes 
+   for a row are summed in the same order as a single threaded pass would.
+
+   A row is finished off (all frames, gates, and planes) before moving onto the next, 
+   so its sums stay in cache.  For thick sagittal and coronal slices, the planes
+   of a row also lie next to each other in the data set, so the data set's cache
+   lines and pages get reused between planes instead of being reloaded for each one.
+   With the bricked layout, steps along y and z stay within the same few cache lines
+   as steps along x do, so the row walk costs about the same in any orientation.
+
+   The slice to data set mapping is affine, so instead of transforming each slice voxel
+   we figure out where each row starts in the data set's voxel coordinates, and then 
+   just add tile->step[AMITK_AXIS_X] as we walk along the row */
+static void get_slice_rows(const gint start_row, const gint end_row, gpointer data) {
+
+  slice_tile_t * tile = data;
+  AmitkDataSet * data_set = tile->data_set;
+  AmitkDataSet * slice = tile->slice;
+  AmitkVoxel i_voxel;
+  amide_intpoint_t z;
+  guint k, l, start_k;
+  amide_data_t weight;
+  amide_data_t time_weight;
+  amide_intpoint_t i_gate;
+  guint row_k, width;
+  AmitkVoxel box_voxel[8];
+  amide_data_t box_value[8];
+  amide_data_t box_weight[8];
+  gsize box_offset[8];
+  gsize box_index[8];
+  amide_real_t x_weight[2], y_weight[2], z_weight[2];
+  amide_data_t value;
+  AmitkVoxel start, end;
+  AmitkVoxel ds_voxel;
+  AmitkVoxel dim;
+  AmitkPoint ds_point, frac;
+  amide_real_t row, plane;
+  amide_data_t * weights;
+  amide_data_t * intermediate_data;
+  amitk_format_`'m4_Variable_Type`'_t * frame_data;
+  amide_data_t * frame_scale;
+m4_ifelse(m4_Intercept, `INTERCEPT_', `  amide_data_t * frame_intercept;
+')m4_dnl
+  gsize offset, plane_size;
+  gint num_z;
+  gboolean empties;
+  gboolean bricked;
+
+  /* the rows we're responsible for */
+  start = tile->start;
+  end = tile->end;
+  start.y = tile->start.y + start_row;
+  end.y = tile->start.y + end_row - 1;
+  width = end.x-start.x+1;
+  start_k = start_row*width;
+
+  num_z = ceil(tile->z_steps);
+  weights = tile->weights;
+  intermediate_data = tile->intermediate_data;
+  dim = AMITK_DATA_SET_DIM(data_set);
+  plane_size = ((gsize) dim.y)*dim.x;
+  bricked = (AMITK_DATA_SET_LAYOUT(data_set) == AMITK_RAW_DATA_LAYOUT_BRICKED);
+
+  /* offsets to the 8 neighbors used for trilinear interpolation, linear layout only */
+  for (l=0; l<8; l=l+1)
+    box_offset[l] = (l & 0x1) + ((l >> 1) & 0x1)*dim.x + ((l >> 2) & 0x1)*plane_size;
+
+  for (i_voxel.y = start.y, row_k = start_k; i_voxel.y <= end.y; i_voxel.y++, row_k += width) {
+    row = i_voxel.y - tile->start.y;
+
+    for (ds_voxel.t = tile->start_frame; ds_voxel.t <= tile->end_frame; ds_voxel.t++) {
+      time_weight = tile->time_weights[ds_voxel.t-tile->start_frame];
+    
+      for (i_gate=0; i_gate < tile->num_gates; i_gate++) {
+	if (tile->gate < 0)
+	  ds_voxel.g = i_gate+AMITK_DATA_SET_VIEW_START_GATE(data_set);
+	else
+	  ds_voxel.g = i_gate+tile->gate;
+      
+	if (ds_voxel.g >= AMITK_DATA_SET_NUM_GATES(data_set))
+	  ds_voxel.g -= AMITK_DATA_SET_NUM_GATES(data_set);
+
+	/* get pointers to the start of this frame/gate's data and scaling factors */
+	ds_voxel.x = ds_voxel.y = ds_voxel.z = 0;
+	frame_data = AMITK_RAW_DATA_`'m4_Variable_Type`'_POINTER(data_set->raw_data, ds_voxel);
+	frame_scale = AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->current_scaling_factor, ds_voxel);
+m4_ifelse(m4_Intercept, `INTERCEPT_', `	frame_intercept = AMITK_RAW_DATA_DOUBLE_`'m4_Scale_Dim`'_POINTER(data_set->internal_scaling_intercept, ds_voxel);
+')m4_dnl
+
+	/* iterate over the number of planes we'll be compressing into this slice */
+	for (z = 0; z < num_z; z++) {
+	  plane = z;
+	
+	  /* weight is between 0 and 1, this is used to weight the last voxel in the slice's z direction */
+	  if (floor(tile->z_steps) > z)
+	    weight = time_weight/tile->z_steps;
+	  else
+	    weight = time_weight*(tile->z_steps-floor(tile->z_steps)) / tile->z_steps;
+
+	  /* where this row starts in the data set */
+	  k = row_k;
+	  ds_point.x = tile->origin.x + row*tile->step[AMITK_AXIS_Y].x + plane*tile->step[AMITK_AXIS_Z].x;
+	  ds_point.y = tile->origin.y + row*tile->step[AMITK_AXIS_Y].y + plane*tile->step[AMITK_AXIS_Z].y;
+	  ds_point.z = tile->origin.z + row*tile->step[AMITK_AXIS_Y].z + plane*tile->step[AMITK_AXIS_Z].z;
+
+	  switch(data_set->interpolation) {
+	  case AMITK_INTERPOLATION_TRILINEAR:
+
+	    /* shift by half a voxel so that voxel centers land on integer coordinates */
+	    ds_point.x -= 0.5;
+	    ds_point.y -= 0.5;
+	    ds_point.z -= 0.5;
+
+	    for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) {
+
+	      if ((ds_point.x < -1.0) || (ds_point.x >= dim.x) ||
+		  (ds_point.y < -1.0) || (ds_point.y >= dim.y) ||
+		  (ds_point.z < -1.0) || (ds_point.z >= dim.z)) {
+		/* none of the neighbors are in the data set */
+		value = NAN;
+		empties = TRUE;
+
+	      } else {
+		/* the lower corner of the box of neighbors, casting truncates towards zero so 
+		   need to correct for that between -1 and 0 */
+		ds_voxel.x = ds_point.x;
+		ds_voxel.y = ds_point.y;
+		ds_voxel.z = ds_point.z;
+		if (ds_voxel.x > ds_point.x) ds_voxel.x--;
+		if (ds_voxel.y > ds_point.y) ds_voxel.y--;
+		if (ds_voxel.z > ds_point.z) ds_voxel.z--;
+		POINT_SUB(ds_point, ds_voxel, frac);
+
+		if ((ds_voxel.x >= 0) && (ds_voxel.x+1 < dim.x) &&
+		    (ds_voxel.y >= 0) && (ds_voxel.y+1 < dim.y) &&
+		    (ds_voxel.z >= 0) && (ds_voxel.z+1 < dim.z)) { /* faster */
+		  empties = FALSE;
+		  if (bricked) {
+		    for (l=0; l<8; l=l+1)
+		      box_index[l] = amitk_raw_data_brick_offset(dim, ds_voxel.z + ((l >> 2) & 0x1),
+								 ds_voxel.y + ((l >> 1) & 0x1),
+								 ds_voxel.x + (l & 0x1));
+		  } else {
+		    offset = (ds_voxel.z*((gsize) dim.y) + ds_voxel.y)*dim.x + ds_voxel.x;
+		    for (l=0; l<8; l=l+1)
+		      box_index[l] = offset+box_offset[l];
+		  }
+
+		  /* the weights and the sum are kept as flat loops over the 8 
+		     neighbors so that the compiler can vectorize them */
+		  x_weight[0] = 1.0-frac.x;  x_weight[1] = frac.x;
+		  y_weight[0] = 1.0-frac.y;  y_weight[1] = frac.y;
+		  z_weight[0] = 1.0-frac.z;  z_weight[1] = frac.z;
+		  for (l=0; l<8; l=l+1)
+		    box_weight[l] = x_weight[l & 0x1]*y_weight[(l >> 1) & 0x1]*z_weight[(l >> 2) & 0x1];
+		  for (l=0; l<8; l=l+1)
+		    box_value[l] = VOXEL_VALUE(frame_data[box_index[l]], ds_voxel.z + ((l >> 2) & 0x1));
+		  value = 0.0;
+		  for (l=0; l<8; l=l+1)
+		    value += box_weight[l]*box_value[l];
+		  value = PIXEL_VALUE(value);
+
+		} else { /* slow algorithm - checking for empties */
+		  empties = TRUE;
+
+		  for (l=0; l<8; l=l+1) {
+		    box_voxel[l].x = ds_voxel.x + (l & 0x1);
+		    box_voxel[l].y = ds_voxel.y + ((l >> 1) & 0x1);
+		    box_voxel[l].z = ds_voxel.z + ((l >> 2) & 0x1);
+		    if ((box_voxel[l].x >= 0) && (box_voxel[l].x < dim.x) &&
+			(box_voxel[l].y >= 0) && (box_voxel[l].y < dim.y) &&
+			(box_voxel[l].z >= 0) && (box_voxel[l].z < dim.z)) {
+		      offset = FRAME_OFFSET(box_voxel[l].x, box_voxel[l].y, box_voxel[l].z);
+		      box_value[l] = VOXEL_VALUE(frame_data[offset], box_voxel[l].z);
+		    } else
+		      box_value[l] = NAN;
+		  }
+
+		  /* interpolate along x, then y, then z */
+		  for (l=0;l<8;l=l+2)
+		    box_value[l] = lerp_with_empties(box_value[l], box_value[l+1], frac.x);
+		  for (l=0;l<8;l=l+4)
+		    box_value[l] = lerp_with_empties(box_value[l], box_value[l+2], frac.y);
+		  value = PIXEL_VALUE(lerp_with_empties(box_value[0], box_value[4], frac.z));
+		}
+	      }
+
+	      /* separate into MPR/MIP/minIP algorithms */
+	      if (data_set->rendering == AMITK_RENDERING_MPR) { /* MPR */
+		if (!empties || !isnan(value)) {
+		  intermediate_data[k] += weight*value;
+		  weights[k] += weight;
+		}
+	      } else { /* MIP or MINIP */
+		if ((z == 0) && (ds_voxel.t == tile->start_frame) && (i_gate == 0)) 
+		  intermediate_data[k]=value;
+		else if (data_set->rendering == AMITK_RENDERING_MIP)  /* MIP */
+		  intermediate_data[k] = empties ? MAX(value, intermediate_data[k]) : MAX(intermediate_data[k], value);
+		else  /* MINIP */
+		  intermediate_data[k] = empties ? MIN(value, intermediate_data[k]) : MIN(intermediate_data[k], value);
+	      }
+	      
+	      POINT_ADD(ds_point, tile->step[AMITK_AXIS_X], ds_point);
+	    } /* x */
+	    break;
+
+	  case AMITK_INTERPOLATION_NEAREST_NEIGHBOR:
+	  default:  
+	    /* separate into MPR and MIP/MINIP algorithms. A fair amount
+	       of code is duplicated within the algorithms. The reason
+	       they aren't combined is to keep the MPR vs MIP/MINIP branch
+	       point out of the x loop and speed things up slightly for the
+	       most commonly used selection (MPR) */
+	    switch(data_set->rendering) {
+	    case AMITK_RENDERING_MPR:
+	      for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++, k++) { 
+		if (VOXEL_POINT_IN_DIM(ds_point, dim)) {
+		  ds_voxel.x = ds_point.x;
+		  ds_voxel.y = ds_point.y;
+		  ds_voxel.z = ds_point.z;
+		  offset = FRAME_OFFSET(ds_voxel.x, ds_voxel.y, ds_voxel.z);
+		  intermediate_data[k] += weight*PIXEL_VALUE(VOXEL_VALUE(frame_data[offset], ds_voxel.z));
+		  weights[k] += weight;
+		}
+		POINT_ADD(ds_point, tile->step[AMITK_AXIS_X], ds_point); 
+	      } /* x */
+	      break;
+
+	    case AMITK_RENDERING_MIP:
+	    case AMITK_RENDERING_MINIP:
+	      /* need to initialize based on the first plane we encounter */
+	      if ((z == 0) && (ds_voxel.t == tile->start_frame) && (i_gate == 0)) {
+		for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) {
+		  if (!VOXEL_POINT_IN_DIM(ds_point, dim))
+		    intermediate_data[k] = NAN;
+		  else {
+		    ds_voxel.x = ds_point.x;
+		    ds_voxel.y = ds_point.y;
+		    ds_voxel.z = ds_point.z;
+		    offset = FRAME_OFFSET(ds_voxel.x, ds_voxel.y, ds_voxel.z);
+		    intermediate_data[k] = PIXEL_VALUE(VOXEL_VALUE(frame_data[offset], ds_voxel.z));
+		  }
+		  POINT_ADD(ds_point, tile->step[AMITK_AXIS_X], ds_point); 
+		} /* x */
+
+	      } else if (data_set->rendering == AMITK_RENDERING_MIP) {
+		for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) { 
+		  if (VOXEL_POINT_IN_DIM(ds_point, dim)) {
+		    ds_voxel.x = ds_point.x;
+		    ds_voxel.y = ds_point.y;
+		    ds_voxel.z = ds_point.z;
+		    offset = FRAME_OFFSET(ds_voxel.x, ds_voxel.y, ds_voxel.z);
+		    value = PIXEL_VALUE(VOXEL_VALUE(frame_data[offset], ds_voxel.z));
+		    intermediate_data[k] = MAX(intermediate_data[k], value);
+		  }
+		  POINT_ADD(ds_point, tile->step[AMITK_AXIS_X], ds_point); 
+		} /* x */
+
+	      } else { /* AMITK_RENDERING_MINIP */
+		for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) { 
+		  if (VOXEL_POINT_IN_DIM(ds_point, dim)) {
+		    ds_voxel.x = ds_point.x;
+		    ds_voxel.y = ds_point.y;
+		    ds_voxel.z = ds_point.z;
+		    offset = FRAME_OFFSET(ds_voxel.x, ds_voxel.y, ds_voxel.z);
+		    value = PIXEL_VALUE(VOXEL_VALUE(frame_data[offset], ds_voxel.z));
+		    intermediate_data[k] = MIN(intermediate_data[k], value);
+		  }
+		  POINT_ADD(ds_point, tile->step[AMITK_AXIS_X], ds_point); 
+		} /* x */
+	      } /* end else, MIP vs MINIP */
+	      break;
+
+	    default:
+	      break;
+	    } /* MIP vs NON-MIP */
+	    break;
+	  } /* interpolation */
+	} /* z */
+      } /* iterating over gates */
+    } /* iterating over frames */
+  } /* y */
+
+  /* fill in data/normalize if needed */
+  i_voxel.t = i_voxel.g = i_voxel.z = 0;
+  if (data_set->rendering == AMITK_RENDERING_MPR) {
+    for (i_voxel.y = start.y,k=start_k; i_voxel.y <= end.y; i_voxel.y++) 
+      for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) 
+	if (weights[k] > 0)
+	  AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = intermediate_data[k]/weights[k];
+	else
+	  AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = NAN;
+  } else { /* MIP or MINIP */
+    for (i_voxel.y = start.y,k=start_k; i_voxel.y <= end.y; i_voxel.y++) 
+      for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) 
+	AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = intermediate_data[k];
+  }
+
+  return;
+}
+
+#undef SCALED_VALUE
+#undef VOXEL_VALUE
+#undef PIXEL_VALUE
+#undef FRAME_OFFSET
 
 
 /* returns a slice  with the appropriate data from the data_set */
@@ -178,36 +905,26 @@ AmitkDataSet * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Interce
 
   AmitkDataSet * slice = NULL;
   AmitkVoxel i_voxel;
-  amide_intpoint_t z;
-  amide_real_t max_diff, voxel_length, z_steps;
+  amide_real_t voxel_length, z_steps;
   AmitkPoint alt;
-  AmitkPoint stride[AMITK_AXIS_NUM], last[AMITK_AXIS_NUM];
   AmitkAxis i_axis;
-  guint k, l;
-  amide_data_t weight;
-  amide_data_t time_weight;
   amide_intpoint_t start_frame, end_frame;
-  amide_intpoint_t i_gate;
   amide_time_t end_time;
-  AmitkPoint box_point[8];
-  AmitkVoxel box_voxel[8];
   AmitkVoxel start, end;
-  amide_data_t box_value[8];
-  AmitkPoint slice_point, ds_point,start_point,diff, nearest_point;
   AmitkSpace * slice_space;
   AmitkSpace * data_set_space;
 #if AMIDE_DEBUG
   gchar * temp_string;
   AmitkPoint center_point;
 #endif
-  AmitkVoxel ds_voxel;
-  amide_data_t weight1, weight2;
   amide_data_t * weights=NULL;
   amide_data_t * intermediate_data=NULL;
+  amide_data_t * time_weights=NULL;
+  amide_intpoint_t i_frame;
   AmitkCorners intersection_corners;
   AmitkVoxel dim;
   gint num_gates;
-  gboolean empties=FALSE;
+  slice_tile_t tile;
 
   /* ----- figure out what frames of this data set to include ----*/
   end_time = start_time+duration;
@@ -220,6 +937,23 @@ AmitkDataSet * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Interce
   else
     num_gates = 1;
 
+  /* how much each frame counts for */
+  if ((time_weights = g_try_new(amide_data_t, end_frame-start_frame+1)) == NULL) {
+    g_warning(_("couldn't allocate memory space for the frame weights"));
+    goto error;
+  }
+  for (i_frame = start_frame; i_frame <= end_frame; i_frame++) {
+    if (end_frame-start_frame > 0) { /* averaging over more then one frame */
+      if (i_frame == start_frame)
+	time_weights[i_frame-start_frame] = (amitk_data_set_get_end_time(data_set, start_frame)-start_time)/(duration*num_gates);
+      else if (i_frame == end_frame)
+	time_weights[i_frame-start_frame] = (end_time-amitk_data_set_get_start_time(data_set, end_frame))/(duration*num_gates);
+      else
+	time_weights[i_frame-start_frame] = amitk_data_set_get_frame_duration(data_set, i_frame)/(duration*num_gates);
+    } else
+      time_weights[i_frame-start_frame] = 1.0/((gdouble) num_gates);
+  }
+
   /* ------------------------- */
 
   dim.x = ceil(fabs(AMITK_VOLUME_X_CORNER(slice_volume))/pixel_size.x);
@@ -249,9 +983,7 @@ AmitkDataSet * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Interce
     goto error;
   }
 
-  slice->slice_parent = data_set;
-  g_object_add_weak_pointer(G_OBJECT(data_set), 
-			    (gpointer *) &(slice->slice_parent));
+  amitk_data_set_set_slice_parent(slice, data_set);
   slice->voxel_size.x = pixel_size.x;
   slice->voxel_size.y = pixel_size.y;
   slice->voxel_size.z = AMITK_VOLUME_Z_CORNER(slice_volume);
@@ -344,397 +1076,48 @@ AmitkDataSet * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Interce
     for (i_voxel.y = 0; i_voxel.y < dim.y; i_voxel.y++) 
       AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = NAN;
 
-
-  switch(data_set->interpolation) {
-    
-  case AMITK_INTERPOLATION_TRILINEAR:
-
-    /* iterate over the frames we'll be incorporating into this slice */
-    for (ds_voxel.t = start_frame; ds_voxel.t <= end_frame; ds_voxel.t++) {
-      
-      /* averaging over more then one frame */
-      if (end_frame-start_frame > 0) {
-	if (ds_voxel.t == start_frame)
-	  time_weight = (amitk_data_set_get_end_time(data_set, start_frame)-start_time)/(duration*num_gates);
-	else if (ds_voxel.t == end_frame)
-	  time_weight = (end_time-amitk_data_set_get_start_time(data_set, end_frame))/(duration*num_gates);
-	else
-	  time_weight = amitk_data_set_get_frame_duration(data_set, ds_voxel.t)/(duration*num_gates);
-      } else
-	time_weight = 1.0/((gdouble) num_gates);
-      
-      for (i_gate=0; i_gate < num_gates; i_gate++) {
-	if (gate < 0)
-	  ds_voxel.g = i_gate+AMITK_DATA_SET_VIEW_START_GATE(data_set);
-	else
-	  ds_voxel.g = i_gate+gate;
-	
-	if (ds_voxel.g >= AMITK_DATA_SET_NUM_GATES(data_set))
-	  ds_voxel.g -= AMITK_DATA_SET_NUM_GATES(data_set);
-
-	/* initialize the .t/.g components of box_voxel */
-	for (l=0; l<8; l=l+1) {
-	  box_voxel[l].t = ds_voxel.t;
-	  box_voxel[l].g = ds_voxel.g;
-	}
-
-	/* iterate over the number of planes we'll be compressing into this slice */
-	for (z = 0; z < ceil(z_steps); z++) {
-	  
-	  /* the slices z_coordinate for this iteration's slice voxel */
-	  if (ceil(z_steps) > 1.0)
-	    slice_point.z = (z+0.5)*voxel_length;
-	  else
-	    slice_point.z = (0.5)*slice->voxel_size.z; /* only one iteration in z */
-	  
-	  /* weight is between 0 and 1, this is used to weight the last voxel in the slice's z direction */
-	  if (floor(z_steps) > z)
-	    weight = time_weight/z_steps;
-	  else
-	    weight = time_weight*(z_steps-floor(z_steps)) / z_steps;
-	  
-	  /* iterate over the y dimension */
-	  for (i_voxel.y = start.y,k=0; i_voxel.y <= end.y; i_voxel.y++) {
-	    
-	    /* the slice y_coordinate of the center of this iteration's slice voxel */
-	    slice_point.y = (((amide_real_t) i_voxel.y)+0.5)*slice->voxel_size.y;
-	    
-	    /* the slice x coord of the center of the first slice voxel in this loop */
-	    slice_point.x = (((amide_real_t) start.x)+0.5)*slice->voxel_size.x;
-	    
-	    /* iterate over the x dimension */
-	    for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) {
-	      
-	      /* translate the current point in slice space into the data set's coordinate frame */
-	      ds_point = amitk_space_s2s(slice_space, data_set_space, slice_point);
-	      
-	      /* get the nearest neighbor in the data set to this slice voxel */
-	      POINT_TO_VOXEL_COORDS_ONLY(ds_point, data_set->voxel_size, ds_voxel);
-	      VOXEL_TO_POINT(ds_voxel, data_set->voxel_size, nearest_point);
-	      
-	      /* figure out which way to go to get the nearest voxels to our slice voxel*/
-	      POINT_SUB(ds_point, nearest_point, diff);
-	      
-	      /* figure out which voxels to look at */
-	      for (l=0; l<8; l=l+1) {
-		if (diff.x < 0)
-		  box_voxel[l].x = (l & 0x1) ? ds_voxel.x-1 : ds_voxel.x;
-		else /* diff.x >= 0 */
-		  box_voxel[l].x = (l & 0x1) ? ds_voxel.x : ds_voxel.x+1;
-		if (diff.y < 0)
-		  box_voxel[l].y = (l & 0x2) ? ds_voxel.y-1 : ds_voxel.y;
-		else /* diff.y >= 0 */
-		  box_voxel[l].y = (l & 0x2) ? ds_voxel.y : ds_voxel.y+1;
-		if (diff.z < 0)
-		  box_voxel[l].z = (l & 0x4) ? ds_voxel.z-1 : ds_voxel.z;
-		else /* diff.z >= 0 */
-		  box_voxel[l].z = (l & 0x4) ? ds_voxel.z : ds_voxel.z+1;
-		
-		VOXEL_TO_POINT(box_voxel[l], data_set->voxel_size, box_point[l]);
-		
-		/* get the value of the point on the box */
-		if (amitk_raw_data_includes_voxel(data_set->raw_data, box_voxel[l]))
-		  box_value[l] = AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set, box_voxel[l]);
-		else {
-		  box_value[l] = NAN;
-		  empties = TRUE;
-		}
-	      }
-	      
-	      if (empties) { /* slow algorithm - checking for empties */
-		/* reset value */
-		empties = FALSE; 
-
-		/* do the x direction linear interpolation of the sets of two points */
-		for (l=0;l<8;l=l+2) {
-		  max_diff = box_point[l+1].x-box_point[l].x;
-		  weight1 = ((max_diff - (ds_point.x - box_point[l].x))/max_diff);
-		  weight2 = ((max_diff - (box_point[l+1].x - ds_point.x))/max_diff);
-		  if (isnan(box_value[l])) {
-		    if (weight2 >= weight1)
-		      box_value[l] = box_value[l+1];
-		    /* else box_value[l] left as is (NAN/empty) */
-		  } else if (isnan(box_value[l+1])) {
-		    if (weight1 < weight2)
-		      box_value[l] = NAN;
-		    /* else box_value[l] left as is */
-		  } else
-		    box_value[l] = (box_value[l] * weight1) + (box_value[l+1] * weight2);
-		}
-		
-		/* do the y direction linear interpolation of the sets of two points */
-		for (l=0;l<8;l=l+4) {
-		  max_diff = box_point[l+2].y-box_point[l].y;
-		  weight1 = ((max_diff - (ds_point.y - box_point[l].y))/max_diff);
-		  weight2 = ((max_diff - (box_point[l+2].y - ds_point.y))/max_diff);
-		  if (isnan(box_value[l])) {
-		    if (weight2 >= weight1)
-		      box_value[l] = box_value[l+2];
-		    /* else box_value[l] left as is (NAN/empty) */
-		  } else if (isnan(box_value[l+2])) {
-		    if (weight1 < weight2)
-		      box_value[l] = NAN;
-		    /* else box_value[l] left as is */
-		  } else
-		    box_value[l] = (box_value[l] * weight1) + (box_value[l+2] * weight2);
-		}
-		
-		/* do the z direction linear interpolation of the sets of two points */
-		for (l=0;l<8;l=l+8) {
-		  max_diff = box_point[l+4].z-box_point[l].z;
-		  weight1 = ((max_diff - (ds_point.z - box_point[l].z))/max_diff);
-		  weight2 = ((max_diff - (box_point[l+4].z - ds_point.z))/max_diff);
-		  if (isnan(box_value[l])) {
-		    if (weight2 >= weight1)
-		      box_value[l] = box_value[l+4];
-		    /* else box_value[l] left as is (NAN/empty) */
-		  } else if (isnan(box_value[l+4])) {
-		    if (weight1 < weight2)
-		      box_value[l] = NAN;
-		    /* else box_value[l] left as is */
-		  } else
-		    box_value[l] = (box_value[l] * weight1) + (box_value[l+4] * weight2);
-		}
-
-		/* separate into MPR/MIP/minIP algorithms */
-		if (data_set->rendering == AMITK_RENDERING_MPR) { /* MPR */
-		  if (!isnan(box_value[0])) {
-		    intermediate_data[k] += weight*box_value[0];
-		    weights[k] += weight;
-		  }
-		} else { /* MIP or MINIP */
-		  if ((z == 0) && (ds_voxel.t == start_frame) && (i_gate == 0)) 
-		    intermediate_data[k]=box_value[0];
-		  else if (data_set->rendering == AMITK_RENDERING_MIP)  /* MIP */
-		    intermediate_data[k] = MAX(box_value[0], intermediate_data[k]);
-		  else  /* MINIP */
-		    intermediate_data[k] = MIN(box_value[0], intermediate_data[k]);
-		}
-
-	      } else { /* faster */
-		/* do the x direction linear interpolation of the sets of two points */
-		for (l=0;l<8;l=l+2) {
-		  max_diff = box_point[l+1].x-box_point[l].x;
-		  weight1 = ((max_diff - (ds_point.x - box_point[l].x))/max_diff);
-		  weight2 = ((max_diff - (box_point[l+1].x - ds_point.x))/max_diff);
-		  box_value[l] = (box_value[l] * weight1) + (box_value[l+1] * weight2);
-		}
-		
-		/* do the y direction linear interpolation of the sets of two points */
-		for (l=0;l<8;l=l+4) {
-		  max_diff = box_point[l+2].y-box_point[l].y;
-		  weight1 = ((max_diff - (ds_point.y - box_point[l].y))/max_diff);
-		  weight2 = ((max_diff - (box_point[l+2].y - ds_point.y))/max_diff);
-		  box_value[l] = (box_value[l] * weight1) + (box_value[l+2] * weight2);
-		}
-		
-		/* do the z direction linear interpolation of the sets of two points */
-		for (l=0;l<8;l=l+8) {
-		  max_diff = box_point[l+4].z-box_point[l].z;
-		  weight1 = ((max_diff - (ds_point.z - box_point[l].z))/max_diff);
-		  weight2 = ((max_diff - (box_point[l+4].z - ds_point.z))/max_diff);
-		  box_value[l] = (box_value[l] * weight1) + (box_value[l+4] * weight2);
-		}
-
-		/* separate into MPR/MIP/minIP algorithms */
-		if (data_set->rendering == AMITK_RENDERING_MPR) { /* MPR */
-		  intermediate_data[k] += weight*box_value[0];
-		  weights[k] += weight;
-		} else { /* MIP or MINIP */
-		  if ((z == 0) && (ds_voxel.t == start_frame) && (i_gate == 0)) 
-		    intermediate_data[k]=box_value[0];
-		  else if (data_set->rendering == AMITK_RENDERING_MIP)  /* MIP */
-		    intermediate_data[k] = MAX(intermediate_data[k], box_value[0]);
-		  else  /* MINIP */
-		    intermediate_data[k] = MIN(intermediate_data[k], box_value[0]);
-		}
-	      } /* slow (empties) vs fast algorithm */
-	      
-	      slice_point.x += slice->voxel_size.x; 
-	    }
-	  }
-	}
-      }
-    }
-    break;
-
-  case AMITK_INTERPOLATION_NEAREST_NEIGHBOR:
-  default:  
-    /* figure out what point in the data set we're going to start at */
-    start_point.x = ((amide_real_t) start.x+0.5) * slice->voxel_size.x;
-    start_point.y = ((amide_real_t) start.y+0.5) * slice->voxel_size.y;
-    if (ceil(z_steps) > 1.0)
-      start_point.z = voxel_length/2.0;
-    else
-      start_point.z = slice->voxel_size.z/2.0; /* only one iteration in z */
-    start_point = amitk_space_s2s(slice_space, data_set_space, start_point);
-
-    /* figure out what stepping one voxel in a given direction in our slice cooresponds to in our data set */
-    for (i_axis = 0; i_axis < AMITK_AXIS_NUM; i_axis++) {
-      alt.x = (i_axis == AMITK_AXIS_X) ? slice->voxel_size.x : 0.0;
-      alt.y = (i_axis == AMITK_AXIS_Y) ? slice->voxel_size.y : 0.0;
-      alt.z = (i_axis == AMITK_AXIS_Z) ? voxel_length : 0.0;
-      alt = point_add(point_sub(amitk_space_s2b(slice_space, alt),
-				AMITK_SPACE_OFFSET(slice_space)),
-		      AMITK_SPACE_OFFSET(data_set_space));
-      stride[i_axis] = amitk_space_b2s(data_set_space, alt);
-    }
-
-    /* iterate over the number of frames we'll be incorporating into this slice */
-    for (ds_voxel.t = start_frame; ds_voxel.t <= end_frame; ds_voxel.t++) {
-
-      /* averaging over more then one frame */
-      if (end_frame-start_frame > 0) {
-	if (ds_voxel.t == start_frame)
-	  time_weight = (amitk_data_set_get_end_time(data_set, start_frame)-start_time)/(duration*num_gates);
-	else if (ds_voxel.t == end_frame)
-	  time_weight = (end_time-amitk_data_set_get_start_time(data_set, end_frame))/(duration*num_gates);
-	else
-	  time_weight = amitk_data_set_get_frame_duration(data_set, ds_voxel.t)/(duration*num_gates);
-      } else
-	time_weight = 1.0/((gdouble) num_gates);
-
-      /* iterate over gates */
-      for (i_gate=0; i_gate < num_gates; i_gate++) {
-	if (gate < 0)
-	  ds_voxel.g = i_gate+AMITK_DATA_SET_VIEW_START_GATE(data_set);
-	else
-	  ds_voxel.g = i_gate+gate;
-
-	if (ds_voxel.g >= AMITK_DATA_SET_NUM_GATES(data_set))
-	  ds_voxel.g -= AMITK_DATA_SET_NUM_GATES(data_set);
-
-	ds_point = start_point;
-
-	/* separate into MPR and MIP/MINIP algorithms. A fair amount
-	   of code is duplicated within the algorithms. The reason
-	   they aren't combined is to keep the MPR vs MIP/MINIP branch
-	   point out of the loop and speed things up slightly for the
-	   most commonly used selection (MPR) */
-
-	switch(data_set->rendering) {
-
-	case AMITK_RENDERING_MPR:
-	  /* iterate over the number of planes we'll be compressing into this slice */
-	  for (z = 0; z < ceil(z_steps); z++) { 
-	    last[AMITK_AXIS_Z] = ds_point;
-	  
-	    /* weight is between 0 and 1, this is used to weight the last voxel  in the slice's z direction */
-	    if (floor(z_steps) > z)
-	      weight = time_weight/z_steps;
-	    else
-	      weight = time_weight*(z_steps-floor(z_steps)) / z_steps;
-	  
-	    /* iterate over x and y */
-	    for (i_voxel.y = start.y, k=0; i_voxel.y <= end.y; i_voxel.y++) { 
-	      last[AMITK_AXIS_Y] = ds_point;
-	      for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++, k++) { 
-		POINT_TO_VOXEL_COORDS_ONLY(ds_point, data_set->voxel_size, ds_voxel);
-		if (amitk_raw_data_includes_voxel(data_set->raw_data,ds_voxel)) {
-		  intermediate_data[k] +=
-		    weight*AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,ds_voxel);
-		  weights[k] += weight;
-		}
-		POINT_ADD(ds_point, stride[AMITK_AXIS_X], ds_point); 
-	      } /* x */
-	      POINT_ADD(last[AMITK_AXIS_Y], stride[AMITK_AXIS_Y], ds_point);
-	    } /* y */
-	    
-	    POINT_ADD(last[AMITK_AXIS_Z], stride[AMITK_AXIS_Z], ds_point); 
-	  } /* z */
-	  break;
-
-	case AMITK_RENDERING_MIP:
-	case AMITK_RENDERING_MINIP:
-
-	  /* iterate over the number of planes we'll be compressing into this slice */
-	  for (z = 0; z < ceil(z_steps); z++) { 
-	    last[AMITK_AXIS_Z] = ds_point;
-
-	    /* need to initialize based on the first plane we encounter */
-	    if ((z == 0) && (ds_voxel.t == start_frame) && (i_gate == 0)) {
-	      /* iterate over x and y */
-	      for (i_voxel.y = start.y,k=0; i_voxel.y <= end.y; i_voxel.y++) {
-		last[AMITK_AXIS_Y] = ds_point;
-		for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) {
-		  POINT_TO_VOXEL_COORDS_ONLY(ds_point, data_set->voxel_size, ds_voxel);
-		  if (!amitk_raw_data_includes_voxel(data_set->raw_data,ds_voxel)) 
-		    intermediate_data[k] = NAN;
-		  else
-		    intermediate_data[k] =
-		      AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,ds_voxel);
-		  POINT_ADD(ds_point, stride[AMITK_AXIS_X], ds_point); 
-		} /* x */
-		POINT_ADD(last[AMITK_AXIS_Y], stride[AMITK_AXIS_Y], ds_point);
-	      } /* y */
-
-	    } else { /* iterate over everything that's not the first plane */
-
-	      if (data_set->rendering == AMITK_RENDERING_MIP) {
-		/* iterate over x and y */
-		for (i_voxel.y = start.y,k=0; i_voxel.y <= end.y; i_voxel.y++) { 
-		  last[AMITK_AXIS_Y] = ds_point;
-		  for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) { 
-		    POINT_TO_VOXEL_COORDS_ONLY(ds_point, data_set->voxel_size, ds_voxel);
-		    if (amitk_raw_data_includes_voxel(data_set->raw_data,ds_voxel)) 
-		      intermediate_data[k] = 
-			MAX(intermediate_data[k],
-			    AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,ds_voxel));
-		    POINT_ADD(ds_point, stride[AMITK_AXIS_X], ds_point); 
-		  } /* x */
-		  POINT_ADD(last[AMITK_AXIS_Y], stride[AMITK_AXIS_Y], ds_point);
-		} /* y */ 
-	      } else { /* AMITK_RENDERING_MINIP */
-		/* iterate over x and y */
-		for (i_voxel.y = start.y,k=0; i_voxel.y <= end.y; i_voxel.y++) { 
-		  last[AMITK_AXIS_Y] = ds_point;
-		  for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) { 
-		    POINT_TO_VOXEL_COORDS_ONLY(ds_point, data_set->voxel_size, ds_voxel);
-		    if (amitk_raw_data_includes_voxel(data_set->raw_data,ds_voxel)) 
-		      intermediate_data[k] = 
-			MIN(intermediate_data[k],
-			    AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,ds_voxel));
-		    POINT_ADD(ds_point, stride[AMITK_AXIS_X], ds_point); 
-		  } /* x */
-		  POINT_ADD(last[AMITK_AXIS_Y], stride[AMITK_AXIS_Y], ds_point);
-		} /* y */ 
-	      } /* end else, MIP vs MINIP */
-	    } /* end else */
-	      
-	    POINT_ADD(last[AMITK_AXIS_Z], stride[AMITK_AXIS_Z], ds_point); 
-	  } /* z */
-	  break;
-
-	default:
-	  break;
-	} /* MIP vs NON-MIP */
-
-      } /* iterating over gates */
-    } /* iterating over frames */
-    break;
+  tile.data_set = data_set;
+  tile.slice = slice;
+  tile.gate = gate;
+  tile.start_frame = start_frame;
+  tile.end_frame = end_frame;
+  tile.time_weights = time_weights;
+  tile.num_gates = num_gates;
+  tile.z_steps = z_steps;
+  tile.start = start;
+  tile.end = end;
+  tile.weights = weights;
+  tile.intermediate_data = intermediate_data;
+
+  /* figure out where the center of our first slice voxel is in the data set */
+  alt.x = ((amide_real_t) start.x+0.5) * slice->voxel_size.x;
+  alt.y = ((amide_real_t) start.y+0.5) * slice->voxel_size.y;
+  if (ceil(z_steps) > 1.0)
+    alt.z = voxel_length/2.0;
+  else
+    alt.z = slice->voxel_size.z/2.0; /* only one iteration in z */
+  alt = amitk_space_s2s(slice_space, data_set_space, alt);
+  tile.origin = point_div(alt, data_set->voxel_size);
+
+  /* figure out what stepping one voxel in a given direction in our slice cooresponds to in our data set */
+  for (i_axis = 0; i_axis < AMITK_AXIS_NUM; i_axis++) {
+    alt.x = (i_axis == AMITK_AXIS_X) ? slice->voxel_size.x : 0.0;
+    alt.y = (i_axis == AMITK_AXIS_Y) ? slice->voxel_size.y : 0.0;
+    alt.z = (i_axis == AMITK_AXIS_Z) ? voxel_length : 0.0;
+    alt = point_add(point_sub(amitk_space_s2b(slice_space, alt),
+			      AMITK_SPACE_OFFSET(slice_space)),
+		    AMITK_SPACE_OFFSET(data_set_space));
+    tile.step[i_axis] = point_div(amitk_space_b2s(data_set_space, alt), data_set->voxel_size);
   }
 
-  /* fill in data/normalize if needed */
-  i_voxel.t = i_voxel.g = i_voxel.z = 0;
-  if (data_set->rendering == AMITK_RENDERING_MPR) {
-    for (i_voxel.y = start.y,k=0; i_voxel.y <= end.y; i_voxel.y++) 
-      for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) 
-	if (weights[k] > 0)
-	  AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = intermediate_data[k]/weights[k];
-	else
-	  AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = NAN;
-  } else { /* MIP or MINIP */
-    for (i_voxel.y = start.y,k=0; i_voxel.y <= end.y; i_voxel.y++) 
-      for (i_voxel.x = start.x; i_voxel.x <= end.x; i_voxel.x++,k++) 
-	AMITK_RAW_DATA_DOUBLE_SET_CONTENT(slice->raw_data,i_voxel) = intermediate_data[k];
-  }
+  /* and hand the rows off to the worker threads */
+  amitk_parallel_for(end.y-start.y+1, SLICE_TILE_ROWS, get_slice_rows, &tile);
     
  error:
 
   if (weights != NULL) g_free(weights);
   if (intermediate_data != NULL) g_free(intermediate_data);
+  if (time_weights != NULL) g_free(time_weights);
 
   return slice;
 }
-
-
@@ -83,12 +83,48 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_calc_slice_m
 										       const amide_intpoint_t z,
 										       amitk_format_DOUBLE_t * pmin,
 										       amitk_format_DOUBLE_t * pmax);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_get_plane_values(const AmitkDataSet * data_set,
+									   const amide_intpoint_t frame,
+									   const amide_intpoint_t gate,
+									   const amide_intpoint_t z,
+									   amide_data_t * values);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_get_plane_values(const AmitkDataSet * data_set,
+										     const amide_intpoint_t frame,
+										     const amide_intpoint_t gate,
+										     const amide_intpoint_t z,
+										     amide_data_t * values);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_threshold_plane(const AmitkDataSet * data_set,
+									  const amide_intpoint_t frame,
+									  const amide_intpoint_t gate,
+									  const amide_intpoint_t z,
+									  const amide_data_t min_value,
+									  const amide_data_t max_value,
+									  amitk_format_UBYTE_t * mask,
+									  const amitk_format_UBYTE_t bit);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_threshold_plane(const AmitkDataSet * data_set,
+										    const amide_intpoint_t frame,
+										    const amide_intpoint_t gate,
+										    const amide_intpoint_t z,
+										    const amide_data_t min_value,
+										    const amide_data_t max_value,
+										    amitk_format_UBYTE_t * mask,
+										    const amitk_format_UBYTE_t bit);
 void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_calc_distribution(AmitkDataSet * data_set,
 									     AmitkUpdateFunc update_func,
 									    gpointer update_data);
 void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_calc_distribution(AmitkDataSet * data_set,
 										      AmitkUpdateFunc update_func,
 										      gpointer update_data);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_reduce_frame(AmitkDataSet * data_set,
+								       const amide_intpoint_t frame,
+								       const gint start_plane,
+								       const gint end_plane,
+								       AmitkDataSet * reduced);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_reduce_frame(AmitkDataSet * data_set,
+										 const amide_intpoint_t frame,
+										 const gint start_plane,
+										 const gint end_plane,
+										 AmitkDataSet * reduced);
 AmitkDataSet * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_get_slice(AmitkDataSet * data_set,
 									      const amide_time_t start_time,
 									      const amide_time_t duration,
@@ -42,7 +42,8 @@ static AmitkObject * fiducial_mark_copy                (const AmitkObject
 static void          fiducial_mark_copy_in_place       (AmitkObject * dest_object, const AmitkObject * src_object);
 static void          fiducial_mark_write_xml           (const AmitkObject   *object, 
 							xmlNodePtr           nodes,
-							FILE                *study_file);
+							FILE                *study_file,
+							const gboolean       compress_raw_data);
 static gchar *       fiducial_mark_read_xml            (AmitkObject         *object, 
 							xmlNodePtr           nodes, 
 							FILE                *study_file,
@@ -148,11 +149,12 @@ static void fiducial_mark_copy_in_place(AmitkObject * dest_object, const AmitkOb
 }
 
 
-static void fiducial_mark_write_xml(const AmitkObject * object, xmlNodePtr nodes, FILE *study_file) {
+static void fiducial_mark_write_xml(const AmitkObject * object, xmlNodePtr nodes, FILE *study_file,
+				    const gboolean compress_raw_data) {
 
   AmitkFiducialMark * fm;
 
-  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file);
+  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file, compress_raw_data);
 
   fm = AMITK_FIDUCIAL_MARK(object);
 
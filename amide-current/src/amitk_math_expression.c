@@ -0,0 +1,669 @@
+/* amitk_math_expression.c
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2017 Andy Loening
+ *
+ * Author: Andy Loening <loening@alum.mit.edu>
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+/* A small expression language for voxel math, for example "(a-b)/c * (c > 10)".
+   The expression is parsed into a stack based program, which is then run over
+   blocks of voxels at a time, with each instruction applied to the whole block
+   before going on to the next.  That way the interpreter's overhead is only paid
+   once per block, the loop for each instruction is simple enough to be vectorized
+   by the compiler, and the intermediate values only take up a few blocks' worth
+   of memory instead of a whole data set each.
+
+   The grammar, from lowest to highest precedence:
+     expression:  or ['?' expression ':' expression]
+     or:          and {'||' and}
+     and:         compare {'&&' compare}
+     compare:     sum [('<' | '<=' | '>' | '>=' | '==' | '!=') sum]
+     sum:         product {('+' | '-') product}
+     product:     unary {('*' | '/') unary}
+     unary:       ('-' | '+' | '!') unary | power
+     power:       primary ['^' unary]
+     primary:     number | variable | 'pi' | function '(' arguments ')' | '(' expression ')'
+
+   variables are the letters a-z, comparisons and logical operators give 1 or 0,
+   and any non-zero value counts as true.  Division follows the usual floating
+   point rules, so dividing by zero gives inf or NaN. */
+
+#include "amide_config.h"
+#include <math.h>
+#include <string.h>
+#include "amitk_math_expression.h"
+
+/* number of voxels an instruction is applied to at a time */
+#define MATH_EXPRESSION_BLOCK 256
+
+/* guards against running out of stack while parsing */
+#define MATH_EXPRESSION_MAX_NESTING 256
+
+typedef enum {
+  OP_CONSTANT,
+  OP_VARIABLE,
+  /* unary */
+  OP_NEGATE,
+  OP_NOT,
+  OP_ABS,
+  OP_SQRT,
+  OP_EXP,
+  OP_LOG,
+  OP_LOG10,
+  /* binary */
+  OP_ADD,
+  OP_SUB,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_POWER,
+  OP_MIN,
+  OP_MAX,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_AND,
+  OP_OR,
+  /* ternary */
+  OP_SELECT
+} math_op_t;
+
+typedef struct {
+  math_op_t op;
+  gint variable;
+  amide_data_t constant;
+} math_instruction_t;
+
+struct _AmitkMathExpression {
+  gchar * string;
+  math_instruction_t * program;
+  gint num_instructions;
+  gint max_depth; /* deepest the value stack gets */
+  gboolean variables[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+};
+
+typedef struct {
+  const gchar * string;
+  const gchar * pos;
+  GArray * program;
+  gint depth;
+  gint max_depth;
+  gint nesting;
+  gboolean variables[AMITK_MATH_EXPRESSION_MAX_VARIABLES];
+  gchar * error;
+} math_parser_t;
+
+typedef struct {
+  const gchar * name;
+  math_op_t op;
+  gint num_arguments;
+} math_function_t;
+
+static const math_function_t math_functions[] = {
+  {"abs", OP_ABS, 1},
+  {"sqrt", OP_SQRT, 1},
+  {"exp", OP_EXP, 1},
+  {"log", OP_LOG, 1},
+  {"ln", OP_LOG, 1},
+  {"log10", OP_LOG10, 1},
+  {"min", OP_MIN, 2},
+  {"max", OP_MAX, 2},
+  {"pow", OP_POWER, 2},
+};
+
+
+static gint op_num_operands(const math_op_t op) {
+  if ((op == OP_CONSTANT) || (op == OP_VARIABLE)) return 0;
+  else if (op < OP_ADD) return 1;
+  else if (op < OP_SELECT) return 2;
+  else return 3;
+}
+
+#define MATH_UNARY(value)				\
+  for (k=0; k<n; k++) {					\
+    x = in0[k];						\
+    out[k] = (value);					\
+  }
+
+#define MATH_BINARY(value)				\
+  for (k=0; k<n; k++) {					\
+    x = in0[k];						\
+    y = in1[k];						\
+    out[k] = (value);					\
+  }
+
+/* runs the program over n (at most MATH_EXPRESSION_BLOCK) voxels starting at offset,
+   returning the results.  stack needs room for max_depth blocks.  A variable's
+   values are used in place rather than copied onto the stack */
+static const amide_data_t * run_block(const math_instruction_t * program,
+				      const gint num_instructions,
+				      const amide_data_t * const * variables,
+				      const gsize offset,
+				      const gint n,
+				      amide_data_t * stack,
+				      const amide_data_t ** values) {
+
+  gint i, k;
+  gint num_operands;
+  gint top=-1;
+  const amide_data_t * in0;
+  const amide_data_t * in1;
+  const amide_data_t * in2;
+  amide_data_t * out;
+  amide_data_t x, y;
+  amide_data_t constant;
+
+  for (i=0; i<num_instructions; i++) {
+    /* the result replaces the operands on the stack */
+    num_operands = op_num_operands(program[i].op);
+    top += 1-num_operands;
+    in0 = (num_operands > 0) ? values[top] : NULL;
+    in1 = (num_operands > 1) ? values[top+1] : NULL;
+    out = stack + top*MATH_EXPRESSION_BLOCK;
+
+    switch(program[i].op) {
+    case OP_CONSTANT:
+      constant = program[i].constant;
+      for (k=0; k<n; k++)
+	out[k] = constant;
+      break;
+    case OP_VARIABLE:
+      values[top] = variables[program[i].variable]+offset;
+      continue;
+    case OP_NEGATE:
+      MATH_UNARY(-x);
+      break;
+    case OP_NOT:
+      MATH_UNARY((x == 0.0) ? 1.0 : 0.0);
+      break;
+    case OP_ABS:
+      MATH_UNARY(fabs(x));
+      break;
+    case OP_SQRT:
+      MATH_UNARY(sqrt(x));
+      break;
+    case OP_EXP:
+      MATH_UNARY(exp(x));
+      break;
+    case OP_LOG:
+      MATH_UNARY(log(x));
+      break;
+    case OP_LOG10:
+      MATH_UNARY(log10(x));
+      break;
+    case OP_ADD:
+      MATH_BINARY(x + y);
+      break;
+    case OP_SUB:
+      MATH_BINARY(x - y);
+      break;
+    case OP_MULTIPLY:
+      MATH_BINARY(x * y);
+      break;
+    case OP_DIVIDE:
+      MATH_BINARY(x / y);
+      break;
+    case OP_POWER:
+      MATH_BINARY(pow(x, y));
+      break;
+    case OP_MIN:
+      MATH_BINARY((y < x) ? y : x);
+      break;
+    case OP_MAX:
+      MATH_BINARY((y > x) ? y : x);
+      break;
+    case OP_LESS:
+      MATH_BINARY((x < y) ? 1.0 : 0.0);
+      break;
+    case OP_LESS_EQUAL:
+      MATH_BINARY((x <= y) ? 1.0 : 0.0);
+      break;
+    case OP_GREATER:
+      MATH_BINARY((x > y) ? 1.0 : 0.0);
+      break;
+    case OP_GREATER_EQUAL:
+      MATH_BINARY((x >= y) ? 1.0 : 0.0);
+      break;
+    case OP_EQUAL:
+      MATH_BINARY((x == y) ? 1.0 : 0.0);
+      break;
+    case OP_NOT_EQUAL:
+      MATH_BINARY((x != y) ? 1.0 : 0.0);
+      break;
+    case OP_AND:
+      MATH_BINARY(((x != 0.0) && (y != 0.0)) ? 1.0 : 0.0);
+      break;
+    case OP_OR:
+      MATH_BINARY(((x != 0.0) || (y != 0.0)) ? 1.0 : 0.0);
+      break;
+    case OP_SELECT:
+      in2 = values[top+2];
+      for (k=0; k<n; k++)
+	out[k] = (in0[k] != 0.0) ? in1[k] : in2[k];
+      break;
+    default:
+      g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
+      break;
+    }
+    values[top] = out;
+  }
+
+  return values[0];
+}
+
+
+
+static void parser_error(math_parser_t * parser, const gchar * message) {
+
+  if (parser->error == NULL) /* keep the first error */
+    parser->error = g_strdup_printf(_("%s at position %d"), message,
+				    (gint) (parser->pos - parser->string)+1);
+
+  return;
+}
+
+/* adds an instruction to the program, parts of the expression that only
+   depend on constants are evaluated right away */
+static void parser_emit(math_parser_t * parser, const math_op_t op,
+			const gint variable, const amide_data_t constant) {
+
+  math_instruction_t instruction;
+  math_instruction_t * program;
+  gint num_operands;
+  gint i;
+  amide_data_t stack[3*MATH_EXPRESSION_BLOCK];
+  const amide_data_t * values[3];
+
+  if (parser->error != NULL) return;
+
+  instruction.op = op;
+  instruction.variable = variable;
+  instruction.constant = constant;
+
+  num_operands = op_num_operands(op);
+  parser->depth += 1-num_operands;
+  parser->max_depth = MAX(parser->max_depth, parser->depth);
+
+  if ((num_operands > 0) && (parser->program->len >= num_operands)) {
+    program = &g_array_index(parser->program, math_instruction_t,
+			     parser->program->len-num_operands);
+    for (i=0; i<num_operands; i++)
+      if (program[i].op != OP_CONSTANT)
+	break;
+    if (i == num_operands) {
+      g_array_append_val(parser->program, instruction);
+      program = &g_array_index(parser->program, math_instruction_t,
+			       parser->program->len-num_operands-1);
+      instruction.op = OP_CONSTANT;
+      instruction.variable = -1;
+      instruction.constant = run_block(program, num_operands+1, NULL, 0, 1, stack, values)[0];
+      g_array_set_size(parser->program, parser->program->len-num_operands-1);
+    }
+  }
+
+  g_array_append_val(parser->program, instruction);
+
+  return;
+}
+
+static void parser_skip_space(math_parser_t * parser) {
+  while (g_ascii_isspace(*(parser->pos)))
+    parser->pos++;
+  return;
+}
+
+/* if the next token is the given one, consume it */
+static gboolean parser_accept(math_parser_t * parser, const gchar * token) {
+
+  gint length;
+
+  parser_skip_space(parser);
+  length = strlen(token);
+  if (strncmp(parser->pos, token, length) != 0)
+    return FALSE;
+
+  /* don't mistake "<=" for "<" and so on */
+  if ((length == 1) && (parser->pos[1] == '=') && (strchr("<>=!", token[0]) != NULL))
+    return FALSE;
+
+  parser->pos += length;
+  return TRUE;
+}
+
+static void parse_expression(math_parser_t * parser);
+
+static void parse_primary(math_parser_t * parser) {
+
+  const gchar * start;
+  gchar * end;
+  gint length;
+  gint i, j;
+  amide_data_t value;
+
+  parser_skip_space(parser);
+  start = parser->pos;
+
+  if (g_ascii_isdigit(*start) || ((*start == '.') && g_ascii_isdigit(start[1]))) {
+    value = g_ascii_strtod(start, &end);
+    parser->pos = end;
+    parser_emit(parser, OP_CONSTANT, -1, value);
+
+  } else if (g_ascii_isalpha(*start)) {
+    while (g_ascii_isalnum(*(parser->pos)))
+      parser->pos++;
+    length = parser->pos - start;
+    parser_skip_space(parser);
+
+    if (*(parser->pos) != '(') {
+      if (length == 1) {
+	i = g_ascii_tolower(*start) - 'a';
+	parser->variables[i] = TRUE;
+	parser_emit(parser, OP_VARIABLE, i, 0.0);
+      } else if ((length == 2) && (g_ascii_strncasecmp(start, "pi", 2) == 0)) {
+	parser_emit(parser, OP_CONSTANT, -1, M_PI);
+      } else {
+	parser->pos = start;
+	parser_error(parser, _("Unknown variable"));
+      }
+      return;
+    }
+
+    for (i=0; i<G_N_ELEMENTS(math_functions); i++)
+      if ((strlen(math_functions[i].name) == length) &&
+	  (g_ascii_strncasecmp(start, math_functions[i].name, length) == 0))
+	break;
+    if (i == G_N_ELEMENTS(math_functions)) {
+      parser->pos = start;
+      parser_error(parser, _("Unknown function"));
+      return;
+    }
+
+    parser->pos++; /* the '(' */
+    for (j=0; j < math_functions[i].num_arguments; j++) {
+      if ((j > 0) && !parser_accept(parser, ",")) {
+	parser_error(parser, _("Expected ','"));
+	return;
+      }
+      parse_expression(parser);
+    }
+    if (!parser_accept(parser, ")")) {
+      parser_error(parser, _("Expected ')'"));
+      return;
+    }
+    parser_emit(parser, math_functions[i].op, -1, 0.0);
+
+  } else if (parser_accept(parser, "(")) {
+    parse_expression(parser);
+    if (!parser_accept(parser, ")"))
+      parser_error(parser, _("Expected ')'"));
+
+  } else {
+    parser_error(parser, _("Expected a number, variable, or function"));
+  }
+
+  return;
+}
+
+static void parse_unary(math_parser_t * parser);
+
+static void parse_power(math_parser_t * parser) {
+
+  parse_primary(parser);
+  if (parser_accept(parser, "^")) {
+    parse_unary(parser); /* right associative */
+    parser_emit(parser, OP_POWER, -1, 0.0);
+  }
+
+  return;
+}
+
+static void parse_unary(math_parser_t * parser) {
+
+  if (parser->error != NULL) return;
+  if (++parser->nesting > MATH_EXPRESSION_MAX_NESTING) {
+    parser_error(parser, _("Expression is nested too deeply"));
+    return;
+  }
+
+  if (parser_accept(parser, "-")) {
+    parse_unary(parser);
+    parser_emit(parser, OP_NEGATE, -1, 0.0);
+  } else if (parser_accept(parser, "+")) {
+    parse_unary(parser);
+  } else if (parser_accept(parser, "!")) {
+    parse_unary(parser);
+    parser_emit(parser, OP_NOT, -1, 0.0);
+  } else {
+    parse_power(parser);
+  }
+
+  parser->nesting--;
+  return;
+}
+
+static void parse_product(math_parser_t * parser) {
+
+  parse_unary(parser);
+  while (parser->error == NULL) {
+    if (parser_accept(parser, "*")) {
+      parse_unary(parser);
+      parser_emit(parser, OP_MULTIPLY, -1, 0.0);
+    } else if (parser_accept(parser, "/")) {
+      parse_unary(parser);
+      parser_emit(parser, OP_DIVIDE, -1, 0.0);
+    } else
+      break;
+  }
+
+  return;
+}
+
+static void parse_sum(math_parser_t * parser) {
+
+  parse_product(parser);
+  while (parser->error == NULL) {
+    if (parser_accept(parser, "+")) {
+      parse_product(parser);
+      parser_emit(parser, OP_ADD, -1, 0.0);
+    } else if (parser_accept(parser, "-")) {
+      parse_product(parser);
+      parser_emit(parser, OP_SUB, -1, 0.0);
+    } else
+      break;
+  }
+
+  return;
+}
+
+static void parse_compare(math_parser_t * parser) {
+
+  static const struct {const gchar * token; math_op_t op;} compares[] = {
+    {"<=", OP_LESS_EQUAL},
+    {">=", OP_GREATER_EQUAL},
+    {"==", OP_EQUAL},
+    {"!=", OP_NOT_EQUAL},
+    {"<", OP_LESS},
+    {">", OP_GREATER},
+  };
+  gint i;
+
+  parse_sum(parser);
+  if (parser->error != NULL) return;
+
+  for (i=0; i<G_N_ELEMENTS(compares); i++)
+    if (parser_accept(parser, compares[i].token)) {
+      parse_sum(parser);
+      parser_emit(parser, compares[i].op, -1, 0.0);
+      break;
+    }
+
+  return;
+}
+
+static void parse_and(math_parser_t * parser) {
+
+  parse_compare(parser);
+  while ((parser->error == NULL) && parser_accept(parser, "&&")) {
+    parse_compare(parser);
+    parser_emit(parser, OP_AND, -1, 0.0);
+  }
+
+  return;
+}
+
+static void parse_or(math_parser_t * parser) {
+
+  parse_and(parser);
+  while ((parser->error == NULL) && parser_accept(parser, "||")) {
+    parse_and(parser);
+    parser_emit(parser, OP_OR, -1, 0.0);
+  }
+
+  return;
+}
+
+static void parse_expression(math_parser_t * parser) {
+
+  if (parser->error != NULL) return;
+  if (++parser->nesting > MATH_EXPRESSION_MAX_NESTING) {
+    parser_error(parser, _("Expression is nested too deeply"));
+    return;
+  }
+
+  parse_or(parser);
+  if ((parser->error == NULL) && parser_accept(parser, "?")) {
+    parse_expression(parser);
+    if (!parser_accept(parser, ":")) {
+      parser_error(parser, _("Expected ':'"));
+    } else {
+      parse_expression(parser);
+      parser_emit(parser, OP_SELECT, -1, 0.0);
+    }
+  }
+
+  parser->nesting--;
+  return;
+}
+
+
+/* parses the expression, on failure NULL is returned, and if error_message is
+   given it's set to a description of the problem, which the caller should free */
+AmitkMathExpression * amitk_math_expression_new(const gchar * string,
+						gchar ** error_message) {
+
+  math_parser_t parser;
+  AmitkMathExpression * expression;
+
+  g_return_val_if_fail(string != NULL, NULL);
+
+  parser.string = string;
+  parser.pos = string;
+  parser.program = g_array_new(FALSE, FALSE, sizeof(math_instruction_t));
+  parser.depth = 0;
+  parser.max_depth = 0;
+  parser.nesting = 0;
+  parser.error = NULL;
+  memset(parser.variables, 0, sizeof(parser.variables));
+
+  parse_expression(&parser);
+  parser_skip_space(&parser);
+  if ((parser.error == NULL) && (*(parser.pos) != '\0'))
+    parser_error(&parser, _("Unexpected character"));
+
+  if (parser.error != NULL) {
+    if (error_message != NULL)
+      *error_message = parser.error;
+    else
+      g_free(parser.error);
+    g_array_free(parser.program, TRUE);
+    return NULL;
+  }
+
+  expression = g_new(AmitkMathExpression, 1);
+  expression->string = g_strdup(string);
+  expression->num_instructions = parser.program->len;
+  expression->program = (math_instruction_t *) g_array_free(parser.program, FALSE);
+  expression->max_depth = parser.max_depth;
+  memcpy(expression->variables, parser.variables, sizeof(parser.variables));
+
+  return expression;
+}
+
+void amitk_math_expression_free(AmitkMathExpression * expression) {
+
+  if (expression == NULL) return;
+
+  g_free(expression->string);
+  g_free(expression->program);
+  g_free(expression);
+
+  return;
+}
+
+const gchar * amitk_math_expression_get_string(const AmitkMathExpression * expression) {
+  g_return_val_if_fail(expression != NULL, NULL);
+  return expression->string;
+}
+
+gboolean amitk_math_expression_uses_variable(const AmitkMathExpression * expression,
+					     const gint variable) {
+  g_return_val_if_fail(expression != NULL, FALSE);
+
+  if ((variable < 0) || (variable >= AMITK_MATH_EXPRESSION_MAX_VARIABLES))
+    return FALSE;
+  else
+    return expression->variables[variable];
+}
+
+/* evaluates the expression for num_voxels voxels, variables[i] holds the values
+   of the i'th variable (a, b, c, ...), and only needs to be set for the variables
+   the expression uses.  Safe to call from several threads at once. */
+void amitk_math_expression_evaluate(const AmitkMathExpression * expression,
+				    const amide_data_t * const * variables,
+				    amitk_format_FLOAT_t * output,
+				    const gsize num_voxels) {
+
+  amide_data_t * stack;
+  const amide_data_t ** values;
+  const amide_data_t * result;
+  gsize offset;
+  gint n, k;
+
+  g_return_if_fail(expression != NULL);
+
+  stack = g_new(amide_data_t, expression->max_depth*MATH_EXPRESSION_BLOCK);
+  values = g_new(const amide_data_t *, expression->max_depth);
+
+  for (offset=0; offset < num_voxels; offset += MATH_EXPRESSION_BLOCK) {
+    n = MIN(MATH_EXPRESSION_BLOCK, num_voxels-offset);
+    result = run_block(expression->program, expression->num_instructions,
+		       variables, offset, n, stack, values);
+    for (k=0; k<n; k++)
+      output[offset+k] = result[k];
+  }
+
+  g_free(stack);
+  g_free(values);
+
+  return;
+}
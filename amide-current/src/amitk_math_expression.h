@@ -0,0 +1,53 @@
+/* amitk_math_expression.h
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2017 Andy Loening
+ *
+ * Author: Andy Loening <loening@alum.mit.edu>
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+#ifndef __AMITK_MATH_EXPRESSION_H__
+#define __AMITK_MATH_EXPRESSION_H__
+
+#include <glib.h>
+#include "amitk_raw_data.h"
+
+G_BEGIN_DECLS
+
+/* variables in an expression are the single letters a through z */
+#define AMITK_MATH_EXPRESSION_MAX_VARIABLES 26
+#define amitk_math_expression_variable_name(i) ((gchar) ('a'+(i)))
+
+typedef struct _AmitkMathExpression AmitkMathExpression;
+
+AmitkMathExpression * amitk_math_expression_new        (const gchar * expression,
+							 gchar ** error_message);
+void                  amitk_math_expression_free       (AmitkMathExpression * expression);
+const gchar *         amitk_math_expression_get_string (const AmitkMathExpression * expression);
+gboolean              amitk_math_expression_uses_variable(const AmitkMathExpression * expression,
+							   const gint variable);
+void                  amitk_math_expression_evaluate   (const AmitkMathExpression * expression,
+							 const amide_data_t * const * variables,
+							 amitk_format_FLOAT_t * output,
+							 const gsize num_voxels);
+
+G_END_DECLS
+
+#endif /* __AMITK_MATH_EXPRESSION_H__ */
@@ -74,7 +74,8 @@ static void          object_copy_in_place          (AmitkObject * dest_object,
 						    const AmitkObject * src_object);
 static void          object_write_xml              (const AmitkObject * object, 
 						    xmlNodePtr           nodes,
-						    FILE                *study_file);
+						    FILE                *study_file,
+						    const gboolean       compress_raw_data);
 static gchar *       object_read_xml               (AmitkObject         *object, 
 						    xmlNodePtr           nodes, 
 						    FILE                *study_file,
@@ -183,9 +184,9 @@ static void object_class_init (AmitkObjectClass * class) {
   		  G_TYPE_FROM_CLASS(class),
   		  G_SIGNAL_RUN_LAST,
   		  G_STRUCT_OFFSET(AmitkObjectClass, object_write_xml),
-  		  NULL, NULL, amitk_marshal_NONE__POINTER_POINTER,
-		  G_TYPE_NONE, 2,
-		  G_TYPE_POINTER, G_TYPE_POINTER);
+  		  NULL, NULL, amitk_marshal_NONE__POINTER_POINTER_BOOLEAN,
+		  G_TYPE_NONE, 3,
+		  G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_BOOLEAN);
   object_signals[OBJECT_READ_XML] =
     g_signal_new ("object_read_xml",
   		  G_TYPE_FROM_CLASS(class),
@@ -450,7 +451,8 @@ void object_copy_in_place(AmitkObject * dest_object, const AmitkObject * src_obj
   return;
 }
 
-static void object_write_xml (const AmitkObject * object, xmlNodePtr nodes, FILE * study_file) {
+static void object_write_xml (const AmitkObject * object, xmlNodePtr nodes, FILE * study_file,
+			      const gboolean compress_raw_data) {
 
   xmlNodePtr children_nodes;
   AmitkSelection i_selection;
@@ -458,7 +460,7 @@ static void object_write_xml (const AmitkObject * object, xmlNodePtr nodes, FILE
   amitk_space_write_xml(nodes, "coordinate_space", AMITK_SPACE(object));
 
   children_nodes = xmlNewChild(nodes, NULL, (xmlChar*) "children", NULL);
-  amitk_objects_write_xml(AMITK_OBJECT_CHILDREN(object), children_nodes, study_file);
+  amitk_objects_write_xml(AMITK_OBJECT_CHILDREN(object), children_nodes, study_file, compress_raw_data);
 
   for (i_selection = 0; i_selection < AMITK_SELECTION_NUM; i_selection++)
     xml_save_boolean(nodes, amitk_selection_get_name(i_selection),
@@ -531,8 +533,10 @@ gchar * amide_data_file_xml_end_tag = "</amide_data_file_version>";
 
 /* if study_file is NULL, we're saving as a directory, 
    and output_filename will be set (if not NULL),
-   otherwise location will be set */
+   otherwise location will be set. compress_raw_data gets passed on
+   to the raw data of the object and its children */
 void amitk_object_write_xml(AmitkObject * object, FILE * study_file, 
+			    const gboolean compress_raw_data,
 			    gchar ** output_filename, guint64 * plocation, guint64 *psize) {
 
   gchar * xml_filename=NULL;
@@ -586,7 +590,7 @@ void amitk_object_write_xml(AmitkObject * object, FILE * study_file,
   doc->children = xmlNewDocNode(doc, NULL, (xmlChar *) amide_data_file_version_str, AMITK_FILE_VERSION);
 
   nodes = xmlNewChild(doc->children, NULL, (xmlChar *) object_name, (xmlChar *) AMITK_OBJECT_NAME(object));
-  g_signal_emit(G_OBJECT(object), object_signals[OBJECT_WRITE_XML], 0, nodes, study_file);
+  g_signal_emit(G_OBJECT(object), object_signals[OBJECT_WRITE_XML], 0, nodes, study_file, compress_raw_data);
 
   /* and save */
   if (study_file == NULL) { /* save as directory */
@@ -1183,7 +1187,8 @@ gboolean amitk_objects_has_type(GList * objects, const AmitkObjectType type, con
   return TRUE;
 }
 
-void amitk_objects_write_xml(GList * objects, xmlNodePtr node_list, FILE * study_file) {
+void amitk_objects_write_xml(GList * objects, xmlNodePtr node_list, FILE * study_file,
+			     const gboolean compress_raw_data) {
 
   gchar * object_filename=NULL;;
   guint64 location;
@@ -1191,7 +1196,7 @@ void amitk_objects_write_xml(GList * objects, xmlNodePtr node_list, FILE * study
 
   if (objects == NULL) return;
 
-  amitk_object_write_xml(objects->data, study_file, &object_filename, 
+  amitk_object_write_xml(objects->data, study_file, compress_raw_data, &object_filename, 
 			 &location, &size);
 
   if (study_file == NULL) 
@@ -1204,7 +1209,7 @@ void amitk_objects_write_xml(GList * objects, xmlNodePtr node_list, FILE * study
   if (object_filename != NULL) g_free(object_filename);
 
   /* and recurse */
-  amitk_objects_write_xml(objects->next, node_list, study_file);
+  amitk_objects_write_xml(objects->next, node_list, study_file, compress_raw_data);
   
   return;
 }
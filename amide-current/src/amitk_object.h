@@ -88,7 +88,8 @@ struct _AmitkObjectClass
   void (* object_child_selection_changed) (AmitkObject * object);
   AmitkObject * (* object_copy)           (const AmitkObject * object);
   void (* object_copy_in_place)           (AmitkObject * dest_object, const AmitkObject * src_object);
-  void (* object_write_xml)               (const AmitkObject * object, xmlNodePtr nodes, FILE * study_file);
+  void (* object_write_xml)               (const AmitkObject * object, xmlNodePtr nodes, FILE * study_file,
+					   const gboolean compress_raw_data);
   gchar * (* object_read_xml)             (AmitkObject * object, xmlNodePtr nodes, FILE * study_file, gchar * error_buf);
   void (* object_add_child)               (AmitkObject * object, AmitkObject * child);
   void (* object_remove_child)            (AmitkObject * object, AmitkObject * child);
@@ -103,6 +104,7 @@ GType	        amitk_object_get_type	             (void);
 AmitkObject *   amitk_object_new                     (void);
 void            amitk_object_write_xml               (AmitkObject * object,
 						      FILE * study_file,
+						      const gboolean compress_raw_data,
 						      gchar ** output_filename,
 						      guint64 * location,
 						      guint64 * size);
@@ -165,7 +167,8 @@ gboolean        amitk_objects_has_type               (GList * objects,
 						      const gboolean recurse);
 void            amitk_objects_write_xml              (GList * objects, 
 						      xmlNodePtr node_list,
-						      FILE * study_file);
+						      FILE * study_file,
+						      const gboolean compress_raw_data);
 GList *         amitk_objects_read_xml               (xmlNodePtr node_list,
 						      FILE * study_file,
 						      gchar **perror_buf);
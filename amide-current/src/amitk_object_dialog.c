@@ -79,6 +79,7 @@ static void dialog_change_frame_duration_cb  (GtkWidget * widget, gpointer data)
 static void dialog_change_gate_time_cb       (GtkWidget * widget, gpointer data);
 static void dialog_change_roi_type_cb      (GtkWidget * widget, gpointer data);
 static void dialog_change_modality_cb      (GtkWidget * widget, gpointer data);
+static void dialog_change_voxel_layout_cb  (GtkWidget * widget, gpointer data);
 static void dialog_change_subject_orientation_cb(GtkWidget * widget, gpointer data);
 static void dialog_change_subject_sex_cb   (GtkWidget * widget, gpointer data);
 static void dialog_change_dose_unit_cb     (GtkWidget * widget, gpointer data);
@@ -312,6 +313,7 @@ static void object_dialog_construct(AmitkObjectDialog * dialog,
   } else if (AMITK_IS_DATA_SET(object)) {
     AmitkInterpolation i_interpolation;
     AmitkRendering i_rendering;
+    AmitkRawDataLayout i_layout;
     AmitkConversion i_conversion;
     AmitkModality i_modality;
     AmitkDoseUnit i_dose_unit;
@@ -415,6 +417,22 @@ static void object_dialog_construct(AmitkObjectDialog * dialog,
     gtk_widget_show(dialog->rendering_menu);
     table_row++;
 
+    /* widget to change how the voxels are ordered in memory */
+    label = gtk_label_new(_("Voxel Layout:"));
+    gtk_table_attach(GTK_TABLE(packing_table), label, 2,3,
+		     table_row, table_row+1, 0, 0, X_PADDING, Y_PADDING);
+    gtk_widget_show(label);
+
+    dialog->voxel_layout_menu = gtk_combo_box_new_text();
+    for (i_layout = 0; i_layout < AMITK_RAW_DATA_LAYOUT_NUM; i_layout++)
+      gtk_combo_box_append_text(GTK_COMBO_BOX(dialog->voxel_layout_menu),
+				amitk_raw_data_layout_get_name(i_layout));
+    g_signal_connect(G_OBJECT(dialog->voxel_layout_menu), "changed", G_CALLBACK(dialog_change_voxel_layout_cb), dialog);
+    gtk_table_attach(GTK_TABLE(packing_table), dialog->voxel_layout_menu, 3,4,
+		     table_row, table_row+1, GTK_FILL, 0, X_PADDING, Y_PADDING);
+    gtk_widget_show(dialog->voxel_layout_menu);
+    table_row++;
+
 
     /* a separator for clarity */
     hseparator = gtk_hseparator_new();
@@ -1608,6 +1626,10 @@ static void dialog_update_entries(AmitkObjectDialog * dialog) {
     gtk_combo_box_set_active(GTK_COMBO_BOX(dialog->modality_menu), AMITK_DATA_SET_MODALITY(dialog->object));
     g_signal_handlers_unblock_by_func(G_OBJECT(dialog->modality_menu),G_CALLBACK(dialog_change_modality_cb), dialog);
 
+    g_signal_handlers_block_by_func(G_OBJECT(dialog->voxel_layout_menu),G_CALLBACK(dialog_change_voxel_layout_cb), dialog);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(dialog->voxel_layout_menu), AMITK_DATA_SET_LAYOUT(dialog->object));
+    g_signal_handlers_unblock_by_func(G_OBJECT(dialog->voxel_layout_menu),G_CALLBACK(dialog_change_voxel_layout_cb), dialog);
+
     g_signal_handlers_block_by_func(G_OBJECT(dialog->subject_orientation_menu),G_CALLBACK(dialog_change_subject_orientation_cb), dialog);
     gtk_combo_box_set_active(GTK_COMBO_BOX(dialog->subject_orientation_menu), AMITK_DATA_SET_SUBJECT_ORIENTATION(dialog->object));
     g_signal_handlers_unblock_by_func(G_OBJECT(dialog->subject_orientation_menu),G_CALLBACK(dialog_change_subject_orientation_cb), dialog);
@@ -2392,6 +2414,20 @@ static void dialog_change_modality_cb(GtkWidget * widget, gpointer data) {
   return;
 }
 
+/* function called when the memory layout of a data set gets changed */
+static void dialog_change_voxel_layout_cb(GtkWidget * widget, gpointer data) {
+
+  AmitkObjectDialog * dialog = data;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(dialog->object));
+  ui_common_place_cursor(UI_CURSOR_WAIT, widget);
+  amitk_data_set_set_layout(AMITK_DATA_SET(dialog->object), 
+			    gtk_combo_box_get_active(GTK_COMBO_BOX(widget)));
+  ui_common_remove_wait_cursor(widget);
+
+  return;
+}
+
 /* function called when the subject orientation of a data set gets changed */
 static void dialog_change_subject_orientation_cb(GtkWidget * widget, gpointer data) {
 
@@ -76,6 +76,7 @@ struct _AmitkObjectDialog
   GtkWidget * creation_date_entry;
   GtkWidget * interpolation_button[AMITK_INTERPOLATION_NUM];
   GtkWidget * rendering_menu;
+  GtkWidget * voxel_layout_menu;
   GtkWidget * conversion_button[AMITK_CONVERSION_NUM];
 
   GtkWidget * center_spin[AMITK_AXIS_NUM];
@@ -160,6 +160,12 @@ static void preferences_init (AmitkPreferences * preferences) {
   preferences->prompt_for_save_on_exit = 
     amide_gconf_get_bool_with_default(GCONF_AMIDE_MISC,"PromptForSaveOnExit", AMITK_PREFERENCES_DEFAULT_PROMPT_FOR_SAVE_ON_EXIT);
 
+  preferences->save_xif_compressed = 
+    amide_gconf_get_bool_with_default(GCONF_AMIDE_MISC,"SaveXifCompressed", AMITK_PREFERENCES_DEFAULT_SAVE_XIF_COMPRESSED);
+
+  preferences->dicom_use_index = 
+    amide_gconf_get_bool_with_default(GCONF_AMIDE_MISC,"DicomUseIndex", AMITK_PREFERENCES_DEFAULT_DICOM_USE_INDEX);
+
   preferences->which_default_directory = 
     amide_gconf_get_int_with_default(GCONF_AMIDE_MISC,"WhichDefaultDirectory", AMITK_PREFERENCES_DEFAULT_WHICH_DEFAULT_DIRECTORY);
 
@@ -361,6 +367,30 @@ void amitk_preferences_set_prompt_for_save_on_exit(AmitkPreferences * preference
   return;
 }
 
+void amitk_preferences_set_save_xif_compressed(AmitkPreferences * preferences, gboolean new_value) {
+
+  g_return_if_fail(AMITK_IS_PREFERENCES(preferences));
+
+  if (AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(preferences) != new_value) {
+    preferences->save_xif_compressed = new_value;
+    amide_gconf_set_bool(GCONF_AMIDE_MISC,"SaveXifCompressed",new_value);
+    g_signal_emit(G_OBJECT(preferences), preferences_signals[MISC_PREFERENCES_CHANGED], 0);
+  }
+  return;
+}
+
+void amitk_preferences_set_dicom_use_index(AmitkPreferences * preferences, gboolean new_value) {
+
+  g_return_if_fail(AMITK_IS_PREFERENCES(preferences));
+
+  if (AMITK_PREFERENCES_DICOM_USE_INDEX(preferences) != new_value) {
+    preferences->dicom_use_index = new_value;
+    amide_gconf_set_bool(GCONF_AMIDE_MISC,"DicomUseIndex",new_value);
+    g_signal_emit(G_OBJECT(preferences), preferences_signals[MISC_PREFERENCES_CHANGED], 0);
+  }
+  return;
+}
+
 void amitk_preferences_set_which_default_directory(AmitkPreferences * preferences, AmitkWhichDefaultDirectory new_value) {
 
   g_return_if_fail(AMITK_IS_PREFERENCES(preferences));
@@ -43,6 +43,8 @@ G_BEGIN_DECLS
 #define AMITK_PREFERENCES_WARNINGS_TO_CONSOLE(object)     (AMITK_PREFERENCES(object)->warnings_to_console)
 
 #define AMITK_PREFERENCES_PROMPT_FOR_SAVE_ON_EXIT(object) (AMITK_PREFERENCES(object)->prompt_for_save_on_exit)
+#define AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(object)     (AMITK_PREFERENCES(object)->save_xif_compressed)
+#define AMITK_PREFERENCES_DICOM_USE_INDEX(object)         (AMITK_PREFERENCES(object)->dicom_use_index)
 #define AMITK_PREFERENCES_WHICH_DEFAULT_DIRECTORY(object) (AMITK_PREFERENCES(object)->which_default_directory)
 #define AMITK_PREFERENCES_DEFAULT_DIRECTORY(object)       (AMITK_PREFERENCES(object)->default_directory)
 
@@ -83,6 +85,8 @@ typedef enum {
 #define AMITK_PREFERENCES_DEFAULT_WARNINGS_TO_CONSOLE FALSE
 #define AMITK_PREFERENCES_DEFAULT_PROMPT_FOR_SAVE_ON_EXIT TRUE
 #define AMITK_PREFERENCES_DEFAULT_SAVE_XIF_AS_DIRECTORY FALSE
+#define AMITK_PREFERENCES_DEFAULT_SAVE_XIF_COMPRESSED FALSE
+#define AMITK_PREFERENCES_DEFAULT_DICOM_USE_INDEX FALSE
 #define AMITK_PREFERENCES_DEFAULT_WHICH_DEFAULT_DIRECTORY AMITK_WHICH_DEFAULT_DIRECTORY_NONE
 #define AMITK_PREFERENCES_DEFAULT_DEFAULT_DIRECTORY NULL
 #define AMITK_PREFERENCES_DEFAULT_THRESHOLD_STYLE AMITK_THRESHOLD_STYLE_MIN_MAX
@@ -107,9 +111,13 @@ struct _AmitkPreferences {
   /* file saving preferences */
   gboolean prompt_for_save_on_exit;
   gboolean save_xif_as_directory;
+  gboolean save_xif_compressed;
   AmitkWhichDefaultDirectory which_default_directory;
   gchar * default_directory;
 
+  /* file loading preferences */
+  gboolean dicom_use_index;
+
   /* canvas preferences -> study preferences */
   gint canvas_roi_width;
   gdouble canvas_roi_transparency;
@@ -170,6 +178,10 @@ void                amitk_preferences_set_warnings_to_console    (AmitkPreferenc
 								  gboolean new_value);
 void                amitk_preferences_set_prompt_for_save_on_exit(AmitkPreferences * preferences,
 								  gboolean new_value);
+void                amitk_preferences_set_save_xif_compressed    (AmitkPreferences * preferences,
+							          gboolean new_value);
+void                amitk_preferences_set_dicom_use_index        (AmitkPreferences * preferences,
+							          gboolean new_value);
 void                amitk_preferences_set_xif_as_directory       (AmitkPreferences * preferences,
 							          gboolean new_value);
 void                amitk_preferences_set_which_default_directory(AmitkPreferences * preferences,
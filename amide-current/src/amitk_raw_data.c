@@ -27,6 +27,15 @@
 
 #include <sys/stat.h>
 #include <stdio.h>
+#include <string.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#include <unistd.h>
+#define AMITK_RAW_DATA_MMAP
+#endif
+#ifdef AMIDE_ZLIB_SUPPORT
+#include <zlib.h>
+#endif
 
 #include "amitk_raw_data.h"
 #include "amitk_marshal.h"
@@ -213,6 +222,9 @@ static void raw_data_init (AmitkRawData * raw_data) {
   raw_data->dim = zero_voxel;
   raw_data->data = NULL;
   raw_data->format = AMITK_FORMAT_DOUBLE;
+  raw_data->layout = AMITK_RAW_DATA_LAYOUT_LINEAR;
+  raw_data->mapping = NULL;
+  raw_data->mapping_length = 0;
 
   return;
 }
@@ -222,6 +234,14 @@ static void raw_data_finalize (GObject *object) {
 
   AmitkRawData * raw_data = AMITK_RAW_DATA(object);
 
+#ifdef AMITK_RAW_DATA_MMAP
+  if (raw_data->mapping != NULL) {
+    munmap(raw_data->mapping, raw_data->mapping_length);
+    raw_data->mapping = NULL;
+    raw_data->data = NULL;
+  }
+#endif
+
   if (raw_data->data != NULL) {
 #ifdef AMIDE_DEBUG
     //g_print("\tfreeing raw data\n");
@@ -324,6 +344,80 @@ AmitkRawData* amitk_raw_data_new_with_data0(AmitkFormat format, AmitkVoxel dim)
 
 
 
+#ifdef AMITK_RAW_DATA_MMAP
+/* tries to wrap a memory map of the file around the raw data, instead of reading it
+   in.  This only works if the data on disk is already in the format we'd use in 
+   memory.  The mapping is private, so pages are shared with the page cache (and 
+   other processes) until something writes into them, at which point that page is 
+   copied.  Returns NULL if the file can't be mapped, in which case the data should 
+   just be read in. */
+static AmitkRawData * raw_data_map_file(const gchar * file_name, 
+					FILE * existing_file,
+					AmitkRawFormat raw_format,
+					AmitkVoxel dim,
+					long file_offset) {
+
+  AmitkRawData * raw_data=NULL;
+  AmitkFormat format;
+  FILE * new_file_pointer=NULL;
+  struct stat file_info;
+  gsize num_bytes;
+  long page_size;
+  long map_offset;
+  gsize map_length;
+  gpointer map;
+  int fd;
+
+  if (raw_format == AMITK_RAW_FORMAT_ASCII_8_NE) return NULL;
+
+  /* data needs to be in native format, and aligned */
+  format = amitk_raw_format_to_format(raw_format);
+  if (amitk_format_to_raw_format(format) != raw_format) return NULL;
+  if ((file_offset % amitk_format_sizes[format]) != 0) return NULL;
+
+  num_bytes = amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format);
+  num_bytes *= (gsize) dim.z * dim.g * dim.t;
+  if (num_bytes == 0) return NULL;
+
+  page_size = sysconf(_SC_PAGESIZE);
+  if (page_size <= 0) return NULL;
+
+  if (existing_file == NULL) {
+    if ((new_file_pointer = fopen(file_name, "rb")) == NULL)
+      return NULL;
+    fd = fileno(new_file_pointer);
+  } else {
+    fd = fileno(existing_file);
+  }
+
+  /* if the file's too short, let the normal read path complain about it */
+  if (fstat(fd, &file_info) != 0) goto exit_condition;
+  if ((guint64) file_info.st_size < ((guint64) file_offset) + num_bytes) goto exit_condition;
+
+  /* mappings have to start on a page boundary */
+  map_offset = file_offset - (file_offset % page_size);
+  map_length = num_bytes + (file_offset - map_offset);
+  map = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, map_offset);
+  if (map == MAP_FAILED) goto exit_condition;
+
+  raw_data = amitk_raw_data_new();
+  raw_data->format = format;
+  raw_data->dim = dim;
+  raw_data->mapping = map;
+  raw_data->mapping_length = map_length;
+  raw_data->data = ((guchar *) map) + (file_offset - map_offset);
+
+ exit_condition:
+  /* the mapping stays valid after the file is closed */
+  if (new_file_pointer != NULL)
+    fclose(new_file_pointer);
+
+  return raw_data;
+}
+#endif
+
+
+
 /* reads the contents of a raw data file into an amide raw data structure,
 
    notes: 
@@ -331,6 +425,8 @@ AmitkRawData* amitk_raw_data_new_with_data0(AmitkFormat format, AmitkVoxel dim)
    1. file_offset is bytes for a binary file, lines for an ascii file
    2. either file_name, of existing_file need to be specified.  
       If existing_file is not being used, it must be NULL
+   3. if the data is already in our in memory format, the file is memory 
+      mapped instead of read in (where supported)
 */
 AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name, 
 					      FILE * existing_file,
@@ -365,6 +461,11 @@ AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name,
   total_planes = dim.z*dim.t*dim.g;
   divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
 
+#ifdef AMITK_RAW_DATA_MMAP
+  raw_data = raw_data_map_file(file_name, existing_file, raw_format, dim, file_offset);
+  if (raw_data != NULL) goto exit_condition;
+#endif
+
   raw_data = amitk_raw_data_new_with_data(amitk_raw_format_to_format(raw_format), dim);
   if (raw_data == NULL) {
     g_warning(_("couldn't allocate memory space for the raw data set structure"));
@@ -784,10 +885,417 @@ AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name,
 }
 
 
+/* writes the raw data out a plane at a time, for data that isn't stored linearly */
+static gboolean raw_data_write_planes(AmitkRawData * raw_data, FILE * file_pointer) {
+
+  AmitkVoxel i;
+  gpointer buffer;
+  gpointer plane;
+  size_t num_per_plane;
+  gboolean okay=TRUE;
+
+  buffer = g_try_malloc(amitk_raw_data_size_plane_mem(raw_data));
+  if (buffer == NULL) return FALSE;
+  num_per_plane = raw_data->dim.x*raw_data->dim.y;
+
+  i = zero_voxel;
+  for (i.t=0; (i.t < raw_data->dim.t) && okay; i.t++)
+    for (i.g=0; (i.g < raw_data->dim.g) && okay; i.g++)
+      for (i.z=0; (i.z < raw_data->dim.z) && okay; i.z++) {
+	plane = amitk_raw_data_get_plane(raw_data, i, buffer);
+	if (fwrite(plane, amitk_format_sizes[raw_data->format], num_per_plane, file_pointer) != num_per_plane)
+	  okay = FALSE;
+      }
+
+  g_free(buffer);
+
+  return okay;
+}
+
+/* writes the raw data out as is */
+static gboolean raw_data_write_data(AmitkRawData * raw_data, FILE * file_pointer) {
+
+  size_t num_wrote;
+  size_t num_to_write;
+  size_t num_to_write_this_time;
+  size_t bytes_per_unit;
+  size_t total_wrote = 0;
+
+  /* files are always written out linearly */
+  if (raw_data->layout != AMITK_RAW_DATA_LAYOUT_LINEAR)
+    return raw_data_write_planes(raw_data, file_pointer);
+
+  num_to_write = amitk_raw_data_num_voxels(raw_data);
+  bytes_per_unit = amitk_format_sizes[AMITK_RAW_DATA_FORMAT(raw_data)]; 
+   
+  /* write in small chunks (<=16MB) to get around a bad samba/cygwin interaction */
+  while(num_to_write > 0) {
+    if (num_to_write*bytes_per_unit > 0x1000000) 
+      num_to_write_this_time = 0x1000000/bytes_per_unit;
+    else
+      num_to_write_this_time = num_to_write;
+    num_to_write -= num_to_write_this_time;
+    
+    num_wrote = fwrite((raw_data->data + total_wrote*bytes_per_unit),
+		       bytes_per_unit, num_to_write_this_time, file_pointer);
+    total_wrote += num_wrote;
+    
+    if (num_wrote != num_to_write_this_time) 
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+#ifdef AMIDE_ZLIB_SUPPORT
+
+/* Compressed raw data is stored as a series of 3D bricks, each compressed with
+   zlib.  Bricks are ordered x fastest, then y, z, gate, and frame, and are 
+   clipped at the edges of the data.  The xml file holds the brick dimensions and 
+   the compressed size of each brick. The data in the bricks is in the raw 
+   format given in the xml file.
+
+   Bricks are compressed/decompressed in parallel, a batch at a time, with the
+   file I/O done from the calling thread */
+
+static const AmitkVoxel raw_data_brick_dim = {64, 64, 16, 1, 1};
+
+/* bricks handed out to threads at once, per thread */
+#define BRICKS_PER_THREAD 2
+
+typedef struct {
+  AmitkRawData * raw_data;
+  AmitkVoxel brick_dim;
+  gint first_brick;
+  gsize max_brick_bytes;
+  gsize max_compressed_bytes;
+  gboolean swap_bytes;
+  guchar * brick_buffers;   /* max_brick_bytes per brick in the batch */
+  guchar * compressed;      /* max_compressed_bytes per brick in the batch */
+  gsize * compressed_sizes;
+  gboolean * okay;
+} raw_data_bricks_t;
+
+static gint raw_data_num_bricks(const AmitkVoxel dim, const AmitkVoxel brick_dim) {
+  return ((dim.x+brick_dim.x-1)/brick_dim.x) * 
+    ((dim.y+brick_dim.y-1)/brick_dim.y) * 
+    ((dim.z+brick_dim.z-1)/brick_dim.z) * dim.g * dim.t;
+}
+
+/* figure out what voxels are in the given brick, end is exclusive */
+static void raw_data_brick_bounds(const AmitkVoxel dim, const AmitkVoxel brick_dim, gint brick,
+				  AmitkVoxel * pstart, AmitkVoxel * pend) {
+
+  AmitkVoxel num;
+
+  num.x = (dim.x+brick_dim.x-1)/brick_dim.x;
+  num.y = (dim.y+brick_dim.y-1)/brick_dim.y;
+  num.z = (dim.z+brick_dim.z-1)/brick_dim.z;
+
+  pstart->x = (brick % num.x)*brick_dim.x;
+  brick /= num.x;
+  pstart->y = (brick % num.y)*brick_dim.y;
+  brick /= num.y;
+  pstart->z = (brick % num.z)*brick_dim.z;
+  brick /= num.z;
+  pstart->g = brick % dim.g;
+  pstart->t = brick / dim.g;
+
+  pend->x = MIN(pstart->x+brick_dim.x, dim.x);
+  pend->y = MIN(pstart->y+brick_dim.y, dim.y);
+  pend->z = MIN(pstart->z+brick_dim.z, dim.z);
+  pend->g = pstart->g+1;
+  pend->t = pstart->t+1;
+
+  return;
+}
+
+/* copy between a brick's buffer and the raw data, returns the number of bytes in the brick */
+static gsize raw_data_copy_brick(AmitkRawData * raw_data, guchar * buffer,
+				 const AmitkVoxel start, const AmitkVoxel end,
+				 const gboolean to_brick) {
+
+  AmitkVoxel i;
+  gsize row_bytes;
+  guchar * brick_p = buffer;
+  gpointer row;
+
+  /* when reading, raw_data is always freshly allocated linear data */
+  g_return_val_if_fail(to_brick || (raw_data->layout == AMITK_RAW_DATA_LAYOUT_LINEAR), 0);
+
+  row_bytes = (end.x-start.x)*amitk_format_sizes[raw_data->format];
+  i = start;
+  for (i.z=start.z; i.z < end.z; i.z++)
+    for (i.y=start.y; i.y < end.y; i.y++, brick_p += row_bytes) {
+      if (to_brick) {
+	row = amitk_raw_data_get_row(raw_data, i, end.x-start.x, brick_p);
+	if (row != brick_p) memcpy(brick_p, row, row_bytes);
+      } else
+	memcpy(amitk_raw_data_get_pointer(raw_data, i), brick_p, row_bytes);
+    }
+
+  return brick_p-buffer;
+}
+
+/* reverses the bytes of each element, for data from a machine of the other endianness */
+static void raw_data_swap_bytes(guchar * buffer, const gsize num_bytes, const gsize element_size) {
+
+  gsize j, k;
+  guchar temp;
+
+  for (j=0; j < num_bytes; j += element_size) 
+    for (k=0; k < element_size/2; k++) {
+      temp = buffer[j+k];
+      buffer[j+k] = buffer[j+element_size-1-k];
+      buffer[j+element_size-1-k] = temp;
+    }
+
+  return;
+}
+
+static void raw_data_compress_bricks(const gint start, const gint end, gpointer data) {
+
+  raw_data_bricks_t * bricks = data;
+  AmitkVoxel brick_start, brick_end;
+  guchar * brick_buffer;
+  uLongf compressed_size;
+  gsize brick_bytes;
+  gint j;
+
+  for (j=start; j<end; j++) {
+    raw_data_brick_bounds(AMITK_RAW_DATA_DIM(bricks->raw_data), bricks->brick_dim, 
+			  bricks->first_brick+j, &brick_start, &brick_end);
+    brick_buffer = bricks->brick_buffers + j*bricks->max_brick_bytes;
+    brick_bytes = raw_data_copy_brick(bricks->raw_data, brick_buffer, brick_start, brick_end, TRUE);
+
+    compressed_size = bricks->max_compressed_bytes;
+    bricks->okay[j] = (compress2(bricks->compressed + j*bricks->max_compressed_bytes, &compressed_size,
+				 brick_buffer, brick_bytes, Z_DEFAULT_COMPRESSION) == Z_OK);
+    bricks->compressed_sizes[j] = compressed_size;
+  }
+
+  return;
+}
+
+static void raw_data_decompress_bricks(const gint start, const gint end, gpointer data) {
+
+  raw_data_bricks_t * bricks = data;
+  AmitkVoxel brick_start, brick_end;
+  guchar * brick_buffer;
+  uLongf brick_bytes;
+  gint j;
+
+  for (j=start; j<end; j++) {
+    raw_data_brick_bounds(AMITK_RAW_DATA_DIM(bricks->raw_data), bricks->brick_dim, 
+			  bricks->first_brick+j, &brick_start, &brick_end);
+    brick_buffer = bricks->brick_buffers + j*bricks->max_brick_bytes;
+
+    brick_bytes = bricks->max_brick_bytes;
+    bricks->okay[j] = (uncompress(brick_buffer, &brick_bytes, 
+				  bricks->compressed + j*bricks->max_compressed_bytes,
+				  bricks->compressed_sizes[j]) == Z_OK);
+    if (bricks->okay[j])  /* make sure we got a complete brick */
+      bricks->okay[j] = (brick_bytes == ((gsize) (brick_end.x-brick_start.x)) * (brick_end.y-brick_start.y) * 
+			 (brick_end.z-brick_start.z) * amitk_format_sizes[bricks->raw_data->format]);
+    if (!bricks->okay[j]) continue;
+
+    if (bricks->swap_bytes)
+      raw_data_swap_bytes(brick_buffer, brick_bytes, amitk_format_sizes[bricks->raw_data->format]);
+    raw_data_copy_brick(bricks->raw_data, brick_buffer, brick_start, brick_end, FALSE);
+  }
+
+  return;
+}
+
+/* allocate the buffers for a batch of bricks, returns the number of bricks per batch */
+static gint raw_data_bricks_alloc(raw_data_bricks_t * bricks, AmitkRawData * raw_data, 
+				  const AmitkVoxel brick_dim, const gint num_bricks) {
+  gint batch_bricks;
+
+  batch_bricks = MIN(num_bricks, BRICKS_PER_THREAD*amitk_get_num_threads());
+  bricks->raw_data = raw_data;
+  bricks->brick_dim = brick_dim;
+  bricks->swap_bytes = FALSE;
+  bricks->max_brick_bytes = ((gsize) brick_dim.x)*brick_dim.y*brick_dim.z*amitk_format_sizes[raw_data->format];
+  bricks->max_compressed_bytes = compressBound(bricks->max_brick_bytes);
+  bricks->brick_buffers = g_try_malloc(batch_bricks*bricks->max_brick_bytes);
+  bricks->compressed = g_try_malloc(batch_bricks*bricks->max_compressed_bytes);
+  bricks->compressed_sizes = g_new(gsize, batch_bricks);
+  bricks->okay = g_new(gboolean, batch_bricks);
+
+  if ((bricks->brick_buffers == NULL) || (bricks->compressed == NULL)) {
+    g_warning(_("couldn't allocate memory space for compressing raw data"));
+    return 0;
+  }
+
+  return batch_bricks;
+}
+
+static void raw_data_bricks_free(raw_data_bricks_t * bricks) {
+  g_free(bricks->brick_buffers);
+  g_free(bricks->compressed);
+  g_free(bricks->compressed_sizes);
+  g_free(bricks->okay);
+  return;
+}
+
+/* writes out the raw data as compressed bricks, returns the list of
+   compressed brick sizes, or NULL on error */
+static GString * raw_data_write_bricks(AmitkRawData * raw_data, FILE * file_pointer, 
+				       const AmitkVoxel brick_dim) {
+
+  raw_data_bricks_t bricks;
+  GString * brick_sizes;
+  gint num_bricks, batch_bricks, num_in_batch;
+  gint j;
+  gboolean okay=TRUE;
+
+  num_bricks = raw_data_num_bricks(AMITK_RAW_DATA_DIM(raw_data), brick_dim);
+  batch_bricks = raw_data_bricks_alloc(&bricks, raw_data, brick_dim, num_bricks);
+  if ((batch_bricks == 0) && (num_bricks > 0)) {
+    raw_data_bricks_free(&bricks);
+    return NULL;
+  }
+  brick_sizes = g_string_new(NULL);
+
+  for (bricks.first_brick=0; (bricks.first_brick < num_bricks) && okay; bricks.first_brick += num_in_batch) {
+    num_in_batch = MIN(batch_bricks, num_bricks-bricks.first_brick);
+    amitk_parallel_for(num_in_batch, 1, raw_data_compress_bricks, &bricks);
+
+    for (j=0; (j < num_in_batch) && okay; j++) {
+      okay = bricks.okay[j];
+      if (okay)
+	okay = (fwrite(bricks.compressed + j*bricks.max_compressed_bytes, 1, 
+		       bricks.compressed_sizes[j], file_pointer) == bricks.compressed_sizes[j]);
+      g_string_append_printf(brick_sizes, "%s%" G_GSIZE_FORMAT, 
+			     (bricks.first_brick+j == 0) ? "" : " ", bricks.compressed_sizes[j]);
+    }
+  }
+  raw_data_bricks_free(&bricks);
+
+  if (!okay) {
+    g_string_free(brick_sizes, TRUE);
+    return NULL;
+  }
+
+  return brick_sizes;
+}
+
+/* reads in raw data stored as compressed bricks */
+static AmitkRawData * raw_data_read_bricks(const gchar * file_name, 
+					   FILE * existing_file,
+					   AmitkRawFormat raw_format,
+					   AmitkVoxel dim,
+					   long file_offset,
+					   AmitkVoxel brick_dim,
+					   const gchar * brick_sizes,
+					   gchar ** perror_buf,
+					   AmitkUpdateFunc update_func,
+					   gpointer update_data) {
+
+  AmitkRawData * raw_data;
+  raw_data_bricks_t bricks;
+  FILE * new_file_pointer=NULL;
+  FILE * file_pointer;
+  gchar * temp_string;
+  const gchar * sizes_p;
+  gchar * end_p;
+  gint num_bricks, batch_bricks, num_in_batch;
+  gint j;
+  gboolean okay=TRUE;
+  gboolean continue_work=TRUE;
+
+  if ((brick_dim.x < 1) || (brick_dim.y < 1) || (brick_dim.z < 1) || (brick_sizes == NULL)) {
+    amitk_append_str_with_newline(perror_buf, _("Compressed raw data has an invalid brick index"));
+    return NULL;
+  }
+
+  raw_data = amitk_raw_data_new_with_data(amitk_raw_format_to_format(raw_format), dim);
+  if (raw_data == NULL) {
+    amitk_append_str_with_newline(perror_buf, _("couldn't allocate memory space for the raw data set structure"));
+    return NULL;
+  }
+
+  if (existing_file == NULL) {
+    if ((new_file_pointer = fopen(file_name, "rb")) == NULL) {
+      amitk_append_str_with_newline(perror_buf, _("couldn't open raw data file %s"), file_name);
+      g_object_unref(raw_data);
+      return NULL;
+    }
+    file_pointer = new_file_pointer;
+  } else {
+    file_pointer = existing_file;
+  }
+
+  if (fseek(file_pointer, file_offset, SEEK_SET) != 0) {
+    amitk_append_str_with_newline(perror_buf, _("could not seek forward %ld bytes in raw data file"),file_offset);
+    okay = FALSE;
+  }
+
+  num_bricks = raw_data_num_bricks(dim, brick_dim);
+  batch_bricks = raw_data_bricks_alloc(&bricks, raw_data, brick_dim, num_bricks);
+  if ((batch_bricks == 0) && (num_bricks > 0)) okay = FALSE;
+  bricks.swap_bytes = (amitk_format_to_raw_format(raw_data->format) != raw_format);
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Reading: %s"), (file_name != NULL) ? file_name : "raw data");
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+
+  sizes_p = brick_sizes;
+  for (bricks.first_brick=0; (bricks.first_brick < num_bricks) && okay && continue_work; 
+       bricks.first_brick += num_in_batch) {
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, ((gdouble) bricks.first_brick)/((gdouble) num_bricks));
+
+    /* read in this batch of bricks */
+    num_in_batch = MIN(batch_bricks, num_bricks-bricks.first_brick);
+    for (j=0; (j < num_in_batch) && okay; j++) {
+      bricks.compressed_sizes[j] = g_ascii_strtoull(sizes_p, &end_p, 10);
+      okay = ((end_p != sizes_p) && (bricks.compressed_sizes[j] <= bricks.max_compressed_bytes));
+      sizes_p = end_p;
+      if (okay)
+	okay = (fread(bricks.compressed + j*bricks.max_compressed_bytes, 1,
+		      bricks.compressed_sizes[j], file_pointer) == bricks.compressed_sizes[j]);
+    }
+    if (!okay) {
+      amitk_append_str_with_newline(perror_buf, _("Compressed raw data is truncated or has an invalid brick index"));
+      break;
+    }
+
+    amitk_parallel_for(num_in_batch, 1, raw_data_decompress_bricks, &bricks);
+    for (j=0; (j < num_in_batch) && okay; j++)
+      okay = bricks.okay[j];
+    if (!okay) 
+      amitk_append_str_with_newline(perror_buf, _("Compressed raw data is corrupt"));
+  }
+  raw_data_bricks_free(&bricks);
+
+  if (update_func != NULL) 
+    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+
+  if (new_file_pointer != NULL)
+    fclose(new_file_pointer);
+
+  if (!okay || !continue_work) {
+    g_object_unref(raw_data);
+    return NULL;
+  }
+
+  return raw_data;
+}
+
+#endif /* AMIDE_ZLIB_SUPPORT */
+
+
 /* function to write out the information content of a raw_data set into an xml
-   file.  Returns a string containing the name of the file. */
+   file.  Returns a string containing the name of the file.  If compressed is
+   TRUE, and we have zlib, the data gets written out as compressed bricks */
 void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name, 
-			      FILE *study_file, gchar ** output_filename, guint64 * plocation,
+			      FILE *study_file, const gboolean compressed, 
+			      gchar ** output_filename, guint64 * plocation,
 			      guint64 * psize) {
 
   gchar * xml_filename=NULL;
@@ -797,12 +1305,11 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
   xmlDocPtr doc;
   FILE * file_pointer;
   guint64 location, size;
-  size_t num_wrote;
-  size_t num_to_write;
-  size_t num_to_write_this_time;
-  size_t bytes_per_unit;
-  size_t total_to_write;
-  size_t total_wrote = 0;
+  gboolean okay;
+#ifdef AMIDE_ZLIB_SUPPORT
+  GString * brick_sizes=NULL;
+  AmitkVoxel brick_dim = raw_data_brick_dim;
+#endif
 
   if (study_file == NULL) {
     /* make a guess as to our filename */
@@ -837,34 +1344,20 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
   
   /* write it on out.  */
   location = ftell(file_pointer);
-  num_to_write = amitk_raw_data_num_voxels(raw_data);
-  bytes_per_unit = amitk_format_sizes[AMITK_RAW_DATA_FORMAT(raw_data)]; 
-  total_to_write = num_to_write;
-   
-  /* write in small chunks (<=16MB) to get around a bad samba/cygwin interaction */
-  while(num_to_write > 0) {
-    if (num_to_write*bytes_per_unit > 0x1000000) 
-      num_to_write_this_time = 0x1000000/bytes_per_unit;
-    else
-      num_to_write_this_time = num_to_write;
-    num_to_write -= num_to_write_this_time;
-    
-    num_wrote = fwrite((raw_data->data + total_wrote*bytes_per_unit),
-		       bytes_per_unit, num_to_write_this_time, file_pointer);
-    total_wrote += num_wrote;
-    
-    if (num_wrote != num_to_write_this_time) {
-      g_warning(_("incomplete save of raw data, wrote %zd (bytes), needed %zd (bytes), file: %s"),
-		total_wrote*bytes_per_unit, 
-		total_to_write*bytes_per_unit,
-		raw_filename);
-      g_free(xml_filename);
-      g_free(raw_filename);
-      if (study_file == NULL) fclose(file_pointer);
-      return;
-    }
+#ifdef AMIDE_ZLIB_SUPPORT
+  if (compressed)
+    okay = ((brick_sizes = raw_data_write_bricks(raw_data, file_pointer, brick_dim)) != NULL);
+  else
+#endif
+    okay = raw_data_write_data(raw_data, file_pointer);
+
+  if (!okay) {
+    g_warning(_("incomplete save of raw data, file: %s"), raw_filename);
+    g_free(xml_filename);
+    g_free(raw_filename);
+    if (study_file == NULL) fclose(file_pointer);
+    return;
   }
- 
   
   size = ftell(file_pointer)-location;
   if (study_file == NULL) fclose(file_pointer);
@@ -875,6 +1368,14 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
   amitk_voxel_write_xml(doc->children, "dim", raw_data->dim);
   xml_save_string(doc->children,"raw_format", 
 		  amitk_raw_format_get_name(amitk_format_to_raw_format(raw_data->format)));
+#ifdef AMIDE_ZLIB_SUPPORT
+  if (brick_sizes != NULL) {
+    xml_save_string(doc->children, "compression", "zlib");
+    amitk_voxel_write_xml(doc->children, "brick_dim", brick_dim);
+    xml_save_string(doc->children, "brick_sizes", brick_sizes->str);
+    g_string_free(brick_sizes, TRUE);
+  }
+#endif
 
   /* store the info on our associated data */
   if (study_file == NULL) {
@@ -921,6 +1422,9 @@ AmitkRawData * amitk_raw_data_read_xml(gchar * xml_filename,
   guint64 offset, dummy;
   long offset_long=0;
   AmitkVoxel dim;
+#ifdef AMIDE_ZLIB_SUPPORT
+  AmitkVoxel brick_dim;
+#endif
 
 
   if ((doc = xml_open_doc(xml_filename, study_file, location, size, perror_buf)) == NULL)
@@ -976,8 +1480,30 @@ AmitkRawData * amitk_raw_data_read_xml(gchar * xml_filename,
   }
 
 
-  raw_data = amitk_raw_data_import_raw_file(raw_filename, study_file, raw_format, dim, offset_long, 
-					    update_func, update_data);
+  /* compressed data is only written by versions compiled with zlib */
+  if (xml_node_exists(nodes, "compression")) {
+    temp_string = xml_get_string(nodes, "compression");
+#ifdef AMIDE_ZLIB_SUPPORT
+    if (g_ascii_strcasecmp(temp_string, "zlib") == 0) {
+      gchar * brick_sizes;
+
+      brick_dim = amitk_voxel_read_xml(nodes, "brick_dim", perror_buf);
+      brick_sizes = xml_get_string(nodes, "brick_sizes");
+      raw_data = raw_data_read_bricks(raw_filename, study_file, raw_format, dim, offset_long, 
+				      brick_dim, brick_sizes, perror_buf, update_func, update_data);
+      g_free(brick_sizes);
+    } else 
+#endif
+      {
+	amitk_append_str_with_newline(perror_buf, _("Raw data is compressed with \"%s\", which this version of AMIDE can't read"), 
+				      temp_string);
+	raw_data = NULL;
+      }
+    g_free(temp_string);
+  } else {
+    raw_data = amitk_raw_data_import_raw_file(raw_filename, study_file, raw_format, dim, offset_long, 
+					      update_func, update_data);
+  }
 
   /* and we're done */
   if (raw_filename != NULL) g_free(raw_filename);
@@ -1047,6 +1573,148 @@ gpointer amitk_raw_data_get_pointer(const AmitkRawData * rd, const AmitkVoxel i)
 
 
 
+/* moves num voxels, starting at voxel i and going along x, between the raw data
+   and a linear buffer.  Works for either layout. */
+static void raw_data_transfer_row(const AmitkRawData * rd, const AmitkVoxel i, 
+				  const amide_intpoint_t num, guchar * buffer, 
+				  const gboolean to_buffer) {
+
+  guchar * data;
+  guchar * voxel_p;
+  guchar * from;
+  guchar * to;
+  guint size;
+  AmitkVoxel j;
+
+  size = amitk_format_sizes[rd->format];
+  data = rd->data;
+  j = i;
+  for (j.x = i.x; j.x < i.x+num; j.x++, buffer += size) {
+    voxel_p = data + amitk_raw_data_voxel_offset(rd, j)*size;
+    from = to_buffer ? voxel_p : buffer;
+    to = to_buffer ? buffer : voxel_p;
+    switch(size) {
+    case 1:
+      *((guint8 *) to) = *((guint8 *) from);
+      break;
+    case 2:
+      *((guint16 *) to) = *((guint16 *) from);
+      break;
+    case 4:
+      *((guint32 *) to) = *((guint32 *) from);
+      break;
+    case 8:
+      *((guint64 *) to) = *((guint64 *) from);
+      break;
+    default:
+      memcpy(to, from, size);
+      break;
+    }
+  }
+
+  return;
+}
+
+/* returns a pointer to num voxels along x starting at voxel i.  For linear data 
+   this points straight into the raw data, otherwise the voxels are gathered into 
+   buffer, which needs to hold num voxels. Either way, treat the result as read only. */
+gpointer amitk_raw_data_get_row(const AmitkRawData * rd, const AmitkVoxel i, 
+				const amide_intpoint_t num, gpointer buffer) {
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(rd), NULL);
+  g_return_val_if_fail(amitk_raw_data_includes_voxel(rd, i), NULL);
+  g_return_val_if_fail(i.x+num <= rd->dim.x, NULL);
+
+  if (rd->layout == AMITK_RAW_DATA_LAYOUT_LINEAR)
+    return amitk_raw_data_get_pointer(rd, i);
+
+  g_return_val_if_fail(buffer != NULL, NULL);
+  raw_data_transfer_row(rd, i, num, buffer, TRUE);
+  return buffer;
+}
+
+/* returns a pointer to the x/y plane (linearly ordered) at i.z, i.g, i.t.  
+   As with amitk_raw_data_get_row, buffer is only used for non-linear data,
+   and needs to be amitk_raw_data_size_plane_mem bytes */
+gpointer amitk_raw_data_get_plane(const AmitkRawData * rd, const AmitkVoxel i, gpointer buffer) {
+
+  AmitkVoxel j;
+  gsize row_bytes;
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(rd), NULL);
+
+  j = i;
+  j.x = j.y = 0;
+  if (rd->layout == AMITK_RAW_DATA_LAYOUT_LINEAR)
+    return amitk_raw_data_get_pointer(rd, j);
+
+  g_return_val_if_fail(buffer != NULL, NULL);
+  row_bytes = rd->dim.x*amitk_format_sizes[rd->format];
+  for (j.y=0; j.y < rd->dim.y; j.y++)
+    raw_data_transfer_row(rd, j, rd->dim.x, ((guchar *) buffer) + j.y*row_bytes, TRUE);
+
+  return buffer;
+}
+
+
+typedef struct {
+  const AmitkRawData * src;
+  AmitkRawData * dest;
+} raw_data_relayout_t;
+
+static void raw_data_relayout_planes(const gint start, const gint end, gpointer data) {
+
+  raw_data_relayout_t * relayout = data;
+  const AmitkRawData * src = relayout->src;
+  AmitkRawData * dest = relayout->dest;
+  AmitkVoxel i;
+  gint plane;
+
+  i = zero_voxel;
+  for (plane = start; plane < end; plane++) {
+    i.z = plane % src->dim.z;
+    i.g = (plane / src->dim.z) % src->dim.g;
+    i.t = plane / (src->dim.z*src->dim.g);
+    for (i.y=0; i.y < src->dim.y; i.y++) {
+      if (src->layout == AMITK_RAW_DATA_LAYOUT_LINEAR)
+	raw_data_transfer_row(dest, i, src->dim.x, amitk_raw_data_get_pointer(src, i), FALSE);
+      else 
+	raw_data_transfer_row(src, i, src->dim.x, amitk_raw_data_get_pointer(dest, i), TRUE);
+    }
+  }
+
+  return;
+}
+
+/* returns a copy of the raw data, reordered into the given layout.  The new
+   raw data is always in allocated memory, even if src was memory mapped. */
+AmitkRawData * amitk_raw_data_new_with_layout(const AmitkRawData * src, const AmitkRawDataLayout layout) {
+
+  AmitkRawData * dest;
+  raw_data_relayout_t relayout;
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(src), NULL);
+
+  dest = amitk_raw_data_new_with_data(src->format, src->dim);
+  if (dest == NULL) {
+    g_warning(_("couldn't allocate memory space for the raw data"));
+    return NULL;
+  }
+  dest->layout = layout;
+
+  if (src->layout == layout) {
+    memcpy(dest->data, src->data, amitk_raw_data_size_data_mem(src));
+  } else {
+    /* one of the two is linear, so rows can be copied straight in/out of it */
+    relayout.src = src;
+    relayout.dest = dest;
+    amitk_parallel_for(src->dim.z*src->dim.g*src->dim.t, 1, raw_data_relayout_planes, &relayout);
+  }
+
+  return dest;
+}
+
+
 /* take in one of the raw data formats, and return the corresponding data format */
 AmitkFormat amitk_raw_format_to_format(AmitkRawFormat raw_format) {
 
@@ -1185,6 +1853,18 @@ const gchar * amitk_raw_format_get_name(const AmitkRawFormat raw_format) {
   return enum_value->value_nick;
 }
 
+const gchar * amitk_raw_data_layout_get_name(const AmitkRawDataLayout layout) {
+
+  GEnumClass * enum_class;
+  GEnumValue * enum_value;
+
+  enum_class = g_type_class_ref(AMITK_TYPE_RAW_DATA_LAYOUT);
+  enum_value = g_enum_get_value(enum_class, layout);
+  g_type_class_unref(enum_class);
+
+  return enum_value->value_nick;
+}
+
 
 
 
@@ -47,6 +47,7 @@ G_BEGIN_DECLS
 #define AMITK_RAW_DATA_DIM_Z(rd)          (AMITK_RAW_DATA(rd)->dim.z)
 #define AMITK_RAW_DATA_DIM_G(rd)          (AMITK_RAW_DATA(rd)->dim.g)
 #define AMITK_RAW_DATA_DIM_T(rd)          (AMITK_RAW_DATA(rd)->dim.t)
+#define AMITK_RAW_DATA_LAYOUT(rd)         (AMITK_RAW_DATA(rd)->layout)
 
 /* glib doesn't define these for PDP */
 #ifdef G_BIG_ENDIAN
@@ -110,6 +111,23 @@ typedef enum {
 
 
 
+/* how the voxels of each frame/gate are ordered in memory.  Linear is the
+   usual x fastest, then y, then z.  Bricked stores each frame/gate as 8x8x8 
+   bricks, bricks ordered x fastest, then y, then z, with the voxels inside a 
+   full brick in Morton (Z-curve) order.  Partial bricks at the edges of the data
+   are stored linearly.  This keeps neighboring voxels in all three directions
+   within a few cache lines of each other, so coronal and sagittal slices are 
+   about as cheap to pull out as transverse ones.  Frames and gates follow 
+   each other without padding in either layout.  */
+typedef enum {
+  AMITK_RAW_DATA_LAYOUT_LINEAR,
+  AMITK_RAW_DATA_LAYOUT_BRICKED,
+  AMITK_RAW_DATA_LAYOUT_NUM
+} AmitkRawDataLayout;
+
+#define AMITK_RAW_DATA_BRICK_SIZE 8
+#define AMITK_RAW_DATA_BRICK_MASK (AMITK_RAW_DATA_BRICK_SIZE-1)
+
 typedef struct _AmitkRawDataClass AmitkRawDataClass;
 typedef struct _AmitkRawData      AmitkRawData;
 
@@ -121,6 +139,11 @@ struct _AmitkRawData {
   AmitkVoxel dim;
   gpointer data;
   AmitkFormat format;
+  AmitkRawDataLayout layout;
+
+  /* set if data points into a memory mapped file, instead of allocated memory */
+  gpointer mapping;
+  gsize mapping_length;
   
 };
 
@@ -146,6 +169,58 @@ struct _AmitkRawDataClass
 #define amitk_raw_data_size_data_mem(rd) (amitk_raw_data_num_voxels(rd) * amitk_format_sizes[(rd)->format])
 #define amitk_raw_data_get_data_mem(rd) (g_try_malloc(amitk_raw_data_size_data_mem(rd)))
 #define amitk_raw_data_get_data_mem0(rd) (g_try_malloc0(amitk_raw_data_size_data_mem(rd)))
+#define amitk_raw_data_size_plane_mem(rd) ((rd)->dim.x * (rd)->dim.y * amitk_format_sizes[(rd)->format])
+
+/* offset of a frame/gate's block of voxels, the same for either layout */
+#define amitk_raw_data_frame_offset(dim, i) \
+  ((((i).t) * ((dim).g) + (i).g) * ((dim).z) * ((dim).y) * ((dim).x))
+
+#define amitk_raw_data_linear_offset(dim, i) \
+  ((((((((((i).t) * ((dim).g)) + \
+	 (i).g) * ((dim).z)) + \
+       (i).z) * ((dim).y)) + \
+     (i).y) * ((dim).x)) + \
+   (i).x)
+
+/* spreads the low 3 bits of v out to bits 0, 3, and 6 */
+#define amitk_raw_data_morton_spread(v) (((v) & 1) | (((v) & 2) << 2) | (((v) & 4) << 4))
+
+/* offset of voxel (x,y,z) within a frame/gate's block of voxels, for the bricked layout */
+static inline gsize amitk_raw_data_brick_offset(const AmitkVoxel dim, const amide_intpoint_t z, 
+						const amide_intpoint_t y, const amide_intpoint_t x) {
+  amide_intpoint_t bx, by, bz;
+  amide_intpoint_t width, height, depth;
+  amide_intpoint_t ix, iy, iz;
+  gsize offset;
+
+  bz = z & ~AMITK_RAW_DATA_BRICK_MASK;
+  by = y & ~AMITK_RAW_DATA_BRICK_MASK;
+  bx = x & ~AMITK_RAW_DATA_BRICK_MASK;
+  depth = MIN(AMITK_RAW_DATA_BRICK_SIZE, dim.z-bz);
+  height = MIN(AMITK_RAW_DATA_BRICK_SIZE, dim.y-by);
+  width = MIN(AMITK_RAW_DATA_BRICK_SIZE, dim.x-bx);
+
+  offset = ((gsize) bz)*dim.y*dim.x + ((gsize) by)*dim.x*depth + ((gsize) bx)*height*depth;
+
+  ix = x & AMITK_RAW_DATA_BRICK_MASK;
+  iy = y & AMITK_RAW_DATA_BRICK_MASK;
+  iz = z & AMITK_RAW_DATA_BRICK_MASK;
+  if ((width == AMITK_RAW_DATA_BRICK_SIZE) && 
+      (height == AMITK_RAW_DATA_BRICK_SIZE) && 
+      (depth == AMITK_RAW_DATA_BRICK_SIZE))
+    return offset + (amitk_raw_data_morton_spread(ix) | 
+		     (amitk_raw_data_morton_spread(iy) << 1) | 
+		     (amitk_raw_data_morton_spread(iz) << 2));
+  else
+    return offset + ix + width*(iy + height*iz);
+}
+
+/* offset of voxel i from the start of the data, for whichever layout rd is in */
+#define amitk_raw_data_voxel_offset(rd, i) \
+  (((rd)->layout == AMITK_RAW_DATA_LAYOUT_LINEAR) ? \
+   ((gsize) amitk_raw_data_linear_offset((rd)->dim, (i))) : \
+   (amitk_raw_data_frame_offset((rd)->dim, (i)) + \
+    amitk_raw_data_brick_offset((rd)->dim, (i).z, (i).y, (i).x)))
 
 
 /* ------------ external functions ---------- */
@@ -171,7 +246,8 @@ AmitkRawData *  amitk_raw_data_import_raw_file      (const gchar * file_name,
 						     AmitkUpdateFunc update_func,
 						     gpointer update_data);
 void            amitk_raw_data_write_xml            (AmitkRawData  * raw_data, const gchar * name,
-						     FILE * study_file, gchar ** output_filename, 
+						     FILE * study_file, const gboolean compressed,
+						     gchar ** output_filename, 
 						     guint64 * location, guint64 * size);
 AmitkRawData *  amitk_raw_data_read_xml             (gchar * xml_filename,
 						     FILE * study_file,
@@ -184,6 +260,16 @@ amide_data_t    amitk_raw_data_get_value            (const AmitkRawData * rd,
 						     const AmitkVoxel i);
 gpointer        amitk_raw_data_get_pointer          (const AmitkRawData * rd,
 						     const AmitkVoxel i);
+gpointer        amitk_raw_data_get_row              (const AmitkRawData * rd,
+						     const AmitkVoxel i,
+						     const amide_intpoint_t num,
+						     gpointer buffer);
+gpointer        amitk_raw_data_get_plane            (const AmitkRawData * rd,
+						     const AmitkVoxel i,
+						     gpointer buffer);
+AmitkRawData *  amitk_raw_data_new_with_layout      (const AmitkRawData * src,
+						     const AmitkRawDataLayout layout);
+const gchar *   amitk_raw_data_layout_get_name      (const AmitkRawDataLayout layout);
 
 AmitkFormat    amitk_raw_format_to_format(AmitkRawFormat raw_format);
 AmitkRawFormat amitk_format_to_raw_format(AmitkFormat data_format);
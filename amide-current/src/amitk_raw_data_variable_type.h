@@ -41,13 +41,10 @@
       (i).g) * ((amitk_raw_data)->dim.z)) + \
     (i).z))
 
+/* follows the raw data's layout, the 2D/3D and scaling versions assume linear data */
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_POINTER(amitk_raw_data,i) \
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+ \
-   ((((((((((i).t) * ((amitk_raw_data)->dim.g)) + \
-	  (i).g) * ((amitk_raw_data)->dim.z)) + \
-	(i).z) * ((amitk_raw_data)->dim.y)) + \
-      (i).y) * ((amitk_raw_data)->dim.x)) + \
-    (i).x))
+   amitk_raw_data_voxel_offset((amitk_raw_data),(i)))
 
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_3D_POINTER(amitk_raw_data,iz,iy,ix) \
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+ \
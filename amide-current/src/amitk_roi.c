@@ -77,7 +77,8 @@ static AmitkObject * roi_copy                (const AmitkObject * object);
 static void          roi_copy_in_place       (AmitkObject * dest_object, const AmitkObject * src_object);
 static void          roi_write_xml           (const AmitkObject  *object, 
 					      xmlNodePtr          nodes, 
-					      FILE               *study_file);
+					      FILE               *study_file,
+					      const gboolean      compress_raw_data);
 static gchar *       roi_read_xml            (AmitkObject        *object, 
 					      xmlNodePtr          nodes, 
 					      FILE               *study_file, 
@@ -257,14 +258,15 @@ static void roi_copy_in_place (AmitkObject * dest_object, const AmitkObject * sr
 }
 
 
-static void roi_write_xml (const AmitkObject * object, xmlNodePtr nodes, FILE * study_file) {
+static void roi_write_xml (const AmitkObject * object, xmlNodePtr nodes, FILE * study_file,
+			   const gboolean compress_raw_data) {
 
   AmitkRoi * roi;
   gchar * name;
   gchar * filename;
   guint64 location, size;
 
-  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file);
+  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file, compress_raw_data);
 
   roi = AMITK_ROI(object);
 
@@ -280,7 +282,7 @@ static void roi_write_xml (const AmitkObject * object, xmlNodePtr nodes, FILE *
 
   if (AMITK_ROI_TYPE_ISOCONTOUR(roi) || AMITK_ROI_TYPE_FREEHAND(roi)) {
     name = g_strdup_printf("roi_%s_map_data", AMITK_OBJECT_NAME(roi));
-    amitk_raw_data_write_xml(roi->map_data, name, study_file, &filename, &location, &size);
+    amitk_raw_data_write_xml(roi->map_data, name, study_file, compress_raw_data, &filename, &location, &size);
     g_free(name);
     if (study_file == NULL) {
       xml_save_string(nodes,"map_file", filename);
@@ -814,6 +816,517 @@ void amitk_roi_calculate_on_data_set(const AmitkRoi * roi,
   return;
 }
 
+
+/* the mask's arrays get grown as needed */
+#define MASK_INITIAL_SIZE 1024
+
+static void record_mask(AmitkVoxel voxel,
+			amide_data_t value,
+			amide_real_t voxel_fraction,
+			gpointer data) {
+
+  AmitkRoiMask * mask = data;
+
+  if (voxel_fraction <= 0.0) return;
+
+  if (mask->num_voxels == mask->allocated) {
+    mask->allocated = MAX(2*mask->allocated, MASK_INITIAL_SIZE);
+    mask->voxels = g_renew(AmitkVoxel, mask->voxels, mask->allocated);
+    mask->fractions = g_renew(amide_real_t, mask->fractions, mask->allocated);
+  }
+
+  voxel.t = voxel.g = 0;
+  mask->voxels[mask->num_voxels] = voxel;
+  mask->fractions[mask->num_voxels] = voxel_fraction;
+  mask->num_voxels++;
+
+  return;
+}
+
+/* figures out which voxels of the data set are in the roi (or outside it, if inverse), 
+   and what fraction of each voxel is covered.  The roi's geometry is the same
+   for every frame and gate, so this only needs to be done once per roi/data set
+   pair, and the result can be handed to amitk_roi_calculate_on_mask for each
+   frame/gate.  Free with amitk_roi_mask_free */
+AmitkRoiMask * amitk_roi_get_mask(const AmitkRoi * roi,
+				  const AmitkDataSet * ds,
+				  const gboolean inverse,
+				  const gboolean accurate) {
+
+  AmitkRoiMask * mask;
+
+  g_return_val_if_fail(AMITK_IS_ROI(roi), NULL);
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+
+  mask = g_new0(AmitkRoiMask, 1);
+  amitk_roi_calculate_on_data_set(roi, ds, 0, 0, inverse, accurate, record_mask, mask);
+
+  return mask;
+}
+
+void amitk_roi_mask_free(AmitkRoiMask * mask) {
+
+  if (mask == NULL) return;
+
+  g_free(mask->voxels);
+  g_free(mask->fractions);
+  g_free(mask);
+
+  return;
+}
+
+/* same as amitk_roi_calculate_on_data_set, but goes over the voxels of a 
+   precomputed mask, so no point in roi tests get done */
+void amitk_roi_calculate_on_mask(const AmitkRoiMask * mask,
+				 const AmitkDataSet * ds, 
+				 const guint frame,
+				 const guint gate,
+				 void (*calculation)(),
+				 gpointer data) {
+
+  AmitkVoxel voxel;
+  guint i;
+
+  g_return_if_fail(mask != NULL);
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+
+  for (i=0; i < mask->num_voxels; i++) {
+    voxel = mask->voxels[i];
+    voxel.t = frame;
+    voxel.g = gate;
+    (*calculation)(voxel, amitk_data_set_get_value(ds, voxel), mask->fractions[i], data);
+  }
+
+  return;
+}
+
+/* label maps are integer valued data sets, where each voxel holds the number 
+   of the region it belongs to, with 0 being background.  Only the first 
+   frame/gate of the label map gets used */
+static gint label_map_get_label(const AmitkDataSet * label_map, const AmitkVoxel voxel) {
+  return (gint) floor(amitk_data_set_get_value(label_map, voxel)+0.5);
+}
+
+/* the position of label in the sorted labels array, or -1 if it's not there */
+static gint label_map_find_label(const guint * labels, const guint num_labels, const gint label) {
+
+  gint low, high, mid;
+
+  if (label <= 0) return -1;
+
+  low = 0;
+  high = ((gint) num_labels)-1;
+  while (low <= high) {
+    mid = (low+high)/2;
+    if ((gint) labels[mid] == label)
+      return mid;
+    else if ((gint) labels[mid] < label)
+      low = mid+1;
+    else
+      high = mid-1;
+  }
+
+  return -1;
+}
+
+/* whether the data set can be used as a label map, i.e. it's stored as integers */
+gboolean amitk_rois_label_map_valid(const AmitkDataSet * ds) {
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), FALSE);
+
+  switch(AMITK_DATA_SET_FORMAT(ds)) {
+  case AMITK_FORMAT_UBYTE:
+  case AMITK_FORMAT_SBYTE:
+  case AMITK_FORMAT_USHORT:
+  case AMITK_FORMAT_SSHORT:
+  case AMITK_FORMAT_UINT:
+  case AMITK_FORMAT_SINT:
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+/* the extent of a label in the label map */
+typedef struct {
+  gint label;
+  AmitkVoxel min_voxel;
+  AmitkVoxel max_voxel;
+} label_extent_t;
+
+static gint label_extent_compare(gconstpointer a, gconstpointer b) {
+
+  const label_extent_t * extent_a = a;
+  const label_extent_t * extent_b = b;
+
+  if (extent_a->label < extent_b->label) return -1;
+  else if (extent_a->label > extent_b->label) return 1;
+  else return 0;
+}
+
+/* makes a 3D freehand roi for each of the labels in a label map, all in
+   one pass over the label map.  Only labels that occur in the label map
+   get an roi, and only the first AMITK_ROI_MAX_LABELS of them.  The returned
+   array has *pnum_labels entries, in order of increasing label, with a NULL 
+   entry for a label whose roi couldn't be allocated.  *plabels gets set to an 
+   array giving the label of each entry, free both with g_free.  Returns NULL
+   if the data set can't be used as a label map */
+AmitkRoi ** amitk_rois_new_from_label_map(const AmitkDataSet * label_map, 
+					  guint ** plabels,
+					  guint * pnum_labels) {
+
+  AmitkRoi ** rois;
+  GArray * extents;
+  GHashTable * label_table;
+  label_extent_t new_extent;
+  label_extent_t * extent=NULL;
+  guint * labels;
+  guint num_labels;
+  AmitkVoxel dim, i_voxel, j_voxel;
+  AmitkPoint temp_point;
+  amide_data_t value;
+  gint label, last_label, index;
+  gboolean too_many=FALSE;
+  guint i;
+  gchar * name;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(label_map), NULL);
+  g_return_val_if_fail(plabels != NULL, NULL);
+  g_return_val_if_fail(pnum_labels != NULL, NULL);
+
+  if (!amitk_rois_label_map_valid(label_map)) {
+    g_warning(_("Data set %s is not stored as integers, so can't be used as a label map"),
+	      AMITK_OBJECT_NAME(label_map));
+    return NULL;
+  }
+
+  dim = AMITK_DATA_SET_DIM(label_map);
+
+  /* figure out which labels there are, and the extent of each.  Labels tend
+     to come in runs, so remember the last one to save on hash lookups */
+  extents = g_array_new(FALSE, FALSE, sizeof(label_extent_t));
+  label_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+  last_label = 0;
+  i_voxel.t = i_voxel.g = 0;
+  for (i_voxel.z=0; i_voxel.z<dim.z; i_voxel.z++)
+    for (i_voxel.y=0; i_voxel.y<dim.y; i_voxel.y++)
+      for (i_voxel.x=0; i_voxel.x<dim.x; i_voxel.x++) {
+	value = amitk_data_set_get_value(label_map, i_voxel);
+	if ((value != floor(value)) || (value > G_MAXINT) || (value < G_MININT)) {
+	  g_warning(_("Label map %s has the non-integer value %g, scaling needs to be 1 for a label map"),
+		    AMITK_OBJECT_NAME(label_map), value);
+	  g_hash_table_destroy(label_table);
+	  g_array_free(extents, TRUE);
+	  return NULL;
+	}
+	label = (gint) value;
+	if (label <= 0) continue;
+
+	if (label != last_label) {
+	  index = GPOINTER_TO_INT(g_hash_table_lookup(label_table, GINT_TO_POINTER(label)));
+	  if (index == 0) { /* a new label */
+	    if (extents->len >= AMITK_ROI_MAX_LABELS) {
+	      too_many = TRUE;
+	      continue;
+	    }
+	    new_extent.label = label;
+	    new_extent.min_voxel = dim;
+	    new_extent.max_voxel = zero_voxel;
+	    g_array_append_val(extents, new_extent);
+	    index = extents->len;
+	    g_hash_table_insert(label_table, GINT_TO_POINTER(label), GINT_TO_POINTER(index));
+	  }
+	  extent = &g_array_index(extents, label_extent_t, index-1);
+	  last_label = label;
+	}
+
+	extent->min_voxel.x = MIN(extent->min_voxel.x, i_voxel.x);
+	extent->min_voxel.y = MIN(extent->min_voxel.y, i_voxel.y);
+	extent->min_voxel.z = MIN(extent->min_voxel.z, i_voxel.z);
+	extent->max_voxel.x = MAX(extent->max_voxel.x, i_voxel.x);
+	extent->max_voxel.y = MAX(extent->max_voxel.y, i_voxel.y);
+	extent->max_voxel.z = MAX(extent->max_voxel.z, i_voxel.z);
+      }
+  g_hash_table_destroy(label_table);
+
+  if (too_many)
+    g_warning(_("Label map %s has more than %d labels, only the first %d found will be used"),
+	      AMITK_OBJECT_NAME(label_map), AMITK_ROI_MAX_LABELS, AMITK_ROI_MAX_LABELS);
+
+  g_array_sort(extents, label_extent_compare);
+  num_labels = extents->len;
+  labels = g_new(guint, num_labels+1);
+  rois = g_new0(AmitkRoi *, num_labels+1);
+  for (i=0; i < num_labels; i++) {
+    extent = &g_array_index(extents, label_extent_t, i);
+    labels[i] = extent->label;
+
+    rois[i] = amitk_roi_new(AMITK_ROI_TYPE_FREEHAND_3D);
+    name = g_strdup_printf("%s %d", AMITK_OBJECT_NAME(label_map), extent->label);
+    amitk_object_set_name(AMITK_OBJECT(rois[i]), name);
+    g_free(name);
+
+    rois[i]->map_data = 
+      amitk_raw_data_new_3D_with_data0(AMITK_FORMAT_UBYTE,
+				       extent->max_voxel.z-extent->min_voxel.z+1,
+				       extent->max_voxel.y-extent->min_voxel.y+1, 
+				       extent->max_voxel.x-extent->min_voxel.x+1);
+    if (rois[i]->map_data == NULL) {
+      g_warning(_("couldn't allocate memory space for the map of label %d"), extent->label);
+      rois[i] = amitk_object_unref(rois[i]);
+      continue;
+    }
+
+    amitk_space_copy_in_place(AMITK_SPACE(rois[i]), AMITK_SPACE(label_map));
+    rois[i]->voxel_size = AMITK_DATA_SET_VOXEL_SIZE(label_map);
+    POINT_MULT(extent->min_voxel, AMITK_DATA_SET_VOXEL_SIZE(label_map), temp_point);
+    amitk_space_set_offset(AMITK_SPACE(rois[i]), 
+			   amitk_space_s2b(AMITK_SPACE(label_map), temp_point));
+  }
+
+  /* fill in the maps */
+  j_voxel.t = j_voxel.g = 0;
+  last_label = 0;
+  index = -1;
+  for (i_voxel.z=0; i_voxel.z<dim.z; i_voxel.z++)
+    for (i_voxel.y=0; i_voxel.y<dim.y; i_voxel.y++)
+      for (i_voxel.x=0; i_voxel.x<dim.x; i_voxel.x++) {
+	label = label_map_get_label(label_map, i_voxel);
+	if (label <= 0) continue;
+	if (label != last_label) {
+	  index = label_map_find_label(labels, num_labels, label);
+	  last_label = label;
+	}
+	if ((index < 0) || (rois[index] == NULL)) continue;
+
+	extent = &g_array_index(extents, label_extent_t, index);
+	j_voxel.x = i_voxel.x - extent->min_voxel.x;
+	j_voxel.y = i_voxel.y - extent->min_voxel.y;
+	j_voxel.z = i_voxel.z - extent->min_voxel.z;
+	AMITK_RAW_DATA_UBYTE_SET_CONTENT(rois[index]->map_data, j_voxel) = 1;
+      }
+
+  for (i=0; i < num_labels; i++) 
+    if (rois[i] != NULL) {
+      amitk_roi_FREEHAND_3D_mark_edges(rois[i]);
+      amitk_roi_calc_far_corner(rois[i]);
+    }
+
+  g_array_free(extents, TRUE);
+
+  *plabels = labels;
+  *pnum_labels = num_labels;
+  return rois;
+}
+
+
+/* the voxels of one plane of the data set, and which label each belongs to,
+   as a position in the labels array */
+typedef struct {
+  guint num_voxels;
+  guint allocated;
+  AmitkVoxel * voxels;
+  guint * labels;
+  amide_real_t * fractions;
+} label_plane_t;
+
+typedef struct {
+  const AmitkDataSet * label_map;
+  const AmitkDataSet * ds;
+  const guint * labels;
+  guint num_labels;
+  gboolean accurate;
+  AmitkVoxel start;
+  AmitkVoxel end;
+  label_plane_t * planes;
+} label_job_t;
+
+static void label_plane_add(label_plane_t * plane, AmitkVoxel voxel, 
+			    guint label, amide_real_t fraction) {
+
+  if (plane->num_voxels == plane->allocated) {
+    plane->allocated = MAX(2*plane->allocated, MASK_INITIAL_SIZE);
+    plane->voxels = g_renew(AmitkVoxel, plane->voxels, plane->allocated);
+    plane->labels = g_renew(guint, plane->labels, plane->allocated);
+    plane->fractions = g_renew(amide_real_t, plane->fractions, plane->allocated);
+  }
+
+  plane->voxels[plane->num_voxels] = voxel;
+  plane->labels[plane->num_voxels] = label;
+  plane->fractions[plane->num_voxels] = fraction;
+  plane->num_voxels++;
+
+  return;
+}
+
+/* work function for amitk_parallel_for, each item is a plane of the data set.
+   fast uses the label at the center of each voxel, accurate splits each voxel
+   into subvoxels to get the fraction of the voxel in each label */
+static void label_masks_planes(const gint start, const gint end, gpointer data) {
+
+  label_job_t * job = data;
+  label_plane_t * plane;
+  AmitkPoint ds_voxel_size, label_voxel_size, sub_voxel_size;
+  AmitkPoint ds_pt, label_pt;
+  AmitkVoxel j, k, label_voxel;
+  gint label, index;
+  gint last_label=0, last_index=-1;
+  gint sub_labels[AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY];
+  guint sub_counts[AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY];
+  guint num_sub_labels, i;
+  gint i_plane;
+  amide_real_t grain_size;
+
+  ds_voxel_size = AMITK_DATA_SET_VOXEL_SIZE(job->ds);
+  label_voxel_size = AMITK_DATA_SET_VOXEL_SIZE(job->label_map);
+  sub_voxel_size = point_cmult(1.0/AMITK_ROI_GRANULARITY, ds_voxel_size);
+  grain_size = 1.0/(AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY);
+
+  j.t = j.g = k.t = k.g = 0;
+  for (i_plane=start; i_plane < end; i_plane++) {
+    plane = &(job->planes[i_plane]);
+    j.z = job->start.z + i_plane;
+
+    for (j.y = job->start.y; j.y <= job->end.y; j.y++) {
+      for (j.x = job->start.x; j.x <= job->end.x; j.x++) {
+
+	if (!job->accurate) {
+	  VOXEL_TO_POINT(j, ds_voxel_size, ds_pt);
+	  label_pt = amitk_space_s2s(AMITK_SPACE(job->ds), AMITK_SPACE(job->label_map), ds_pt);
+	  POINT_TO_VOXEL(label_pt, label_voxel_size, 0, 0, label_voxel);
+	  label = label_map_get_label(job->label_map, label_voxel);
+	  if (label != last_label) {
+	    last_index = label_map_find_label(job->labels, job->num_labels, label);
+	    last_label = label;
+	  }
+	  if (last_index >= 0)
+	    label_plane_add(plane, j, last_index, 1.0);
+	  continue;
+	}
+
+	num_sub_labels = 0;
+	for (k.z = 0;k.z<AMITK_ROI_GRANULARITY;k.z++) {
+	  ds_pt.z = j.z*ds_voxel_size.z+ (k.z+0.5)*sub_voxel_size.z;
+	  for (k.y = 0;k.y<AMITK_ROI_GRANULARITY;k.y++) {
+	    ds_pt.y = j.y*ds_voxel_size.y+ (k.y+0.5)*sub_voxel_size.y;
+	    for (k.x = 0;k.x<AMITK_ROI_GRANULARITY;k.x++) {
+	      ds_pt.x = j.x*ds_voxel_size.x+ (k.x+0.5)*sub_voxel_size.x;
+
+	      label_pt = amitk_space_s2s(AMITK_SPACE(job->ds), AMITK_SPACE(job->label_map), ds_pt);
+	      POINT_TO_VOXEL(label_pt, label_voxel_size, 0, 0, label_voxel);
+	      label = label_map_get_label(job->label_map, label_voxel);
+	      if (label != last_label) {
+		last_index = label_map_find_label(job->labels, job->num_labels, label);
+		last_label = label;
+	      }
+	      index = last_index;
+	      if (index < 0) continue;
+
+	      for (i=0; i<num_sub_labels; i++)
+		if (sub_labels[i] == index) break;
+	      if (i == num_sub_labels) {
+		sub_labels[i] = index;
+		sub_counts[i] = 0;
+		num_sub_labels++;
+	      }
+	      sub_counts[i]++;
+	    }
+	  }
+	}
+
+	for (i=0; i<num_sub_labels; i++)
+	  label_plane_add(plane, j, sub_labels[i], sub_counts[i]*grain_size);
+      }
+    }
+  }
+
+  return;
+}
+
+/* the label map equivalent of amitk_roi_get_mask.  labels is the sorted array
+   of num_labels labels from amitk_rois_new_from_label_map.  Returns an array 
+   of num_labels masks, in the same order, giving the voxels of the data set in 
+   each label.  Labels not in the array are ignored. This is done in a 
+   single pass over the data set, regardless of the number of labels.  Free 
+   each mask with amitk_roi_mask_free, and then the array with g_free */
+AmitkRoiMask ** amitk_roi_get_label_masks(const AmitkDataSet * label_map,
+					  const guint * labels,
+					  const guint num_labels,
+					  const AmitkDataSet * ds,
+					  const gboolean accurate) {
+
+  AmitkRoiMask ** masks;
+  AmitkRoiMask * mask;
+  label_job_t job;
+  label_plane_t * plane;
+  AmitkCorners intersection_corners;
+  AmitkVoxel ds_dim;
+  guint num_planes=0;
+  guint i_plane, i, label;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(label_map), NULL);
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+
+  masks = g_new(AmitkRoiMask *, num_labels);
+  for (label=0; label<num_labels; label++)
+    masks[label] = g_new0(AmitkRoiMask, 1);
+
+  /* only need to go over the part of the data set the label map covers */
+  if (amitk_volume_volume_intersection_corners(AMITK_VOLUME(ds), AMITK_VOLUME(label_map), 
+					       intersection_corners)) {
+    ds_dim = AMITK_DATA_SET_DIM(ds);
+    POINT_TO_VOXEL(intersection_corners[0], AMITK_DATA_SET_VOXEL_SIZE(ds), 0, 0, job.start);
+    POINT_TO_VOXEL(intersection_corners[1], AMITK_DATA_SET_VOXEL_SIZE(ds), 0, 0, job.end);
+    if (job.start.x < 0) job.start.x = 0;
+    if (job.start.y < 0) job.start.y = 0;
+    if (job.start.z < 0) job.start.z = 0;
+    if (job.end.x >= ds_dim.x) job.end.x = ds_dim.x-1;
+    if (job.end.y >= ds_dim.y) job.end.y = ds_dim.y-1;
+    if (job.end.z >= ds_dim.z) job.end.z = ds_dim.z-1;
+    if ((job.start.x <= job.end.x) && (job.start.y <= job.end.y) && (job.start.z <= job.end.z))
+      num_planes = job.end.z-job.start.z+1;
+  }
+  if (num_planes == 0) return masks;
+
+  job.label_map = label_map;
+  job.ds = ds;
+  job.labels = labels;
+  job.num_labels = num_labels;
+  job.accurate = accurate;
+  job.planes = g_new0(label_plane_t, num_planes);
+  amitk_parallel_for(num_planes, 1, label_masks_planes, &job);
+
+  /* sort the voxels out into the masks, keeping them in data set order */
+  for (i_plane=0; i_plane<num_planes; i_plane++) {
+    plane = &(job.planes[i_plane]);
+    for (i=0; i<plane->num_voxels; i++)
+      masks[plane->labels[i]]->allocated++;
+  }
+
+  for (label=0; label<num_labels; label++) {
+    mask = masks[label];
+    if (mask->allocated == 0) continue;
+    mask->voxels = g_new(AmitkVoxel, mask->allocated);
+    mask->fractions = g_new(amide_real_t, mask->allocated);
+  }
+
+  for (i_plane=0; i_plane<num_planes; i_plane++) {
+    plane = &(job.planes[i_plane]);
+    for (i=0; i<plane->num_voxels; i++) {
+      mask = masks[plane->labels[i]];
+      mask->voxels[mask->num_voxels] = plane->voxels[i];
+      mask->fractions[mask->num_voxels] = plane->fractions[i];
+      mask->num_voxels++;
+    }
+    g_free(plane->voxels);
+    g_free(plane->labels);
+    g_free(plane->fractions);
+  }
+  g_free(job.planes);
+
+  return masks;
+}
+
 static void erase_volume(AmitkVoxel voxel, 
 			 amide_data_t value, 
 			 amide_real_t voxel_fraction, 
@@ -836,10 +1349,24 @@ void amitk_roi_erase_volume(const AmitkRoi * roi,
 
   guint i_frame;
   guint i_gate;
+  AmitkRoiMask * mask;
+
+  if (outside) {
+    /* the outside is most of the data set, too big to keep a mask of */
+    for (i_frame=0; i_frame<AMITK_DATA_SET_NUM_FRAMES(ds); i_frame++) 
+      for (i_gate=0; i_gate<AMITK_DATA_SET_NUM_GATES(ds); i_gate++) 
+	amitk_roi_calculate_on_data_set(roi, ds, i_frame, i_gate, TRUE, FALSE, erase_volume, ds);
+  } else {
+    /* the voxels to erase are the same in every frame/gate */
+    mask = amitk_roi_get_mask(roi, ds, FALSE, FALSE);
+    g_return_if_fail(mask != NULL);
+
+    for (i_frame=0; i_frame<AMITK_DATA_SET_NUM_FRAMES(ds); i_frame++) 
+      for (i_gate=0; i_gate<AMITK_DATA_SET_NUM_GATES(ds); i_gate++) 
+	amitk_roi_calculate_on_mask(mask, ds, i_frame, i_gate, erase_volume, ds);
 
-  for (i_frame=0; i_frame<AMITK_DATA_SET_NUM_FRAMES(ds); i_frame++) 
-    for (i_gate=0; i_gate<AMITK_DATA_SET_NUM_GATES(ds); i_gate++) 
-      amitk_roi_calculate_on_data_set(roi, ds, i_frame, i_gate, outside, FALSE, erase_volume, ds);
+    amitk_roi_mask_free(mask);
+  }
 
   /* recalc max and min */
   amitk_data_set_calc_min_max(ds, update_func, update_data);
@@ -56,6 +56,9 @@ G_BEGIN_DECLS
 #define AMITK_ROI_GRANULARITY 4 /* # subvoxels in one dimension, so 1/64 is grain size */
 //#define AMITK_ROI_GRANULARITY 10 - takes way to long
 
+/* the most regions that get made out of a label map */
+#define AMITK_ROI_MAX_LABELS 4096
+
 typedef enum {
   AMITK_ROI_TYPE_ELLIPSOID, 
   AMITK_ROI_TYPE_CYLINDER, 
@@ -77,6 +80,7 @@ typedef enum {
 
 typedef struct _AmitkRoiClass AmitkRoiClass;
 typedef struct _AmitkRoi AmitkRoi;
+typedef struct _AmitkRoiMask AmitkRoiMask;
 
 
 struct _AmitkRoi
@@ -110,6 +114,16 @@ struct _AmitkRoiClass
 
 };
 
+/* the voxels of a data set that an roi covers, along with the fraction of
+   each voxel that's inside the roi.  The voxels have t and g set to 0 */
+struct _AmitkRoiMask
+{
+  guint num_voxels;
+  guint allocated;
+  AmitkVoxel * voxels;
+  amide_real_t * fractions;
+};
+
 
 
 /* Application-level methods */
@@ -154,6 +168,26 @@ void            amitk_roi_calculate_on_data_set   (const AmitkRoi * roi,
 						   const gboolean accurate,
 						   void (* calculation)(),
 						   gpointer data);
+AmitkRoiMask *  amitk_roi_get_mask                (const AmitkRoi * roi,
+						   const AmitkDataSet * ds,
+						   const gboolean inverse,
+						   const gboolean accurate);
+void            amitk_roi_mask_free               (AmitkRoiMask * mask);
+void            amitk_roi_calculate_on_mask       (const AmitkRoiMask * mask,
+						   const AmitkDataSet * ds, 
+						   const guint frame,
+						   const guint gate,
+						   void (* calculation)(),
+						   gpointer data);
+gboolean        amitk_rois_label_map_valid        (const AmitkDataSet * ds);
+AmitkRoi **     amitk_rois_new_from_label_map     (const AmitkDataSet * label_map,
+						   guint ** plabels,
+						   guint * pnum_labels);
+AmitkRoiMask ** amitk_roi_get_label_masks         (const AmitkDataSet * label_map,
+						   const guint * labels,
+						   const guint num_labels,
+						   const AmitkDataSet * ds,
+						   const gboolean accurate);
 void            amitk_roi_erase_volume            (const AmitkRoi * roi, 
 						   AmitkDataSet * ds,
 						   const gboolean outside,
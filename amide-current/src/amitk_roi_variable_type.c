@@ -28,6 +28,7 @@
 #include "amide_config.h"
 #include <sys/types.h>
 #include <sys/time.h>
+#include <string.h>
 #include <glib.h>
 #include "amitk_roi_`'m4_Variable_Type`'.h"
 
@@ -426,121 +427,137 @@ AmitkDataSet * amitk_roi_`'m4_Variable_Type`'_get_intersection_slice(const Amitk
 
 
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) 
+
+#define ISOCONTOUR_QUEUE_INITIAL_SIZE 4096
+
 /* the data in temp_rd is setup as follows:
    bit 1 -> is the voxel in the isocontour
-   bit 2 -> has the voxel been checked 
-   bit 3 -> increment x for backup
-   bit 4 -> decrement x for backup
-   bit 5 -> increment y for backup
-   bit 6 -> decrement y for backup
-   bit 7 -> increment z for backup
-   bit 8 -> decrement z for backup
+   bit 2 -> has the voxel been queued
+   bit 3 -> is the voxel's value within the isocontour range
+
+   bit 3 is filled in a whole plane at a time (using the raw data and the range
+   transformed into raw units) the first time the region reaches that plane, so
+   planes the isocontour never touches are never read.  The region is grown breadth
+   first from the starting voxel using a queue of voxel offsets into temp_rd, and
+   the bounding box of the region is tracked as we go.
 */
+static void isocontour_threshold_plane(const AmitkDataSet * ds,
+				       const AmitkRawData * temp_rd,
+				       gboolean * plane_done,
+				       AmitkVoxel ds_voxel,
+				       const amide_intpoint_t z,
+				       const amide_data_t iso_min_value,
+				       const amide_data_t iso_max_value) {
+
+  AmitkVoxel i_voxel;
+
+  if (plane_done[z]) return;
+
+  i_voxel = zero_voxel;
+  i_voxel.z = z;
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+  ds_voxel.z = z;
+#endif
+  amitk_data_set_threshold_plane(ds, ds_voxel.t, ds_voxel.g, ds_voxel.z,
+				 iso_min_value, iso_max_value,
+				 AMITK_RAW_DATA_UBYTE_POINTER(temp_rd, i_voxel), 0x04);
+  plane_done[z] = TRUE;
+
+  return;
+}
+
 static void isocontour_consider(const AmitkDataSet * ds,
 				const AmitkRawData * temp_rd, 
 				AmitkVoxel ds_voxel, 
 				const amide_data_t iso_min_value,
 				const amide_data_t iso_max_value,
-				const AmitkRoiIsocontourRange iso_range) {
+				AmitkVoxel * pmin_voxel,
+				AmitkVoxel * pmax_voxel) {
 
-
-  AmitkVoxel i_voxel;
   AmitkVoxel roi_voxel;
-  gboolean found;
-  gboolean done;
-  amide_data_t voxel_value;
+  AmitkVoxel i_voxel;
+  AmitkVoxel min_voxel, max_voxel;
+  amitk_format_UBYTE_t * data;
+  gboolean * plane_done;
+  gsize * queue;
+  gsize queue_size, head, tail;
+  gsize plane_size, index, i_index;
+
+  data = AMITK_RAW_DATA_UBYTE_POINTER(temp_rd, zero_voxel);
+  plane_size = ((gsize) temp_rd->dim.y)*temp_rd->dim.x;
+  plane_done = g_new0(gboolean, temp_rd->dim.z);
+  queue_size = ISOCONTOUR_QUEUE_INITIAL_SIZE;
+  queue = g_new(gsize, queue_size);
 
   roi_voxel = ds_voxel;
   roi_voxel.t = roi_voxel.g = 0;
-  i_voxel =roi_voxel;
-  done=FALSE;
+#ifdef ROI_TYPE_ISOCONTOUR_2D
+  roi_voxel.z = 0;
+#endif
+  min_voxel = max_voxel = roi_voxel;
 
   /* the starting point is in by definition */
-  AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd, roi_voxel) |= 0x03;
+  isocontour_threshold_plane(ds, temp_rd, plane_done, ds_voxel, roi_voxel.z, iso_min_value, iso_max_value);
+  index = roi_voxel.z*plane_size + ((gsize) roi_voxel.y)*temp_rd->dim.x + roi_voxel.x;
+  data[index] |= 0x03;
+  head = 0;
+  tail = 0;
+  queue[tail++] = index;
 
-  /* while we still have neighbor voxels to check */
-  while (!done) {
-
-    found = FALSE;
+  i_voxel.t = i_voxel.g = 0;
+  while (head < tail) {
+
+    index = queue[head++];
+    roi_voxel.z = index / plane_size;
+    roi_voxel.y = (index % plane_size) / temp_rd->dim.x;
+    roi_voxel.x = index % temp_rd->dim.x;
+
+    if (min_voxel.x > roi_voxel.x) min_voxel.x = roi_voxel.x;
+    if (max_voxel.x < roi_voxel.x) max_voxel.x = roi_voxel.x;
+    if (min_voxel.y > roi_voxel.y) min_voxel.y = roi_voxel.y;
+    if (max_voxel.y < roi_voxel.y) max_voxel.y = roi_voxel.y;
+    if (min_voxel.z > roi_voxel.z) min_voxel.z = roi_voxel.z;
+    if (max_voxel.z < roi_voxel.z) max_voxel.z = roi_voxel.z;
+
+    /* make sure there's room for all the neighbors, 8 adjoining voxels, or 26 in the case of 3D */
+    if (tail + 26 > queue_size) {
+      if (head > queue_size/2) { /* plenty of room at the front, slide the queue down */
+	memmove(queue, queue+head, (tail-head)*sizeof(gsize));
+	tail -= head;
+	head = 0;
+      } else {
+	queue_size *= 2;
+	queue = g_renew(gsize, queue, queue_size);
+      }
+    }
 
-    /* find a neighbor to check, consider the 8 adjoining voxels, or 26 in the case of 3D */
-#ifdef ROI_TYPE_ISOCONTOUR_3D
+    /* temp_rd is a single plane in the 2D case, so this only covers z=0 */
     for (i_voxel.z = (roi_voxel.z >= 1) ? roi_voxel.z-1 : 0;
-	 (i_voxel.z < temp_rd->dim.z) && (i_voxel.z <= roi_voxel.z+1) && (!found);
-	 i_voxel.z++)
-#endif
+	 (i_voxel.z < temp_rd->dim.z) && (i_voxel.z <= roi_voxel.z+1);
+	 i_voxel.z++) {
+      isocontour_threshold_plane(ds, temp_rd, plane_done, ds_voxel, i_voxel.z, iso_min_value, iso_max_value);
       for (i_voxel.y = (roi_voxel.y >= 1) ? roi_voxel.y-1 : 0;
-	   (i_voxel.y < temp_rd->dim.y) && (i_voxel.y <= roi_voxel.y+1) && (!found);
-	   i_voxel.y++)
+	   (i_voxel.y < temp_rd->dim.y) && (i_voxel.y <= roi_voxel.y+1);
+	   i_voxel.y++) {
+	i_index = i_voxel.z*plane_size + ((gsize) i_voxel.y)*temp_rd->dim.x;
 	for (i_voxel.x = (roi_voxel.x >= 1) ? roi_voxel.x-1 : 0;
-	     (i_voxel.x < temp_rd->dim.x) && (i_voxel.x <= roi_voxel.x+1) && (!found);
-	     i_voxel.x++) 
-	  if (!(AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, i_voxel) & 0x02)) { /* don't recheck something we've already checked */
-	    AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x02; /* it's been checked */
-
-	    ds_voxel.z = i_voxel.z;
-	    ds_voxel.y = i_voxel.y;
-	    ds_voxel.x = i_voxel.x;
-
-	    voxel_value = amitk_data_set_get_value(ds, ds_voxel);
-	    if (((iso_range == AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN) && (voxel_value >= iso_min_value)) ||
-		((iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BELOW_MAX) && (voxel_value <= iso_max_value)) ||
-		((iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BETWEEN_MIN_MAX) && (voxel_value >= iso_min_value) && (voxel_value <= iso_max_value))) {
-
-	      AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x01; /* it's in */
-
-	      /* store backup info */
-#ifdef ROI_TYPE_ISOCONTOUR_3D
-	      if (i_voxel.z > roi_voxel.z)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x40;
-	      else if (i_voxel.z < roi_voxel.z)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x80;
-#endif
-	      if (i_voxel.y > roi_voxel.y)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x10;
-	      else if (i_voxel.y < roi_voxel.y)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x20;
-	      if (i_voxel.x > roi_voxel.x)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x04;
-	      else if (i_voxel.x < roi_voxel.x)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x08;
-	      
-	      /* start next iteration at this voxel */
-	      roi_voxel = i_voxel; 
-	      found = TRUE;
-	    }
+	     (i_voxel.x < temp_rd->dim.x) && (i_voxel.x <= roi_voxel.x+1);
+	     i_voxel.x++) {
+	  if ((data[i_index+i_voxel.x] & 0x06) == 0x04) { /* in range and not yet queued */
+	    data[i_index+i_voxel.x] |= 0x03;
+	    queue[tail++] = i_index+i_voxel.x;
 	  }
-
-        
-    if (!found) { /* all neighbors exhaustively checked, backup */
-
-      /* backup to previous voxel */
-      i_voxel = roi_voxel;
-#ifdef ROI_TYPE_ISOCONTOUR_3D
-      if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x80)
-	i_voxel.z++;
-      else if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x40)
-	i_voxel.z--;
-#endif
-
-      if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x20)
-	i_voxel.y++;
-      else if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x10)
-	i_voxel.y--;
-
-      if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x08)
-	i_voxel.x++;
-      else if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x04)
-	i_voxel.x--;
-
-      /* the inital voxel will backup to itself, which is why we get out of the loop */
-      if (VOXEL_EQUAL(roi_voxel, i_voxel)) 
-	done = TRUE;
-      else
-	roi_voxel = i_voxel;
+	}
+      }
     }
   }
 
+  g_free(queue);
+  g_free(plane_done);
+
+  *pmin_voxel = min_voxel;
+  *pmax_voxel = max_voxel;
+
   return;
 }
   
@@ -576,29 +593,17 @@ void amitk_roi_`'m4_Variable_Type`'_set_isocontour(AmitkRoi * roi, AmitkDataSet
   temp_min_value = roi->isocontour_min_value-EPSILON*fabs(roi->isocontour_min_value); 
   temp_max_value = roi->isocontour_max_value+EPSILON*fabs(roi->isocontour_max_value); 
 
-  /* fill in the data set */
-  isocontour_consider(ds, temp_rd, iso_voxel, temp_min_value, temp_max_value, iso_range);
-  
-  /* figure out the min and max dimensions */
-  min_voxel = max_voxel = iso_voxel;
-  
-  i_voxel.t = i_voxel.g = 0;
-  for (i_voxel.z=0; i_voxel.z < temp_rd->dim.z; i_voxel.z++) {
-    for (i_voxel.y=0; i_voxel.y < temp_rd->dim.y; i_voxel.y++) {
-      for (i_voxel.x=0; i_voxel.x < temp_rd->dim.x; i_voxel.x++) {
-	if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, i_voxel) & 0x1) {
-	  if (min_voxel.x > i_voxel.x) min_voxel.x = i_voxel.x;
-	  if (max_voxel.x < i_voxel.x) max_voxel.x = i_voxel.x;
-	  if (min_voxel.y > i_voxel.y) min_voxel.y = i_voxel.y;
-	  if (max_voxel.y < i_voxel.y) max_voxel.y = i_voxel.y;
-#ifdef ROI_TYPE_ISOCONTOUR_3D
-	  if (min_voxel.z > i_voxel.z) min_voxel.z = i_voxel.z;
-	  if (max_voxel.z < i_voxel.z) max_voxel.z = i_voxel.z;
+  /* open ended ranges */
+  if (iso_range == AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN)
+    temp_max_value = INFINITY;
+  else if (iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BELOW_MAX)
+    temp_min_value = -INFINITY;
+
+  /* fill in the data set, and figure out the min and max dimensions */
+  isocontour_consider(ds, temp_rd, iso_voxel, temp_min_value, temp_max_value, &min_voxel, &max_voxel);
+#if defined(ROI_TYPE_ISOCONTOUR_2D)
+  min_voxel.z = max_voxel.z = iso_voxel.z;
 #endif
-	}
-      }
-    }
-  }
   
   /* transfer the subset of the data set that contains positive information */
   if (roi->map_data != NULL)
@@ -802,6 +807,26 @@ void amitk_roi_`'m4_Variable_Type`'_calc_center_of_mass(AmitkRoi * roi) {
 
 }
 
+/* marks the edges of whatever has been filled into the map data */
+void amitk_roi_`'m4_Variable_Type`'_mark_edges(AmitkRoi * roi) {
+
+  AmitkVoxel i_voxel;
+
+  g_return_if_fail(roi->map_data != NULL);
+
+  i_voxel.t = i_voxel.g = 0;
+  for (i_voxel.z=0; i_voxel.z<roi->map_data->dim.z; i_voxel.z++)
+    for (i_voxel.y=0; i_voxel.y<roi->map_data->dim.y; i_voxel.y++) 
+      for (i_voxel.x=0; i_voxel.x<roi->map_data->dim.x; i_voxel.x++) 
+	if (AMITK_RAW_DATA_UBYTE_CONTENT(roi->map_data, i_voxel)) 
+	  AMITK_RAW_DATA_UBYTE_SET_CONTENT(roi->map_data, i_voxel) =
+	    map_roi_edge(roi->map_data, i_voxel);
+
+  roi->center_of_mass_calculated=FALSE;
+
+  return;
+}
+
 #endif
 
 
@@ -57,6 +57,7 @@ void amitk_roi_`'m4_Variable_Type`'_set_isocontour(AmitkRoi * roi,
 						   AmitkRoiIsocontourRange iso_range);
 void amitk_roi_`'m4_Variable_Type`'_manipulate_area(AmitkRoi * roi, gboolean erase, AmitkVoxel voxel, gint area_size);
 void amitk_roi_`'m4_Variable_Type`'_calc_center_of_mass(AmitkRoi * roi);
+void amitk_roi_`'m4_Variable_Type`'_mark_edges(AmitkRoi * roi);
 #endif
 
 void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_fast(const AmitkRoi * roi,  
@@ -68,7 +68,8 @@ static AmitkObject * study_copy                (const AmitkObject   *object);
 static void          study_copy_in_place       (AmitkObject * dest_object, const AmitkObject * src_object);
 static void          study_write_xml           (const AmitkObject   *object, 
 						xmlNodePtr           nodes,
-						FILE                *study_file);
+						FILE                *study_file,
+						const gboolean       compress_raw_data);
 static gchar *       study_read_xml            (AmitkObject         *object,
 						xmlNodePtr           nodes,
 						FILE                *study_file,
@@ -365,14 +366,15 @@ static void study_copy_in_place(AmitkObject * dest_object, const AmitkObject * s
 
 
 
-static void study_write_xml(const AmitkObject * object,xmlNodePtr nodes,  FILE *study_file) {
+static void study_write_xml(const AmitkObject * object,xmlNodePtr nodes,  FILE *study_file,
+			    const gboolean compress_raw_data) {
 
 
   AmitkStudy * study;
   AmitkView i_view;
   gchar * temp_string;
 
-  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file);
+  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file, compress_raw_data);
 
   study = AMITK_STUDY(object);
 
@@ -1137,7 +1139,7 @@ AmitkStudy * amitk_study_load_xml(const gchar * study_filename) {
 
 /* function to writeout the study to disk in an xif file */
 gboolean amitk_study_save_xml(AmitkStudy * study, const gchar * study_filename,
-			      gboolean save_as_directory) {
+			      gboolean save_as_directory, const gboolean compress_raw_data) {
 
   gchar * old_dir=NULL;
   struct stat file_info;
@@ -1217,7 +1219,7 @@ gboolean amitk_study_save_xml(AmitkStudy * study, const gchar * study_filename,
   }
 
   /* save the study */
-  amitk_object_write_xml(AMITK_OBJECT(study), study_file, NULL, &location, &size);
+  amitk_object_write_xml(AMITK_OBJECT(study), study_file, compress_raw_data, NULL, &location, &size);
 
   if (save_as_directory) {
     if (chdir(old_dir) != 0) {
@@ -203,7 +203,8 @@ AmitkStudy *    amitk_study_recover_xml             (const gchar * study_filenam
 AmitkStudy *    amitk_study_load_xml                (const gchar * study_filename);
 gboolean        amitk_study_save_xml                (AmitkStudy * study, 
 						     const gchar * study_filename,
-						     const gboolean save_as_directory);
+						     const gboolean save_as_directory,
+						     const gboolean compress_raw_data);
 
 const gchar *   amitk_fuse_type_get_name            (const AmitkFuseType fuse_type);
 const gchar *   amitk_view_mode_get_name            (const AmitkViewMode view_mode);
@@ -98,6 +98,7 @@ static void ds_threshold_style_changed_cb(AmitkDataSet * ds, AmitkThreshold* thr
 static void ds_thresholds_changed_cb(AmitkDataSet * ds, AmitkThreshold* threshold);
 static void ds_conversion_changed_cb(AmitkDataSet * ds, AmitkThreshold* threshold);
 static void ds_modality_changed_cb(AmitkDataSet * ds, AmitkThreshold* threshold);
+static void ds_min_max_changed_cb(AmitkDataSet * ds, AmitkThreshold* threshold);
 static void study_view_mode_changed_cb(AmitkStudy * study, AmitkThreshold * threshold);
 static gint threshold_arrow_cb(GtkWidget* widget, GdkEvent * event, gpointer AmitkThreshold);
 static void color_table_cb(GtkWidget * widget, gpointer data);
@@ -625,11 +626,9 @@ static void threshold_add_data_set(AmitkThreshold * threshold, AmitkDataSet * ds
 
   threshold->data_set = amitk_object_ref(ds);
 
-  /* explicitly make sure the min/max values have been calculated on the new data set, 
-   this is to make sure a progress box gets pushed up if these haven't been calculated eyt */
-  amitk_data_set_calc_min_max_if_needed(threshold->data_set,
-					amitk_progress_dialog_update,
-					threshold->progress_dialog);
+  /* get the min/max values going on the new data set, until they're all calculated
+     we'll be showing the range over the frames done so far */
+  amitk_data_set_calc_min_max_in_background(threshold->data_set);
 
   for (i=0; i<2; i++) {
     threshold->threshold_max[i] = AMITK_DATA_SET_THRESHOLD_MAX(ds, i);
@@ -651,6 +650,7 @@ static void threshold_add_data_set(AmitkThreshold * threshold, AmitkDataSet * ds
   g_signal_connect(G_OBJECT(ds), "thresholds_changed", G_CALLBACK(ds_thresholds_changed_cb), threshold);
   g_signal_connect(G_OBJECT(ds), "conversion_changed", G_CALLBACK(ds_conversion_changed_cb), threshold);
   g_signal_connect(G_OBJECT(ds), "modality_changed", G_CALLBACK(ds_modality_changed_cb), threshold);
+  g_signal_connect(G_OBJECT(ds), "min_max_changed", G_CALLBACK(ds_min_max_changed_cb), threshold);
   if (study != NULL)
     g_signal_connect(G_OBJECT(study), "view_mode_changed", G_CALLBACK(study_view_mode_changed_cb), threshold);
 
@@ -672,6 +672,7 @@ static void threshold_remove_data_set(AmitkThreshold * threshold) {
   g_signal_handlers_disconnect_by_func(G_OBJECT(threshold->data_set), ds_thresholds_changed_cb, threshold);
   g_signal_handlers_disconnect_by_func(G_OBJECT(threshold->data_set), ds_conversion_changed_cb, threshold);
   g_signal_handlers_disconnect_by_func(G_OBJECT(threshold->data_set), ds_modality_changed_cb, threshold);
+  g_signal_handlers_disconnect_by_func(G_OBJECT(threshold->data_set), ds_min_max_changed_cb, threshold);
   if (study != NULL)
     g_signal_handlers_disconnect_by_func(G_OBJECT(study), study_view_mode_changed_cb, threshold);
   threshold->data_set = amitk_object_unref(threshold->data_set);
@@ -699,6 +700,11 @@ static void threshold_update_histogram(AmitkThreshold * threshold) {
 
   if (threshold->minimal) return; /* no histogram in minimal configuration */
 
+  /* the distribution needs the full range, wait till the min/max values are calculated */
+  if ((AMITK_DATA_SET_DISTRIBUTION(threshold->data_set) == NULL) &&
+      (!AMITK_DATA_SET_MIN_MAX_CALCULATED(threshold->data_set)))
+    return;
+
   /* figure out what colors to use for the distribution image */
   widget_style = gtk_widget_get_style(GTK_WIDGET(threshold));
   if (widget_style == NULL) {
@@ -740,8 +746,8 @@ static void threshold_update_spin_buttons(AmitkThreshold * threshold) {
   if (threshold->minimal) return; /* no spin buttons in minimal configuration */
   g_return_if_fail(AMITK_IS_DATA_SET(threshold->data_set));
 
-  scale = (amitk_data_set_get_global_max(threshold->data_set) -
-	   amitk_data_set_get_global_min(threshold->data_set));
+  scale = (amitk_data_set_get_global_max_provisional(threshold->data_set) -
+	   amitk_data_set_get_global_min_provisional(threshold->data_set));
   step = scale / 100.0;
   if (scale < EPSILON) {
     scale = EPSILON;
@@ -755,7 +761,7 @@ static void threshold_update_spin_buttons(AmitkThreshold * threshold) {
       max_val = (threshold->threshold_max[i_ref]+threshold->threshold_min[i_ref])/2; /* center */
       min_val = (threshold->threshold_max[i_ref]-threshold->threshold_min[i_ref]); /* width */
       
-      max_percent = 100*(max_val-amitk_data_set_get_global_min(threshold->data_set))/scale;
+      max_percent = 100*(max_val-amitk_data_set_get_global_min_provisional(threshold->data_set))/scale;
       min_percent = 100*min_val/scale;
       break;
 
@@ -764,8 +770,8 @@ static void threshold_update_spin_buttons(AmitkThreshold * threshold) {
       max_val = threshold->threshold_max[i_ref];
       min_val = threshold->threshold_min[i_ref];
 
-      max_percent = 100*(max_val-amitk_data_set_get_global_min(threshold->data_set))/scale;
-      min_percent = 100*(min_val-amitk_data_set_get_global_min(threshold->data_set))/scale;
+      max_percent = 100*(max_val-amitk_data_set_get_global_min_provisional(threshold->data_set))/scale;
+      min_percent = 100*(min_val-amitk_data_set_get_global_min_provisional(threshold->data_set))/scale;
       break;
     }
 
@@ -806,8 +812,8 @@ static void threshold_update_arrow(AmitkThreshold * threshold, AmitkThresholdArr
   amide_data_t center;
 
   global_diff = 
-    amitk_data_set_get_global_max(threshold->data_set)- 
-    amitk_data_set_get_global_min(threshold->data_set);
+    amitk_data_set_get_global_max_provisional(threshold->data_set)- 
+    amitk_data_set_get_global_min_provisional(threshold->data_set);
   if (global_diff < EPSILON) global_diff = 1.0; /* non sensicle */
 
   for (i_ref=0; i_ref< threshold_visible_refs(threshold->data_set); i_ref++) {
@@ -828,10 +834,10 @@ static void threshold_update_arrow(AmitkThreshold * threshold, AmitkThresholdArr
       else
 	point = THRESHOLD_TRIANGLE_HEIGHT + 
 	  THRESHOLD_COLOR_SCALE_HEIGHT * 
-	  (1-(threshold->threshold_min[i_ref]- amitk_data_set_get_global_min(threshold->data_set))/global_diff);
+	  (1-(threshold->threshold_min[i_ref]- amitk_data_set_get_global_min_provisional(threshold->data_set))/global_diff);
       top = point;
       bottom = point+THRESHOLD_TRIANGLE_HEIGHT;
-      if (threshold->threshold_min[i_ref] < amitk_data_set_get_global_min(threshold->data_set))
+      if (threshold->threshold_min[i_ref] < amitk_data_set_get_global_min_provisional(threshold->data_set))
 	down_pointing=TRUE;
       fill_color = "white";
       break;
@@ -845,12 +851,12 @@ static void threshold_update_arrow(AmitkThreshold * threshold, AmitkThresholdArr
       else
 	point = THRESHOLD_TRIANGLE_HEIGHT + 
 	  THRESHOLD_COLOR_SCALE_HEIGHT * 
-	  (1-(center - amitk_data_set_get_global_min(threshold->data_set))/global_diff);
+	  (1-(center - amitk_data_set_get_global_min_provisional(threshold->data_set))/global_diff);
       top = point-THRESHOLD_TRIANGLE_HEIGHT/1.5;
       bottom = point+THRESHOLD_TRIANGLE_HEIGHT/1.5;
-      if (center < amitk_data_set_get_global_min(threshold->data_set))
+      if (center < amitk_data_set_get_global_min_provisional(threshold->data_set))
 	down_pointing=TRUE;
-      else if (center > amitk_data_set_get_global_max(threshold->data_set))
+      else if (center > amitk_data_set_get_global_max_provisional(threshold->data_set))
 	up_pointing = TRUE;
       fill_color = "gray";
       break;
@@ -863,10 +869,10 @@ static void threshold_update_arrow(AmitkThreshold * threshold, AmitkThresholdArr
       else
 	point = THRESHOLD_TRIANGLE_HEIGHT + 
 	  THRESHOLD_COLOR_SCALE_HEIGHT * 
-	  (1-(threshold->threshold_max[i_ref]-amitk_data_set_get_global_min(threshold->data_set))/global_diff);
+	  (1-(threshold->threshold_max[i_ref]-amitk_data_set_get_global_min_provisional(threshold->data_set))/global_diff);
       top = point-THRESHOLD_TRIANGLE_HEIGHT;
       bottom = point;
-      if (threshold->threshold_max[i_ref] > amitk_data_set_get_global_max(threshold->data_set)) 
+      if (threshold->threshold_max[i_ref] > amitk_data_set_get_global_max_provisional(threshold->data_set)) 
 	up_pointing=TRUE; /* want upward pointing max arrow */
       fill_color = "black";
       break;
@@ -1009,8 +1015,8 @@ static void threshold_update_color_scale(AmitkThreshold * threshold, AmitkThresh
 			      THRESHOLD_COLOR_SCALE_HEIGHT,
 			      threshold->threshold_min[i_ref],
 			      threshold->threshold_max[i_ref],
-			      amitk_data_set_get_global_min(threshold->data_set),
-			      amitk_data_set_get_global_max(threshold->data_set),
+			      amitk_data_set_get_global_min_provisional(threshold->data_set),
+			      amitk_data_set_get_global_max_provisional(threshold->data_set),
 			      FALSE);
       x = THRESHOLD_TRIANGLE_WIDTH;
       y = THRESHOLD_TRIANGLE_HEIGHT;
@@ -1061,8 +1067,8 @@ static void threshold_update_connector_lines(AmitkThreshold * threshold, AmitkTh
   amide_data_t global_diff;
 
   global_diff = 
-    amitk_data_set_get_global_max(threshold->data_set)- 
-    amitk_data_set_get_global_min(threshold->data_set);
+    amitk_data_set_get_global_max_provisional(threshold->data_set)- 
+    amitk_data_set_get_global_min_provisional(threshold->data_set);
   if (global_diff < EPSILON) global_diff = 1.0; /* non-sensicle */
 
   for (i_ref=0; i_ref< threshold_visible_refs(threshold->data_set); i_ref++) {
@@ -1074,7 +1080,7 @@ static void threshold_update_connector_lines(AmitkThreshold * threshold, AmitkTh
     line_points = gnome_canvas_points_new(2);
     line_points->coords[0] = THRESHOLD_COLOR_SCALE_WIDTH+THRESHOLD_TRIANGLE_WIDTH;
     temp = (1.0-(threshold->threshold_max[i_ref]-
-		 amitk_data_set_get_global_min(threshold->data_set))/global_diff);
+		 amitk_data_set_get_global_min_provisional(threshold->data_set))/global_diff);
     if (temp < 0.0) temp = 0.0;
     line_points->coords[1] = THRESHOLD_TRIANGLE_HEIGHT + THRESHOLD_COLOR_SCALE_HEIGHT * temp;
     line_points->coords[2] = THRESHOLD_COLOR_SCALE_WIDTH+
@@ -1099,7 +1105,7 @@ static void threshold_update_connector_lines(AmitkThreshold * threshold, AmitkTh
     line_points = gnome_canvas_points_new(2);
     line_points->coords[0] = THRESHOLD_COLOR_SCALE_WIDTH+THRESHOLD_TRIANGLE_WIDTH;
     temp = (1.0-(threshold->threshold_min[i_ref]-
-		 amitk_data_set_get_global_min(threshold->data_set))/global_diff);
+		 amitk_data_set_get_global_min_provisional(threshold->data_set))/global_diff);
     if (temp > 1.0) temp = 1.0;
     line_points->coords[1] = THRESHOLD_TRIANGLE_HEIGHT + THRESHOLD_COLOR_SCALE_HEIGHT * temp;
     line_points->coords[2] = THRESHOLD_COLOR_SCALE_WIDTH+
@@ -1125,7 +1131,7 @@ static void threshold_update_connector_lines(AmitkThreshold * threshold, AmitkTh
       line_points = gnome_canvas_points_new(2);
       line_points->coords[0] = THRESHOLD_COLOR_SCALE_WIDTH+THRESHOLD_TRIANGLE_WIDTH;
       temp = (1.0-((threshold->threshold_max[i_ref]+threshold->threshold_min[i_ref])/2.0-
-		   amitk_data_set_get_global_min(threshold->data_set))/global_diff);
+		   amitk_data_set_get_global_min_provisional(threshold->data_set))/global_diff);
       if (temp > 1.0) temp = 1.0;
       else if (temp < 0.0) temp = 0.0;
       line_points->coords[1] = THRESHOLD_TRIANGLE_HEIGHT + THRESHOLD_COLOR_SCALE_HEIGHT * temp;
@@ -1525,6 +1531,23 @@ static void ds_modality_changed_cb(AmitkDataSet * ds, AmitkThreshold * threshold
   return;
 }
 
+/* the min/max values have finished being calculated, redraw everything based on them */
+static void ds_min_max_changed_cb(AmitkDataSet * ds, AmitkThreshold * threshold) {
+
+  AmitkThresholdArrow i_arrow;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(AMITK_IS_THRESHOLD(threshold));
+
+  threshold_update_histogram(threshold);
+  threshold_update_color_scales(threshold);
+  threshold_update_spin_buttons(threshold);
+  for (i_arrow=0;i_arrow< AMITK_THRESHOLD_ARROW_NUM_ARROWS;i_arrow++)
+    threshold_update_arrow(threshold, i_arrow);
+
+  return;
+}
+
 static void study_view_mode_changed_cb(AmitkStudy * study, AmitkThreshold * threshold) {
 
   g_return_if_fail(AMITK_IS_STUDY(study));
@@ -1583,8 +1606,8 @@ static gint threshold_arrow_cb(GtkWidget* widget, GdkEvent * event, gpointer dat
 	case AMITK_THRESHOLD_ARROW_FULL_MAX:
 	case AMITK_THRESHOLD_ARROW_FULL_CENTER:
 	case AMITK_THRESHOLD_ARROW_FULL_MIN:
-	  delta *= (amitk_data_set_get_global_max(threshold->data_set) - 
-		    amitk_data_set_get_global_min(threshold->data_set));
+	  delta *= (amitk_data_set_get_global_max_provisional(threshold->data_set) - 
+		    amitk_data_set_get_global_min_provisional(threshold->data_set));
 	  break;
 	case AMITK_THRESHOLD_ARROW_SCALED_MAX:
 	case AMITK_THRESHOLD_ARROW_SCALED_CENTER:
@@ -1600,8 +1623,8 @@ static gint threshold_arrow_cb(GtkWidget* widget, GdkEvent * event, gpointer dat
 	case AMITK_THRESHOLD_ARROW_FULL_MAX:
 	case AMITK_THRESHOLD_ARROW_SCALED_MAX:
 	  temp = threshold->initial_max[which_ref] + delta;
-	  if (temp < amitk_data_set_get_global_min(threshold->data_set))
-	    temp = amitk_data_set_get_global_min(threshold->data_set);
+	  if (temp < amitk_data_set_get_global_min_provisional(threshold->data_set))
+	    temp = amitk_data_set_get_global_min_provisional(threshold->data_set);
 	  if (AMITK_DATA_SET_THRESHOLD_STYLE(threshold->data_set) == AMITK_THRESHOLD_STYLE_CENTER_WIDTH) {
 	    center = (threshold->initial_max[which_ref]+threshold->initial_min[which_ref])/2.0;
 	    if ((temp-EPSILON*fabs(temp)) < center) temp = center+EPSILON*fabs(center);
@@ -1637,10 +1660,10 @@ static gint threshold_arrow_cb(GtkWidget* widget, GdkEvent * event, gpointer dat
 	  center = (threshold->initial_max[which_ref]+threshold->initial_min[which_ref])/2.0;
 	  width = (threshold->initial_max[which_ref]-threshold->initial_min[which_ref]);
 	  temp = center+delta;
-	  if (temp < amitk_data_set_get_global_min(threshold->data_set))
-	    temp = amitk_data_set_get_global_min(threshold->data_set);
-	  if (temp > amitk_data_set_get_global_max(threshold->data_set)) 
-	    temp = amitk_data_set_get_global_max(threshold->data_set);
+	  if (temp < amitk_data_set_get_global_min_provisional(threshold->data_set))
+	    temp = amitk_data_set_get_global_min_provisional(threshold->data_set);
+	  if (temp > amitk_data_set_get_global_max_provisional(threshold->data_set)) 
+	    temp = amitk_data_set_get_global_max_provisional(threshold->data_set);
 	  threshold->threshold_max[which_ref] = temp+width/2.0;
 	  threshold->threshold_min[which_ref] = temp-width/2.0;
 	  threshold_update_arrow(threshold, AMITK_THRESHOLD_ARROW_FULL_MIN);
@@ -1662,10 +1685,10 @@ static gint threshold_arrow_cb(GtkWidget* widget, GdkEvent * event, gpointer dat
 	case AMITK_THRESHOLD_ARROW_FULL_MIN:
 	case AMITK_THRESHOLD_ARROW_SCALED_MIN:
 	  temp = threshold->initial_min[which_ref] + delta;
-	  if (temp > amitk_data_set_get_global_max(threshold->data_set)) 
-	    temp = amitk_data_set_get_global_max(threshold->data_set);
-	  //	  if (temp < amitk_data_set_get_global_min(threshold->data_set)) 
-	  //	    temp = amitk_data_set_get_global_min(threshold->data_set);
+	  if (temp > amitk_data_set_get_global_max_provisional(threshold->data_set)) 
+	    temp = amitk_data_set_get_global_max_provisional(threshold->data_set);
+	  //	  if (temp < amitk_data_set_get_global_min_provisional(threshold->data_set)) 
+	  //	    temp = amitk_data_set_get_global_min_provisional(threshold->data_set);
 	  if (AMITK_DATA_SET_THRESHOLD_STYLE(threshold->data_set) == AMITK_THRESHOLD_STYLE_CENTER_WIDTH) {
 	    center = (threshold->initial_max[which_ref]+threshold->initial_min[which_ref])/2.0;
 	    if ((temp+EPSILON*fabs(temp)) > center) temp = center-EPSILON*fabs(center);
@@ -1833,8 +1856,8 @@ static void threshold_spin_button_cb(GtkWidget* widget, gpointer data) {
   temp = gtk_spin_button_get_value(GTK_SPIN_BUTTON(widget));
 
   global_diff = 
-    amitk_data_set_get_global_max(threshold->data_set)- 
-    amitk_data_set_get_global_min(threshold->data_set);
+    amitk_data_set_get_global_max_provisional(threshold->data_set)- 
+    amitk_data_set_get_global_min_provisional(threshold->data_set);
   if (global_diff < EPSILON) global_diff = EPSILON; /* non sensicle */
 
 
@@ -1844,7 +1867,7 @@ static void threshold_spin_button_cb(GtkWidget* widget, gpointer data) {
     switch (which_threshold_entry) {
       /* max are the "center" entries */
     case AMITK_THRESHOLD_ENTRY_MAX_PERCENT:
-      temp = (global_diff*temp/100.0)+amitk_data_set_get_global_min(threshold->data_set);
+      temp = (global_diff*temp/100.0)+amitk_data_set_get_global_min_provisional(threshold->data_set);
     case AMITK_THRESHOLD_ENTRY_MAX_ABSOLUTE:
       center = temp;
       width = threshold->threshold_max[which_ref]-threshold->threshold_min[which_ref];
@@ -1868,13 +1891,13 @@ static void threshold_spin_button_cb(GtkWidget* widget, gpointer data) {
   default:
     switch (which_threshold_entry) {
     case AMITK_THRESHOLD_ENTRY_MAX_PERCENT:
-      temp = (global_diff*temp/100.0)+amitk_data_set_get_global_min(threshold->data_set);
+      temp = (global_diff*temp/100.0)+amitk_data_set_get_global_min_provisional(threshold->data_set);
     case AMITK_THRESHOLD_ENTRY_MAX_ABSOLUTE:
       max_val = temp;
       max_val_changed = TRUE;
       break;
     case AMITK_THRESHOLD_ENTRY_MIN_PERCENT:
-      temp = (global_diff * temp/100.0)+amitk_data_set_get_global_min(threshold->data_set);
+      temp = (global_diff * temp/100.0)+amitk_data_set_get_global_min_provisional(threshold->data_set);
     case AMITK_THRESHOLD_ENTRY_MIN_ABSOLUTE:
     default:
       min_val = temp;
@@ -1885,7 +1908,7 @@ static void threshold_spin_button_cb(GtkWidget* widget, gpointer data) {
   
   if (min_val_changed) {
     /* make sure it's a valid floating point */
-      if ((min_val < amitk_data_set_get_global_max(threshold->data_set)) && 
+      if ((min_val < amitk_data_set_get_global_max_provisional(threshold->data_set)) && 
 	  (min_val < threshold->threshold_max[which_ref])) {
       }
 	amitk_data_set_set_threshold_min(threshold->data_set, which_ref, min_val);
@@ -1894,7 +1917,7 @@ static void threshold_spin_button_cb(GtkWidget* widget, gpointer data) {
   } 
   if (max_val_changed) {
       if ((max_val > threshold->threshold_min[which_ref]) && 
-	  (max_val > amitk_data_set_get_global_min(threshold->data_set))) {
+	  (max_val > amitk_data_set_get_global_min_provisional(threshold->data_set))) {
       }
 	amitk_data_set_set_threshold_max(threshold->data_set, which_ref, max_val);
 	threshold->threshold_max[which_ref] = max_val;
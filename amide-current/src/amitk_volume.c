@@ -51,7 +51,8 @@ static AmitkObject * volume_copy             (const AmitkObject * object);
 static void          volume_copy_in_place    (AmitkObject * dest_object, const AmitkObject * src_object);
 static void          volume_write_xml        (const AmitkObject *object, 
 					      xmlNodePtr         nodes, 
-					      FILE              *study_file);
+					      FILE              *study_file,
+					      const gboolean     compress_raw_data);
 static gchar *       volume_read_xml         (AmitkObject       *object, 
 					      xmlNodePtr         nodes, 
 					      FILE              *study_file,
@@ -238,9 +239,10 @@ static void volume_copy_in_place(AmitkObject * dest_object, const AmitkObject *
 }
 
 
-static void volume_write_xml(const AmitkObject * object, xmlNodePtr nodes, FILE * study_file) {
+static void volume_write_xml(const AmitkObject * object, xmlNodePtr nodes, FILE * study_file,
+			     const gboolean compress_raw_data) {
 
-  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file);
+  AMITK_OBJECT_CLASS(parent_class)->object_write_xml(object, nodes, study_file, compress_raw_data);
 
   amitk_point_write_xml(nodes, "corner", AMITK_VOLUME_CORNER(object));
   xml_save_boolean(nodes, "valid", AMITK_VOLUME_VALID(object));
@@ -47,32 +47,17 @@
 
 static analysis_gate_t * analysis_gate_unref(analysis_gate_t *gate_analysis);
 static analysis_gate_t * analysis_gate_init(AmitkRoi * roi, AmitkDataSet *ds,guint frame, 
+					    analysis_data_t * gate_data,
 					    analysis_calculation_t calculation_type,
-					    gboolean accurate,
 					    gdouble subfraction, 
 					    gdouble threshold_percentage, 
 					    gdouble threshold_value);
 static analysis_frame_t * analysis_frame_unref(analysis_frame_t * frame_analysis);
-static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds, 
-					      analysis_calculation_t calculation_type,
-					      gboolean accurate,
-					      gdouble subfraction, 
-					      gdouble threshold_percentage,
-					      gdouble threshold_value);
+static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds);
 static analysis_volume_t * analysis_volume_unref(analysis_volume_t *volume_analysis);
-static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * volumes, 
-						analysis_calculation_t calculation_type,
-						gboolean accurate,
-						gdouble subfraction, 
-						gdouble threshold_percentage, 
-						gdouble threshold_value);
+static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * volumes);
 
 
-void free_array_element(gpointer data, gpointer user_data) {
-  analysis_element_t * element = data;
-  g_free(element);
-}
-
 static analysis_gate_t * analysis_gate_unref(analysis_gate_t * gate_analysis) {
 
   analysis_gate_t * return_list;
@@ -89,8 +74,9 @@ static analysis_gate_t * analysis_gate_unref(analysis_gate_t * gate_analysis) {
   /* if we've removed all reference's, free the roi */
   if (gate_analysis->ref_count == 0) {
 
-    g_ptr_array_foreach(gate_analysis->data_array, free_array_element, NULL); /* free the elements */
-    g_ptr_array_free(gate_analysis->data_array, TRUE); /* TRUE frees the array of pointers to elements as well */
+    g_free(gate_analysis->data.values);
+    g_free(gate_analysis->data.weights);
+    g_free(gate_analysis->data.ds_voxels);
 
     /* recursively delete rest of list */
     return_list = analysis_gate_unref(gate_analysis->next_gate_analysis);
@@ -104,80 +90,59 @@ static analysis_gate_t * analysis_gate_unref(analysis_gate_t * gate_analysis) {
 }
 
 
-static void record_stats(AmitkVoxel ds_voxel,
-			 amide_data_t value,
-			 amide_real_t voxel_fraction,
-			 gpointer data) {
+/* rearranges values so that values[n] holds what it would if the array were
+   sorted in ascending order, with nothing bigger before it and nothing smaller
+   after it, and returns that value.  This is quickselect with a three way 
+   partition, so runs of equal values (common with integer data) don't slow 
+   it down.  Order(N) on average. */
+static amide_data_t select_nth(amide_data_t * values, guint num, guint n) {
+
+  guint left = 0;
+  guint right = num;
+  guint lt, gt, i;
+  amide_data_t pivot, temp;
+
+  while (right-left > 1) {
+    pivot = values[left + (right-left)/2];
+
+    /* partition [left, right) into < pivot, == pivot, > pivot */
+    lt = i = left;
+    gt = right;
+    while (i < gt) {
+      if (values[i] < pivot) {
+	temp = values[lt]; values[lt] = values[i]; values[i] = temp;
+	lt++;
+	i++;
+      } else if (values[i] > pivot) {
+	gt--;
+	temp = values[gt]; values[gt] = values[i]; values[i] = temp;
+      } else
+	i++;
+    }
 
-  GPtrArray * array = data;
-  analysis_element_t * element;
-  
-  /* crashes if alloc fails, but I don't want to do error checking in the inner loop... 
-     let's not run out of memory */
-  if (voxel_fraction > 0.0) {
-    element = g_malloc(sizeof(analysis_element_t)); 
-    
-    element->value = value;
-    element->weight = voxel_fraction;
-    element->ds_voxel = ds_voxel;
-    g_ptr_array_add(array, element);
+    if (n < lt) right = lt;
+    else if (n >= gt) left = gt;
+    else return pivot;
   }
 
-  return;
-}
-
-static gint array_comparison(gconstpointer a, gconstpointer b) {
-
-  const analysis_element_t * ea = *((analysis_element_t **) a);
-  const analysis_element_t * eb = *((analysis_element_t **) b);
-
-  if (ea->value > eb->value) 
-    return -1;
-  else if (ea->value < eb->value) 
-    return 1;
-  else
-    return 0;
+  return values[n];
 }
 
+/* median of the values, the values get rearranged */
+static amide_data_t median_of(amide_data_t * values, guint num) {
 
-
-/* note, the following function for weight variance calculation is
-   derived from statistics/wvariance_source.c from gsl version 1.3.  
-   copyright Jim Davies, Brian Gough, released under GPL. */
-/* The variance is divided by N-1, since the mean in a sense is being
-   "estimated" from the data set....  If anyone else with more
-   statistical experience disagrees, please speak up */
-static gdouble wvariance (GPtrArray * array, guint num_elements, gdouble wmean)
-{
-  analysis_element_t * element;
-  gdouble wsumofsquares = 0 ;
-  gdouble Wa = 0;
-  gdouble Wb = 0;
-  gdouble wi;
-  gdouble delta;
-  gdouble factor;
+  amide_data_t upper, lower;
   guint i;
 
-  if (num_elements < 2) return NAN;
-
-  /* find the weight sum of the squares */
-  /* computes sum(wi*(valuei-mean))/sum(wi) */
-  /* and computes the weighted version of N/(N-1) */
-  for (i = 0; i < num_elements; i++) {
-    element = g_ptr_array_index(array, i);
-    wi = element->weight;
-
-    if (wi > 0) {
-      delta = element->value-wmean;
-      Wa += wi ;
-      Wb += wi*wi;
-      wsumofsquares += (delta * delta - wsumofsquares) * (wi / Wa);
-    } 
-  }
+  upper = select_nth(values, num, num/2);
+  if (num & 0x1) return upper; /* odd */
 
-  factor = (Wa*Wa)/((Wa*Wa)-Wb);
+  /* even, the other middle value is the biggest of the ones before it */
+  lower = values[0];
+  for (i=1; i < num/2; i++)
+    if (values[i] > lower) lower = values[i];
 
-  return factor*wsumofsquares;
+  return 0.5*lower + 0.5*upper;
 }
 
 
@@ -187,19 +152,23 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
 						    AmitkDataSet * ds, 
 						    guint frame,
 						    guint gate,
+						    analysis_data_t * gate_data,
 						    analysis_calculation_t calculation_type,
-						    gboolean accurate,
 						    gdouble subfraction,
 						    gdouble threshold_percentage,
 						    gdouble threshold_value) {
 
-  GPtrArray * data_array;
+  analysis_data_t roi_data;
   analysis_gate_t * analysis;
   guint subfraction_voxels;
-  guint i;
-  analysis_element_t * element;
-  gdouble max;
-  gboolean done;
+  guint i, n;
+  amide_data_t * included=NULL;
+  amide_data_t cutoff=0.0;
+  guint num_at_cutoff=0;
+  gboolean include_all=FALSE;
+  amide_data_t value, max, min;
+  amide_data_t total, running_mean, delta, sum_squares;
+  amide_real_t weight, weight_total, weight_squares;
 #ifdef AMIDE_DEBUG
   struct timeval tv1;
   struct timeval tv2;
@@ -212,67 +181,59 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
 
   if (gate == AMITK_DATA_SET_NUM_GATES(ds)) return NULL; /* check if we're done */
 
-  /* and now calculate this gate's data */
-  if ((data_array = g_ptr_array_new()) == NULL) {
-    g_warning(_("couldn't allocate memory space for data array for frame %d/gate %d"), frame, gate);
-    return NULL;
-  }
-  /* fill the array with the appropriate info from the data set */
-  /* note, I really only need a partial sort to get the median value, but
-     glib doesn't have one (only has a full qsort), so I'll just do that.
-     Partial sort would be order(N), qsort is order(NlogN), so it's not that
-     much worse.
-
-     If I used a partial sort, I'd have to iterate over the subfraction to find the 
-     max and min, and I'd have to do another partial sort to find the median 
-  */
-  amitk_roi_calculate_on_data_set(roi, ds, frame, gate,FALSE, accurate, record_stats, data_array);
-  g_ptr_array_sort(data_array, array_comparison);
-  
+  /* take over the arrays that were gathered for this gate */
+  roi_data = gate_data[gate];
+  if (roi_data.len > 0)
+    included = g_new(amide_data_t, roi_data.len);
+
+  /* figure out which voxels we're using.  These are the voxels above the cutoff,
+     and num_at_cutoff of the voxels equal to it */
   switch(calculation_type) {
   case ALL_VOXELS:
-    subfraction_voxels = data_array->len;
+    subfraction_voxels = roi_data.len;
+    include_all = TRUE;
     break;
   case HIGHEST_FRACTION_VOXELS:
-    subfraction_voxels = ceil(subfraction*data_array->len);
+    subfraction_voxels = ceil(subfraction*roi_data.len);
 
-    if ((subfraction_voxels == 0) && (data_array->len > 0))
+    if ((subfraction_voxels == 0) && (roi_data.len > 0))
       subfraction_voxels = 1; /* have at least one voxel if the roi is in the data set*/
 
+    if (subfraction_voxels > 0) {
+      for (i=0; i<roi_data.len; i++)
+	included[i] = roi_data.values[i];
+      cutoff = select_nth(included, roi_data.len, roi_data.len-subfraction_voxels);
+      num_at_cutoff = subfraction_voxels;
+      for (i=0; i<roi_data.len; i++)
+	if (roi_data.values[i] > cutoff) 
+	  num_at_cutoff--;
+    }
     break;
   case VOXELS_NEAR_MAX:
+  case VOXELS_GREATER_THAN_VALUE:
     subfraction_voxels = 0;
+    num_at_cutoff = G_MAXUINT;
 
-    if (data_array->len > 0) {
-      element = g_ptr_array_index(data_array, 0);
-      max = element->value;
-      done = FALSE;
-      for (i=0; i<data_array->len && !done; i++) {
-	element = g_ptr_array_index(data_array, i);
-	if (element->value >= max*threshold_percentage/100.0)
-	  subfraction_voxels++;
-	else
-	  done = TRUE;
-      }
-    }
-
-    if ((subfraction_voxels == 0) && (data_array->len > 0))
-      subfraction_voxels = 1; /* have at least one voxel if the roi is in the data set*/
+    if (roi_data.len > 0) {
+      max = roi_data.values[0];
+      for (i=1; i<roi_data.len; i++)
+	if (roi_data.values[i] > max) 
+	  max = roi_data.values[i];
 
-    break;
-  case VOXELS_GREATER_THAN_VALUE:
-    subfraction_voxels = 0;
+      if (calculation_type == VOXELS_NEAR_MAX) 
+	cutoff = max*threshold_percentage/100.0;
+      else
+	cutoff = threshold_value;
 
-    if (data_array->len > 0) {
-      element = g_ptr_array_index(data_array, 0);
-      max = element->value;
-      done = FALSE;
-      for (i=0; i<data_array->len && !done; i++) {
-	element = g_ptr_array_index(data_array, i);
-	if (element->value >= threshold_value)
+      for (i=0; i<roi_data.len; i++)
+	if (roi_data.values[i] >= cutoff)
 	  subfraction_voxels++;
-	else
-	  done = TRUE;
+
+      /* have at least one voxel if the roi is in the data set*/
+      if ((subfraction_voxels == 0) && (calculation_type == VOXELS_NEAR_MAX)) {
+	subfraction_voxels = 1;
+	cutoff = max;
+	num_at_cutoff = 1;
       }
     }
     break;
@@ -282,21 +243,18 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
   }
 
 
-  /* fill in our gate_analysis structure */
-  if ((analysis =  g_try_new(analysis_gate_t,1)) == NULL) {
-    g_warning(_("couldn't allocate memory space for roi analysis of frame %d/gate %d"), frame, gate);
-    return analysis;
-  }
+  /* fill in our gate_analysis structure, we're in a worker thread so 
+     can't put up a warning, crashes if alloc fails */
+  analysis = g_new(analysis_gate_t,1);
   analysis->ref_count = 1;
 
   /* set values */
-  analysis->data_array = data_array;
+  analysis->data = roi_data;
   analysis->duration = amitk_data_set_get_frame_duration(ds, frame);
   analysis->time_midpoint = amitk_data_set_get_midpt_time(ds, frame);
   analysis->gate_time = amitk_data_set_get_gate_time(ds, gate);
   analysis->total = 0.0;
   analysis->median = 0.0;
-  analysis->total = 0.0;
   analysis->voxels = subfraction_voxels;
   analysis->fractional_voxels = 0.0;
   analysis->correction = 0.0;
@@ -311,38 +269,55 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
 
   } else { 
 
-    /* max */
-    element = g_ptr_array_index(data_array, 0);
-    analysis->max = element->value;
-
-    /* min */
-    element = g_ptr_array_index(data_array, subfraction_voxels-1);
-    analysis->min = element->value;
-
-    /* median */
-    if (subfraction_voxels & 0x1) { /* odd */
-      element = g_ptr_array_index(data_array, (subfraction_voxels-1)/2);
-      analysis->median = element->value;
-    } else { /* even */
-      element = g_ptr_array_index(data_array, subfraction_voxels/2-1);
-      analysis->median = 0.5*element->value;
-      element = g_ptr_array_index(data_array, subfraction_voxels/2);
-      analysis->median += 0.5*element->value;
+    /* one pass through the voxels we're using for the max, min, total, 
+       #fractional_voxels, and variance.  The variance uses the weighted version
+       of Welford's running update, and is divided by the weighted version of N-1,
+       since the mean in a sense is being "estimated" from the data set.  */
+    max = min = NAN;
+    total = running_mean = sum_squares = 0.0;
+    weight_total = weight_squares = 0.0;
+    n = 0;
+    for (i=0; i<roi_data.len; i++) {
+      value = roi_data.values[i];
+      if (!include_all) {
+	if (value == cutoff) {
+	  if (num_at_cutoff == 0) continue;
+	  num_at_cutoff--;
+	} else if (!(value > cutoff))
+	  continue;
+      }
+      weight = roi_data.weights[i];
+
+      if (n == 0) 
+	max = min = value;
+      else if (value > max) max = value;
+      else if (value < min) min = value;
+      included[n++] = value;
+
+      total += weight*value;
+      weight_total += weight;
+      weight_squares += weight*weight;
+      delta = value-running_mean;
+      running_mean += delta*(weight/weight_total);
+      sum_squares += weight*delta*(value-running_mean);
     }
 
-    /* total and #fractional_voxels */
-    for (i=0; i<subfraction_voxels; i++) {
-      element = g_ptr_array_index(data_array, i);
-      analysis->total += element->weight*element->value;
-      analysis->fractional_voxels += element->weight;
-    }
+    analysis->max = max;
+    analysis->min = min;
+    analysis->median = median_of(included, n);
+    analysis->total = total;
+    analysis->fractional_voxels = weight_total;
 
     /* calculate the mean */
     analysis->mean = analysis->total/analysis->fractional_voxels;
 
     /* calculate variance */
-    analysis->var = wvariance(data_array, subfraction_voxels, analysis->mean);
+    if (n < 2) 
+      analysis->var = NAN;
+    else
+      analysis->var = sum_squares*weight_total/(weight_total*weight_total-weight_squares);
   }
+  g_free(included);
   
 #ifdef AMIDE_DEBUG
   /* and wrapup our timing */
@@ -357,7 +332,7 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
 
   /* now let's recurse  */
   analysis->next_gate_analysis = 
-    analysis_gate_init_recurse(roi, ds, frame, gate+1, calculation_type, accurate, 
+    analysis_gate_init_recurse(roi, ds, frame, gate+1, gate_data, calculation_type,
 			       subfraction, threshold_percentage, threshold_value);
 
   return analysis;
@@ -367,13 +342,13 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
 
 static analysis_gate_t * analysis_gate_init(AmitkRoi * roi, AmitkDataSet * ds,
 					    guint frame, 
+					    analysis_data_t * gate_data,
 					    analysis_calculation_t calculation_type,
-					    gboolean accurate,
 					    gdouble subfraction,
 					    gdouble threshold_percentage,
 					    gdouble threshold_value) {
 
-  return analysis_gate_init_recurse(roi, ds, frame, 0, calculation_type, accurate,
+  return analysis_gate_init_recurse(roi, ds, frame, 0, gate_data, calculation_type,
 				    subfraction, threshold_percentage, threshold_value);
 }
 
@@ -407,15 +382,47 @@ static analysis_frame_t * analysis_frame_unref(analysis_frame_t * frame_analysis
 }
 
 
-/* returns a calculated analysis structure of an roi on a frame of a data set */
+/* copies the values of the voxels in the roi mask for each gate of the frame
+   into flat arrays */
+static void gather_frame(const AmitkRoiMask * mask, const AmitkDataSet * ds, 
+			 guint frame, analysis_data_t * gate_data) {
+
+  analysis_data_t * roi_data;
+  AmitkVoxel voxel;
+  guint gate;
+  guint i;
+
+  for (gate=0; gate < AMITK_DATA_SET_NUM_GATES(ds); gate++) {
+    roi_data = &(gate_data[gate]);
+    roi_data->len = roi_data->allocated = mask->num_voxels;
+    roi_data->values = NULL;
+    roi_data->weights = NULL;
+    roi_data->ds_voxels = NULL;
+    if (mask->num_voxels == 0) continue;
+
+    /* crashes if alloc fails, let's not run out of memory */
+    roi_data->values = g_new(amide_data_t, mask->num_voxels);
+    roi_data->weights = g_new(amide_real_t, mask->num_voxels);
+    roi_data->ds_voxels = g_new(AmitkVoxel, mask->num_voxels);
+
+    for (i=0; i<mask->num_voxels; i++) {
+      voxel = mask->voxels[i];
+      voxel.t = frame;
+      voxel.g = gate;
+      roi_data->values[i] = amitk_data_set_get_value(ds, voxel);
+      roi_data->weights[i] = mask->fractions[i];
+      roi_data->ds_voxels[i] = voxel;
+    }
+  }
+
+  return;
+}
+
+/* returns a list of frame analyses for an roi on a data set, the gate analyses
+   get filled in later by calc_frames */
 static analysis_frame_t * analysis_frame_init_recurse(AmitkRoi * roi, 
 						      AmitkDataSet *ds, 
-						      guint frame,
-						      analysis_calculation_t calculation_type,
-						      gboolean accurate,
-						      gdouble subfraction,
-						      gdouble threshold_percentage,
-						      gdouble threshold_value) {
+						      guint frame) {
   
   analysis_frame_t * temp_frame_analysis;
   
@@ -427,27 +434,17 @@ static analysis_frame_t * analysis_frame_init_recurse(AmitkRoi * roi,
   }
   
   temp_frame_analysis->ref_count = 1;
-
-  /* calculate this one */
-  temp_frame_analysis->gate_analyses = 
-    analysis_gate_init(roi, ds, frame, calculation_type, accurate, subfraction, 
-		       threshold_percentage, threshold_value);
+  temp_frame_analysis->gate_analyses = NULL;
 
   /* recurse */
   temp_frame_analysis->next_frame_analysis = 
-    analysis_frame_init_recurse(roi, ds, frame+1, calculation_type, accurate, subfraction, 
-				threshold_percentage, threshold_value);
+    analysis_frame_init_recurse(roi, ds, frame+1);
 
   return temp_frame_analysis;
 }
 
 
-static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds, 
-					      analysis_calculation_t calculation_type,
-					      gboolean accurate,
-					      gdouble subfraction,
-					      gdouble threshold_percentage,
-					      gdouble threshold_value) {
+static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds) {
 
   /* sanity checks */
   g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
@@ -457,8 +454,7 @@ static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds,
     return NULL;
   }
 
-  return analysis_frame_init_recurse(roi, ds, 0, calculation_type, accurate, subfraction, 
-				     threshold_percentage, threshold_value);
+  return analysis_frame_init_recurse(roi, ds, 0);
 }
 
 
@@ -494,12 +490,7 @@ static analysis_volume_t * analysis_volume_unref(analysis_volume_t * volume_anal
 }
 
 /* returns an initialized roi analysis of a list of volumes */
-static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * data_sets, 
-						analysis_calculation_t calculation_type,
-						gboolean accurate,
-						gdouble subfraction,
-						gdouble threshold_percentage,
-						gdouble threshold_value) {
+static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * data_sets) {
   
   analysis_volume_t * temp_volume_analysis;
 
@@ -516,15 +507,13 @@ static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * data_set
   temp_volume_analysis->ref_count = 1;
   temp_volume_analysis->data_set = amitk_object_ref(data_sets->data);
 
-  /* calculate this one */
+  /* setup this one */
   temp_volume_analysis->frame_analyses = 
-    analysis_frame_init(roi, temp_volume_analysis->data_set, calculation_type, accurate,
-			subfraction, threshold_percentage, threshold_value);
+    analysis_frame_init(roi, temp_volume_analysis->data_set);
 
   /* recurse */
   temp_volume_analysis->next_volume_analysis = 
-    analysis_volume_init(roi, data_sets->next, calculation_type, accurate,
-			 subfraction, threshold_percentage, threshold_value);
+    analysis_volume_init(roi, data_sets->next);
 
   
   return temp_volume_analysis;
@@ -567,14 +556,14 @@ analysis_roi_t * analysis_roi_unref(analysis_roi_t * roi_analysis) {
   return return_list;
 }
 
-/* returns an initialized list of roi analyses */
-analysis_roi_t * analysis_roi_init(AmitkStudy * study, GList * rois, 
-				   GList * data_sets, 
-				   analysis_calculation_t calculation_type,
-				   gboolean accurate,
-				   gdouble subfraction, 
-				   gdouble threshold_percentage,
-				   gdouble threshold_value) {
+/* returns a list of roi analyses, with the frame analyses not yet filled in */
+static analysis_roi_t * analysis_roi_init_recurse(AmitkStudy * study, GList * rois, 
+						  GList * data_sets, 
+						  analysis_calculation_t calculation_type,
+						  gboolean accurate,
+						  gdouble subfraction, 
+						  gdouble threshold_percentage,
+						  gdouble threshold_value) {
   
   analysis_roi_t * temp_roi_analysis;
   
@@ -594,19 +583,295 @@ analysis_roi_t * analysis_roi_init(AmitkStudy * study, GList * rois,
   temp_roi_analysis->threshold_percentage = threshold_percentage;
   temp_roi_analysis->threshold_value = threshold_value;
 
-  /* calculate this one */
+  /* setup this one */
   temp_roi_analysis->volume_analyses = 
-    analysis_volume_init(temp_roi_analysis->roi, data_sets, calculation_type, accurate,
-			 subfraction, threshold_percentage, threshold_value);
+    analysis_volume_init(temp_roi_analysis->roi, data_sets);
 
   /* recurse */
   temp_roi_analysis->next_roi_analysis = 
-    analysis_roi_init(study, rois->next, data_sets, calculation_type, accurate,
-		      subfraction, threshold_percentage, threshold_value);
+    analysis_roi_init_recurse(study, rois->next, data_sets, calculation_type, accurate,
+			      subfraction, threshold_percentage, threshold_value);
 
   
   return temp_roi_analysis;
 }
 
 
+/* the roi/data set pairs are worked on independently of each other, 
+   first the roi mask gets calculated for each pair, and then the frames 
+   of each pair get filled in */
+typedef struct {
+  AmitkRoi * roi;
+  AmitkDataSet * ds;
+  guint label; /* position in the labels array, only used with label maps */
+  AmitkRoiMask * mask;
+} analysis_pair_t;
+
+typedef struct {
+  analysis_pair_t * pair;
+  analysis_frame_t * frame_analysis;
+  guint frame;
+} analysis_item_t;
+
+typedef struct {
+  analysis_pair_t * pairs;
+  analysis_item_t * items;
+  guint offset; /* first pair or item of the current batch */
+  analysis_calculation_t calculation_type;
+  gboolean accurate;
+  gdouble subfraction;
+  gdouble threshold_percentage;
+  gdouble threshold_value;
+} analysis_job_t;
+
+/* how many pairs/items each thread gets between progress updates */
+#define ANALYSIS_BATCH 2
+
+/* work function for amitk_parallel_for, each item is an roi/data set pair */
+static void calc_masks(const gint start, const gint end, gpointer data) {
+
+  analysis_job_t * job = data;
+  analysis_pair_t * pair;
+  gint i;
+
+  for (i=start; i<end; i++) {
+    pair = &(job->pairs[job->offset+i]);
+    pair->mask = amitk_roi_get_mask(pair->roi, pair->ds, FALSE, job->accurate);
+  }
+
+  return;
+}
+
+/* work function for amitk_parallel_for, each item is a frame of an roi/data set pair */
+static void calc_frames(const gint start, const gint end, gpointer data) {
+
+  analysis_job_t * job = data;
+  analysis_item_t * item;
+  analysis_data_t * gate_data;
+  gint i;
+
+  for (i=start; i<end; i++) {
+    item = &(job->items[job->offset+i]);
+    if (item->pair->mask == NULL) continue;
+
+    gate_data = g_new(analysis_data_t, AMITK_DATA_SET_NUM_GATES(item->pair->ds));
+    gather_frame(item->pair->mask, item->pair->ds, item->frame, gate_data);
+    item->frame_analysis->gate_analyses = 
+      analysis_gate_init(item->pair->roi, item->pair->ds, item->frame, gate_data,
+			 job->calculation_type, job->subfraction, 
+			 job->threshold_percentage, job->threshold_value);
+    g_free(gate_data); /* the arrays now belong to the gate analyses */
+  }
+
+  return;
+}
+
+/* fills in the statistics of a list of roi analyses. The roi/data set/frame 
+   combinations are calculated in parallel, update_func gets called between 
+   batches, and the calculation can be canceled through it, in which case 
+   the analyses get freed and NULL is returned.  If label_map is given, the roi 
+   masks for each data set come from a single pass over the label map, labels
+   holds the num_labels labels in use, and label_indices gives the position 
+   in labels of each roi's label */
+static analysis_roi_t * analysis_roi_calc(analysis_roi_t * roi_analyses,
+					  GList * data_sets,
+					  const AmitkDataSet * label_map,
+					  const guint * labels,
+					  const guint num_labels,
+					  const guint * label_indices,
+					  analysis_calculation_t calculation_type,
+					  gboolean accurate,
+					  gdouble subfraction, 
+					  gdouble threshold_percentage,
+					  gdouble threshold_value,
+					  AmitkUpdateFunc update_func,
+					  gpointer update_data) {
+
+  analysis_roi_t * roi_analysis;
+  analysis_volume_t * volume_analysis;
+  analysis_frame_t * frame_analysis;
+  analysis_job_t job;
+  AmitkRoiMask ** label_masks;
+  guint num_pairs, num_items, num_masks, num_done;
+  guint i_roi, i_pair, i_item, frame, label;
+  guint batch, num_in_batch;
+  gboolean continue_work=TRUE;
+
+  if (roi_analyses == NULL) return NULL;
+
+  /* figure out the work */
+  num_pairs = num_items = 0;
+  for (roi_analysis = roi_analyses; roi_analysis != NULL; roi_analysis = roi_analysis->next_roi_analysis)
+    for (volume_analysis = roi_analysis->volume_analyses; volume_analysis != NULL; 
+	 volume_analysis = volume_analysis->next_volume_analysis) 
+      if (volume_analysis->frame_analyses != NULL) {
+	num_pairs++;
+	num_items += AMITK_DATA_SET_NUM_FRAMES(volume_analysis->data_set);
+      }
+
+  job.pairs = g_new(analysis_pair_t, num_pairs);
+  job.items = g_new(analysis_item_t, num_items);
+  job.calculation_type = calculation_type;
+  job.accurate = accurate;
+  job.subfraction = subfraction;
+  job.threshold_percentage = threshold_percentage;
+  job.threshold_value = threshold_value;
+
+  i_pair = i_item = i_roi = 0;
+  for (roi_analysis = roi_analyses; roi_analysis != NULL; 
+       roi_analysis = roi_analysis->next_roi_analysis, i_roi++)
+    for (volume_analysis = roi_analysis->volume_analyses; volume_analysis != NULL; 
+	 volume_analysis = volume_analysis->next_volume_analysis) {
+      if (volume_analysis->frame_analyses == NULL) continue;
+      job.pairs[i_pair].roi = roi_analysis->roi;
+      job.pairs[i_pair].ds = volume_analysis->data_set;
+      job.pairs[i_pair].label = (label_indices != NULL) ? label_indices[i_roi] : 0;
+      job.pairs[i_pair].mask = NULL;
+
+      for (frame_analysis = volume_analysis->frame_analyses, frame=0; frame_analysis != NULL;
+	   frame_analysis = frame_analysis->next_frame_analysis, frame++) {
+	job.items[i_item].pair = &(job.pairs[i_pair]);
+	job.items[i_item].frame_analysis = frame_analysis;
+	job.items[i_item].frame = frame;
+	i_item++;
+      }
+      i_pair++;
+    }
+  num_items = i_item; /* in case a frame analysis couldn't be allocated */
+
+  if (update_func != NULL)
+    continue_work = (*update_func)(update_data, _("Calculating ROI Statistics"), (gdouble) 0.0);
+  batch = ANALYSIS_BATCH*amitk_get_num_threads();
+  num_masks = (label_map != NULL) ? g_list_length(data_sets) : num_pairs;
+  num_done = 0;
+
+  /* which voxels are in each roi */
+  if (label_map != NULL) {
+    for (; (data_sets != NULL) && continue_work; data_sets = data_sets->next) {
+      label_masks = amitk_roi_get_label_masks(label_map, labels, num_labels, data_sets->data, accurate);
+      for (i_pair=0; i_pair < num_pairs; i_pair++) {
+	label = job.pairs[i_pair].label;
+	if ((job.pairs[i_pair].ds == data_sets->data) && (label < num_labels)) {
+	  job.pairs[i_pair].mask = label_masks[label];
+	  label_masks[label] = NULL;
+	}
+      }
+      for (label=0; label < num_labels; label++)
+	amitk_roi_mask_free(label_masks[label]);
+      g_free(label_masks);
+
+      num_done++;
+      if (update_func != NULL) 
+	continue_work = (*update_func)(update_data, NULL, (gdouble) num_done/(num_masks+num_items));
+    }
+  } else {
+    for (job.offset = 0; (job.offset < num_pairs) && continue_work; job.offset += num_in_batch) {
+      num_in_batch = MIN(batch, num_pairs-job.offset);
+      amitk_parallel_for(num_in_batch, 1, calc_masks, &job);
+
+      num_done += num_in_batch;
+      if (update_func != NULL) 
+	continue_work = (*update_func)(update_data, NULL, (gdouble) num_done/(num_masks+num_items));
+    }
+  }
+
+  /* and the statistics for each frame */
+  for (job.offset = 0; (job.offset < num_items) && continue_work; job.offset += num_in_batch) {
+    num_in_batch = MIN(batch, num_items-job.offset);
+    amitk_parallel_for(num_in_batch, 1, calc_frames, &job);
+
+    num_done += num_in_batch;
+    if (update_func != NULL) 
+      continue_work = (*update_func)(update_data, NULL, (gdouble) num_done/(num_masks+num_items));
+  }
 
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+
+  /* garbage collection */
+  for (i_pair=0; i_pair < num_pairs; i_pair++)
+    amitk_roi_mask_free(job.pairs[i_pair].mask);
+  g_free(job.pairs);
+  g_free(job.items);
+
+  if (!continue_work) /* we were canceled */
+    roi_analyses = analysis_roi_unref(roi_analyses);
+  
+  return roi_analyses;
+}
+
+/* returns an initialized list of roi analyses, NULL if canceled through update_func */
+analysis_roi_t * analysis_roi_init(AmitkStudy * study, GList * rois, 
+				   GList * data_sets, 
+				   analysis_calculation_t calculation_type,
+				   gboolean accurate,
+				   gdouble subfraction, 
+				   gdouble threshold_percentage,
+				   gdouble threshold_value,
+				   AmitkUpdateFunc update_func,
+				   gpointer update_data) {
+  
+  analysis_roi_t * roi_analyses;
+
+  roi_analyses = analysis_roi_init_recurse(study, rois, data_sets, calculation_type, accurate,
+					   subfraction, threshold_percentage, threshold_value);
+
+  return analysis_roi_calc(roi_analyses, data_sets, NULL, NULL, 0, NULL,
+			   calculation_type, accurate, subfraction, 
+			   threshold_percentage, threshold_value, 
+			   update_func, update_data);
+}
+
+/* returns an initialized list of roi analyses, one for each of the labels
+   in the given label map.  The voxels of all the labels are found with a 
+   single pass over each data set.  NULL if canceled through update_func */
+analysis_roi_t * analysis_roi_init_from_label_map(AmitkStudy * study, 
+						  AmitkDataSet * label_map,
+						  GList * data_sets, 
+						  analysis_calculation_t calculation_type,
+						  gboolean accurate,
+						  gdouble subfraction, 
+						  gdouble threshold_percentage,
+						  gdouble threshold_value,
+						  AmitkUpdateFunc update_func,
+						  gpointer update_data) {
+
+  analysis_roi_t * roi_analyses;
+  AmitkRoi ** label_rois;
+  guint num_labels=0;
+  guint * labels=NULL;
+  guint * label_indices;
+  guint num_rois, i;
+  GList * rois=NULL;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(label_map), NULL);
+
+  label_rois = amitk_rois_new_from_label_map(label_map, &labels, &num_labels);
+  if (label_rois == NULL) return NULL;
+
+  /* roi analyses are in the same order as the roi list */
+  label_indices = g_new(guint, num_labels+1);
+  num_rois = 0;
+  for (i=0; i < num_labels; i++)
+    if (label_rois[i] != NULL) {
+      rois = g_list_append(rois, label_rois[i]);
+      label_indices[num_rois++] = i;
+    }
+
+  if (rois == NULL)
+    g_warning(_("Label map %s does not contain any labels"), AMITK_OBJECT_NAME(label_map));
+
+  roi_analyses = analysis_roi_init_recurse(study, rois, data_sets, calculation_type, accurate,
+					   subfraction, threshold_percentage, threshold_value);
+  rois = amitk_objects_unref(rois); /* the analyses have their own references */
+  g_free(label_rois);
+
+  roi_analyses = analysis_roi_calc(roi_analyses, data_sets, label_map, labels, num_labels, 
+				   label_indices, calculation_type, accurate, subfraction, 
+				   threshold_percentage, threshold_value, 
+				   update_func, update_data);
+  g_free(label_indices);
+  g_free(labels);
+
+  return roi_analyses;
+}
@@ -49,17 +49,20 @@ typedef struct _analysis_study_t analysis_study_t;
 
 
 
-typedef struct analysis_element_t {
-  amide_data_t value;
-  amide_real_t weight;
-  AmitkVoxel ds_voxel;
-} analysis_element_t;
+/* the voxels in an roi, element i of each array goes with voxel i */
+typedef struct _analysis_data_t {
+  guint len;
+  guint allocated;
+  amide_data_t * values;
+  amide_real_t * weights;
+  AmitkVoxel * ds_voxels;
+} analysis_data_t;
 
 
 struct _analysis_gate_t {
 
-  /* roi data - array of analysis_element's */
-  GPtrArray * data_array;
+  /* roi data - values/weights/locations of the voxels in the roi */
+  analysis_data_t data;
 
   /* stats */
   amide_data_t mean;
@@ -121,7 +124,19 @@ analysis_roi_t * analysis_roi_init(AmitkStudy * study,
 				   gboolean accurate,
 				   gdouble subfraction, 
 				   gdouble threshold_percentage, 
-				   gdouble threshold_value);
+				   gdouble threshold_value,
+				   AmitkUpdateFunc update_func,
+				   gpointer update_data);
+analysis_roi_t * analysis_roi_init_from_label_map(AmitkStudy * study, 
+						  AmitkDataSet * label_map,
+						  GList * data_sets, 
+						  analysis_calculation_t calculation_type,
+						  gboolean accurate,
+						  gdouble subfraction, 
+						  gdouble threshold_percentage,
+						  gdouble threshold_value,
+						  AmitkUpdateFunc update_func,
+						  gpointer update_data);
 
 #endif /* __ANALYSIS_H__ */
 
@@ -34,6 +34,7 @@
 #include "dcmtk_interface.h" 
 #include <dirent.h>
 #include <sys/stat.h>
+#include <time.h>
 #include "amitk_data_set_DOUBLE_0D_SCALING.h"
 #include <glib/gstdio.h> /* make sure we get g_mkdir on mingw32 */
 
@@ -1516,8 +1517,7 @@ typedef struct slice_info_t {
   gchar * series_instance_uid;
   gchar * modality;
   gchar * series_description;
-  gchar * patient_id;
-  gchar * patient_name;
+  gchar * patient_key; /* checksum of the patient id and name, only used for comparing */
   gint series_number;
 } slice_info_t;
 
@@ -1535,11 +1535,8 @@ static void free_slice_info(slice_info_t * info) {
   if (info->series_description != NULL)
     g_free(info->series_description);
 
-  if (info->patient_id != NULL)
-    g_free(info->patient_id);
-
-  if (info->patient_name != NULL)
-    g_free(info->patient_name);
+  if (info->patient_key != NULL)
+    g_free(info->patient_key);
 
   g_free(info);
 
@@ -1555,8 +1552,7 @@ static slice_info_t * slice_info_new(void) {
   info->series_instance_uid=NULL;
   info->modality=NULL;
   info->series_description=NULL;
-  info->patient_id=NULL;
-  info->patient_name=NULL;
+  info->patient_key=NULL;
   info->series_number = -1;
 
   return info;
@@ -1571,8 +1567,16 @@ static slice_info_t * get_slice_info(const gchar * filename) {
   const char * return_str=NULL;
   slice_info_t * info=NULL;
   Sint32 return_sint32;
+  gchar * patient_id;
+  gchar * patient_str;
 
-  result = dcm_format.loadFile(filename);
+  /* only the header's needed, don't bother reading in the pixel data */
+#if OFFIS_DCMTK_VERSION_NUMBER >= 362
+  result = dcm_format.loadFileUntilTag(filename, EXS_Unknown, EGL_noChange, 
+				       DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+#else
+  result = dcm_format.loadFile(filename, EXS_Unknown, EGL_noChange, 1024);
+#endif
   if (result.bad()) return NULL;
 
   dcm_dataset = dcm_format.getDataset();
@@ -1593,13 +1597,17 @@ static slice_info_t * get_slice_info(const gchar * filename) {
   if (return_str != NULL) 
       info->series_description = g_strdup(return_str);
 
+  /* the patient's id and name are only needed to check that slices go 
+     together, so don't keep them around (or in the index) as is */
   dcm_dataset->findAndGetString(DCM_PatientID, return_str, OFTrue);
-  if (return_str != NULL) 
-      info->patient_id = g_strdup(return_str);
-
+  patient_id = (return_str != NULL) ? g_strdup(return_str) : NULL;
   dcm_dataset->findAndGetString(DCM_PatientName, return_str, OFTrue);
-  if (return_str != NULL) 
-      info->patient_name = g_strdup(return_str);
+  patient_str = g_strdup_printf("%c%s\n%c%s", 
+				(patient_id != NULL) ? '+' : '-', (patient_id != NULL) ? patient_id : "",
+				(return_str != NULL) ? '+' : '-', (return_str != NULL) ? return_str : "");
+  info->patient_key = g_compute_checksum_for_string(G_CHECKSUM_SHA256, patient_str, -1);
+  g_free(patient_str);
+  g_free(patient_id);
 
   if (dcm_dataset->findAndGetSint32(DCM_SeriesNumber, return_sint32).good())
     info->series_number = return_sint32;
@@ -1607,6 +1615,293 @@ static slice_info_t * get_slice_info(const gchar * filename) {
   return info;
 }
 
+static slice_info_t * slice_info_copy(const slice_info_t * info) {
+
+  slice_info_t * new_info;
+
+  new_info = slice_info_new();
+  if (new_info == NULL) return NULL;
+
+  new_info->filename = g_strdup(info->filename);
+  new_info->series_instance_uid = g_strdup(info->series_instance_uid);
+  new_info->modality = g_strdup(info->modality);
+  new_info->series_description = g_strdup(info->series_description);
+  new_info->patient_key = g_strdup(info->patient_key);
+  new_info->series_number = info->series_number;
+
+  return new_info;
+}
+
+
+/* Finding the other slices that go with a DICOM file means looking at every 
+   file in its directory. Only a handful of header tags are needed from each, 
+   so get_slice_info stops reading before the pixel data, and the files get 
+   spread across threads.  If the DICOM index preference is turned on, what's
+   found is also kept in an index file in the user's cache directory, keyed by
+   each file's name, modification time and size, so that opening the same 
+   directory again doesn't need to read the files at all.  The index only holds
+   what check_same needs, with the patient reduced to a checksum, and index 
+   files that haven't been written in DICOM_INDEX_MAX_AGE get removed. */
+#define DICOM_INDEX_VERSION 2
+#define DICOM_INDEX_MAX_AGE (30*24*60*60) /* seconds */
+#define DICOM_INDEX_HEADER "AMIDE DICOM Index" /* group with the version, not a file */
+#define DICOM_SCAN_BATCH 256 /* files scanned between progress updates */
+
+typedef struct {
+  gchar * filename;
+  gint64 mtime;
+  gint64 size;
+  slice_info_t * info; /* NULL if not a DICOM file we can use */
+  gboolean indexed; /* TRUE if this came out of the index */
+} dicom_scan_t;
+
+typedef struct {
+  dicom_scan_t ** scans;
+  GHashTable * index; /* basename -> dicom_scan_t, or NULL */
+} dicom_scan_job_t;
+
+static void dicom_scan_free(gpointer data) {
+
+  dicom_scan_t * scan = (dicom_scan_t *) data;
+
+  if (scan->info != NULL)
+    free_slice_info(scan->info);
+  g_free(scan->filename);
+  g_free(scan);
+
+  return;
+}
+
+/* where the index for the given directory lives */
+static gchar * dicom_index_filename(const gchar * dirname) {
+
+  gchar * current_dir;
+  gchar * full_dirname;
+  gchar * checksum;
+  gchar * index_name;
+  gchar * index_filename;
+
+  if (g_path_is_absolute(dirname)) {
+    full_dirname = g_strdup(dirname);
+  } else {
+    current_dir = g_get_current_dir();
+    full_dirname = g_build_filename(current_dir, dirname, NULL);
+    g_free(current_dir);
+  }
+
+  checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, full_dirname, -1);
+  index_name = g_strdup_printf("%s.index", checksum);
+  index_filename = g_build_filename(g_get_user_cache_dir(), "amide", "dicom", index_name, NULL);
+
+  g_free(index_name);
+  g_free(checksum);
+  g_free(full_dirname);
+
+  return index_filename;
+}
+
+static gchar * dicom_index_get_string(GKeyFile * key_file, const gchar * group, const gchar * key) {
+  return g_key_file_get_string(key_file, group, key, NULL); /* NULL if not there */
+}
+
+/* returns a table of what's in the index, or NULL if there's no usable index */
+static GHashTable * dicom_index_load(const gchar * index_filename) {
+
+  GKeyFile * key_file;
+  GHashTable * index;
+  GError * error=NULL;
+  gchar ** groups;
+  gchar * temp_str;
+  dicom_scan_t * scan;
+  gint series_number;
+  gint i;
+
+  key_file = g_key_file_new();
+  if (!g_key_file_load_from_file(key_file, index_filename, G_KEY_FILE_NONE, NULL)) {
+    g_key_file_free(key_file);
+    return NULL;
+  }
+
+  if (g_key_file_get_integer(key_file, DICOM_INDEX_HEADER, "Version", NULL) != DICOM_INDEX_VERSION) {
+    g_key_file_free(key_file);
+    return NULL;
+  }
+
+  index = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, dicom_scan_free);
+
+  groups = g_key_file_get_groups(key_file, NULL);
+  for (i=0; groups[i] != NULL; i++) {
+    if (strcmp(groups[i], DICOM_INDEX_HEADER) == 0) continue;
+
+    scan = g_new0(dicom_scan_t, 1);
+    scan->filename = g_strdup(groups[i]);
+    temp_str = dicom_index_get_string(key_file, groups[i], "MTime");
+    scan->mtime = (temp_str != NULL) ? g_ascii_strtoll(temp_str, NULL, 10) : -1;
+    g_free(temp_str);
+    temp_str = dicom_index_get_string(key_file, groups[i], "Size");
+    scan->size = (temp_str != NULL) ? g_ascii_strtoll(temp_str, NULL, 10) : -1;
+    g_free(temp_str);
+    if (g_key_file_get_boolean(key_file, groups[i], "DICOM", NULL)) {
+      scan->info = slice_info_new();
+      scan->info->series_instance_uid = dicom_index_get_string(key_file, groups[i], "SeriesInstanceUID");
+      scan->info->modality = dicom_index_get_string(key_file, groups[i], "Modality");
+      scan->info->series_description = dicom_index_get_string(key_file, groups[i], "SeriesDescription");
+      scan->info->patient_key = dicom_index_get_string(key_file, groups[i], "PatientKey");
+      series_number = g_key_file_get_integer(key_file, groups[i], "SeriesNumber", &error);
+      if (error == NULL) 
+	scan->info->series_number = series_number;
+      else {
+	g_error_free(error);
+	error = NULL;
+      }
+    }
+
+    g_hash_table_insert(index, scan->filename, scan);
+  }
+  g_strfreev(groups);
+  g_key_file_free(key_file);
+
+  return index;
+}
+
+static void dicom_index_set_string(GKeyFile * key_file, const gchar * group, 
+				   const gchar * key, const gchar * str) {
+  if (str != NULL)
+    g_key_file_set_string(key_file, group, key, str);
+  return;
+}
+
+/* throw out index files that haven't been written in a while, so indexes of 
+   directories that are gone or no longer used don't pile up */
+static void dicom_index_prune(const gchar * index_dirname) {
+
+  GDir * dir;
+  const gchar * name;
+  gchar * filename;
+  struct stat file_info;
+  time_t now;
+
+  if ((dir = g_dir_open(index_dirname, 0, NULL)) == NULL) return;
+
+  now = time(NULL);
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    if (!g_str_has_suffix(name, ".index")) continue;
+    filename = g_build_filename(index_dirname, name, NULL);
+    if ((stat(filename, &file_info) == 0) && (now - file_info.st_mtime > DICOM_INDEX_MAX_AGE))
+      g_unlink(filename);
+    g_free(filename);
+  }
+  g_dir_close(dir);
+
+  return;
+}
+
+/* write out what we know about the directory's files. The index is just a
+   speed up, so not being able to write it isn't worth complaining about */
+static void dicom_index_save(const gchar * index_filename, dicom_scan_t ** scans, gint num_scans) {
+
+  GKeyFile * key_file;
+  gchar * index_dirname;
+  gchar * name;
+  gchar * temp_str;
+  gchar * data;
+  gsize length;
+  gint i;
+
+  index_dirname = g_path_get_dirname(index_filename);
+  if (g_mkdir_with_parents(index_dirname, 0700) != 0) {
+    g_free(index_dirname);
+    return;
+  }
+  dicom_index_prune(index_dirname);
+  g_free(index_dirname);
+
+  key_file = g_key_file_new();
+  g_key_file_set_integer(key_file, DICOM_INDEX_HEADER, "Version", DICOM_INDEX_VERSION);
+
+  for (i=0; i < num_scans; i++) {
+    if (scans[i]->mtime < 0) continue; /* couldn't stat */
+    name = g_path_get_basename(scans[i]->filename);
+
+    /* some names can't be group names in a key file */
+    if (g_utf8_validate(name, -1, NULL) && (strcmp(name, DICOM_INDEX_HEADER) != 0) &&
+	(strpbrk(name, "[]\n\r") == NULL)) {
+      temp_str = g_strdup_printf("%" G_GINT64_FORMAT, scans[i]->mtime);
+      g_key_file_set_string(key_file, name, "MTime", temp_str);
+      g_free(temp_str);
+      temp_str = g_strdup_printf("%" G_GINT64_FORMAT, scans[i]->size);
+      g_key_file_set_string(key_file, name, "Size", temp_str);
+      g_free(temp_str);
+      g_key_file_set_boolean(key_file, name, "DICOM", scans[i]->info != NULL);
+
+      if (scans[i]->info != NULL) {
+	dicom_index_set_string(key_file, name, "SeriesInstanceUID", scans[i]->info->series_instance_uid);
+	dicom_index_set_string(key_file, name, "Modality", scans[i]->info->modality);
+	dicom_index_set_string(key_file, name, "SeriesDescription", scans[i]->info->series_description);
+	dicom_index_set_string(key_file, name, "PatientKey", scans[i]->info->patient_key);
+	if (scans[i]->info->series_number >= 0)
+	  g_key_file_set_integer(key_file, name, "SeriesNumber", scans[i]->info->series_number);
+      }
+    }
+    g_free(name);
+  }
+
+  data = g_key_file_to_data(key_file, &length, NULL);
+  if (data != NULL) {
+    g_file_set_contents(index_filename, data, length, NULL);
+    g_free(data);
+  }
+  g_key_file_free(key_file);
+
+  return;
+}
+
+/* scans files start through end-1, can run on any thread */
+static void dicom_scan_func(const gint start, const gint end, gpointer data) {
+
+  dicom_scan_job_t * job = (dicom_scan_job_t *) data;
+  dicom_scan_t * scan;
+  dicom_scan_t * indexed;
+  struct stat file_info;
+  gchar * name;
+  gint i;
+
+  for (i=start; i<end; i++) {
+    scan = job->scans[i];
+
+    if (stat(scan->filename, &file_info) != 0) {
+      scan->mtime = scan->size = -1;
+    } else {
+      scan->mtime = file_info.st_mtime;
+      scan->size = file_info.st_size;
+    }
+
+    /* see if the index already knows about this one, the index is only read here */
+    if ((job->index != NULL) && (scan->mtime >= 0)) {
+      name = g_path_get_basename(scan->filename);
+      indexed = (dicom_scan_t *) g_hash_table_lookup(job->index, name);
+      g_free(name);
+
+      if ((indexed != NULL) && (indexed->mtime == scan->mtime) && (indexed->size == scan->size)) {
+	if (indexed->info != NULL) {
+	  scan->info = slice_info_copy(indexed->info);
+	  if (scan->info != NULL) {
+	    g_free(scan->info->filename);
+	    scan->info->filename = g_strdup(scan->filename);
+	  }
+	}
+	scan->indexed = TRUE;
+	continue;
+      }
+    }
+
+    if (dcmtk_test_dicom(scan->filename))
+      scan->info = get_slice_info(scan->filename);
+  }
+
+  return;
+}
+
 static gboolean check_str(gchar * str1, gchar * str2) {
 
   if ((str1 == NULL) && (str2 == NULL))
@@ -1662,11 +1957,7 @@ static gboolean check_same(slice_info_t * slice1, slice_info_t * slice2) {
   if (!check_str(slice1->modality, slice2->modality))
     return FALSE;
 
-  if (!check_str(slice1->patient_id, slice2->patient_id)) {
-    return FALSE;
-  }
-
-  if (!check_str(slice1->patient_name, slice2->patient_name)) {
+  if (!check_str(slice1->patient_key, slice2->patient_key)) {
     return FALSE;
   }
 
@@ -1732,7 +2023,13 @@ static GList * import_files(const gchar * filename,
   gchar * dirname=NULL;
   gchar * basename=NULL;
   gchar * regularized_filename;
-  gchar * new_filename;
+  gchar * index_filename=NULL;
+  GHashTable * index=NULL;
+  GPtrArray * scans;
+  dicom_scan_t * scan;
+  dicom_scan_job_t job;
+  gboolean index_dirty;
+  guint i, batch;
   DIR* dir;
   struct dirent* entry;
   gboolean continue_work=TRUE;
@@ -1762,29 +2059,65 @@ static GList * import_files(const gchar * filename,
   if (update_func != NULL) 
     continue_work = (*update_func)(update_data, _("Scanning Files to find additional DICOM Slices"), (gdouble) 0.0);
     
+  scans = g_ptr_array_new();
   if ((dir = opendir(dirname))!=NULL) {
     while (((entry = readdir(dir)) != NULL) && (continue_work)) {
 
       if (update_func != NULL)
 	continue_work = (*update_func)(update_data, NULL, -1.0);
 
-      if (dirname == NULL)
-	new_filename = g_strdup_printf("%s", entry->d_name);
-      else
-	new_filename = g_strdup_printf("%s%s%s", dirname, G_DIR_SEPARATOR_S,entry->d_name);
-
       if (strcmp(basename, entry->d_name) != 0) { /* we've already got the initial filename */
-	if (dcmtk_test_dicom(new_filename)) {
-	  info = get_slice_info(new_filename);
-	  if (info != NULL) 
-	    raw_info = g_list_append(raw_info, info); /* we have a match */
-	}
+	scan = g_new0(dicom_scan_t, 1);
+	if (dirname == NULL)
+	  scan->filename = g_strdup_printf("%s", entry->d_name);
+	else
+	  scan->filename = g_strdup_printf("%s%s%s", dirname, G_DIR_SEPARATOR_S,entry->d_name);
+	g_ptr_array_add(scans, scan);
       }
-
-      g_free(new_filename);
     }
     if (dir != NULL) closedir(dir);
   }
+
+  /* see what we already know about these files */
+  if ((dirname != NULL) && 
+      ((preferences != NULL) ? AMITK_PREFERENCES_DICOM_USE_INDEX(preferences) : AMITK_PREFERENCES_DEFAULT_DICOM_USE_INDEX)) {
+    index_filename = dicom_index_filename(dirname);
+    index = dicom_index_load(index_filename);
+  }
+
+  /* and read the headers of the rest */
+  job.index = index;
+  for (i=0; (i < scans->len) && continue_work; i += batch) {
+    batch = MIN(DICOM_SCAN_BATCH, scans->len-i);
+    job.scans = ((dicom_scan_t **) scans->pdata) + i;
+    amitk_parallel_for(batch, 4, dicom_scan_func, &job);
+
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, (gdouble) (i+batch)/scans->len);
+  }
+
+  /* update the index if anything's changed */
+  if ((index_filename != NULL) && continue_work) {
+    index_dirty = (index == NULL) || (g_hash_table_size(index) != scans->len);
+    for (i=0; (i < scans->len) && !index_dirty; i++)
+      if (!((dicom_scan_t *) g_ptr_array_index(scans, i))->indexed)
+	index_dirty = TRUE;
+    if (index_dirty)
+      dicom_index_save(index_filename, (dicom_scan_t **) scans->pdata, scans->len);
+  }
+  if (index != NULL) g_hash_table_destroy(index);
+  if (index_filename != NULL) g_free(index_filename);
+
+  for (i=0; i < scans->len; i++) {
+    scan = (dicom_scan_t *) g_ptr_array_index(scans, i);
+    if (scan->info != NULL) {
+      raw_info = g_list_prepend(raw_info, scan->info); /* we have a match */
+      scan->info = NULL;
+    }
+    dicom_scan_free(scan);
+  }
+  g_ptr_array_free(scans, TRUE);
+
   if (dirname != NULL) g_free(dirname);
   if (basename != NULL) g_free(basename);
 
@@ -2315,6 +2648,7 @@ gboolean dcmtk_export(AmitkDataSet * ds,
   gboolean format_changing;
   gboolean format_size_short;
   gpointer buffer = NULL;
+  gpointer plane_pointer;
   amitk_format_SSHORT_t * sshort_buffer;
   gdouble min,max;
   gint buffer_size;
@@ -2811,7 +3145,9 @@ gboolean dcmtk_export(AmitkDataSet * ds,
 	} else { /* short or char type */
 	  i_voxel.y = 0;
 	  i_voxel.x = 0;
-	  memcpy(buffer, amitk_raw_data_get_pointer(AMITK_DATA_SET_RAW_DATA(ds), i_voxel), buffer_size);
+	  plane_pointer = amitk_raw_data_get_plane(AMITK_DATA_SET_RAW_DATA(ds), i_voxel, buffer);
+	  if (plane_pointer != buffer)
+	    memcpy(buffer, plane_pointer, buffer_size);
 	}
 
 	/* convert to little endian */
@@ -149,6 +149,38 @@ static void image_free_rgb_data(guchar * pixels, gpointer data) {
   return;
 }
 
+/* colors in the (single plane) data set with the given color table, flipping it
+   over to compensate for the fact that X defines the origin as top left, not 
+   bottom left.  Returns NULL if out of memory */
+static rgba_t * image_colorize_plane(AmitkDataSet * ds,
+				     const AmitkColorTable color_table,
+				     const amide_data_t min,
+				     const amide_data_t max) {
+
+  AmitkVoxel dim;
+  amide_data_t * values;
+  rgba_t * colors;
+  amide_intpoint_t y;
+
+  dim = AMITK_DATA_SET_DIM(ds);
+
+  if ((values = g_try_new(amide_data_t, dim.x*dim.y)) == NULL) 
+    return NULL;
+  if ((colors = g_try_new(rgba_t, dim.x*dim.y)) == NULL) {
+    g_free(values);
+    return NULL;
+  }
+
+  amitk_data_set_get_plane_values(ds, 0, 0, 0, values);
+  for (y = 0; y < dim.y; y++)
+    amitk_color_table_lookup_array(values + (dim.y-y-1)*dim.x, dim.x,
+				   color_table, min, max, colors + y*dim.x);
+
+  g_free(values);
+
+  return colors;
+}
+
 
 
 /* note, return offset and corner are in base coordinate frame */
@@ -565,12 +597,12 @@ GdkPixbuf * image_from_colortable(const AmitkColorTable color_table,
 GdkPixbuf * image_from_projection(AmitkDataSet * projection) {
 
   guchar * rgb_data;
-  AmitkVoxel i;
   AmitkVoxel dim;
   amide_data_t max,min;
   GdkPixbuf * temp_image;
-  rgba_t rgba_temp;
+  rgba_t * colors;
   AmitkColorTable color_table;
+  gint j;
   
   /* sanity checks */
   g_return_val_if_fail(AMITK_IS_DATA_SET(projection), NULL);
@@ -589,18 +621,18 @@ GdkPixbuf * image_from_projection(AmitkDataSet * projection) {
       
   color_table = AMITK_DATA_SET_COLOR_TABLE(projection, AMITK_VIEW_MODE_SINGLE);
 
-  i.t = i.g = i.z = 0;
-  for (i.y = 0; i.y < dim.y; i.y++) 
-    for (i.x = 0; i.x < dim.x; i.x++) {
-      rgba_temp =
-	amitk_color_table_lookup(AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(projection,i), 
-				 color_table,min, max);
-	  
-      /* compensate for the fact that X defines the origin as top left, not bottom left */
-	rgb_data[(dim.y-i.y-1)*dim.x*3 + i.x*3+0] = rgba_temp.r;
-	rgb_data[(dim.y-i.y-1)*dim.x*3 + i.x*3+1] = rgba_temp.g;
-	rgb_data[(dim.y-i.y-1)*dim.x*3 + i.x*3+2] = rgba_temp.b;
-    }
+  if ((colors = image_colorize_plane(projection, color_table, min, max)) == NULL) {
+    g_warning(_("couldn't allocate memory for rgba_data for projection image"));
+    g_free(rgb_data);
+    return NULL;
+  }
+
+  for (j=0; j < dim.x*dim.y; j++) {
+    rgb_data[3*j+0] = colors[j].r;
+    rgb_data[3*j+1] = colors[j].g;
+    rgb_data[3*j+2] = colors[j].b;
+  }
+  g_free(colors);
 
   /* from the rgb_data, generate a GdkPixbuf */
   temp_image = gdk_pixbuf_new_from_data(rgb_data, GDK_COLORSPACE_RGB,
@@ -614,12 +646,9 @@ GdkPixbuf * image_from_projection(AmitkDataSet * projection) {
 GdkPixbuf * image_from_slice(AmitkDataSet * slice, AmitkViewMode view_mode) {
 
   guchar * rgba_data;
-  AmitkVoxel i;
   AmitkVoxel dim;
   amide_data_t max,min;
   GdkPixbuf * temp_image;
-  guint index;
-  rgba_t rgba_temp;
   AmitkColorTable color_table;
 
   /* sanity checks */
@@ -628,11 +657,6 @@ GdkPixbuf * image_from_slice(AmitkDataSet * slice, AmitkViewMode view_mode) {
   
   dim = AMITK_DATA_SET_DIM(slice);
 
-  if ((rgba_data = g_try_new(guchar,4*dim.x*dim.y)) == NULL) {
-    g_warning(_("couldn't allocate memory for rgba_data for slice image"));
-    return NULL;
-  }
-
   amitk_data_set_get_thresholding_min_max(AMITK_DATA_SET_SLICE_PARENT(slice),
 					  AMITK_DATA_SET(slice),
 					  AMITK_DATA_SET_SCAN_START(slice),
@@ -641,20 +665,11 @@ GdkPixbuf * image_from_slice(AmitkDataSet * slice, AmitkViewMode view_mode) {
       
   color_table = amitk_data_set_get_color_table_to_use(AMITK_DATA_SET_SLICE_PARENT(slice), view_mode);
 
-  i.t = i.g = i.z = 0;
-  index=0;
-
-  /* compensate for the fact that X defines the origin as top left, not bottom left */
-  for (i.y = dim.y-1; i.y >= 0; i.y--) 
-    for (i.x = 0; i.x < dim.x; i.x++, index+=4) {
-      rgba_temp =
-	amitk_color_table_lookup(AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(slice,i), color_table,min, max);
-      
-	rgba_data[index+0] = rgba_temp.r;
-	rgba_data[index+1] = rgba_temp.g;
-	rgba_data[index+2] = rgba_temp.b;
-	rgba_data[index+3] = rgba_temp.a;
-    }
+  /* rgba_t is laid out as the pixbuf wants its pixels */
+  if ((rgba_data = (guchar *) image_colorize_plane(slice, color_table, min, max)) == NULL) {
+    g_warning(_("couldn't allocate memory for rgba_data for slice image"));
+    return NULL;
+  }
 
   /* from the rgb_data, generate a GdkPixbuf */
   temp_image = gdk_pixbuf_new_from_data(rgba_data, GDK_COLORSPACE_RGB,
@@ -664,168 +679,328 @@ GdkPixbuf * image_from_slice(AmitkDataSet * slice, AmitkViewMode view_mode) {
   return temp_image;
 }
 
-/* note, generally call this function with gate -1, only use the gate
-   parameter if you want to override the data set's specified gate */
-GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
-				 GList ** pslice_cache,
-				 const gint max_slice_cache_size,
-				 GList * objects,
-				 const AmitkDataSet * active_ds,
-				 const amide_time_t start,
-				 const amide_time_t duration,
-				 const amide_intpoint_t gate,
-				 const amide_real_t pixel_size,
-				 const AmitkVolume * view_volume,
-				 const AmitkFuseType fuse_type,
-				 const AmitkViewMode view_mode) {
+/* rows get handed out to the threads in chunks of roughly this many pixels,
+   so small canvases just get done on the calling thread */
+#define BLEND_PIXELS_PER_CHUNK 16384
 
-  gint slice_num;
-  guint32 total_alpha;
-  guchar * rgb_data;
-  rgba16_t * rgba16_data;
-  guint location;
-  AmitkVoxel i;
-  AmitkVoxel dim;
-  amide_data_t max,min;
-  GdkPixbuf * temp_image;
-  rgba_t rgba_temp;
-  GList * slices;
-  GList * temp_slices;
+typedef struct {
   AmitkDataSet * slice;
   AmitkColorTable color_table;
-  AmitkDataSet * overlay_slice = NULL;
-  gint j;
+  gboolean per_slice; /* if set, min and max start off as fractions of the slice's range */
+  amide_data_t min;
+  amide_data_t max;
+} blend_layer_t;
+
+typedef struct {
+  AmitkVoxel dim;
+  blend_layer_t * layers; /* the slices to blend */
+  gint num_layers;
+  blend_layer_t * overlay; /* drawn over the blend where it's not transparent, or NULL */
+  guchar * rgb_data;
+} blend_t;
+
+/* colors in row y of the slice, y counted from the bottom of the slice */
+static void blend_colorize_row(const blend_layer_t * layer, const amide_intpoint_t y,
+			       const amide_intpoint_t dim_x, amide_data_t * values, rgba_t * colors) {
+  AmitkVoxel i;
+  amitk_format_DOUBLE_t * row;
+  amide_data_t scale;
+
+  i.t = i.g = i.z = i.x = 0;
+  i.y = y;
+  row = AMITK_RAW_DATA_DOUBLE_POINTER(layer->slice->raw_data, i);
+  scale = *AMITK_RAW_DATA_DOUBLE_0D_SCALING_POINTER(layer->slice->current_scaling_factor, i);
+  for (i.x = 0; i.x < dim_x; i.x++)
+    values[i.x] = scale*row[i.x];
+
+  amitk_color_table_lookup_array(values, dim_x, layer->color_table, 
+				 layer->min, layer->max, colors);
+  return;
+}
+
+/* blends output rows start through end-1 straight into the rgb buffer.
+   Where any of the slices has some opacity, the result is the opacity weighted
+   average of the slices' colors, otherwise it's the plain average. */
+static void blend_rows_func(const gint start, const gint end, gpointer data) {
+
+  blend_t * job = data;
+  amide_intpoint_t dim_x = job->dim.x;
+  amide_data_t * values;
+  rgba_t * colors;
+  guint32 * sum_ca; /* r,g,b weighted by alpha */
+  guint32 * sum_c; /* r,g,b unweighted */
+  guint32 * sum_a;
+  guchar * rgb_row;
+  guint32 a;
+  gint y, l, x;
+
+  values = g_new(amide_data_t, dim_x);
+  colors = g_new(rgba_t, dim_x);
+  sum_ca = g_new(guint32, 3*dim_x);
+  sum_c = g_new(guint32, 3*dim_x);
+  sum_a = g_new(guint32, dim_x);
+
+  for (y=start; y<end; y++) {
+    /* X puts the origin top left, so output row y is slice row dim.y-y-1 */
+    rgb_row = job->rgb_data + ((gsize) y)*dim_x*3;
+
+    for (x=0; x<3*dim_x; x++) {
+      sum_ca[x] = 0;
+      sum_c[x] = 0;
+    }
+    for (x=0; x<dim_x; x++)
+      sum_a[x] = 0;
+
+    for (l=0; l<job->num_layers; l++) {
+      blend_colorize_row(&(job->layers[l]), job->dim.y-y-1, dim_x, values, colors);
+      for (x=0; x<dim_x; x++) {
+	a = colors[x].a;
+	sum_ca[3*x+0] += a*colors[x].r;
+	sum_ca[3*x+1] += a*colors[x].g;
+	sum_ca[3*x+2] += a*colors[x].b;
+	sum_c[3*x+0] += colors[x].r;
+	sum_c[3*x+1] += colors[x].g;
+	sum_c[3*x+2] += colors[x].b;
+	sum_a[x] += a;
+      }
+    }
+
+    if (job->num_layers > 0) {
+      for (x=0; x<dim_x; x++) {
+	if (sum_a[x] != 0) {
+	  rgb_row[3*x+0] = sum_ca[3*x+0]/sum_a[x];
+	  rgb_row[3*x+1] = sum_ca[3*x+1]/sum_a[x];
+	  rgb_row[3*x+2] = sum_ca[3*x+2]/sum_a[x];
+	} else {
+	  rgb_row[3*x+0] = sum_c[3*x+0]/job->num_layers;
+	  rgb_row[3*x+1] = sum_c[3*x+1]/job->num_layers;
+	  rgb_row[3*x+2] = sum_c[3*x+2]/job->num_layers;
+	}
+      }
+    } else {
+      for (x=0; x<3*dim_x; x++)
+	rgb_row[x] = 0;
+    }
+
+    if (job->overlay != NULL) {
+      blend_colorize_row(job->overlay, job->dim.y-y-1, dim_x, values, colors);
+      for (x=0; x<dim_x; x++) 
+	if (colors[x].a != 0) {
+	  rgb_row[3*x+0] = colors[x].r;
+	  rgb_row[3*x+1] = colors[x].g;
+	  rgb_row[3*x+2] = colors[x].b;
+	}
+    }
+  }
+
+  g_free(values);
+  g_free(colors);
+  g_free(sum_ca);
+  g_free(sum_c);
+  g_free(sum_a);
+
+  return;
+}
+
+/* everything image_from_data_sets needs is gathered up on the main thread
+   (image_fuse_new), so the slicing and blending (image_fuse_run) can be done 
+   from another thread */
+struct _image_fuse_t {
+  AmitkSliceRequest * request;
+  gint num_layers;
+  blend_layer_t * layers; /* one for each data set, in the order of the request */
+  gint overlay; /* which layer gets overlaid, or -1 */
+};
+
+/* note, generally call this function with gate -1, only use the gate
+   parameter if you want to override the data set's specified gate */
+image_fuse_t * image_fuse_new(GList * objects,
+			      const AmitkDataSet * active_ds,
+			      const amide_time_t start,
+			      const amide_time_t duration,
+			      const amide_intpoint_t gate,
+			      const amide_real_t pixel_size,
+			      const AmitkVolume * view_volume,
+			      const AmitkFuseType fuse_type,
+			      const AmitkViewMode view_mode) {
+
+  image_fuse_t * fuse;
+  blend_layer_t * layer;
+  AmitkDataSet * ds;
   AmitkCanvasPoint pixel_size2;
-  
+  amide_data_t threshold_range;
+  GList * temp_objects;
 
   /* sanity checks */
   g_return_val_if_fail(objects != NULL, NULL);
 
   pixel_size2.x = pixel_size2.y = pixel_size;
-  slices = amitk_data_sets_get_slices(objects, pslice_cache, max_slice_cache_size,
-				      start, duration, gate, pixel_size2,view_volume);
-  g_return_val_if_fail(slices != NULL, NULL);
 
-  /* get the dimensions.  since all slices have the same dimensions, we'll just get the first */
-  dim = AMITK_DATA_SET_DIM(slices->data);
+  fuse = g_new0(image_fuse_t, 1);
+  fuse->request = amitk_data_sets_slice_request_new(objects, TRUE, start, duration, 
+						    gate, pixel_size2, view_volume);
+  if (fuse->request == NULL) {
+    g_free(fuse);
+    return NULL;
+  }
+  fuse->layers = g_new0(blend_layer_t, g_list_length(objects));
+  fuse->overlay = -1;
+
+  /* figure out how each data set gets colored in */
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    if (!AMITK_IS_DATA_SET(temp_objects->data)) continue;
+    ds = AMITK_DATA_SET(temp_objects->data);
+
+    if ((fuse_type == AMITK_FUSE_TYPE_OVERLAY) && (ds == active_ds))
+      fuse->overlay = fuse->num_layers;
+
+    layer = &(fuse->layers[fuse->num_layers]);
+    fuse->num_layers++;
+    layer->color_table = amitk_data_set_get_color_table_to_use(ds, view_mode);
+
+    /* per slice thresholds depend on a slice we don't have yet, so just keep 
+       the fraction of the slice's range we'll want */
+    layer->per_slice = (AMITK_DATA_SET_THRESHOLDING(ds) == AMITK_THRESHOLDING_PER_SLICE);
+    if (layer->per_slice) {
+      threshold_range = amitk_data_set_get_global_max(ds)-amitk_data_set_get_global_min(ds);
+      layer->max = AMITK_DATA_SET_THRESHOLD_MAX(ds, 0)/threshold_range;
+      layer->min = AMITK_DATA_SET_THRESHOLD_MIN(ds, 0)/threshold_range;
+    } else {
+      amitk_data_set_get_thresholding_min_max(ds, NULL, start, duration, &(layer->min), &(layer->max));
+    }
+  }
 
-  /* allocate and initialize space for a temporary storage buffer */
-  rgba16_data = g_try_new(rgba16_t,dim.y*dim.x);
-  g_return_val_if_fail(rgba16_data != NULL, NULL);
+  return fuse;
+}
 
-  for (j=0; j<dim.y*dim.x; j++) {
-    rgba16_data[j].r = 0;
-    rgba16_data[j].g = 0;
-    rgba16_data[j].b = 0;
-    rgba16_data[j].a = 0;
-  }
+/* TRUE if the slices are all in the cache, so running is quick */
+gboolean image_fuse_cached(const image_fuse_t * fuse) {
+  g_return_val_if_fail(fuse != NULL, TRUE);
+  return amitk_data_sets_slice_request_cached(fuse->request);
+}
 
-  /* iterate through all the slices */
-  temp_slices = slices;
-  slice_num = 0;
+/* generates the slices and blends them together, can be called from any thread. 
+   Returns NULL if there's nothing to show or we run out of memory. */
+/* notes
+   - all the slices are colored in and blended in a single pass over the 
+     image, a chunk of rows at a time, writing straight into the pixbuf's buffer
+ */
+GdkPixbuf * image_fuse_run(image_fuse_t * fuse) {
 
-  while (temp_slices != NULL) {
-    slice = temp_slices->data;
-    if ((fuse_type == AMITK_FUSE_TYPE_OVERLAY) && (AMITK_DATA_SET_SLICE_PARENT(slice) == active_ds)) {
-      overlay_slice = slice;
-    } else { /* blend this slice */
-      slice_num++;
+  blend_t job;
+  blend_layer_t overlay;
+  blend_layer_t * layer;
+  AmitkDataSet * slice;
+  amide_data_t slice_range;
+  gint rows_per_chunk;
+  gint i;
 
-      amitk_data_set_get_thresholding_min_max(AMITK_DATA_SET_SLICE_PARENT(slice),
-					      AMITK_DATA_SET(slice),
-					      start, duration, &min, &max);
-      
-      
-      color_table = amitk_data_set_get_color_table_to_use(AMITK_DATA_SET_SLICE_PARENT(slice), view_mode);
-      /* now add this slice into the rgba16 data */
-      i.t = i.g = i.z = 0;
-      location=0;
-      /* compensate for the fact that X defines the origin as top left, not bottom left */
-      for (i.y = dim.y-1; i.y >= 0; i.y--) 
-	for (i.x = 0; i.x < dim.x; i.x++, location++) {
-	  rgba_temp = 
-	    amitk_color_table_lookup(AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(slice,i), color_table,min, max);
-	  
-	  total_alpha = rgba16_data[location].a + rgba_temp.a;
-	  if (total_alpha == 0) {
-	    rgba16_data[location].r = (((slice_num-1)*rgba16_data[location].r + 
-					rgba_temp.r)/
-				       ((gdouble) slice_num));
-	    rgba16_data[location].g = (((slice_num-1)*rgba16_data[location].g + 
-					rgba_temp.g)/
-				       ((gdouble) slice_num));
-	    rgba16_data[location].b = (((slice_num-1)*rgba16_data[location].b + 
-					rgba_temp.b)/
-				       ((gdouble) slice_num));
-	  } else if (rgba16_data[location].a == 0) {
-	    rgba16_data[location].r = rgba_temp.r;
-	    rgba16_data[location].g = rgba_temp.g;
-	    rgba16_data[location].b = rgba_temp.b;
-	    rgba16_data[location].a = rgba_temp.a;
-	  } else if (rgba_temp.a != 0) {
-	    rgba16_data[location].r = ((rgba16_data[location].r*rgba16_data[location].a 
-					+ rgba_temp.r*rgba_temp.a)/
-				       ((gdouble) total_alpha));
-	    rgba16_data[location].g = ((rgba16_data[location].g*rgba16_data[location].a 
-					+ rgba_temp.g*rgba_temp.a)/
-				       ((gdouble) total_alpha));
-	    rgba16_data[location].b = ((rgba16_data[location].b*rgba16_data[location].a 
-					+ rgba_temp.b*rgba_temp.a)/
-				       ((gdouble) total_alpha));
-	    rgba16_data[location].a = total_alpha;
-	  }
-	}
-    }
-    temp_slices = temp_slices->next;
-  }
+  g_return_val_if_fail(fuse != NULL, NULL);
 
-  /* allocate space for the true rgb buffer */
-  rgb_data = g_try_new(guchar,3*dim.y*dim.x);
-  g_return_val_if_fail(rgb_data != NULL, NULL);
+  amitk_data_sets_slice_request_run(fuse->request);
 
-  /* now convert our temp rgb data to real rgb data */
-  i.z = 0;
-  location=0;
-  for (i.y = 0; i.y < dim.y; i.y++) 
-    for (i.x = 0; i.x < dim.x; i.x++, location++) {
-      rgb_data[3*location+0] = rgba16_data[location].r < 0xFF ? rgba16_data[location].r : 0xFF;
-      rgb_data[3*location+1] = rgba16_data[location].g < 0xFF ? rgba16_data[location].g : 0xFF;
-      rgb_data[3*location+2] = rgba16_data[location].b < 0xFF ? rgba16_data[location].b : 0xFF;
-    }
+  job.layers = g_new(blend_layer_t, MAX(fuse->num_layers, 1));
+  job.num_layers = 0;
+  job.overlay = NULL;
+  job.rgb_data = NULL;
 
-  /* if we have a data set we're overlaying, add it in now */
-  if (overlay_slice != NULL) {
-      amitk_data_set_get_thresholding_min_max(AMITK_DATA_SET_SLICE_PARENT(overlay_slice),
-					      AMITK_DATA_SET(overlay_slice),
-					      start, duration, &min, &max);
-      
-      color_table = amitk_data_set_get_color_table_to_use(AMITK_DATA_SET_SLICE_PARENT(overlay_slice), view_mode);
+  for (i=0; i < fuse->num_layers; i++) {
+    slice = amitk_data_sets_slice_request_get_slice(fuse->request, i);
+    if (slice == NULL) continue; /* get_slice will have already complained */
 
-      i.t = i.g = i.z = 0;
-      for (i.y = 0; i.y < dim.y; i.y++) 
-	for (i.x = 0; i.x < dim.x; i.x++) {
-	  rgba_temp = 
-	    amitk_color_table_lookup(AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(overlay_slice,i), 
-				     color_table,min, max);
+    if (i == fuse->overlay) {
+      layer = &overlay;
+      job.overlay = &overlay;
+    } else {  /* blend this slice */
+      layer = &(job.layers[job.num_layers]);
+      job.num_layers++;
+    }
+    *layer = fuse->layers[i];
+    layer->slice = slice;
 
-	  /* compensate for the fact that X defines the origin as top left, not bottom left */
-	  location = (dim.y - i.y - 1)*dim.x+i.x;
-	  if (rgba_temp.a != 0) {
-	    rgb_data[3*location+0] = rgba_temp.r;
-	    rgb_data[3*location+1] = rgba_temp.g;
-	    rgb_data[3*location+2] = rgba_temp.b;
-	  }
-	}
+    if (layer->per_slice) {
+      slice_range = amitk_data_set_get_global_max(slice)-amitk_data_set_get_global_min(slice);
+      layer->max *= slice_range;
+      layer->min *= slice_range;
+    }
+
+    /* since all slices have the same dimensions, any of them will do */
+    job.dim = AMITK_DATA_SET_DIM(slice);
   }
-  
+
+  /* allocate space for the rgb buffer that'll become the pixbuf's */
+  if ((job.num_layers > 0) || (job.overlay != NULL))
+    job.rgb_data = g_try_new(guchar,3*job.dim.y*job.dim.x);
+  g_free(job.layers);
+  if (job.rgb_data == NULL) 
+    return NULL;
+
+  rows_per_chunk = MAX(1, BLEND_PIXELS_PER_CHUNK/job.dim.x);
+  amitk_parallel_for(job.dim.y, rows_per_chunk, blend_rows_func, &job);
 
   /* from the rgb_data, generate a GdkPixbuf */
-  temp_image = gdk_pixbuf_new_from_data(rgb_data, GDK_COLORSPACE_RGB,
-  					FALSE,8,dim.x,dim.y,dim.x*3*sizeof(guchar),
-  					image_free_rgb_data, NULL);
+  return gdk_pixbuf_new_from_data(job.rgb_data, GDK_COLORSPACE_RGB,
+				  FALSE,8,job.dim.x,job.dim.y,job.dim.x*3*sizeof(guchar),
+				  image_free_rgb_data, NULL);
+}
 
-  /* cleanup */
-  g_free(rgba16_data);
+/* returns the slices that were used, and frees fuse.  fuse must have been run */
+GList * image_fuse_finish(image_fuse_t * fuse) {
+
+  GList * slices;
+
+  g_return_val_if_fail(fuse != NULL, NULL);
+
+  slices = amitk_data_sets_slice_request_finish(fuse->request);
+  fuse->request = NULL;
+  image_fuse_free(fuse);
+
+  return slices;
+}
+
+void image_fuse_free(image_fuse_t * fuse) {
+
+  g_return_if_fail(fuse != NULL);
+
+  if (fuse->request != NULL)
+    amitk_data_sets_slice_request_free(fuse->request);
+  g_free(fuse->layers);
+  g_free(fuse);
+
+  return;
+}
+
+/* note, generally call this function with gate -1, only use the gate
+   parameter if you want to override the data set's specified gate */
+GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
+				 GList * objects,
+				 const AmitkDataSet * active_ds,
+				 const amide_time_t start,
+				 const amide_time_t duration,
+				 const amide_intpoint_t gate,
+				 const amide_real_t pixel_size,
+				 const AmitkVolume * view_volume,
+				 const AmitkFuseType fuse_type,
+				 const AmitkViewMode view_mode) {
+
+  image_fuse_t * fuse;
+  GdkPixbuf * temp_image;
+  GList * slices;
+
+  fuse = image_fuse_new(objects, active_ds, start, duration, gate, pixel_size,
+			view_volume, fuse_type, view_mode);
+  g_return_val_if_fail(fuse != NULL, NULL);
+
+  temp_image = image_fuse_run(fuse);
+  slices = image_fuse_finish(fuse);
+  if (slices == NULL) {
+    g_warning(_("couldn't generate slices for image"));
+    if (temp_image != NULL) g_object_unref(temp_image);
+    return NULL;
+  }
+
+  if (temp_image == NULL)
+    g_warning(_("couldn't allocate memory for rgb_data for image"));
 
   if (pdisp_slices != NULL) {
     amitk_objects_unref((*pdisp_slices));
@@ -841,9 +1016,6 @@ GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
 
 
 
-
-
-
 /* get the icon to use for this modality */
 GdkPixbuf * image_get_data_set_pixbuf(AmitkDataSet * ds) {
 
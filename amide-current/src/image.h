@@ -76,9 +76,21 @@ GdkPixbuf * image_from_colortable(const AmitkColorTable color_table,
 GdkPixbuf * image_from_projection(AmitkDataSet * projection);
 GdkPixbuf * image_from_slice(AmitkDataSet * slice,
 			     AmitkViewMode view_mode);
+typedef struct _image_fuse_t image_fuse_t;
+image_fuse_t * image_fuse_new(GList * objects,
+			      const AmitkDataSet * active_ds,
+			      const amide_time_t start,
+			      const amide_time_t duration,
+			      const amide_intpoint_t gate,
+			      const amide_real_t pixel_size,
+			      const AmitkVolume * view_volume,
+			      const AmitkFuseType fuse_type,
+			      const AmitkViewMode view_mode);
+gboolean image_fuse_cached(const image_fuse_t * fuse);
+GdkPixbuf * image_fuse_run(image_fuse_t * fuse);
+GList * image_fuse_finish(image_fuse_t * fuse);
+void image_fuse_free(image_fuse_t * fuse);
 GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
-				 GList ** pslice_cache,
-				 const gint max_slice_cache_size,
 				 GList * objects,
 				 const AmitkDataSet * active_ds,
 				 const amide_time_t start,
@@ -875,6 +875,7 @@ gboolean libmdc_export(AmitkDataSet * ds,
   gchar * err_str; /* note, err_str (if used) will point to a const string in libmdc  */
   gint err_num;
   void * data_ptr;
+  void * row_buf;
   gchar * temp_string;
   amide_time_t frame_start, frame_duration;
   AmitkCanvasPoint pixel_size;
@@ -1080,7 +1081,6 @@ gboolean libmdc_export(AmitkDataSet * ds,
 
 
   image_num=0;
-  data_ptr = ds->raw_data->data;
   j = zero_voxel;
   i = zero_voxel;
   for (i.t = 0; (i.t < dim.t) && (continue_work); i.t++) {
@@ -1173,8 +1173,10 @@ gboolean libmdc_export(AmitkDataSet * ds,
 		row_data[j.x] = 0.0;
 	    }
 	  } else {
-	    memcpy(plane->buf+bytes_per_row*(dim.y-i.y-1), data_ptr, bytes_per_row);
-	    data_ptr += bytes_per_row;
+	    row_buf = plane->buf+bytes_per_row*(dim.y-i.y-1);
+	    data_ptr = amitk_raw_data_get_row(AMITK_DATA_SET_RAW_DATA(ds), i, dim.x, row_buf);
+	    if (data_ptr != row_buf)
+	      memcpy(row_buf, data_ptr, bytes_per_row);
 	  }
 	}
 
@@ -862,7 +862,8 @@ static gboolean update_canvas_while_idle(gpointer data) {
 
     /* create the projections if we haven't already */
     if (tb_crop->projections[view] == NULL) 
-      amitk_data_set_get_projections(tb_crop->data_set, tb_crop->frame, tb_crop->gate, 
+      amitk_data_set_get_projections(tb_crop->data_set, AMITK_PROJECTION_SUM,
+				     tb_crop->frame, 1, tb_crop->gate, 1,
 				     tb_crop->projections, 
 				     amitk_progress_dialog_update, tb_crop->progress_dialog);
 
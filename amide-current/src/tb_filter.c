@@ -33,8 +33,8 @@
 
 #define LABEL_WIDTH 375
 
-#define MIN_FIR_FILTER_SIZE 7
-#define MAX_FIR_FILTER_SIZE 31
+#define MIN_GAUSSIAN_FILTER_SIZE 7
+#define MAX_GAUSSIAN_FILTER_SIZE 255
 #define MIN_NONLINEAR_FILTER_SIZE 3
 #define MAX_NONLINEAR_FILTER_SIZE 11
 #define DEFAULT_GAUSSIAN_FILTER_SIZE 15
@@ -50,10 +50,8 @@ N_("When the apply button is hit, a new data set will be created "
    "and placed into the study's tree, consisting of the appropriately "
    "filtered data\n");
 
-#ifdef AMIDE_LIBGSL_SUPPORT
 static const char * gaussian_filter_text = 
 N_("The Gaussian filter is an effective smoothing filter");
-#endif
 
 
 static const char * median_3d_filter_text = 
@@ -71,11 +69,22 @@ N_("Median filters work relatively well at preserving edges while\n"
    "determining the median will be of the given kernel size, and the\n"
    "data set will be filtered 3x (once for each direction).");
 
-#ifndef AMIDE_LIBGSL_SUPPORT
-static const char *no_libgsl_text =
-N_("This filter requires support from the GNU Scientific Library (GSL).\n"
-   "This version of AMIDE has not been compiled with GSL support enabled.");
-#endif
+static const char * median_frames_filter_text = 
+N_("Median filters work relatively well at preserving edges while\n"
+   "removing speckle noise.\n"
+   "\n"
+   "This filter takes the median of each voxel over the neighboring\n"
+   "frames, so the neighborhood used for determining the median will\n"
+   "be of the given kernel size in time.");
+
+static const char * median_gates_filter_text = 
+N_("Median filters work relatively well at preserving edges while\n"
+   "removing speckle noise.\n"
+   "\n"
+   "This filter takes the median of each voxel over the neighboring\n"
+   "gates, so the neighborhood used for determining the median will\n"
+   "be of the given kernel size across the gates.");
+
 
 
 typedef enum {
@@ -83,6 +92,8 @@ typedef enum {
   GAUSSIAN_FILTER_PAGE,
   MEDIAN_LINEAR_FILTER_PAGE,
   MEDIAN_3D_FILTER_PAGE,
+  MEDIAN_FRAMES_FILTER_PAGE,
+  MEDIAN_GATES_FILTER_PAGE,
   CONCLUSION_PAGE,
   NUM_PAGES
 } which_page_t;
@@ -225,6 +236,8 @@ static gint forward_page_function (gint current_page, gpointer data) {
   case GAUSSIAN_FILTER_PAGE:
   case MEDIAN_LINEAR_FILTER_PAGE:
   case MEDIAN_3D_FILTER_PAGE:
+  case MEDIAN_FRAMES_FILTER_PAGE:
+  case MEDIAN_GATES_FILTER_PAGE:
     return CONCLUSION_PAGE;
     break;
   default:
@@ -330,7 +343,6 @@ static GtkWidget * create_page(tb_filter_t * tb_filter, which_page_t i_page) {
     
     break;
   case GAUSSIAN_FILTER_PAGE:
-#ifdef AMIDE_LIBGSL_SUPPORT
     tb_filter->kernel_size = DEFAULT_GAUSSIAN_FILTER_SIZE;
     
     label = gtk_label_new(_(gaussian_filter_text));
@@ -345,8 +357,8 @@ static GtkWidget * create_page(tb_filter_t * tb_filter, which_page_t i_page) {
 		     table_column,table_column+1, table_row,table_row+1,
 		     FALSE,FALSE, X_PADDING, Y_PADDING);
     
-    spin_button =  gtk_spin_button_new_with_range(MIN_FIR_FILTER_SIZE, 
-						  MAX_FIR_FILTER_SIZE,2);
+    spin_button =  gtk_spin_button_new_with_range(MIN_GAUSSIAN_FILTER_SIZE, 
+						  MAX_GAUSSIAN_FILTER_SIZE,2);
     gtk_spin_button_set_digits(GTK_SPIN_BUTTON(spin_button),0);
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), 
 			      tb_filter->kernel_size);
@@ -372,19 +384,21 @@ static GtkWidget * create_page(tb_filter_t * tb_filter, which_page_t i_page) {
     gtk_table_attach(GTK_TABLE(table), spin_button, 
 		     table_column+1,table_column+2, table_row,table_row+1,
 		     FALSE,FALSE, X_PADDING, Y_PADDING);
-#else /* no libgsl support */
-    label = gtk_label_new(_(no_libgsl_text));
-    gtk_table_attach(GTK_TABLE(table), label, 
-		     table_column,table_column+2, table_row,table_row+1,
-		     FALSE,FALSE, X_PADDING, Y_PADDING);
-    table_row++;
-#endif
     break;
   case MEDIAN_3D_FILTER_PAGE:
   case MEDIAN_LINEAR_FILTER_PAGE:
+  case MEDIAN_FRAMES_FILTER_PAGE:
+  case MEDIAN_GATES_FILTER_PAGE:
     tb_filter->kernel_size = DEFAULT_MEDIAN_FILTER_SIZE;
     
-    label = gtk_label_new((i_page == MEDIAN_3D_FILTER_PAGE) ? _(median_3d_filter_text) : _(median_linear_filter_text));
+    if (i_page == MEDIAN_3D_FILTER_PAGE)
+      label = gtk_label_new(_(median_3d_filter_text));
+    else if (i_page == MEDIAN_FRAMES_FILTER_PAGE)
+      label = gtk_label_new(_(median_frames_filter_text));
+    else if (i_page == MEDIAN_GATES_FILTER_PAGE)
+      label = gtk_label_new(_(median_gates_filter_text));
+    else
+      label = gtk_label_new(_(median_linear_filter_text));
     gtk_table_attach(GTK_TABLE(table), label, 
 		     table_column,table_column+2, table_row,table_row+1,
 		     FALSE,FALSE, X_PADDING, Y_PADDING);
@@ -476,10 +490,6 @@ void tb_filter(AmitkStudy * study, AmitkDataSet * active_ds, GtkWindow * parent)
   }
   g_object_unref(logo);
 
-#ifndef AMIDE_LIBGSL_SUPPORT
-  gtk_assistant_set_page_complete(GTK_ASSISTANT(tb_filter->dialog), tb_filter->page[GAUSSIAN_FILTER_PAGE], FALSE);
-#endif
-
   gtk_widget_show_all(tb_filter->dialog);
 
   return;
@@ -27,12 +27,16 @@
 #include "amide_config.h"
 #include "amide.h"
 #include "amitk_progress_dialog.h"
+#include "amitk_math_expression.h"
 #include "tb_math.h"
 
 
 #define SPIN_BUTTON_X_SIZE 100
 #define LABEL_WIDTH 375
 
+/* the expression comes after the unary and binary operations in the operation list */
+#define EXPRESSION_OPERATION (AMITK_OPERATION_UNARY_NUM+AMITK_OPERATION_BINARY_NUM)
+
 
 static gchar * data_set_error_page_text = 
 N_("There are no data sets in this study to perform "
@@ -47,6 +51,12 @@ N_("Welcome to the data set math wizard, used for "
    "will likely get more pleasing results if the data sets in "
    "question are set to trilinear interpolation mode.");
 
+static gchar * expression_text = 
+N_("Enter a formula in terms of the data sets below, for example "
+   "\"(a-b)/c * (c > 10)\".  Supported are + - * / ^, comparisons, "
+   "&& || !, \"condition ? value : value\", and the functions "
+   "abs, sqrt, exp, log, log10, min, max and pow.");
+
 
 typedef enum {
   COLUMN_DATA_SET_NAME,
@@ -85,6 +95,10 @@ typedef struct tb_math_t {
   GtkWidget * parameter1_spin;
   GtkWidget * by_frames_check_button;
   GtkWidget * maintain_ds1_dim_check_button;
+  GtkWidget * expression_help_label;
+  GtkWidget * expression_entry;
+  GtkWidget * expression_variables_label;
+  GtkWidget * expression_error_label;
 
   AmitkStudy * study;
   gint ds_count;
@@ -95,6 +109,7 @@ typedef struct tb_math_t {
   amide_data_t parameter1;
   gboolean by_frames;
   gboolean maintain_ds1_dim;
+  gchar * expression;
 
   guint reference_count;
 } tb_math_t;
@@ -110,6 +125,9 @@ static void parameter0_spinner_cb(GtkSpinButton * spin_button, gpointer data);
 static void parameter1_spinner_cb(GtkSpinButton * spin_button, gpointer data);
 static void by_frames_cb(GtkWidget * widget, gpointer data);
 static void maintain_ds1_dim_cb(GtkWidget * widget, gpointer data);
+static void expression_update(tb_math_t * tb_math);
+static void expression_changed_cb(GtkWidget * widget, gpointer data);
+static gint forward_page_function (gint current_page, gpointer data);
 
 static tb_math_t * tb_math_free(tb_math_t * math);
 static tb_math_t * tb_math_init(void);
@@ -159,6 +177,14 @@ static void operation_update_model(tb_math_t * tb_math) {
     }
   }
 
+  /* and the free form expression */
+  gtk_list_store_append (GTK_LIST_STORE(model), &iter);  /* Acquire an iterator */
+  gtk_list_store_set(GTK_LIST_STORE(model), &iter,
+		     COLUMN_OPERATION_NAME, _("expression"),
+		     COLUMN_OPERATION_NUMBER, EXPRESSION_OPERATION, -1);
+  if (tb_math->operation == EXPRESSION_OPERATION)
+    gtk_tree_selection_select_iter (selection, &iter);
+
   return;
 }
 
@@ -226,7 +252,33 @@ static void data_sets_update_model(tb_math_t * tb_math) {
 
 static void parameters_update_page(tb_math_t * tb_math) {
 
-  if (tb_math->operation == AMITK_OPERATION_UNARY_RESCALE) {
+  if (tb_math->operation == EXPRESSION_OPERATION) {
+    gtk_widget_show(tb_math->expression_help_label);
+    gtk_widget_show(tb_math->expression_entry);
+    gtk_widget_show(tb_math->expression_variables_label);
+    gtk_widget_show(tb_math->expression_error_label);
+    gtk_button_set_label(GTK_BUTTON(tb_math->maintain_ds1_dim_check_button),
+			 _("Maintain dimensions of the first data set used (default is superset of all data sets used)"));
+  } else {
+    gtk_widget_hide(tb_math->expression_help_label);
+    gtk_widget_hide(tb_math->expression_entry);
+    gtk_widget_hide(tb_math->expression_variables_label);
+    gtk_widget_hide(tb_math->expression_error_label);
+    gtk_button_set_label(GTK_BUTTON(tb_math->maintain_ds1_dim_check_button),
+			 _("Maintain data set 1 dimensions (default is superset of both data sets)"));
+    gtk_assistant_set_page_complete(GTK_ASSISTANT(tb_math->dialog),
+				    tb_math->page[PARAMETERS_PAGE], TRUE);
+  }
+
+  if (tb_math->operation == EXPRESSION_OPERATION) {
+    gtk_widget_hide(tb_math->parameter0_label);
+    gtk_widget_hide(tb_math->parameter0_spin);
+    gtk_widget_hide(tb_math->parameter1_label);
+    gtk_widget_hide(tb_math->parameter1_spin);
+    gtk_widget_show(tb_math->by_frames_check_button);
+    gtk_widget_show(tb_math->maintain_ds1_dim_check_button);
+    expression_update(tb_math);
+  } else if (tb_math->operation == AMITK_OPERATION_UNARY_RESCALE) {
     gtk_label_set_text(GTK_LABEL(tb_math->parameter0_label), _("Set to 0 below:"));
     gtk_widget_show(tb_math->parameter0_label);
     gtk_widget_show(tb_math->parameter0_spin);
@@ -360,6 +412,90 @@ static void maintain_ds1_dim_cb(GtkWidget * widget, gpointer data) {
   return;
 }
 
+/* lists which data set each variable stands for, and checks the expression */
+static void expression_update(tb_math_t * tb_math) {
+
+  AmitkMathExpression * expression;
+  GList * data_sets;
+  GList * temp_data_sets;
+  GString * variables;
+  gchar * error_message=NULL;
+  gint num_data_sets;
+  gint i;
+  gboolean valid;
+
+  data_sets = amitk_object_get_children_of_type(AMITK_OBJECT(tb_math->study), AMITK_OBJECT_TYPE_DATA_SET, TRUE);
+  num_data_sets = g_list_length(data_sets);
+
+  variables = g_string_new(NULL);
+  temp_data_sets = data_sets;
+  for (i=0; (i < AMITK_MATH_EXPRESSION_MAX_VARIABLES) && (temp_data_sets != NULL); i++) {
+    g_string_append_printf(variables, "%s%c = %s", (i == 0) ? "" : "\n",
+			   amitk_math_expression_variable_name(i),
+			   AMITK_OBJECT_NAME(temp_data_sets->data));
+    temp_data_sets = temp_data_sets->next;
+  }
+  gtk_label_set_text(GTK_LABEL(tb_math->expression_variables_label), variables->str);
+  g_string_free(variables, TRUE);
+
+  if (data_sets != NULL)
+    data_sets = amitk_objects_unref(data_sets);
+
+  /* see if we can use the expression */
+  expression = amitk_math_expression_new((tb_math->expression != NULL) ? tb_math->expression : "",
+					 &error_message);
+  valid = (expression != NULL);
+  if (valid) {
+    for (i=num_data_sets; i < AMITK_MATH_EXPRESSION_MAX_VARIABLES; i++)
+      if (amitk_math_expression_uses_variable(expression, i)) {
+	error_message = g_strdup_printf(_("There is no data set %c"),
+					amitk_math_expression_variable_name(i));
+	valid = FALSE;
+	break;
+      }
+    for (i=0; i < AMITK_MATH_EXPRESSION_MAX_VARIABLES; i++)
+      if (amitk_math_expression_uses_variable(expression, i))
+	break;
+    if (valid && (i == AMITK_MATH_EXPRESSION_MAX_VARIABLES)) {
+      error_message = g_strdup(_("The expression needs to use at least one data set"));
+      valid = FALSE;
+    }
+    amitk_math_expression_free(expression);
+  }
+
+  gtk_label_set_text(GTK_LABEL(tb_math->expression_error_label), 
+		     (error_message != NULL) ? error_message : "");
+  if (error_message != NULL)
+    g_free(error_message);
+
+  gtk_assistant_set_page_complete(GTK_ASSISTANT(tb_math->dialog),
+				  tb_math->page[PARAMETERS_PAGE], valid);
+
+  return;
+}
+
+static void expression_changed_cb(GtkWidget * widget, gpointer data) {
+  tb_math_t * tb_math = data;
+
+  if (tb_math->expression != NULL)
+    g_free(tb_math->expression);
+  tb_math->expression = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+  expression_update(tb_math);
+
+  return;
+}
+
+/* the expression picks its data sets by letter, so skips the data set page */
+static gint forward_page_function (gint current_page, gpointer data) {
+
+  tb_math_t * tb_math=data;
+
+  if ((current_page == OPERATION_PAGE) && (tb_math->operation == EXPRESSION_OPERATION))
+    return PARAMETERS_PAGE;
+  else
+    return current_page+1;
+}
+
 
 static void prepare_page_cb(GtkAssistant * wizard, GtkWidget * page, gpointer data) {
  
@@ -404,7 +540,19 @@ static void apply_cb(GtkAssistant * assistant, gpointer data) {
 
   /* apply the math */
 
-  if (tb_math->operation < AMITK_OPERATION_UNARY_NUM) {
+  if (tb_math->operation == EXPRESSION_OPERATION) {
+    GList * data_sets;
+    g_return_if_fail(tb_math->expression != NULL); /* sanity check */
+    data_sets = amitk_object_get_children_of_type(AMITK_OBJECT(tb_math->study), AMITK_OBJECT_TYPE_DATA_SET, TRUE);
+    output_ds = amitk_data_sets_math_expression(data_sets,
+						tb_math->expression,
+						tb_math->by_frames,
+						tb_math->maintain_ds1_dim,
+						amitk_progress_dialog_update,
+						tb_math->progress_dialog);
+    if (data_sets != NULL)
+      data_sets = amitk_objects_unref(data_sets);
+  } else if (tb_math->operation < AMITK_OPERATION_UNARY_NUM) {
     output_ds = amitk_data_sets_math_unary(tb_math->ds1, 
 					   tb_math->operation,
 					   tb_math->parameter0,
@@ -485,6 +633,11 @@ static tb_math_t * tb_math_free(tb_math_t * tb_math) {
       tb_math->ds2 = NULL;
     }
 
+    if (tb_math->expression != NULL) {
+      g_free(tb_math->expression);
+      tb_math->expression = NULL;
+    }
+
     if (tb_math->progress_dialog != NULL) {
       g_signal_emit_by_name(G_OBJECT(tb_math->progress_dialog), "delete_event", NULL, &return_val);
       tb_math->progress_dialog = NULL;
@@ -520,6 +673,7 @@ static tb_math_t * tb_math_init(void) {
   tb_math->parameter1 = 0.0;
   tb_math->by_frames = FALSE;
   tb_math->maintain_ds1_dim = FALSE;
+  tb_math->expression = NULL;
 
   return tb_math;
 }
@@ -627,6 +781,33 @@ static GtkWidget * create_parameters_page(tb_math_t * tb_math) {
   table = gtk_table_new(3,2,FALSE);
 
 
+  tb_math->expression_help_label = gtk_label_new(_(expression_text));
+  gtk_widget_set_size_request(tb_math->expression_help_label, LABEL_WIDTH, -1);
+  gtk_label_set_line_wrap(GTK_LABEL(tb_math->expression_help_label), TRUE);
+  gtk_table_attach(GTK_TABLE(table), tb_math->expression_help_label, 0,2, table_row,table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+  table_row++;
+
+  tb_math->expression_entry = gtk_entry_new();
+  gtk_entry_set_activates_default(GTK_ENTRY(tb_math->expression_entry), TRUE);
+  g_signal_connect(G_OBJECT(tb_math->expression_entry), "changed",
+		   G_CALLBACK(expression_changed_cb), tb_math);
+  gtk_table_attach(GTK_TABLE(table), tb_math->expression_entry, 0,2, table_row,table_row+1,
+		   GTK_FILL|GTK_EXPAND, 0, X_PADDING, Y_PADDING);
+  table_row++;
+
+  tb_math->expression_error_label = gtk_label_new(NULL); /* set in expression_update */
+  gtk_misc_set_alignment(GTK_MISC(tb_math->expression_error_label), 0.0, 0.5);
+  gtk_table_attach(GTK_TABLE(table), tb_math->expression_error_label, 0,2, table_row,table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+  table_row++;
+
+  tb_math->expression_variables_label = gtk_label_new(NULL); /* set in expression_update */
+  gtk_misc_set_alignment(GTK_MISC(tb_math->expression_variables_label), 0.0, 0.5);
+  gtk_table_attach(GTK_TABLE(table), tb_math->expression_variables_label, 0,2, table_row,table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+  table_row++;
+
   tb_math->parameter0_label = gtk_label_new(NULL); /* label set in parameter_page_update function */
   gtk_table_attach(GTK_TABLE(table), tb_math->parameter0_label, 0,1, table_row,table_row+1,
 		   FALSE, FALSE, X_PADDING, Y_PADDING);
@@ -701,6 +882,9 @@ void tb_math(AmitkStudy * study, GtkWindow * parent) {
   g_signal_connect(G_OBJECT(tb_math->dialog), "close", G_CALLBACK(close_cb), tb_math);
   g_signal_connect(G_OBJECT(tb_math->dialog), "apply", G_CALLBACK(apply_cb), tb_math);
   g_signal_connect(G_OBJECT(tb_math->dialog), "prepare",  G_CALLBACK(prepare_page_cb), tb_math);
+  gtk_assistant_set_forward_page_func(GTK_ASSISTANT(tb_math->dialog),
+				      forward_page_function,
+				      tb_math, NULL);
 
 
   tb_math->progress_dialog = amitk_progress_dialog_new(GTK_WINDOW(tb_math->dialog));
@@ -740,7 +924,7 @@ void tb_math(AmitkStudy * study, GtkWindow * parent) {
   gtk_assistant_append_page(GTK_ASSISTANT(tb_math->dialog), tb_math->page[PARAMETERS_PAGE]);
   gtk_assistant_set_page_title(GTK_ASSISTANT(tb_math->dialog), tb_math->page[PARAMETERS_PAGE], 
 			       _("Parameter Selection"));
-  gtk_assistant_set_page_complete(GTK_ASSISTANT(tb_math->dialog),tb_math->page[PARAMETERS_PAGE], TRUE);
+  gtk_assistant_set_page_complete(GTK_ASSISTANT(tb_math->dialog),tb_math->page[PARAMETERS_PAGE], TRUE); /* updated for expressions */
 
   /* ----------------  conclusion page ---------------------------------- */
   tb_math->page[CONCLUSION_PAGE] = gtk_label_new("");
@@ -30,6 +30,7 @@
 #include "amide.h"
 #include "amide_gconf.h"
 #include "amitk_common.h"
+#include "amitk_progress_dialog.h"
 #include "analysis.h"
 #include "tb_roi_analysis.h"
 #include "ui_common.h"
@@ -178,6 +179,21 @@ static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_data)
   return;
 }
 
+/* for sorting indices into an array of values, highest value first */
+static gint value_comparison(gconstpointer a, gconstpointer b, gpointer data) {
+
+  const amide_data_t * values = data;
+  amide_data_t value_a = values[*((const guint *) a)];
+  amide_data_t value_b = values[*((const guint *) b)];
+
+  if (value_a > value_b) 
+    return -1;
+  else if (value_a < value_b) 
+    return 1;
+  else
+    return 0;
+}
+
 static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_analyses, gboolean raw_data) {
 
   FILE * file_pointer;
@@ -191,7 +207,8 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
   amide_real_t voxel_volume;
   gboolean title_printed;
   AmitkPoint location;
-  analysis_element_t * element;
+  guint * order;
+  guint j;
 
   /* sanity checks */
   g_return_if_fail(save_filename != NULL);
@@ -318,12 +335,21 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
 	  } else { /* raw data */
 	    fprintf(file_pointer, "#   Frame %d, Gate %d, Gate Time %5.3f\n", frame, gate,gate_analyses->gate_time);
 	    fprintf(file_pointer, "#      Value\t      Weight\t      X (mm)\t      Y (mm)\t      Z (mm)\n");
-	    for (i=0; i < gate_analyses->data_array->len; i++) {
-	      element = g_ptr_array_index(gate_analyses->data_array, i);
-	      VOXEL_TO_POINT(element->ds_voxel, AMITK_DATA_SET_VOXEL_SIZE(volume_analyses->data_set),location);
+	    /* write them out from highest value to lowest */
+	    order = g_new(guint, gate_analyses->data.len);
+	    for (i=0; i < gate_analyses->data.len; i++)
+	      order[i] = i;
+	    g_qsort_with_data(order, gate_analyses->data.len, sizeof(guint), 
+			      value_comparison, gate_analyses->data.values);
+	    for (i=0; i < gate_analyses->data.len; i++) {
+	      j = order[i];
+	      VOXEL_TO_POINT(gate_analyses->data.ds_voxels[j], AMITK_DATA_SET_VOXEL_SIZE(volume_analyses->data_set),location);
 	      location = amitk_space_s2b(AMITK_SPACE(volume_analyses->data_set), location);
-	      fprintf(file_pointer, "%12g\t%12g\t%12g\t%12g\t%12g\n", element->value, element->weight, location.x, location.y, location.z);
+	      fprintf(file_pointer, "%12g\t%12g\t%12g\t%12g\t%12g\n", 
+		      gate_analyses->data.values[j], gate_analyses->data.weights[j], 
+		      location.x, location.y, location.z);
 	    }
+	    g_free(order);
 	  }
 
 	  gate_analyses = gate_analyses->next_gate_analysis;
@@ -767,13 +793,16 @@ static tb_roi_analysis_t * tb_roi_analysis_init(void) {
 }
 
 
-void tb_roi_analysis(AmitkStudy * study, AmitkPreferences * preferences, GtkWindow * parent) {
+void tb_roi_analysis(AmitkStudy * study, AmitkDataSet * label_map,
+		     AmitkPreferences * preferences, GtkWindow * parent) {
 
   tb_roi_analysis_t * tb_roi_analysis;
   GtkWidget * notebook;
   gchar * title;
   GList * rois;
   GList * data_sets;
+  GtkWidget * progress_dialog;
+  gboolean return_val;
 
   gboolean all_data_sets;
   gboolean all_rois;
@@ -797,31 +826,53 @@ void tb_roi_analysis(AmitkStudy * study, AmitkPreferences * preferences, GtkWind
     data_sets = amitk_object_get_selected_children_of_type(AMITK_OBJECT(study), 
 							   AMITK_OBJECT_TYPE_DATA_SET, AMITK_SELECTION_ANY, TRUE);
 
+  /* the label map defines the regions, it's not something to calculate on */
+  if (label_map != NULL) 
+    if (g_list_find(data_sets, label_map) != NULL) {
+      data_sets = g_list_remove(data_sets, label_map);
+      amitk_object_unref(label_map);
+    }
+
   if (data_sets == NULL) {
     g_warning(_("No Data Sets selected for calculating analyses"));
     return;
   }
 
   /* get the list of roi's we're going to be calculating over */
-  if (all_rois)
+  if (label_map != NULL)
+    rois = NULL; /* the rois come from the label map */
+  else if (all_rois)
     rois = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_ROI, TRUE);
   else 
     rois = amitk_object_get_selected_children_of_type(AMITK_OBJECT(study), 
 						      AMITK_OBJECT_TYPE_ROI, AMITK_SELECTION_ANY, TRUE);
 
-  if (rois == NULL) {
+  if ((rois == NULL) && (label_map == NULL)) {
     g_warning(_("No ROI's selected for calculating analyses"));
     amitk_objects_unref(data_sets);
     return;
   }
 
   /* calculate all our data */
-  tb_roi_analysis->roi_analyses = analysis_roi_init(study, rois, data_sets, calculation_type, accurate, 
-						    subfraction, threshold_percentage, threshold_value);
+  progress_dialog = amitk_progress_dialog_new(parent);
+  if (label_map != NULL)
+    tb_roi_analysis->roi_analyses = 
+      analysis_roi_init_from_label_map(study, label_map, data_sets, calculation_type, accurate, 
+				       subfraction, threshold_percentage, threshold_value,
+				       amitk_progress_dialog_update, progress_dialog);
+  else
+    tb_roi_analysis->roi_analyses = 
+      analysis_roi_init(study, rois, data_sets, calculation_type, accurate, 
+			subfraction, threshold_percentage, threshold_value,
+			amitk_progress_dialog_update, progress_dialog);
+  g_signal_emit_by_name(G_OBJECT(progress_dialog), "delete_event", NULL, &return_val);
 
   rois = amitk_objects_unref(rois);
   data_sets = amitk_objects_unref(data_sets);
-  g_return_if_fail(tb_roi_analysis->roi_analyses != NULL);
+  if (tb_roi_analysis->roi_analyses == NULL) { /* canceled */
+    tb_roi_analysis_free(tb_roi_analysis);
+    return;
+  }
   
   /* start setting up the widget we'll display the info from */
   title = g_strdup_printf(_("%s Roi Analysis: Study %s"), PACKAGE, 
@@ -899,6 +950,35 @@ static void calculation_type_cb(GtkWidget * widget, gpointer data) {
   amide_gconf_set_int(GCONF_AMIDE_ANALYSIS,"CalculationType", calculation_type);
 }
 
+/* the chosen label map gets stored on the dialog */
+static void label_map_cb(GtkWidget * widget, gpointer data) {
+
+  GtkWidget * dialog = data;
+  GList * data_sets;
+  gint which;
+
+  which = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+  data_sets = g_object_get_data(G_OBJECT(widget), "data_sets");
+  
+  if (which <= 0) /* first entry is no label map */
+    g_object_set_data(G_OBJECT(dialog), "label_map", NULL);
+  else
+    g_object_set_data(G_OBJECT(dialog), "label_map", g_list_nth_data(data_sets, which-1));
+
+  return;
+}
+
+static void label_map_destroy_cb(GtkWidget * widget, gpointer data) {
+
+  GList * data_sets;
+
+  data_sets = g_object_get_data(G_OBJECT(widget), "data_sets");
+  amitk_objects_unref(data_sets);
+  g_object_set_data(G_OBJECT(widget), "data_sets", NULL);
+
+  return;
+}
+
 static void accurate_cb(GtkWidget * widget, gpointer data) {
   amide_gconf_set_bool(GCONF_AMIDE_ANALYSIS,"Accurate", 
 		       gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)));
@@ -940,8 +1020,10 @@ static void threshold_value_cb(GtkWidget * widget, gpointer data) {
 }
 
 
-/* function to setup a dialog to allow us to choice options for rendering */
-GtkWidget * tb_roi_analysis_init_dialog(GtkWindow * parent) {
+/* function to setup a dialog to allow us to choice options for rendering.
+   The label map picked by the user, if any, can be retrieved with
+   g_object_get_data(G_OBJECT(dialog), "label_map") */
+GtkWidget * tb_roi_analysis_init_dialog(AmitkStudy * study, GtkWindow * parent) {
   
   GtkWidget * tb_roi_init_dialog;
   gchar * temp_string;
@@ -953,6 +1035,10 @@ GtkWidget * tb_roi_analysis_init_dialog(GtkWindow * parent) {
   GtkObject * adjustment;
   GtkWidget * spin_buttons[3];
   GtkWidget * check_button;
+  GtkWidget * combo_box;
+  GList * data_sets;
+  GList * study_data_sets;
+  GList * temp_data_sets;
   analysis_calculation_t i_calculation_type;
   gboolean all_data_sets;
   gboolean all_rois;
@@ -1045,6 +1131,29 @@ GtkWidget * tb_roi_analysis_init_dialog(GtkWindow * parent) {
   g_signal_connect(G_OBJECT(radio_button[2]), "clicked", G_CALLBACK(radio_buttons_cb), NULL);
   g_signal_connect(G_OBJECT(radio_button[3]), "clicked", G_CALLBACK(radio_buttons_cb), NULL);
 
+  /* instead of rois, a data set of integer labels can be used to define the regions */
+  label = gtk_label_new(_("Regions From Label Map:"));
+  gtk_table_attach(GTK_TABLE(table), label, 0,1, 
+		   table_row, table_row+1, X_PACKING_OPTIONS, 0, X_PADDING, Y_PADDING);
+
+  combo_box = gtk_combo_box_new_text();
+  gtk_combo_box_append_text(GTK_COMBO_BOX(combo_box), _("None (use ROIs)"));
+  study_data_sets = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_DATA_SET, TRUE);
+  data_sets = NULL; /* only the ones that are stored as integers can be label maps */
+  for (temp_data_sets = study_data_sets; temp_data_sets != NULL; temp_data_sets = temp_data_sets->next)
+    if (amitk_rois_label_map_valid(temp_data_sets->data)) {
+      data_sets = g_list_append(data_sets, amitk_object_ref(temp_data_sets->data));
+      gtk_combo_box_append_text(GTK_COMBO_BOX(combo_box), AMITK_OBJECT_NAME(temp_data_sets->data));
+    }
+  amitk_objects_unref(study_data_sets);
+  gtk_combo_box_set_active(GTK_COMBO_BOX(combo_box), 0);
+  g_object_set_data(G_OBJECT(combo_box), "data_sets", data_sets);
+  g_signal_connect(G_OBJECT(combo_box), "changed", G_CALLBACK(label_map_cb), tb_roi_init_dialog);
+  g_signal_connect(G_OBJECT(combo_box), "destroy", G_CALLBACK(label_map_destroy_cb), NULL);
+  gtk_table_attach(GTK_TABLE(table), combo_box, 1,3, 
+		   table_row, table_row+1, GTK_FILL, 0, X_PADDING, Y_PADDING);
+  table_row++;
+
 
   /* a separator for clarity */
   hseparator = gtk_hseparator_new();
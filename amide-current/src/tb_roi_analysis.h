@@ -31,8 +31,9 @@
 #include "amitk_study.h"
 
 /* external functions */
-void tb_roi_analysis(AmitkStudy * study, AmitkPreferences * preferences, GtkWindow * parent);
-GtkWidget * tb_roi_analysis_init_dialog(GtkWindow * parent);
+void tb_roi_analysis(AmitkStudy * study, AmitkDataSet * label_map,
+		     AmitkPreferences * preferences, GtkWindow * parent);
+GtkWidget * tb_roi_analysis_init_dialog(AmitkStudy * study, GtkWindow * parent);
 
 
 #endif /* __TB_ROI_ANALYSIS_DIALOG_H__ */
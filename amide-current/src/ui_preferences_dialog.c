@@ -61,6 +61,12 @@ static void target_empty_area_cb(GtkWidget * widget, gpointer data);
 static void threshold_style_cb(GtkWidget * widget, gpointer data);
 
 static void warnings_to_console_cb(GtkWidget * widget, gpointer data);
+#ifdef AMIDE_ZLIB_SUPPORT
+static void save_xif_compressed_cb(GtkWidget * widget, gpointer data);
+#endif
+#ifdef AMIDE_LIBDCMDATA_SUPPORT
+static void dicom_use_index_cb(GtkWidget * widget, gpointer data);
+#endif
 static void save_on_exit_cb(GtkWidget * widget, gpointer data);
 static void which_default_directory_cb(GtkWidget * widget, gpointer data);
 static void default_directory_cb(GtkWidget * fc, gpointer data);
@@ -201,6 +207,27 @@ static void warnings_to_console_cb(GtkWidget * widget, gpointer data) {
 }
 
 
+#ifdef AMIDE_ZLIB_SUPPORT
+static void save_xif_compressed_cb(GtkWidget * widget, gpointer data) {
+
+  ui_study_t * ui_study = data;
+  amitk_preferences_set_save_xif_compressed(ui_study->preferences, 
+					    gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)));
+  return;
+}
+#endif
+
+#ifdef AMIDE_LIBDCMDATA_SUPPORT
+static void dicom_use_index_cb(GtkWidget * widget, gpointer data) {
+
+  ui_study_t * ui_study = data;
+  amitk_preferences_set_dicom_use_index(ui_study->preferences, 
+					gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)));
+  return;
+}
+#endif
+
+
 static void save_on_exit_cb(GtkWidget * widget, gpointer data) {
 
   ui_study_t * ui_study = data;
@@ -579,6 +606,38 @@ void ui_preferences_dialog_create(ui_study_t * ui_study) {
 		   GTK_FILL, 0, X_PADDING, Y_PADDING);
   table_row++;
 
+#ifdef AMIDE_ZLIB_SUPPORT
+  label = gtk_label_new(_("Compress Data in Saved .xif Files:"));
+  gtk_table_attach(GTK_TABLE(packing_table), label, 
+		   0,1, table_row, table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+
+  check_button = gtk_check_button_new();
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), 
+			       AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(ui_study->preferences));
+  g_signal_connect(G_OBJECT(check_button), "toggled", G_CALLBACK(save_xif_compressed_cb), ui_study);
+  gtk_table_attach(GTK_TABLE(packing_table), check_button, 
+		   1,2, table_row, table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+  table_row++;
+#endif
+
+#ifdef AMIDE_LIBDCMDATA_SUPPORT
+  label = gtk_label_new(_("Keep an Index of Scanned DICOM Directories:"));
+  gtk_table_attach(GTK_TABLE(packing_table), label, 
+		   0,1, table_row, table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+
+  check_button = gtk_check_button_new();
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), 
+			       AMITK_PREFERENCES_DICOM_USE_INDEX(ui_study->preferences));
+  g_signal_connect(G_OBJECT(check_button), "toggled", G_CALLBACK(dicom_use_index_cb), ui_study);
+  gtk_table_attach(GTK_TABLE(packing_table), check_button, 
+		   1,2, table_row, table_row+1,
+		   GTK_FILL, 0, X_PADDING, Y_PADDING);
+  table_row++;
+#endif
+
 
   label = gtk_label_new(_("Which Default Directory:"));
   gtk_table_attach(GTK_TABLE(packing_table), label, 
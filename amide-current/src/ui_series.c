@@ -65,8 +65,6 @@ static gchar * series_explanations[] = {
 typedef struct ui_series_t {
   GtkWindow * window;
   GtkWidget * window_vbox;
-  GList * slice_cache;
-  gint max_slice_cache_size;
   GList * objects;
   AmitkDataSet * active_ds;
   GtkWidget * canvas;
@@ -113,6 +111,7 @@ typedef struct ui_series_t {
 
   guint next_update;
   guint idle_handler_id;
+  gint last_start_i; /* first image shown last time, for guessing the next page */
 
   guint reference_count;
 } ui_series_t;
@@ -282,10 +281,6 @@ static void color_table_changed_cb(gpointer dummy, AmitkViewMode view_mode, gpoi
 static void data_set_invalidate_slice_cache(AmitkDataSet *ds, gpointer data) {
   ui_series_t * ui_series=data;
 
-  if (ui_series->slice_cache != NULL) {
-    ui_series->slice_cache = amitk_objects_unref(ui_series->slice_cache);
-  }
-
   add_update(ui_series);
   return;
 }
@@ -469,6 +464,8 @@ static ui_series_t * ui_series_unref(ui_series_t * ui_series) {
       ui_series->idle_handler_id = 0;
     }
 
+    amitk_data_sets_prefetch_cancel(ui_series);
+
     if (ui_series->active_ds != NULL) 
       ui_series->active_ds = amitk_object_unref(ui_series->active_ds);
 
@@ -492,10 +489,6 @@ static ui_series_t * ui_series_unref(ui_series_t * ui_series) {
       ui_series->objects = NULL;
     }
 
-    if (ui_series->slice_cache != NULL) {
-      ui_series->slice_cache = amitk_objects_unref(ui_series->slice_cache);
-    }
-
     if (ui_series->volume != NULL) {
       amitk_object_unref(ui_series->volume);
       ui_series->volume = NULL;
@@ -566,8 +559,6 @@ static ui_series_t * ui_series_init(GtkWindow * window, GtkWidget * window_vbox)
   /* set any needed parameters */
   ui_series->window = window;
   ui_series->window_vbox = window_vbox;
-  ui_series->slice_cache = NULL;
-  ui_series->max_slice_cache_size=10;
   ui_series->num_slices = 0;
   ui_series->rows = 0;
   ui_series->columns = 0;
@@ -612,6 +603,7 @@ static ui_series_t * ui_series_init(GtkWindow * window, GtkWidget * window_vbox)
 
   ui_series->next_update = UPDATE_NONE;
   ui_series->idle_handler_id = 0;
+  ui_series->last_start_i = -1;
 
   return ui_series;
 }
@@ -658,6 +650,65 @@ static void add_update(ui_series_t * ui_series) {
 }
 
 
+/* start generating the slices for the page of images beginning at start_i,
+   so that paging over to it goes quickly */
+static void prefetch_page(ui_series_t * ui_series, gint start_i) {
+
+  AmitkPoint temp_point;
+  amide_time_t temp_time, temp_duration;
+  gint temp_gate;
+  AmitkCanvasPoint pixel_size;
+  AmitkVolume * view_volume;
+  gint i;
+
+  if (start_i < 0) start_i = 0;
+
+  temp_point = zero_point;
+  temp_gate = -1;
+  temp_time = ui_series->view_time;
+  temp_duration = ui_series->view_duration;
+  if (ui_series->series_type == OVER_FRAMES) {
+    temp_time = ui_series->start_time;
+    for (i=0;i< start_i; i++)
+      temp_time += ui_series->frame_durations[i];
+  }
+  pixel_size.x = pixel_size.y = ui_series->pixel_dim;
+
+  view_volume = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(ui_series->volume)));
+
+  for (i=start_i; 
+       ((i-start_i) < (ui_series->rows*ui_series->columns)) && (i < ui_series->num_slices);
+       i++) {
+
+    switch (ui_series->series_type) {
+    case OVER_GATES:
+      temp_gate=i;
+      break;
+    case OVER_FRAMES:
+      if (i > start_i) temp_time += temp_duration;
+      temp_duration = ui_series->frame_durations[i];
+      break;
+    case OVER_SPACE:
+    default:
+      temp_point.z = i*AMITK_VOLUME_Z_CORNER(ui_series->volume)+ui_series->start_z;
+      break;
+    }
+
+    amitk_space_set_offset(AMITK_SPACE(view_volume), 
+			   amitk_space_s2b(AMITK_SPACE(ui_series->volume), temp_point));
+
+    if (!amitk_data_sets_prefetch_slices(ui_series, ui_series->objects,
+					 temp_time+EPSILON*fabs(temp_time),
+					 temp_duration-EPSILON*fabs(temp_duration),
+					 temp_gate, pixel_size, view_volume))
+      break; /* out of room */
+  }
+
+  amitk_object_unref(view_volume);
+
+  return;
+}
+
 /* funtion to update the canvas */
 static gboolean update_immediate(gpointer data) {
 
@@ -824,8 +875,6 @@ static gboolean update_immediate(gpointer data) {
 
     if (amitk_objects_has_type(ui_series->objects, AMITK_OBJECT_TYPE_DATA_SET, FALSE)) {
       pixbuf = image_from_data_sets(NULL,
-				    &(ui_series->slice_cache),
-				    ui_series->max_slice_cache_size,
 				    ui_series->objects,
 				    ui_series->active_ds,
 				    temp_time+EPSILON*fabs(temp_time),
@@ -926,6 +975,17 @@ static gboolean update_immediate(gpointer data) {
   }
   amitk_object_unref(view_volume);
 
+  /* guess that the next page wanted is further along in the same direction */
+  amitk_data_sets_prefetch_cancel(ui_series);
+  if (can_continue && !ui_series->quit_generation &&
+      amitk_objects_has_type(ui_series->objects, AMITK_OBJECT_TYPE_DATA_SET, FALSE)) {
+    if ((start_i < ui_series->last_start_i) && (start_i > 0))
+      prefetch_page(ui_series, start_i-ui_series->rows*ui_series->columns);
+    else if (start_i+ui_series->rows*ui_series->columns < ui_series->num_slices)
+      prefetch_page(ui_series, start_i+ui_series->rows*ui_series->columns);
+  }
+  ui_series->last_start_i = start_i;
+
   return_val = FALSE;
 
 
@@ -1239,8 +1299,6 @@ void ui_series_create(AmitkStudy * study,
     break;
   }
 
-  ui_series->max_slice_cache_size = ui_series->num_slices*num_data_sets+5;
-
   /* connect the thresholding and color table signals */
   temp_objects = ui_series->objects;
   while (temp_objects != NULL) {
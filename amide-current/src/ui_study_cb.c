@@ -391,7 +391,8 @@ void save_xif(ui_study_t * ui_study, gboolean as_directory) {
   ui_common_place_cursor(UI_CURSOR_WAIT, ui_study->canvas[AMITK_VIEW_MODE_SINGLE][AMITK_VIEW_TRANSVERSE]);
 
   /* allright, save our study */
-  if (amitk_study_save_xml(ui_study->study, final_filename, as_directory) == FALSE) {
+  if (amitk_study_save_xml(ui_study->study, final_filename, as_directory,
+			   AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(ui_study->preferences)) == FALSE) {
     g_warning(_("Failure Saving File: %s"),final_filename);
   } else {
 
@@ -1040,20 +1041,26 @@ void ui_study_cb_roi_statistics(GtkAction * action, gpointer data) {
   ui_study_t * ui_study = data;
   GtkWidget * dialog;
   gint return_val;
+  AmitkDataSet * label_map;
 
   /* let the user input roi analysis options */
-  dialog = tb_roi_analysis_init_dialog(ui_study->window);
+  dialog = tb_roi_analysis_init_dialog(ui_study->study, ui_study->window);
 
   /* and wait for the question to return */
   return_val = gtk_dialog_run(GTK_DIALOG(dialog));
 
+  label_map = g_object_get_data(G_OBJECT(dialog), "label_map");
+  if (label_map != NULL) amitk_object_ref(label_map);
   gtk_widget_destroy(dialog);
-  if (return_val != AMITK_RESPONSE_EXECUTE)
+  if (return_val != AMITK_RESPONSE_EXECUTE) {
+    if (label_map != NULL) amitk_object_unref(label_map);
     return; /* we hit cancel */
+  }
 
   ui_common_place_cursor(UI_CURSOR_WAIT, ui_study->canvas[AMITK_VIEW_MODE_SINGLE][AMITK_VIEW_TRANSVERSE]);
-  tb_roi_analysis(ui_study->study, ui_study->preferences, ui_study->window);
+  tb_roi_analysis(ui_study->study, label_map, ui_study->preferences, ui_study->window);
   ui_common_remove_wait_cursor(ui_study->canvas[AMITK_VIEW_MODE_SINGLE][AMITK_VIEW_TRANSVERSE]);
+  if (label_map != NULL) amitk_object_unref(label_map);
 
   return;
 }